@@ -0,0 +1,265 @@
+// gcc benchmarks/generate.c -o generate
+// ./generate program 20000000 > big.pl0         (about 20 MB of statements over 40 variables and an array)
+// ./generate program 20000000 7 40 > wide.pl0   (another seed, statements indented by 40 columns)
+// ./generate symbols 99 > sym100k.pl0           (99 chains of nested procedures: about 101k declarations)
+// ./generate names 400000 > names.pl0           (400k assignments over 1000 long names, about 17 MB)
+// ./generate chains 100000 40 > chains.pl0     (100k assignments, each a chain of 40 operators)
+// ./generate nested 20000 200 > nested.pl0     (20k assignments, each nested 200 parentheses deep)
+// ./generate corpus valid/ 2000                 (valid/p0000.pl0 ... p1999.pl0, about 9.5 KB each)
+//
+// Writes generated PL/0 sources to stdout, or for "corpus" into an existing
+// directory, to measure the analyzers on inputs larger or more numerous than
+// anything in the repository (see benchmarks/README.md). The same arguments
+// always give the same bytes: the generator uses its own random number
+// generator rather than rand().
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define PROGRAM_VARIABLES 40
+#define PROGRAM_ARRAY 64
+#define CORPUS_FILE_BYTES 9500
+#define NAME_VARIABLES 1000
+#define SYMBOL_GLOBALS 1000
+#define SYMBOL_DEPTH 10         // Procedures nested in one chain
+#define SYMBOL_LOCALS 100       // Locals of each procedure
+#define SYMBOL_ASSIGNMENTS 200  // Assignments in each body
+
+static uint32_t randomState = 1;
+
+static void seedRandom(uint32_t seed) {
+    randomState = seed != 0 ? seed : 1;
+}
+
+// xorshift32, uniform enough for picking statements and operands.
+static uint32_t nextRandom(uint32_t bound) {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState % bound;
+}
+
+static int chance(int percent) {
+    return (int)nextRandom(100) < percent;
+}
+
+// A random expression, at most three operators deep. Division and modulo
+// only ever divide by a nonzero constant.
+static size_t writeExpression(FILE *out, int depth) {
+    if (depth > 2 || chance(30)) {
+        switch (nextRandom(4)) {
+            case 0: return (size_t)fprintf(out, "v%u", nextRandom(PROGRAM_VARIABLES));
+            case 1: return (size_t)fprintf(out, "%u", nextRandom(1000));
+            case 2: return (size_t)fprintf(out, "k");
+            default: return (size_t)fprintf(out, "arr[%u]", nextRandom(PROGRAM_ARRAY));
+        }
+    }
+    char op = "+-*/%"[nextRandom(5)];
+    size_t n = (size_t)fprintf(out, "(");
+    n += writeExpression(out, depth + 1);
+    if (op == '/' || op == '%') {
+        n += (size_t)fprintf(out, " %c %u)", op, 1 + nextRandom(49));
+    } else {
+        n += (size_t)fprintf(out, " %c ", op);
+        n += writeExpression(out, depth + 1);
+        n += (size_t)fprintf(out, ")");
+    }
+    return n;
+}
+
+// One program of about 'bytes' bytes: a long main block of assignments, IFs,
+// FOR and WHILE loops and output, each statement on a line of its own.
+static void generateProgram(FILE *out, size_t bytes, int indent) {
+    size_t size = (size_t)fprintf(out, "PROGRAM Big;\nCONST k = 7, lim = 100;\nVAR ");
+    for (int v = 0; v < PROGRAM_VARIABLES; v++) {
+        size += (size_t)fprintf(out, "v%d, ", v);
+    }
+    size += (size_t)fprintf(out, "arr[%d], i;\nBEGIN\n", PROGRAM_ARRAY);
+    while (size < bytes) {
+        size += (size_t)fprintf(out, "%*s", indent, "");
+        int kind = (int)nextRandom(100);
+        if (kind < 60) {
+            size += (size_t)fprintf(out, "v%u := ", nextRandom(PROGRAM_VARIABLES));
+            size += writeExpression(out, 0);
+        } else if (kind < 75) {
+            size += (size_t)fprintf(out, "IF v%u <= ", nextRandom(PROGRAM_VARIABLES));
+            size += writeExpression(out, 0);
+            size += (size_t)fprintf(out, " THEN v%u := v%u + 1", nextRandom(PROGRAM_VARIABLES),
+                                    nextRandom(PROGRAM_VARIABLES));
+        } else if (kind < 85) {
+            size += (size_t)fprintf(out, "FOR i := 0 TO %d DO arr[i] := arr[i] + v%u", PROGRAM_ARRAY - 1,
+                                    nextRandom(PROGRAM_VARIABLES));
+        } else if (kind < 95) {
+            size += (size_t)fprintf(out, "WHILE v%u > lim DO v%u := v%u - k", nextRandom(PROGRAM_VARIABLES),
+                                    nextRandom(PROGRAM_VARIABLES), nextRandom(PROGRAM_VARIABLES));
+        } else {
+            size += (size_t)fprintf(out, "CALL WRITELN(v%u)", nextRandom(PROGRAM_VARIABLES));
+        }
+        size += (size_t)fprintf(out, ";\n");
+    }
+    fprintf(out, "%*sv0 := 0\nEND.\n", indent, "");
+}
+
+// A valid program made mostly of identifiers: 'assignments' sums of three of
+// NAME_VARIABLES variables with names of ten characters or more.
+static void generateNames(FILE *out, long assignments) {
+    fprintf(out, "PROGRAM p;\nVAR ");
+    for (int v = 0; v < NAME_VARIABLES; v++) {
+        fprintf(out, v + 1 < NAME_VARIABLES ? "v%dabcdefg, " : "v%dabcdefg;\n", v);
+    }
+    fprintf(out, "BEGIN\n");
+    for (long i = 0; i < assignments; i++) {
+        fprintf(out, "  v%uabcdefg := v%uabcdefg + v%uabcdefg;\n", nextRandom(NAME_VARIABLES),
+                nextRandom(NAME_VARIABLES), nextRandom(NAME_VARIABLES));
+    }
+    fprintf(out, "  v0abcdefg := 1\nEND.\n");
+}
+
+// The name of variable 'v' among those visible in chain 'chain':
+// the globals first, then the locals of each enclosing procedure.
+static int writeVisible(FILE *out, int chain, int v) {
+    if (v < SYMBOL_GLOBALS) {
+        return fprintf(out, "g%d", v);
+    }
+    v -= SYMBOL_GLOBALS;
+    return fprintf(out, "c%dd%dv%d", chain, v / SYMBOL_LOCALS, v % SYMBOL_LOCALS);
+}
+
+static void writeSymbolBody(FILE *out, int chain, int depth) {
+    int visible = SYMBOL_GLOBALS + (depth + 1) * SYMBOL_LOCALS;
+    fprintf(out, "BEGIN\n");
+    for (int i = 0; i < SYMBOL_ASSIGNMENTS; i++) {
+        writeVisible(out, chain, (int)nextRandom((uint32_t)visible));
+        fprintf(out, " := ");
+        writeVisible(out, chain, (int)nextRandom((uint32_t)visible));
+        fprintf(out, " + ");
+        writeVisible(out, chain, (int)nextRandom((uint32_t)visible));
+        fprintf(out, i + 1 < SYMBOL_ASSIGNMENTS ? ";\n" : "\n");
+    }
+    fprintf(out, "END");
+}
+
+// A program with a large symbol table: SYMBOL_GLOBALS globals and 'chains'
+// chains of SYMBOL_DEPTH procedures, each nested in the one before and
+// declaring SYMBOL_LOCALS locals. Every body assigns sums of names from all
+// the scopes it sees, so lookups resolve at every nesting level.
+static void generateSymbols(FILE *out, int chains) {
+    fprintf(out, "PROGRAM big;\nVAR ");
+    for (int v = 0; v < SYMBOL_GLOBALS; v++) {
+        fprintf(out, v + 1 < SYMBOL_GLOBALS ? "g%d, " : "g%d;\n", v);
+    }
+    for (int chain = 0; chain < chains; chain++) {
+        for (int depth = 0; depth < SYMBOL_DEPTH; depth++) {
+            fprintf(out, "PROCEDURE c%dd%d;\nVAR ", chain, depth);
+            for (int v = 0; v < SYMBOL_LOCALS; v++) {
+                fprintf(out, v + 1 < SYMBOL_LOCALS ? "c%dd%dv%d, " : "c%dd%dv%d;\n", chain, depth, v);
+            }
+        }
+        for (int depth = SYMBOL_DEPTH - 1; depth >= 0; depth--) {
+            writeSymbolBody(out, chain, depth);
+            fprintf(out, ";\n");
+        }
+    }
+    writeSymbolBody(out, 0, -1);
+    fprintf(out, ".\n");
+}
+
+static const char *const expressionOperands[] = {"x", "y", "7", "3"};
+
+// The opening of a program of long expressions, one assignment to y per line.
+static void beginExpressions(FILE *out) {
+    fprintf(out, "PROGRAM b;\nVAR x, y;\nBEGIN\nx := 1;\n");
+}
+
+static void endExpressions(FILE *out) {
+    fprintf(out, "x := 0\nEND.\n");
+}
+
+// 'statements' assignments of 'operators' binary operators in a row, mixing
+// both precedence levels, so the parser climbs and falls back all the time.
+static void generateChains(FILE *out, long statements, int operators) {
+    beginExpressions(out);
+    for (long i = 0; i < statements; i++) {
+        fprintf(out, "y := x");
+        for (int j = 0; j < operators; j++) {
+            fprintf(out, "%c%s", "+-*/%"[nextRandom(5)], expressionOperands[nextRandom(4)]);
+        }
+        fprintf(out, ";\n");
+    }
+    endExpressions(out);
+}
+
+// 'statements' assignments nested 'depth' parentheses deep: (((x+y)*7)-3)...
+static void generateNested(FILE *out, long statements, int depth) {
+    beginExpressions(out);
+    for (long i = 0; i < statements; i++) {
+        fprintf(out, "y := ");
+        for (int j = 0; j < depth; j++) {
+            fputc('(', out);
+        }
+        fprintf(out, "x");
+        for (int j = 0; j < depth; j++) {
+            fprintf(out, "%c%s)", "+-*/%"[nextRandom(5)], expressionOperands[nextRandom(4)]);
+        }
+        fprintf(out, ";\n");
+    }
+    endExpressions(out);
+}
+
+// 'files' programs of 'bytes' bytes each into 'directory', for batch
+// compilation. File i is "program" mode with seed i + 1. Returns 0, or -1 if a
+// file cannot be written.
+static int generateCorpus(const char *directory, int files, size_t bytes) {
+    for (int i = 0; i < files; i++) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/p%04d.pl0", directory, i);
+        FILE *out = fopen(path, "w");
+        if (out == NULL) {
+            perror(path);
+            return -1;
+        }
+        seedRandom((uint32_t)i + 1);
+        generateProgram(out, bytes, 2);
+        if (fclose(out) != 0) {
+            perror(path);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int usage(const char *program) {
+    fprintf(stderr, "Usage: %s program <bytes> [seed] [indent]\n"
+                    "       %s symbols <chains>\n"
+                    "       %s names <assignments>\n"
+                    "       %s chains <statements> <operators>\n"
+                    "       %s nested <statements> <depth>\n"
+                    "       %s corpus <directory> <files> [bytes]\n", program, program, program, program, program, program);
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        return usage(argv[0]);
+    }
+    if (strcmp(argv[1], "program") == 0) {
+        seedRandom(argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : 1);
+        generateProgram(stdout, strtoull(argv[2], NULL, 10), argc > 4 ? atoi(argv[4]) : 4);
+    } else if (strcmp(argv[1], "names") == 0) {
+        generateNames(stdout, atol(argv[2]));
+    } else if (strcmp(argv[1], "chains") == 0 && argc > 3) {
+        generateChains(stdout, atol(argv[2]), atoi(argv[3]));
+    } else if (strcmp(argv[1], "nested") == 0 && argc > 3) {
+        generateNested(stdout, atol(argv[2]), atoi(argv[3]));
+    } else if (strcmp(argv[1], "corpus") == 0 && argc > 3) {
+        return generateCorpus(argv[2], atoi(argv[3]), argc > 4 ? strtoull(argv[4], NULL, 10) : CORPUS_FILE_BYTES) == 0
+                   ? EXIT_SUCCESS : EXIT_FAILURE;
+    } else if (strcmp(argv[1], "symbols") == 0) {
+        generateSymbols(stdout, atoi(argv[2]));
+    } else {
+        return usage(argv[0]);
+    }
+    return fflush(stdout) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,172 @@
+// gcc -O2 benchmarks/lexbench.c -o lexbench -pthread
+// ./lexbench big.pl0                 (lexNext throughput, best of 5 passes over the file)
+// ./lexbench -n 20 a.pl0 b.pl0       (best of 20 passes over each file)
+// ./lexbench -j 4 big.pl0            (lexParallel on 4 threads, 0 = one per core; see pl0_parlex.h)
+// ./lexbench -k                      (keyword lookup: strcmp loop against classifyKeyword)
+//
+// Times the lexer of pl0_lexer.h alone: the file is opened once, and every pass
+// restarts the lexer on the whole source and pulls tokens until EOFS. The first
+// pass also pages the file in, which the best of several passes leaves out.
+// With -j a pass is one lexParallel call into a token array, stitching included.
+//
+// -k classifies 1M random identifiers, a quarter of them keywords, with the
+// linear strcmp loop the analyzers used before pl0_token.h and with its perfect
+// hash, after checking that the two agree on every identifier.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "../pl0_lexer.h"
+#include "../pl0_parlex.h"
+
+#define KEYWORD_IDENTIFIERS (1 << 20)
+#define KEYWORD_ROUNDS 20
+
+static double seconds(const struct timespec *start, const struct timespec *stop) {
+    return (double)(stop->tv_sec - start->tv_sec) + (double)(stop->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// The keywords in TokenType order, as the strcmp loop looked them up.
+static const char *const keywordNames[] = {
+    "BEGIN", "CALL", "CONST", "DO", "ELSE", "END", "FOR", "IF", "ODD",
+    "PROCEDURE", "PROGRAM", "THEN", "TO", "VAR", "WHILE",
+};
+
+// The lookup classifyKeyword replaced: an upper-cased identifier against every keyword.
+static TokenType __attribute__((noinline)) strcmpKeyword(const char *s) {
+    for (int i = 0; i < (int)(sizeof(keywordNames) / sizeof(keywordNames[0])); i++) {
+        if (strcmp(s, keywordNames[i]) == 0) {
+            return (TokenType)(BEGIN + i);
+        }
+    }
+    return IDENT;
+}
+
+// Time both lookups over the same identifiers. Returns 0, or -1 if they
+// disagree or memory ran out.
+static int benchKeywords(void) {
+    char (*names)[MAX_IDENT_LEN + 1] = malloc((size_t)KEYWORD_IDENTIFIERS * sizeof(*names));
+    int *lengths = malloc((size_t)KEYWORD_IDENTIFIERS * sizeof(int));
+    if (names == NULL || lengths == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        free(names);
+        free(lengths);
+        return -1;
+    }
+    uint32_t state = 1;
+    for (int i = 0; i < KEYWORD_IDENTIFIERS; i++) {
+        state = state * 1103515245u + 12345u;
+        if ((state >> 16) % 4 == 0) {
+            strcpy(names[i], keywordNames[(state >> 8) % 15]);
+        } else {
+            int length = 1 + (int)((state >> 20) % 8);
+            for (int j = 0; j < length; j++) {
+                state = state * 1103515245u + 12345u;
+                names[i][j] = (char)('A' + (state >> 16) % 26);
+            }
+            names[i][length] = '\0';
+        }
+        lengths[i] = (int)strlen(names[i]);
+        if (strcmpKeyword(names[i]) != classifyKeyword(names[i], lengths[i])) {
+            fprintf(stderr, "Lookups disagree on %s\n", names[i]);
+            free(names);
+            free(lengths);
+            return -1;
+        }
+    }
+    double elapsed[2];
+    long sum = 0;
+    for (int lookup = 0; lookup < 2; lookup++) {
+        struct timespec start, stop;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int round = 0; round < KEYWORD_ROUNDS; round++) {
+            for (int i = 0; i < KEYWORD_IDENTIFIERS; i++) {
+                sum += lookup == 0 ? strcmpKeyword(names[i]) : classifyKeyword(names[i], lengths[i]);
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        elapsed[lookup] = seconds(&start, &stop) / ((double)KEYWORD_ROUNDS * KEYWORD_IDENTIFIERS) * 1e9;
+    }
+    printf("strcmp loop:  %.1f ns/identifier\nperfect hash: %.1f ns/identifier\n(checksum %ld)\n",
+           elapsed[0], elapsed[1], sum);
+    free(names);
+    free(lengths);
+    return 0;
+}
+
+// Lex 'path' 'passes' times, on 'threads' threads unless that is negative, and
+// print the fastest pass. Returns 0, or -1 if the file cannot be read or memory ran out.
+static int benchFile(const char *path, int passes, int threads) {
+    SourceBuffer source;
+    if (openSourceBuffer(&source, path) != 0) {
+        perror(path);
+        return -1;
+    }
+    Interner names;
+    Lexer lexer;
+    TokenArray lexed = {NULL, 0, 0};
+    int rc = 0;
+    initInterner(&names);
+    initLexer(&lexer, &source, &names);
+    double best = 0;
+    size_t tokens = 0;
+    for (int pass = 0; pass < passes; pass++) {
+        source.cur = source.data;
+        resetInterner(&names);
+        resetLexer(&lexer, &source, &names);
+        struct timespec start, stop;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        tokens = 0;
+        if (threads < 0) {
+            while (lexNext(&lexer).type != EOFS) {
+                tokens++;
+            }
+        } else if (lexParallel(&lexer, threads, &lexed) == 0) {
+            tokens = lexed.count - 1;
+        } else {
+            fprintf(stderr, "Out of memory\n");
+            rc = -1;
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        double s = seconds(&start, &stop);
+        if (pass == 0 || s < best) best = s;
+    }
+    if (rc == 0) {
+        printf("%s: %zu bytes, %zu tokens, %.3f s, %.1f MB/s\n", path, source.size, tokens, best,
+               best > 0 ? (double)source.size / 1e6 / best : 0.0);
+    }
+    freeTokenArray(&lexed);
+    freeLexer(&lexer);
+    freeInterner(&names);
+    closeSourceBuffer(&source);
+    return rc;
+}
+
+int main(int argc, char *argv[]) {
+    int passes = 5, threads = -1, argi = 1;
+    if (argc == 2 && strcmp(argv[1], "-k") == 0) {
+        return benchKeywords() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    for (; argi < argc - 1; argi++) {
+        if (strcmp(argv[argi], "-n") == 0) {
+            passes = atoi(argv[++argi]);
+        } else if (strcmp(argv[argi], "-j") == 0) {
+            threads = atoi(argv[++argi]);
+            if (threads <= 0) threads = defaultLexThreads();
+        } else {
+            break;
+        }
+    }
+    if (argi >= argc || passes < 1) {
+        fprintf(stderr, "Usage: %s [-n passes] [-j threads] <source_file...>\n       %s -k\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+    int failed = 0;
+    for (; argi < argc; argi++) {
+        failed |= benchFile(argv[argi], passes, threads) != 0;
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
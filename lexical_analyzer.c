@@ -1,178 +1,150 @@
-// gcc lexical_analyzer.c -o lexical_analyzer
+// gcc lexical_analyzer.c -o lexical_analyzer -pthread
 // ./lexical_analyzer source.txt listing.txt
+// ./lexical_analyzer -b source.txt tokens.bin   (binary token stream, see pl0_tokstream.h)
+// ./lexical_analyzer -j 8 source.txt listing.txt (lex on 8 threads, 0 = one per core; see pl0_parlex.h)
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include "pl0_lexer.h"
+#include "pl0_tokstream.h"
+#include "pl0_parlex.h"
 
-#define MAX_IDENT_LEN 11
-#define MAX_NUM_LEN 6
+Token token;
+int lexThreads = 0;   // -j: lex the whole file up front on this many threads (0: lex on demand)
+TokenArray lexed;
+size_t lexedNext = 0;
 
-typedef enum { // Token types in PL/0
-    NONE = 0, IDENT, NUMBER,
-    BEGIN, CALL, CONST, DO, ELSE, END, FOR, IF, ODD,
-    PROCEDURE, PROGRAM, THEN, TO, VAR, WHILE,
-    PLUS, MINUS, TIMES, SLASH, EQU, NEQ, LSS, LEQ, GTR, GEQ,
-    LPARENT, RPARENT, LBRACK, RBRACK, PERIOD, COMMA, SEMICOLON, ASSIGN, PERCENT
-} TokenType;
-
-const TokenType keywordTokens[] = {
-    BEGIN, CALL, CONST, DO, ELSE, END, FOR, IF, ODD,
-    PROCEDURE, PROGRAM, THEN, TO, VAR, WHILE
-};
-
-const char* keywords[] = {
-    "BEGIN", "CALL", "CONST", "DO", "ELSE", "END", "FOR", "IF", "ODD",
-    "PROCEDURE", "PROGRAM", "THEN", "TO", "VAR", "WHILE"
-};
-
-TokenType token;
-int Num;
-char Id[MAX_IDENT_LEN + 1]; 
-
-char getCh(FILE *file){
-    char ch = fgetc(file); // Read a character from the file
-    return (ch != EOF && isalpha(ch)) ? toupper(ch) : ch;  // Convert to uppercase if it's a letter
+void startLexer(Lexer *lexer, SourceBuffer *source, Interner *names) {
+    initLexer(lexer, source, names);
+    if (lexThreads > 0 && lexParallel(lexer, lexThreads, &lexed) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
 }
 
-TokenType getToken(char *str) {
-    int numKeywords = sizeof(keywords) / sizeof(keywords[0]);  // Get number of keywords
-
-    for (int i = 0; i < numKeywords; i++) {
-        if (strcmp(str, keywords[i]) == 0) { // Compare input with keyword list
-            return keywordTokens[i]; // Return corresponding token
-        }
+// Next token, straight from the lexer or from the array lexed in parallel.
+Token nextToken(Lexer *lexer) {
+    if (lexThreads == 0) {
+        return lexNext(lexer);
     }
-    
-    return IDENT; // If not a keyword, return IDENT
+    Token t = lexed.tokens[lexedNext];
+    if (lexedNext + 1 < lexed.count) lexedNext++;
+    return t;
 }
 
-void lexicalAnalyzer(FILE *source, FILE *destination){
-    char ch;
-    while ((ch = getCh(source)) == ' ' || ch == '\n' || ch == '\t'){ 
-        // Skip whitespace characters
+void printLexicalError(FILE *destination, Token token) {
+    switch (token.error) {
+        case LEX_IDENT_TOO_LONG: fprintf(destination, "Error: Identifier too long\n"); break;
+        case LEX_NUMBER_TOO_LONG: fprintf(destination, "Error: Number too long\n"); break;
+        case LEX_EXPECTED_ASSIGN: fprintf(destination, "Error: Unknown token \n"); break;
+        default: fprintf(destination, "Error: Unknown character %c\n", *token.lexeme); break;
     }
-    ungetc(ch, source); // Put back the last read character
-    while((ch = getCh(source)) != EOF){
-//        printf("Current character: %c\n", ch); // Debugging line
-        if (isspace(ch)) { // Ignore whitespace
-            continue;
-        }
-        if (isalpha(ch)) { // Ident or Keywords
-            int i = 0;
-            do {
-               if (i < MAX_IDENT_LEN){
-                    Id[i++] = ch;
-                    ch = getCh(source);
-               } 
-               else {
-                fprintf(destination, "Error: Identifier too long\n");
-                exit(EXIT_FAILURE);
-                }
-            } while (isalnum(ch));
-            
-            Id[i] = '\0'; // Null-terminate the identifier string
-            ungetc(ch, source); 
-            token = getToken(Id);
-            if (token == IDENT) {
-                fprintf(destination, "IDENT: %s\n", Id); 
-            } else {
-                fprintf(destination, "TOKEN: %s\n", keywords[token - BEGIN]);
-            }
-        }
+}
 
-        else if (isdigit(ch)){
-            Num = 0;
-            int i = 0;
-            do {
-                if (i < MAX_NUM_LEN) {
-                    Num = Num * 10 + (ch - '0'); // Convert char to int
-                    ch = getCh(source);
-                    i++;
+void lexicalAnalyzer(SourceBuffer *source, FILE *destination){
+    Lexer lexer;
+    Interner names;
+    initInterner(&names);
+    startLexer(&lexer, source, &names);
+    while ((token = nextToken(&lexer)).type != EOFS) {
+        switch (token.type) {
+            case IDENT: // Identifiers are case-insensitive; the interned name is upper-case
+                fprintf(destination, "IDENT: %s\n", token.lexeme);
+                break;
+            case NUMBER:
+                fprintf(destination, "NUMBER: %d\n", token.numberValue);
+                break;
+            case NONE:
+                printLexicalError(destination, token);
+                exit(EXIT_FAILURE);
+            default:
+                if (token.type >= BEGIN && token.type <= WHILE) { // Keywords
+                    fprintf(destination, "TOKEN: %s\n", token_to_string(token.type));
                 } else {
-                    fprintf(destination, "Error: Number too long\n");
-                    exit(EXIT_FAILURE);
+                    fprintf(destination, "%s\n", token_to_string(token.type));
                 }
-            } while (isdigit(ch));
-            ungetc(ch, source); // Put back the last read character
-            fprintf(destination, "NUMBER: %d\n", Num);
+                break;
         }
+    }
+    freeLexer(&lexer);
+    freeInterner(&names);
+    freeTokenArray(&lexed);
+}
 
-        else {
-            switch (ch) {
-                case '+': fprintf(destination, "PLUS\n"); break;
-                case '-': fprintf(destination, "MINUS\n"); break;
-                case '*': fprintf(destination, "TIMES\n"); break;
-                case '/': fprintf(destination, "SLASH\n"); break;
-                case '=': fprintf(destination, "EQU\n"); break;
-                case '<':
-                    ch = getCh(source);
-                    if (ch == '=') {
-                        fprintf(destination, "LEQ\n");
-                    } else if (ch == '>') {
-                        fprintf(destination, "NEQ\n");
-                    } else {
-                        ungetc(ch, source); 
-                        fprintf(destination, "LSS\n");
-                    }
-                    break;
-                case '>':
-                    ch = getCh(source);
-                    if (ch == '=') {
-                        fprintf(destination, "GEQ\n");
-                    } else {
-                        ungetc(ch, source); 
-                        fprintf(destination, "GTR\n");
-                    }
-                    break;
-                case ':':
-                    ch = getCh(source);
-                    if (ch == '=') {
-                        fprintf(destination, "ASSIGN\n");
-                    } else {
-                        ungetc(ch, source); 
-                        fprintf(destination, "Error: Unknown token \n");
-                        exit(EXIT_FAILURE);
-                    }
-                    break;
-                case '(': fprintf(destination, "LPARENT\n"); break;
-                case ')': fprintf(destination, "RPARENT\n"); break;
-                case '.': fprintf(destination, "PERIOD\n"); break;
-                case ',': fprintf(destination, "COMMA\n"); break;
-                case ';': fprintf(destination, "SEMICOLON\n"); break;
-                case '%': fprintf(destination, "PERCENT\n"); break;
-                case '[': fprintf(destination, "LBRACK\n"); break;
-                case ']': fprintf(destination, "RBRACK\n"); break;
-                default: 
-                    fprintf(destination, "Error: Unknown character %c\n", ch);
-                    exit(EXIT_FAILURE);
-            }
+// Binary mode: every token lexNext produces, malformed ones and the final EOFS
+// included, goes into the stream so the parser sees exactly what it would have
+// lexed. The first lexical error is also reported on stderr. Returns 0 on success.
+int binaryTokenStream(SourceBuffer *source, FILE *destination) {
+    Lexer lexer;
+    Interner names;
+    TokenWriter writer;
+    int lexicalErrors = 0;
+    if (openTokenWriter(&writer, destination) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+    initInterner(&names);
+    startLexer(&lexer, source, &names);
+    do {
+        token = nextToken(&lexer);
+        if (token.type == NONE && lexicalErrors++ == 0) {
+            printLexicalError(stderr, token);
         }
+        writeTokenRecord(&writer, &token);
+    } while (token.type != EOFS);
+    int rc = closeTokenWriter(&writer, &names);
+    if (rc != 0) {
+        perror("Error writing token stream");
     }
+    freeLexer(&lexer);
+    freeInterner(&names);
+    freeTokenArray(&lexed);
+    return (rc != 0 || lexicalErrors > 0) ? -1 : 0;
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <source_file> <listing_file>\n", argv[0]);
+    int binary = 0, argi = 1;
+    for (; argi < argc - 2; argi++) {
+        if (strcmp(argv[argi], "-b") == 0) {
+            binary = 1;
+        } else if (strcmp(argv[argi], "-j") == 0 && argi + 1 < argc - 2) {
+            lexThreads = atoi(argv[++argi]);
+            if (lexThreads <= 0) lexThreads = defaultLexThreads();
+        } else {
+            break;
+        }
+    }
+    if (argc - argi != 2) {
+        fprintf(stderr, "Usage: %s [-b] [-j threads] <source_file> <listing_file>\n", argv[0]);
         return EXIT_FAILURE;
     }
-    FILE *source = fopen(argv[1], "r");
-    if (source == NULL) {
+    const char *sourcePath = argv[argi];
+    const char *listingPath = argv[argi + 1];
+    SourceBuffer source;
+    if (openSourceBuffer(&source, sourcePath) != 0) {
         perror("Error opening source file");
         return EXIT_FAILURE;
     }
-    FILE *listing = fopen(argv[2], "w");
+    FILE *listing = fopen(listingPath, binary ? "wb" : "w");
     if (listing == NULL) {
         perror("Error opening listing file");
-        fclose(source);
+        closeSourceBuffer(&source);
         return EXIT_FAILURE;
     }
 
     // Call the lexical analyzer
-    lexicalAnalyzer(source, listing); 
-    fclose(source); 
+    int rc = 0;
+    if (binary) {
+        rc = binaryTokenStream(&source, listing);
+    } else {
+        lexicalAnalyzer(&source, listing); 
+    }
+    closeSourceBuffer(&source); 
     fclose(listing);
+    if (rc != 0) {
+        return EXIT_FAILURE;
+    }
     printf("Lexical analysis completed successfully.\n");
     return 0;
 
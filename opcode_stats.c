@@ -0,0 +1,206 @@
+// gcc opcode_stats.c -o opcode_stats -pthread
+// ./opcode_stats benchmarks/                    (every *.pl0 file in the directory, see pl0_files.h)
+// ./opcode_stats -n 30 -i input.txt a.pl0 b.pl0 (top 30 of each table; the programs read input.txt)
+// ./opcode_stats @manifest.txt                  (one source path per line)
+// ./opcode_stats -O benchmarks/                 (what is left after superinstruction fusion)
+//
+// Runs each program on the VM of pl0_vm.h and counts the instructions it
+// dispatches, alone and in sequences of up to four dispatched one after the
+// other, summed over all the programs. The superinstructions of pl0_peephole.h
+// are picked from these counts. Variable access in the current frame is counted
+// apart (LOD0, STO0, LDX0, STX0), as the VM has handlers of its own for it.
+// Program output is discarded, and its input is empty without -i.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "pl0_compiler.h"
+#include "pl0_codegen.h"
+#include "pl0_peephole.h"
+
+static void profileInstruction(int at);
+#define PL0_VM_PROFILE(vm, at) profileInstruction(at)
+
+#include "pl0_vm.h"
+#include "pl0_files.h"
+
+#define KEY_BITS 7              // Bits of one instruction's key in a sequence key
+#define MAX_SEQUENCE 4
+#define TABLE_BITS 18
+
+typedef struct {
+    uint32_t key;               // Keys of the instructions, the last in the low bits; 0 if the slot is free
+    uint64_t count;
+} SequenceCount;
+
+static const Code *profiled;    // Code being run
+static uint32_t history;        // Keys of the last MAX_SEQUENCE instructions dispatched
+static int historyLength;
+static uint64_t dispatched;
+static SequenceCount table[1 << TABLE_BITS];
+static size_t tableUsed;
+static bool fuse;               // -O: fuse superinstructions before running
+
+// Key of one instruction: its opcode, and whether it is a level-0 variable access.
+static uint32_t instructionKey(const Instruction *in) {
+    bool local = in->level == 0 &&
+                 (in->op == OP_LOD || in->op == OP_STO || in->op == OP_LDX || in->op == OP_STX);
+    return (uint32_t)in->op * 2 + local + 1;
+}
+
+static void countSequence(uint32_t key) {
+    size_t mask = ((size_t)1 << TABLE_BITS) - 1;
+    size_t slot = (key * 2654435761u) >> (32 - TABLE_BITS);
+    while (table[slot].key != 0 && table[slot].key != key) {
+        slot = (slot + 1) & mask;
+    }
+    if (table[slot].key == 0) {
+        // Fewer than 128^4 keys can ever exist, but keep a free slot for the probe to stop at.
+        if (tableUsed + 1 >= mask) return;
+        table[slot].key = key;
+        tableUsed++;
+    }
+    table[slot].count++;
+}
+
+static void profileInstruction(int at) {
+    history = history << KEY_BITS | instructionKey(&profiled->code[at]);
+    if (historyLength < MAX_SEQUENCE) {
+        historyLength++;
+    }
+    for (int length = 1; length <= historyLength; length++) {
+        countSequence(history & (((uint32_t)1 << (length * KEY_BITS)) - 1));
+    }
+    dispatched++;
+}
+
+static int sequenceLength(uint32_t key) {
+    int length = 0;
+    for (; key != 0; key >>= KEY_BITS) {
+        length++;
+    }
+    return length;
+}
+
+static int byCountDescending(const void *x, const void *y) {
+    const SequenceCount *a = x, *b = y;
+    return a->count < b->count ? 1 : a->count > b->count ? -1 : (a->key > b->key) - (a->key < b->key);
+}
+
+static void printSequence(uint32_t key, int length) {
+    for (int i = length - 1; i >= 0; i--) {
+        uint32_t k = (key >> (i * KEY_BITS) & ((1u << KEY_BITS) - 1)) - 1;
+        printf(" %s%s", opcodeNames[k / 2], k & 1 ? "0" : "");
+    }
+    printf("\n");
+}
+
+// Compile and run one program. Returns 0, or -1 if it does not compile or stops with an error.
+static int profileFile(const char *path, VM *vm, FILE *input) {
+    SourceBuffer source;
+    if (openSourceBuffer(&source, path) != 0) {
+        perror(path);
+        return -1;
+    }
+    Compiler compiler;
+    initCompiler(&compiler, stderr);
+    Code code = {NULL, NULL, 0, 0, 0};
+    int rc = -1;
+    if (compileSource(&compiler, &source) != COMPILE_OK) {
+        fprintf(stderr, "%s: does not compile\n", path);
+    } else if (generateCode(&compiler, &code) != 0 || (fuse && fuseSuperinstructions(&code) < 0)) {
+        fprintf(stderr, "Out of memory\n");
+    } else {
+        if (input != NULL) {
+            rewind(input);
+        }
+        profiled = &code;
+        history = 0;
+        historyLength = 0;
+        rc = runVM(vm, &code);
+        if (rc != 0) {
+            fprintf(stderr, "%s: Runtime Error at Line %d: %s\n", path, vm->errorLine, vm->error);
+        }
+    }
+    freeCode(&code);
+    freeCompiler(&compiler);
+    closeSourceBuffer(&source);
+    return rc;
+}
+
+int main(int argc, char *argv[]) {
+    int top = 20, argi = 1;
+    const char *inputPath = NULL;
+    for (; argi < argc - 1; argi++) {
+        if (strcmp(argv[argi], "-n") == 0) {
+            top = atoi(argv[++argi]);
+        } else if (strcmp(argv[argi], "-i") == 0) {
+            inputPath = argv[++argi];
+        } else if (strcmp(argv[argi], "-O") == 0) {
+            fuse = true;
+        } else {
+            break;
+        }
+    }
+    if (argi >= argc) {
+        fprintf(stderr, "Usage: %s [-O] [-n top] [-i input_file] <source_file... | directory | @manifest>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FileList files = {NULL, 0, 0};
+    for (; argi < argc; argi++) {
+        int rc = argv[argi][0] == '@' ? readManifest(&files, argv[argi] + 1)
+               : isDirectory(argv[argi]) ? readDirectory(&files, argv[argi])
+               : addFile(&files, argv[argi], strlen(argv[argi]));
+        if (rc != 0) {
+            perror(argv[argi]);
+            freeFileList(&files);
+            return EXIT_FAILURE;
+        }
+    }
+    FILE *input = fopen(inputPath != NULL ? inputPath : "/dev/null", "r");
+    FILE *output = fopen("/dev/null", "w");
+    VM vm;
+    if (input == NULL || output == NULL) {
+        perror(inputPath != NULL ? inputPath : "/dev/null");
+        return EXIT_FAILURE;
+    }
+    if (initVM(&vm, VM_STACK_CELLS, input, output) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    size_t failed = 0;
+    for (size_t i = 0; i < files.count; i++) {
+        failed += profileFile(files.paths[i], &vm, input) != 0;
+    }
+    freeVM(&vm);
+    fclose(input);
+    fclose(output);
+
+    // Gather the used slots at the front, most frequent first.
+    size_t used = 0;
+    for (size_t i = 0; i < (size_t)1 << TABLE_BITS; i++) {
+        if (table[i].key != 0) {
+            table[used++] = table[i];
+        }
+    }
+    qsort(table, used, sizeof(SequenceCount), byCountDescending);
+
+    printf("%llu instructions dispatched by %zu programs (%zu failed)\n",
+           (unsigned long long)dispatched, files.count - failed, failed);
+    for (int length = 1; length <= MAX_SEQUENCE; length++) {
+        printf("\n%s:\n", length == 1 ? "Instructions" : length == 2 ? "Pairs" : length == 3 ? "Triples" : "Quadruples");
+        int shown = 0;
+        for (size_t i = 0; i < used && shown < top; i++) {
+            if (sequenceLength(table[i].key) == length) {
+                printf("%14llu %6.2f%% ", (unsigned long long)table[i].count,
+                       dispatched ? 100.0 * (double)table[i].count / (double)dispatched : 0.0);
+                printSequence(table[i].key, length);
+                shown++;
+            }
+        }
+    }
+    freeFileList(&files);
+    return EXIT_SUCCESS;
+}
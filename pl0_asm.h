@@ -0,0 +1,249 @@
+/*
+Ahead-of-time x86-64 backend: register code (pl0_regcode.h) to GNU as assembly.
+
+The output is one assembly file in Intel syntax for ELF targets. It defines
+pl0_enter, which the runtime of pl0_runtime.c calls; linking the two gives a
+standalone executable:
+
+  ./semantic_analyzer_ver2 -S program.pl0 > program.s
+  gcc -O2 -c pl0_runtime.c
+  gcc program.s pl0_runtime.o -o program
+
+Code is laid out as in the JIT (pl0_jit.h), with the same registers, frames
+and templates: rbx is the current frame, r12 the stack, r13 the
+RuntimeContext, r14 the end of the stack and r15 scratch across calls into C.
+Each procedure is a native function. Each register instruction is preceded by
+a comment naming it and its source line, and jump targets are labelled .L<address>.
+Error exits are placed after all the code, one per instruction that can fail,
+and are labelled .Lfail<address>.
+*/
+
+#ifndef PL0_ASM_H
+#define PL0_ASM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "pl0_regcode.h"
+#include "pl0_runtime.h"
+
+// The runtime error instruction 'op' can stop with, or -1 if it cannot fail.
+static int asmFailure(RegOpcode op) {
+    switch (op) {
+        case R_LDX: case R_STX: case R_LDXI: case R_STXI: case R_CHK: return RUNTIME_BOUNDS;
+        case R_DIV: return RUNTIME_DIVISION;
+        case R_MOD: return RUNTIME_MODULO;
+        case R_ENT: return RUNTIME_STACK;
+        case R_RED: case R_RDL: return RUNTIME_INPUT;
+        default: return -1;
+    }
+}
+
+static const char *asmCondition(RegOpcode op) {
+    switch (op) {
+        case R_JEQ: case R_JEQK: return "e";
+        case R_JNE: case R_JNEK: return "ne";
+        case R_JLT: case R_JLTK: return "l";
+        case R_JLE: case R_JLEK: return "le";
+        case R_JGT: case R_JGTK: return "g";
+        default:                 return "ge";
+    }
+}
+
+// rax := base of the frame 'levels' static links up from the current one.
+static void asmFrame(FILE *out, int levels) {
+    fprintf(out, "\tmov rax, rbx\n");
+    for (int l = 0; l < levels; l++) {
+        fprintf(out, "\tmov eax, DWORD PTR [rax]\n\tlea rax, [r12+rax*4]\n");
+    }
+}
+
+// reg (64 bits) := stack address of the cell reg points to.
+static void asmStackAddress(FILE *out, const char *reg) {
+    fprintf(out, "\tsub %s, r12\n\tshr %s, 2\n", reg, reg);
+}
+
+static void asmCallC(FILE *out, const char *function) {
+    fprintf(out, "\tmov r15, rsp\n\tand rsp, -16\n\tcall %s\n\tmov rsp, r15\n", function);
+}
+
+// eax := cell 'dividend' / ecx, edx := cell 'dividend' % ecx, with ecx not 0.
+// A divisor of -1 is done apart: the quotient of INT_MIN would trap.
+static void asmDivide(FILE *out, int dividend, bool modulo) {
+    fprintf(out, "\tmov eax, DWORD PTR [rbx%+d]\n", 4 * dividend);
+    fprintf(out, "\tcmp ecx, -1\n\tje 1f\n\tcdq\n\tidiv ecx\n\tjmp 2f\n");
+    fprintf(out, modulo ? "1:\txor edx, edx\n2:\n" : "1:\tneg eax\n2:\n");
+}
+
+static void asmInstruction(FILE *out, const RegInstruction *in, int at) {
+    int a = 4 * in->a, b = 4 * in->b, c = 4 * in->c;
+    switch ((RegOpcode)in->op) {
+        case R_LDK:
+            fprintf(out, "\tmov DWORD PTR [rbx%+d], %d\n", a, in->b);
+            break;
+        case R_MOV:
+            fprintf(out, "\tmov eax, DWORD PTR [rbx%+d]\n\tmov DWORD PTR [rbx%+d], eax\n", b, a);
+            break;
+        case R_LDU:
+            asmFrame(out, in->c);
+            fprintf(out, "\tmov ecx, DWORD PTR [rax%+d]\n\tmov DWORD PTR [rbx%+d], ecx\n", b, a);
+            break;
+        case R_STU:
+            asmFrame(out, in->c);
+            fprintf(out, "\tmov ecx, DWORD PTR [rbx%+d]\n\tmov DWORD PTR [rax%+d], ecx\n", a, b);
+            break;
+        case R_ADR:
+            asmFrame(out, in->c);
+            asmStackAddress(out, "rax");
+            fprintf(out, "\tadd eax, %d\n\tmov DWORD PTR [rbx%+d], eax\n", in->b, a);
+            break;
+        case R_LDI:
+            fprintf(out, "\tmov eax, DWORD PTR [rbx%+d]\n\tmov eax, DWORD PTR [r12+rax*4]\n", b);
+            fprintf(out, "\tmov DWORD PTR [rbx%+d], eax\n", a);
+            break;
+        case R_STI:
+            fprintf(out, "\tmov eax, DWORD PTR [rbx%+d]\n\tmov ecx, DWORD PTR [rbx%+d]\n", b, a);
+            fprintf(out, "\tmov DWORD PTR [r12+rax*4], ecx\n");
+            break;
+        case R_LDX: case R_STX: case R_LDXI: case R_STXI:
+            fprintf(out, "\tmov eax, DWORD PTR [rbx%+d]\n\tcmp eax, %d\n\tjae .Lfail%d\n", c, in->d, at);
+            if (in->op == R_LDX) {
+                fprintf(out, "\tmov eax, DWORD PTR [rbx+rax*4%+d]\n\tmov DWORD PTR [rbx%+d], eax\n", b, a);
+            } else if (in->op == R_STX) {
+                fprintf(out, "\tmov ecx, DWORD PTR [rbx%+d]\n\tmov DWORD PTR [rbx+rax*4%+d], ecx\n", a, b);
+            } else {
+                fprintf(out, "\tadd eax, DWORD PTR [rbx%+d]\n", b);
+                if (in->op == R_LDXI) {
+                    fprintf(out, "\tmov eax, DWORD PTR [r12+rax*4]\n\tmov DWORD PTR [rbx%+d], eax\n", a);
+                } else {
+                    fprintf(out, "\tmov ecx, DWORD PTR [rbx%+d]\n\tmov DWORD PTR [r12+rax*4], ecx\n", a);
+                }
+            }
+            break;
+        case R_CHK:
+            fprintf(out, "\tcmp DWORD PTR [rbx%+d], %d\n\tjae .Lfail%d\n", a, in->b, at);
+            break;
+        case R_NEG:
+            fprintf(out, "\tmov eax, DWORD PTR [rbx%+d]\n\tneg eax\n\tmov DWORD PTR [rbx%+d], eax\n", b, a);
+            break;
+        case R_ADD: case R_SUB: case R_MUL:
+            fprintf(out, "\tmov eax, DWORD PTR [rbx%+d]\n\t%s eax, DWORD PTR [rbx%+d]\n\tmov DWORD PTR [rbx%+d], eax\n",
+                    b, in->op == R_ADD ? "add" : in->op == R_SUB ? "sub" : "imul", c, a);
+            break;
+        case R_DIV: case R_MOD:
+            fprintf(out, "\tmov ecx, DWORD PTR [rbx%+d]\n\ttest ecx, ecx\n\tje .Lfail%d\n", c, at);
+            asmDivide(out, in->b, in->op == R_MOD);
+            fprintf(out, "\tmov DWORD PTR [rbx%+d], %s\n", a, in->op == R_MOD ? "edx" : "eax");
+            break;
+        case R_ADDK:
+            fprintf(out, "\tmov eax, DWORD PTR [rbx%+d]\n\tadd eax, %d\n\tmov DWORD PTR [rbx%+d], eax\n", b, in->c, a);
+            break;
+        case R_MULK:
+            fprintf(out, "\timul eax, DWORD PTR [rbx%+d], %d\n\tmov DWORD PTR [rbx%+d], eax\n", b, in->c, a);
+            break;
+        case R_DIVK: case R_MODK:
+            fprintf(out, "\tmov ecx, %d\n", in->c);
+            asmDivide(out, in->b, in->op == R_MODK);
+            fprintf(out, "\tmov DWORD PTR [rbx%+d], %s\n", a, in->op == R_MODK ? "edx" : "eax");
+            break;
+        case R_JEQ: case R_JNE: case R_JLT: case R_JLE: case R_JGT: case R_JGE:
+            fprintf(out, "\tmov eax, DWORD PTR [rbx%+d]\n\tcmp eax, DWORD PTR [rbx%+d]\n\tj%s .L%d\n",
+                    a, b, asmCondition((RegOpcode)in->op), in->c);
+            break;
+        case R_JEQK: case R_JNEK: case R_JLTK: case R_JLEK: case R_JGTK: case R_JGEK:
+            fprintf(out, "\tcmp DWORD PTR [rbx%+d], %d\n\tj%s .L%d\n", a, in->b, asmCondition((RegOpcode)in->op), in->c);
+            break;
+        case R_JODD: case R_JEVEN:
+            fprintf(out, "\ttest BYTE PTR [rbx%+d], 1\n\tj%s .L%d\n", a, in->op == R_JODD ? "ne" : "e", in->c);
+            break;
+        case R_JMP:
+            fprintf(out, "\tjmp .L%d\n", in->c);
+            break;
+        case R_ENT:
+            fprintf(out, "\tlea rax, [rbx%+d]\n\tcmp rax, r14\n\tja .Lfail%d\n", 4 * (in->a + FRAME_HEADER), at);
+            if (in->a - FRAME_HEADER <= 16) {
+                for (int r = FRAME_HEADER; r < in->a; r++) {
+                    fprintf(out, "\tmov DWORD PTR [rbx%+d], 0\n", 4 * r);
+                }
+            } else {
+                fprintf(out, "\tlea rdi, [rbx%+d]\n\tmov ecx, %d\n\txor eax, eax\n\trep stosd\n",
+                        4 * FRAME_HEADER, in->a - FRAME_HEADER);
+            }
+            break;
+        case R_CAL:
+            asmFrame(out, in->b);
+            asmStackAddress(out, "rax");
+            fprintf(out, "\tmov DWORD PTR [rbx%+d], eax\n\tmov rcx, rbx\n", a);
+            asmStackAddress(out, "rcx");
+            fprintf(out, "\tmov DWORD PTR [rbx%+d], ecx\n\tmov DWORD PTR [rbx%+d], %d\n", a + 4, a + 8, at + 1);
+            fprintf(out, "\tadd rbx, %d\n\tcall .L%d\n\tsub rbx, %d\n", a, in->c, a);
+            break;
+        case R_RET:
+            fprintf(out, "\tret\n");
+            break;
+        case R_RED: case R_RDL:
+            fprintf(out, "\tlea rdi, [rbx%+d]\n\tmov esi, %d\n", a, in->op == R_RDL);
+            asmCallC(out, "pl0_read");
+            fprintf(out, "\ttest eax, eax\n\tjne .Lfail%d\n", at);
+            break;
+        case R_WRT: case R_WRL:
+            fprintf(out, "\tmov edi, DWORD PTR [rbx%+d]\n\tmov esi, %d\n", a, in->op == R_WRL);
+            asmCallC(out, "pl0_write");
+            break;
+        case R_HLT:
+            fprintf(out, "\txor eax, eax\n\tjmp .Lexit\n");
+            break;
+        default:
+            break;
+    }
+}
+
+// Write register code as an assembly file. Returns 0, or -1 if memory ran out
+// or writing failed.
+static int emitAssembly(const RegCode *code, FILE *out) {
+    bool *target = calloc((size_t)code->count + 1, sizeof(bool));
+    if (target == NULL) {
+        return -1;
+    }
+    target[0] = true;
+    for (int i = 0; i < code->count; i++) {
+        const RegInstruction *in = &code->code[i];
+        if ((in->op >= R_JEQ && in->op <= R_JMP) || in->op == R_CAL) {
+            target[in->c] = true;
+        }
+    }
+
+    fprintf(out, "\t.intel_syntax noprefix\n\t.text\n\t.globl pl0_enter\n\t.type pl0_enter, @function\n");
+    fprintf(out, "pl0_enter:\n\tpush rbx\n\tpush rbp\n\tpush r12\n\tpush r13\n\tpush r14\n\tpush r15\n");
+    fprintf(out, "\tsub rsp, 8\n\tmov r13, rdi\n");
+    fprintf(out, "\tmov QWORD PTR [r13+%zu], rsp\n", offsetof(RuntimeContext, savedRsp));
+    fprintf(out, "\tmov r12, QWORD PTR [r13+%zu]\n\tmov rbx, r12\n", offsetof(RuntimeContext, stack));
+    fprintf(out, "\tmov r14, QWORD PTR [r13+%zu]\n", offsetof(RuntimeContext, stackEnd));
+    fprintf(out, "\tmov rsp, QWORD PTR [r13+%zu]\n\tcall .L0\n", offsetof(RuntimeContext, nativeStackTop));
+    fprintf(out, ".Lexit:\n\tmov rsp, QWORD PTR [r13+%zu]\n\tadd rsp, 8\n", offsetof(RuntimeContext, savedRsp));
+    fprintf(out, "\tpop r15\n\tpop r14\n\tpop r13\n\tpop r12\n\tpop rbp\n\tpop rbx\n\tret\n");
+    fprintf(out, ".Lerror:\n\tmov DWORD PTR [r13+%zu], esi\n", offsetof(RuntimeContext, errorLine));
+    fprintf(out, "\tmov DWORD PTR [r13+%zu], edx\n\tmov eax, -1\n\tjmp .Lexit\n", offsetof(RuntimeContext, error));
+
+    for (int i = 0; i < code->count; i++) {
+        const RegInstruction *in = &code->code[i];
+        if (target[i]) {
+            fprintf(out, ".L%d:\n", i);
+        }
+        fprintf(out, "\t# %d: %s %d %d %d %d (line %d)\n", i, regOpcodeNames[in->op], in->a, in->b, in->c, in->d,
+                code->lines[i]);
+        asmInstruction(out, in, i);
+    }
+    for (int i = 0; i < code->count; i++) {
+        int failure = asmFailure((RegOpcode)code->code[i].op);
+        if (failure >= 0) {
+            fprintf(out, ".Lfail%d:\n\tmov esi, %d\n\tmov edx, %d\n\tjmp .Lerror\n", i, code->lines[i], failure);
+        }
+    }
+    fprintf(out, "\t.size pl0_enter, .-pl0_enter\n\t.section .note.GNU-stack,\"\",@progbits\n");
+    free(target);
+    return ferror(out) ? -1 : 0;
+}
+
+#endif
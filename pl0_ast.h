@@ -0,0 +1,93 @@
+/*
+Compact syntax tree built by the semantic analyzer.
+
+Every node is one fixed-size 24-byte AstNode in a single growable array, and
+nodes refer to each other by index, never by pointer: the array can move when
+it grows, a whole tree is dropped by resetting the count (or freeing the one
+array), and a pass over the tree walks memory that is mostly contiguous.
+Nodes are appended in the order the parser finishes them, so children come
+before their parents.
+
+Identifiers are resolved while the tree is built: a node that names a
+variable, array or procedure holds its index in the compiler's symbol table,
+and a constant is replaced by its value. Lists (statements of a BEGIN,
+procedures of a block, arguments of a CALL) are chained through 'next'.
+*/
+
+#ifndef PL0_AST_H
+#define PL0_AST_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define AST_NONE (-1)
+
+typedef enum {
+    AST_PROGRAM,    // a: block, b: frame size in cells (see FRAME_HEADER)
+    AST_BLOCK,      // a: first procedure (list), b: body statement, c: first symbol of the block's scope
+    AST_PROCEDURE,  // a: procedure symbol, b: block, c: frame size in cells
+    AST_ASSIGN,     // a: variable symbol, b: index expression (array element) or AST_NONE, c: value
+    AST_CALL,       // a: procedure symbol, b: first argument (list)
+    AST_BEGIN,      // a: first statement (list)
+    AST_IF,         // a: condition, b: THEN statement, c: ELSE statement or AST_NONE
+    AST_WHILE,      // a: condition, b: body
+    AST_FOR,        // a: loop variable symbol, b: start expression (its 'next' is the end expression), c: body
+    AST_ODD,        // a: operand
+    AST_COMPARE,    // op: EQU, NEQ, LSS, LEQ, GTR or GEQ; a, b: operands
+    AST_BINARY,     // op: PLUS, MINUS, TIMES, SLASH or PERCENT; a, b: operands
+    AST_NEGATE,     // a: operand
+    AST_NUMBER,     // a: value, b: constant symbol it was written as, or AST_NONE for a literal
+    AST_VARIABLE,   // a: variable symbol
+    AST_ELEMENT     // a: array symbol, b: index expression
+} AstKind;
+
+typedef struct {
+    uint8_t kind;       // AstKind
+    uint8_t op;         // Operator token (TokenType) for AST_COMPARE and AST_BINARY
+    uint16_t reserved;
+    int32_t line;       // Source line the construct starts on
+    int32_t a, b, c;    // Operands, see AstKind; AST_NONE where absent
+    int32_t next;       // Next node of the same list, AST_NONE at the end
+} AstNode;
+
+typedef struct {
+    AstNode *nodes;
+    int count;
+    int capacity;
+    int root;           // The AST_PROGRAM node, AST_NONE until the program is complete
+} Ast;
+
+// Head and tail of a list being built, so appending is O(1).
+typedef struct {
+    int head;
+    int tail;
+} AstList;
+
+static inline void resetAst(Ast *ast) {
+    ast->count = 0;
+    ast->root = AST_NONE;
+}
+
+static inline void freeAst(Ast *ast) {
+    free(ast->nodes);
+    ast->nodes = NULL;
+    ast->capacity = 0;
+    resetAst(ast);
+}
+
+static inline AstList emptyAstList(void) {
+    AstList list = {AST_NONE, AST_NONE};
+    return list;
+}
+
+static inline void appendAstList(Ast *ast, AstList *list, int node) {
+    if (node == AST_NONE) return;
+    if (list->head == AST_NONE) {
+        list->head = node;
+    } else {
+        ast->nodes[list->tail].next = node;
+    }
+    list->tail = node;
+}
+
+#endif
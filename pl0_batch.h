@@ -0,0 +1,287 @@
+/*
+Batch compilation of many PL/0 programs in one process.
+
+The inputs come from a manifest (one path per line; blank lines and lines
+starting with '#' are skipped) or from every *.pl0 file in a directory, taken
+in name order. They are compiled on a small work-stealing pool: each worker
+starts with a contiguous slice of the file list and takes files from the front
+of it; a worker that runs dry steals the back half of another worker's slice.
+Every worker keeps one Compiler for all of its files, so the symbol tables,
+name pool and line index are allocated once per thread, not once per file.
+
+Each file's diagnostics and result line are captured in memory and written to
+the output in input order as soon as every file before it is done, so the
+output does not depend on the number of threads or on scheduling.
+*/
+
+#ifndef PL0_BATCH_H
+#define PL0_BATCH_H
+
+#include <errno.h>
+#include <time.h>
+#include "pl0_compiler.h"
+#include "pl0_files.h"
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define BATCH_MAX_THREADS 64
+
+// ---- Per-file results ----
+
+typedef struct {
+    char *output;           // Captured diagnostics and result line
+    size_t length;
+    CompileStatus status;
+    bool done;
+} BatchResult;
+
+// In-memory stream for one file's diagnostics.
+static FILE *openCapture(BatchResult *r) {
+    r->output = NULL;
+    r->length = 0;
+#if !defined(_WIN32)
+    return open_memstream(&r->output, &r->length);
+#else
+    return tmpfile();
+#endif
+}
+
+static void closeCapture(BatchResult *r, FILE *capture) {
+#if !defined(_WIN32)
+    (void)r;
+    fclose(capture);
+#else
+    long size = ftell(capture);
+    r->output = size > 0 ? malloc((size_t)size) : NULL;
+    rewind(capture);
+    r->length = r->output ? fread(r->output, 1, (size_t)size, capture) : 0;
+    fclose(capture);
+#endif
+}
+
+static const char *batchStatusText(CompileStatus status) {
+    switch (status) {
+        case COMPILE_OK: return "ok";
+        case COMPILE_ERRORS: return "failed";
+        default: return "aborted";
+    }
+}
+
+static void compileBatchFile(Compiler *c, const char *path, BatchResult *r) {
+    FILE *capture = openCapture(r);
+    if (capture == NULL) {
+        r->status = COMPILE_ABORTED;
+        return;
+    }
+    SourceBuffer source;
+    if (openSourceBuffer(&source, path) != 0) {
+        fprintf(capture, "Error opening source file: %s\n", strerror(errno));
+        r->status = COMPILE_ABORTED;
+    } else {
+        c->diagnostics = capture;
+        r->status = compileSource(c, &source);
+        closeSourceBuffer(&source);
+    }
+    fprintf(capture, "%s: %s\n", path, batchStatusText(r->status));
+    closeCapture(r, capture);
+}
+
+// ---- Work-stealing pool ----
+
+typedef struct {
+#if !defined(_WIN32)
+    pthread_mutex_t lock;
+#endif
+    size_t head;            // Files [head, tail) are still queued on this worker
+    size_t tail;
+} WorkQueue;
+
+typedef struct {
+    const FileList *files;
+    BatchResult *results;
+    WorkQueue queues[BATCH_MAX_THREADS];
+    int workers;
+    int maxErrors;          // Error limit for each file, 0 for none
+    FILE *out;
+#if !defined(_WIN32)
+    pthread_mutex_t emitLock;
+#endif
+    size_t nextToEmit;      // Files before this one have been written to 'out'
+} BatchRun;
+
+typedef struct {
+    BatchRun *run;
+    int self;
+} BatchWorker;
+
+static void lockQueue(WorkQueue *q) {
+#if !defined(_WIN32)
+    pthread_mutex_lock(&q->lock);
+#else
+    (void)q;
+#endif
+}
+
+static void unlockQueue(WorkQueue *q) {
+#if !defined(_WIN32)
+    pthread_mutex_unlock(&q->lock);
+#else
+    (void)q;
+#endif
+}
+
+// Next file for worker 'self': the front of its own queue, or else the back
+// half of the first other queue that still has work. Returns 0 when all are empty.
+static int takeFile(BatchRun *run, int self, size_t *file) {
+    WorkQueue *own = &run->queues[self];
+    lockQueue(own);
+    if (own->head < own->tail) {
+        *file = own->head++;
+        unlockQueue(own);
+        return 1;
+    }
+    unlockQueue(own);
+
+    for (int k = 1; k < run->workers; k++) {
+        WorkQueue *victim = &run->queues[(self + k) % run->workers];
+        lockQueue(victim);
+        size_t left = victim->tail - victim->head;
+        if (left == 0) {
+            unlockQueue(victim);
+            continue;
+        }
+        size_t from = victim->tail - (left + 1) / 2, to = victim->tail;
+        victim->tail = from;
+        unlockQueue(victim);
+
+        // Nobody steals from a queue while it is empty, so it can be refilled in place.
+        lockQueue(own);
+        own->head = from + 1;
+        own->tail = to;
+        unlockQueue(own);
+        *file = from;
+        return 1;
+    }
+    return 0;
+}
+
+// Mark a file finished and write out every finished file that is next in input order.
+static void finishFile(BatchRun *run, size_t file) {
+#if !defined(_WIN32)
+    pthread_mutex_lock(&run->emitLock);
+#endif
+    run->results[file].done = true;
+    while (run->nextToEmit < run->files->count && run->results[run->nextToEmit].done) {
+        BatchResult *r = &run->results[run->nextToEmit++];
+        if (r->length > 0) fwrite(r->output, 1, r->length, run->out);
+        free(r->output);
+        r->output = NULL;
+    }
+#if !defined(_WIN32)
+    pthread_mutex_unlock(&run->emitLock);
+#endif
+}
+
+static void *batchWorker(void *arg) {
+    BatchWorker *w = arg;
+    BatchRun *run = w->run;
+    Compiler compiler;
+    initCompiler(&compiler, NULL);
+    compiler.maxErrors = run->maxErrors;
+    size_t file;
+    while (takeFile(run, w->self, &file)) {
+        compileBatchFile(&compiler, run->files->paths[file], &run->results[file]);
+        finishFile(run, file);
+    }
+    freeCompiler(&compiler);
+    return NULL;
+}
+
+static inline int defaultBatchThreads(void) {
+#if !defined(_WIN32)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#else
+    return 1;
+#endif
+}
+
+// Compile every file in 'files' on 'threads' workers (0: one per core), writing each
+// file's diagnostics (at most maxErrors of them, 0 for all) and result to 'out' in list order. A throughput summary goes
+// to stderr. Returns the number of files that did not compile cleanly, or -1 if
+// memory ran out before any work started.
+static long compileBatch(const FileList *files, int threads, int maxErrors, FILE *out) {
+    if (threads <= 0) threads = defaultBatchThreads();
+    if (threads > BATCH_MAX_THREADS) threads = BATCH_MAX_THREADS;
+    if ((size_t)threads > files->count) threads = files->count > 0 ? (int)files->count : 1;
+#if defined(_WIN32)
+    threads = 1;
+#endif
+
+    BatchRun *run = calloc(1, sizeof(BatchRun));
+    BatchResult *results = calloc(files->count ? files->count : 1, sizeof(BatchResult));
+    if (run == NULL || results == NULL) {
+        free(run);
+        free(results);
+        return -1;
+    }
+    run->files = files;
+    run->results = results;
+    run->workers = threads;
+    run->maxErrors = maxErrors;
+    run->out = out;
+#if !defined(_WIN32)
+    pthread_mutex_init(&run->emitLock, NULL);
+#endif
+    BatchWorker workers[BATCH_MAX_THREADS];
+    for (int i = 0; i < threads; i++) {
+        WorkQueue *q = &run->queues[i];
+#if !defined(_WIN32)
+        pthread_mutex_init(&q->lock, NULL);
+#endif
+        q->head = files->count * (size_t)i / (size_t)threads;
+        q->tail = files->count * (size_t)(i + 1) / (size_t)threads;
+        workers[i].run = run;
+        workers[i].self = i;
+    }
+
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+#if !defined(_WIN32)
+    pthread_t ids[BATCH_MAX_THREADS];
+    int started[BATCH_MAX_THREADS] = {0};
+    for (int i = 1; i < threads; i++) {
+        started[i] = pthread_create(&ids[i], NULL, batchWorker, &workers[i]) == 0;
+    }
+    batchWorker(&workers[0]);  // Also picks up the slices of any thread that failed to start
+    for (int i = 1; i < threads; i++) {
+        if (started[i]) pthread_join(ids[i], NULL);
+    }
+#else
+    batchWorker(&workers[0]);
+#endif
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    fflush(out);
+
+    long failed = 0;
+    for (size_t i = 0; i < files->count; i++) {
+        if (results[i].status != COMPILE_OK) failed++;
+    }
+    double seconds = (double)(stop.tv_sec - start.tv_sec) + (double)(stop.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "Compiled %zu files (%ld failed) in %.3f s on %d thread%s: %.0f files/sec\n",
+            files->count, failed, seconds, threads, threads == 1 ? "" : "s",
+            seconds > 0 ? (double)files->count / seconds : 0.0);
+
+#if !defined(_WIN32)
+    for (int i = 0; i < threads; i++) pthread_mutex_destroy(&run->queues[i].lock);
+    pthread_mutex_destroy(&run->emitLock);
+#endif
+    free(results);
+    free(run);
+    return failed;
+}
+
+#endif
@@ -0,0 +1,1372 @@
+/*
+C backend: translates a checked program into one C translation unit that any C99
+compiler with POSIX threads builds into a native program:
+
+  ./semantic_analyzer_ver2 -E program.pl0 > program.c
+  gcc -O2 program.c -o program -pthread
+
+The translation keeps the program's structure, so the C compiler sees loops,
+arrays and calls as they were written rather than machine instructions:
+
+- Every procedure becomes a static function. Variables of the main program are
+  static globals. A procedure's variables are locals of its function, unless a
+  procedure nested in it uses them: those live in a struct frame_<symbol>
+  local to the function, and each procedure declared in such a block gets a
+  pointer to it, env. A frame holds the frame enclosing it in 'up', so a
+  variable k levels out (Symbol.level) is env->up->...->x. A function that
+  calls none of the procedures nested in it declares no frame, since nothing
+  else can reach one. VAR parameters are pointers.
+- Arrays are int32_t arrays of Symbol's size (ArrayInfo.size), zeroed on entry
+  like a VM frame.
+- Arithmetic wraps like the VM's (pl0_add and the rest compute in unsigned).
+  Division by a constant is plain C division, which the compiler strength
+  reduces.
+- An array index is checked unless its range is known to be inside the array:
+  a constant, or a FOR variable with constant bounds that nothing else can
+  write, or a sum or product of such. Loops over arrays therefore compile to
+  the plain loops a C compiler vectorizes.
+- The runtime errors are those of the VM, at the same source lines. Operands
+  are evaluated in the VM's order where it could matter, that is where more
+  than one of them can fail: the earlier ones go to a temporary first.
+- Each call counts the cells its frame would take on the VM and stops with
+  "Stack overflow" where the VM's stack would end. The program runs on a
+  thread with a native stack large enough for that depth.
+- READ and READLN parse input like the VM; WRITE and WRITELN use stdio.
+
+Given the optimized IR (pl0_ir.h) instead, the declarations stay the same but
+each body is its control-flow graph: a block is a label, every value a local
+vN assigned once (a phi on the edges into its block), and the variables in SSA
+form are not declared at all.
+*/
+
+#ifndef PL0_CGEN_H
+#define PL0_CGEN_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pl0_codegen.h"
+#include "pl0_ir.h"
+#include "pl0_runtime.h"
+
+// Growable text, for the C of an expression.
+typedef struct {
+    char *text;
+    size_t length;
+    size_t capacity;
+} CText;
+
+// Values a FOR variable takes in the loop's body.
+typedef struct {
+    int32_t low;
+    int32_t high;
+    bool known;
+} CRange;
+
+typedef struct {
+    const Compiler *c;
+    FILE *out;
+    bool *reference;            // VAR parameters
+    bool *used;                 // Variables the program uses at all
+    bool *captured;             // Variables used by a procedure nested in their block
+    bool *framed;               // Procedures whose function keeps variables in a struct frame
+    int *parent;                // Procedure declaring each procedure, -1 in the main program
+    CRange *range;
+    int level;                  // Level of the block being translated
+    int line;                   // Source line of the statement being translated
+    int indent;
+    int temporaries;            // Temporaries t0, t1, ... of the function so far
+    CText prefix;               // Declarations to come before the statement being translated
+    const IrProgram *ir;        // Bodies translated from the IR instead of the tree, if not NULL
+    bool *irUsed;               // Per value of the function being translated: some instruction uses it
+    unsigned char *access;      // Per variable, how the function being translated uses it (C_READ, C_WRITTEN)
+    bool inFrame;               // The function being translated declares 'frame' for a procedure nested in it
+    bool usesEnv;               // The function being translated goes through env
+    bool reads;                 // Some READ or READLN is translated
+    bool writes;                // Some WRITE or WRITELN is translated
+    bool outOfMemory;
+} CGen;
+
+enum { C_READ = 1, C_WRITTEN = 2 };
+
+static const char cHeaders[] =
+    "#include <stdint.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <ctype.h>\n"
+    "#include <pthread.h>\n"
+    "\n";
+
+static const char cRuntime[] =
+    "#define PL0_NATIVE_STACK ((size_t)1 << 30)\n"
+    "\n"
+    "static size_t pl0_cells; // Cells the frames of the active calls would take on the VM\n"
+    "\n"
+    "static void pl0_fail(int line, const char *message) {\n"
+    "    fflush(stdout);\n"
+    "    fprintf(stderr, \"Runtime Error at Line %d: %s\\n\", line, message);\n"
+    "    exit(EXIT_FAILURE);\n"
+    "}\n"
+    "\n"
+    "static inline int32_t pl0_add(int32_t a, int32_t b) { return (int32_t)((uint32_t)a + (uint32_t)b); }\n"
+    "static inline int32_t pl0_sub(int32_t a, int32_t b) { return (int32_t)((uint32_t)a - (uint32_t)b); }\n"
+    "static inline int32_t pl0_mul(int32_t a, int32_t b) { return (int32_t)((uint32_t)a * (uint32_t)b); }\n"
+    "static inline int32_t pl0_neg(int32_t a) { return (int32_t)(0u - (uint32_t)a); }\n"
+    "\n"
+    "static inline int32_t pl0_div(int32_t a, int32_t b, int line) {\n"
+    "    if (b == 0) pl0_fail(line, \"Division by zero\");\n"
+    "    return b == -1 ? pl0_neg(a) : a / b;\n"
+    "}\n"
+    "\n"
+    "static inline int32_t pl0_mod(int32_t a, int32_t b, int line) {\n"
+    "    if (b == 0) pl0_fail(line, \"Modulo by zero\");\n"
+    "    return b == -1 ? 0 : a % b;\n"
+    "}\n"
+    "\n"
+    "static inline int32_t pl0_index(int32_t i, int32_t size, int line) {\n"
+    "    if ((uint32_t)i >= (uint32_t)size) pl0_fail(line, \"Array index out of bounds\");\n"
+    "    return i;\n"
+    "}\n"
+    "\n"
+    "static inline void pl0_enter(size_t cells, int line) {\n"
+    "    if ((pl0_cells += cells) > PL0_STACK_CELLS) pl0_fail(line, \"Stack overflow\");\n"
+    "}\n";
+
+// The input and output helpers are emitted only for a program that uses them,
+// as an unused static function draws a warning.
+static const char cReadRuntime[] =
+    "\n"
+    "static void pl0_read(int32_t *cell, int skipLine, int line) {\n"
+    "    int ch;\n"
+    "    do {\n"
+    "        ch = getchar();\n"
+    "    } while (ch != EOF && isspace(ch));\n"
+    "    int negative = ch == '-';\n"
+    "    if (ch == '-' || ch == '+') ch = getchar();\n"
+    "    if (ch == EOF || !isdigit(ch)) pl0_fail(line, \"Expected an integer on input\");\n"
+    "    int64_t n = 0;\n"
+    "    for (; ch != EOF && isdigit(ch); ch = getchar()) {\n"
+    "        n = n * 10 + (ch - '0');\n"
+    "        if (n > (int64_t)INT32_MAX + 1) pl0_fail(line, \"Expected an integer on input\");\n"
+    "    }\n"
+    "    if (ch != EOF) ungetc(ch, stdin);\n"
+    "    n = negative ? -n : n;\n"
+    "    if (n > INT32_MAX) pl0_fail(line, \"Expected an integer on input\");\n"
+    "    *cell = (int32_t)n;\n"
+    "    if (skipLine) {\n"
+    "        while ((ch = getchar()) != EOF && ch != '\\n') {\n"
+    "        }\n"
+    "    }\n"
+    "}\n";
+
+static const char cWriteRuntime[] =
+    "\n"
+    "static void pl0_write(int32_t value, int newline) {\n"
+    "    printf(newline ? \"%d\\n\" : \"%d\", value);\n"
+    "}\n";
+
+static const char cMain[] =
+    "static void *pl0_run(void *unused) {\n"
+    "    (void)unused;\n"
+    "    pl0_program();\n"
+    "    return NULL;\n"
+    "}\n"
+    "\n"
+    "int main(void) {\n"
+    "    pthread_attr_t attributes;\n"
+    "    pthread_t thread;\n"
+    "    if (pthread_attr_init(&attributes) != 0 || pthread_attr_setstacksize(&attributes, PL0_NATIVE_STACK) != 0 ||\n"
+    "        pthread_create(&thread, &attributes, pl0_run, NULL) != 0) {\n"
+    "        fprintf(stderr, \"Out of memory\\n\");\n"
+    "        return EXIT_FAILURE;\n"
+    "    }\n"
+    "    pthread_join(thread, NULL);\n"
+    "    return fflush(stdout) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;\n"
+    "}\n";
+
+static void cText(CGen *g, CText *t, const char *format, ...) {
+    for (;;) {
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(t->text != NULL ? t->text + t->length : NULL, t->text != NULL ? t->capacity - t->length : 0,
+                          format, args);
+        va_end(args);
+        if (n < 0) {
+            g->outOfMemory = true;
+            return;
+        }
+        if (t->text != NULL && t->length + (size_t)n < t->capacity) {
+            t->length += (size_t)n;
+            return;
+        }
+        size_t capacity = t->capacity ? t->capacity : 64;
+        while (capacity <= t->length + (size_t)n) {
+            capacity *= 2;
+        }
+        char *grown = realloc(t->text, capacity);
+        if (grown == NULL) {
+            g->outOfMemory = true;
+            return;
+        }
+        t->text = grown;
+        t->capacity = capacity;
+    }
+}
+
+static const char *cString(const CText *t) {
+    return t->text != NULL ? t->text : "";
+}
+
+static void cLine(CGen *g, const char *format, ...) {
+    fprintf(g->out, "%*s", 4 * g->indent, "");
+    va_list args;
+    va_start(args, format);
+    vfprintf(g->out, format, args);
+    va_end(args);
+    fputc('\n', g->out);
+}
+
+static const AstNode *cNode(const CGen *g, int node) {
+    return &g->c->ast.nodes[node];
+}
+
+static const Symbol *cSymbol(const CGen *g, int symbol) {
+    return &g->c->symbolTable[symbol];
+}
+
+// The C name of a variable or procedure: its name in lower case and its symbol index.
+static void cName(CGen *g, CText *t, int symbol) {
+    const char *name = internedName(&g->c->names, cSymbol(g, symbol)->nameId);
+    for (; *name != '\0'; name++) {
+        cText(g, t, "%c", tolower((unsigned char)*name));
+    }
+    cText(g, t, "_%d", symbol);
+}
+
+static void cNumber(CGen *g, CText *t, int32_t value) {
+    if (value == INT32_MIN) {
+        cText(g, t, "INT32_MIN");
+    } else {
+        cText(g, t, value < 0 ? "(%d)" : "%d", value);
+    }
+}
+
+static int cArraySize(const CGen *g, int symbol) {
+    return g->c->arrayInfo[cSymbol(g, symbol)->info].size;
+}
+
+// Whether the procedure 'symbol' gets an env pointer to the frame of the block declaring it.
+static bool cHasEnv(const CGen *g, int symbol) {
+    return g->parent[symbol] >= 0 && g->framed[g->parent[symbol]];
+}
+
+// The frame of the block at 'level', seen from the block being translated.
+static void cFrameAt(CGen *g, CText *t, int level) {
+    if (level == g->level) {
+        cText(g, t, "&frame");
+        return;
+    }
+    cText(g, t, "env");
+    for (int l = g->level - 1; l > level; l--) {
+        cText(g, t, "->up");
+    }
+}
+
+// Where a variable is stored, seen from the block being translated. For a VAR
+// parameter that is the pointer.
+static void cPlace(CGen *g, CText *t, int symbol) {
+    int level = cSymbol(g, symbol)->level;
+    if (level > 0 && level < g->level) {
+        cFrameAt(g, t, level);
+        cText(g, t, "->");
+    } else if (level > 0 && g->captured[symbol] && g->inFrame) {
+        cText(g, t, "frame.");
+    }
+    cName(g, t, symbol);
+}
+
+// A scalar variable as an lvalue.
+static void cScalar(CGen *g, CText *t, int symbol) {
+    if (g->reference[symbol]) {
+        cText(g, t, "(*");
+        cPlace(g, t, symbol);
+        cText(g, t, ")");
+    } else {
+        cPlace(g, t, symbol);
+    }
+}
+
+// Values the expression can take, if they can be bounded at all.
+static bool cBounds(const CGen *g, int node, int64_t *low, int64_t *high) {
+    const AstNode *n = cNode(g, node);
+    int value;
+    int64_t l1, h1, l2, h2;
+    if (constantValue(g->c, node, &value)) {
+        *low = *high = value;
+        return true;
+    }
+    switch (n->kind) {
+        case AST_VARIABLE:
+            if (!g->range[n->a].known) return false;
+            *low = g->range[n->a].low;
+            *high = g->range[n->a].high;
+            return true;
+        case AST_NEGATE:
+            if (!cBounds(g, n->a, &l1, &h1)) return false;
+            *low = -h1;
+            *high = -l1;
+            break;
+        case AST_BINARY:
+            if (!cBounds(g, n->a, &l1, &h1) || !cBounds(g, n->b, &l2, &h2)) return false;
+            if (n->op == PLUS) {
+                *low = l1 + l2;
+                *high = h1 + h2;
+            } else if (n->op == MINUS) {
+                *low = l1 - h2;
+                *high = h1 - l2;
+            } else if (n->op == TIMES) {
+                int64_t p[4] = {l1 * l2, l1 * h2, h1 * l2, h1 * h2};
+                *low = *high = p[0];
+                for (int i = 1; i < 4; i++) {
+                    if (p[i] < *low) *low = p[i];
+                    if (p[i] > *high) *high = p[i];
+                }
+            } else {
+                return false;
+            }
+            break;
+        default:
+            return false;
+    }
+    // Past the range of int32 the VM wraps around, and nothing is known.
+    return *low >= INT32_MIN && *high <= INT32_MAX;
+}
+
+static bool cIndexInBounds(const CGen *g, int array, int index) {
+    int64_t low, high;
+    return cBounds(g, index, &low, &high) && low >= 0 && high < cArraySize(g, array);
+}
+
+// Declare a temporary holding 'value' ahead of the statement. Writes its name to 't'.
+static void cTemporary(CGen *g, CText *t, const char *type, const CText *value) {
+    cText(g, &g->prefix, "%s t%d = %s;\n", type, g->temporaries, cString(value));
+    cText(g, t, "t%d", g->temporaries++);
+}
+
+static void cExpression(CGen *g, CText *t, int node);
+
+// The index of an element of 'array', checked unless it is known to be in bounds.
+// With 'first' the index is computed ahead of the statement, for a statement
+// whose other operands can fail too.
+static void cIndex(CGen *g, CText *t, int array, int index, bool first) {
+    CText checked = {NULL, 0, 0};
+    if (cIndexInBounds(g, array, index)) {
+        cExpression(g, t, index);
+        return;
+    }
+    cText(g, &checked, "pl0_index(");
+    cExpression(g, &checked, index);
+    cText(g, &checked, ", %d, %d)", cArraySize(g, array), g->line);
+    if (first) {
+        cTemporary(g, t, "int32_t", &checked);
+    } else {
+        cText(g, t, "%s", cString(&checked));
+    }
+    free(checked.text);
+}
+
+static void cElement(CGen *g, CText *t, int array, int index, bool first) {
+    cPlace(g, t, array);
+    cText(g, t, "[");
+    cIndex(g, t, array, index, first);
+    cText(g, t, "]");
+}
+
+static const char *cRelation(TokenType op) {
+    switch (op) {
+        case EQU: return "==";
+        case NEQ: return "!=";
+        case LSS: return "<";
+        case LEQ: return "<=";
+        case GTR: return ">";
+        default:  return ">=";
+    }
+}
+
+static void cExpression(CGen *g, CText *t, int node) {
+    const AstNode *n = cNode(g, node);
+    int value;
+    if (constantValue(g->c, node, &value)) {
+        cNumber(g, t, value);
+        return;
+    }
+    switch (n->kind) {
+        case AST_VARIABLE:
+            cScalar(g, t, n->a);
+            break;
+        case AST_ELEMENT:
+            cElement(g, t, n->a, n->b, false);
+            break;
+        case AST_NEGATE:
+            cText(g, t, "pl0_neg(");
+            cExpression(g, t, n->a);
+            cText(g, t, ")");
+            break;
+        case AST_ODD:
+            cText(g, t, "(");
+            cExpression(g, t, n->a);
+            cText(g, t, " & 1)");
+            break;
+        case AST_BINARY: case AST_COMPARE: {
+            CText left = {NULL, 0, 0}, right = {NULL, 0, 0};
+            if (exprMayFail(g->c, n->a) && exprMayFail(g->c, n->b)) {
+                CText value = {NULL, 0, 0};
+                cExpression(g, &value, n->a);
+                cTemporary(g, &left, "int32_t", &value);
+                free(value.text);
+            } else {
+                cExpression(g, &left, n->a);
+            }
+            cExpression(g, &right, n->b);
+            const char *l = cString(&left), *r = cString(&right);
+            int divisor;
+            bool plainDivisor = constantValue(g->c, n->b, &divisor) && divisor != 0 && divisor != -1;
+            if (n->kind == AST_COMPARE) {
+                cText(g, t, "(%s %s %s)", l, cRelation((TokenType)n->op), r);
+            } else if (n->op == PLUS || n->op == MINUS || n->op == TIMES) {
+                cText(g, t, "pl0_%s(%s, %s)", n->op == PLUS ? "add" : n->op == MINUS ? "sub" : "mul", l, r);
+            } else if (plainDivisor) {
+                cText(g, t, n->op == SLASH ? "(%s / %s)" : "(%s %% %s)", l, r);
+            } else {
+                cText(g, t, "pl0_%s(%s, %s, %d)", n->op == SLASH ? "div" : "mod", l, r, g->line);
+            }
+            free(left.text);
+            free(right.text);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Write the declarations the statement needs ahead of it.
+static void cPrefix(CGen *g) {
+    char *line = g->prefix.text;
+    for (char *end; line != NULL && (end = strchr(line, '\n')) != NULL; line = end + 1) {
+        cLine(g, "%.*s", (int)(end - line), line);
+    }
+    g->prefix.length = 0;
+}
+
+// The same in a block of their own. Returns whether the block was opened.
+static bool cBeginStatement(CGen *g) {
+    if (g->prefix.length == 0) {
+        return false;
+    }
+    cLine(g, "{");
+    g->indent++;
+    cPrefix(g);
+    return true;
+}
+
+static void cEndStatement(CGen *g, bool opened) {
+    if (opened) {
+        g->indent--;
+        cLine(g, "}");
+    }
+}
+
+// Store into a variable, or an array element if 'index' is not AST_NONE.
+static void cAssign(CGen *g, int symbol, int index, int value) {
+    CText target = {NULL, 0, 0}, source = {NULL, 0, 0};
+    if (index == AST_NONE) {
+        cScalar(g, &target, symbol);
+    } else {
+        // The VM checks the index before evaluating the value.
+        cElement(g, &target, symbol, index, exprMayFail(g->c, value));
+    }
+    cExpression(g, &source, value);
+    bool opened = cBeginStatement(g);
+    cLine(g, "%s = %s;", cString(&target), cString(&source));
+    cEndStatement(g, opened);
+    free(target.text);
+    free(source.text);
+}
+
+static void cCall(CGen *g, const AstNode *n) {
+    CText call = {NULL, 0, 0};
+    int argument = n->b;
+    if (n->a < BUILTIN_COUNT) {
+        const AstNode *arg = cNode(g, argument);
+        switch ((Builtin)n->a) {
+            case BUILTIN_READ: case BUILTIN_READLN:
+                cText(g, &call, "pl0_read(&");
+                if (arg->kind == AST_ELEMENT) {
+                    cElement(g, &call, arg->a, arg->b, false);
+                } else {
+                    cScalar(g, &call, arg->a);
+                }
+                cText(g, &call, ", %d, %d);", n->a == BUILTIN_READLN, g->line);
+                break;
+            case BUILTIN_WRITE: case BUILTIN_WRITELN:
+                cText(g, &call, "pl0_write(");
+                cExpression(g, &call, argument);
+                cText(g, &call, ", %d);", n->a == BUILTIN_WRITELN);
+                break;
+            default:
+                break;
+        }
+    } else {
+        unsigned varParams = g->c->procInfo[cSymbol(g, n->a)->info].varParams;
+        int last = -1, i = 0;
+        for (int a = argument; a != AST_NONE; a = cNode(g, a)->next, i++) {
+            if (exprMayFail(g->c, a)) last = i;
+        }
+        cName(g, &call, n->a);
+        cText(g, &call, "(");
+        if (cHasEnv(g, n->a)) {
+            cFrameAt(g, &call, cSymbol(g, n->a)->level);
+        }
+        i = 0;
+        for (int a = argument; a != AST_NONE; a = cNode(g, a)->next, i++) {
+            CText value = {NULL, 0, 0};
+            const AstNode *arg = cNode(g, a);
+            if (!(varParams >> i & 1)) {
+                cExpression(g, &value, a);
+            } else if (arg->kind == AST_ELEMENT) {
+                cText(g, &value, "&");
+                cElement(g, &value, arg->a, arg->b, false);
+            } else if (g->reference[arg->a]) {
+                cPlace(g, &value, arg->a);
+            } else {
+                cText(g, &value, "&");
+                cPlace(g, &value, arg->a);
+            }
+            cText(g, &call, i > 0 || cHasEnv(g, n->a) ? ", " : "");
+            if (i < last && exprMayFail(g->c, a)) {
+                // Arguments are evaluated in order on the VM.
+                cTemporary(g, &call, varParams >> i & 1 ? "int32_t *" : "int32_t", &value);
+            } else {
+                cText(g, &call, "%s", cString(&value));
+            }
+            free(value.text);
+        }
+        cText(g, &call, ");");
+    }
+    bool opened = cBeginStatement(g);
+    cLine(g, "%s", cString(&call));
+    cEndStatement(g, opened);
+    free(call.text);
+}
+
+// True if running the statement can change 'symbol' other than through a
+// procedure; with 'calls' any call to a procedure counts as well.
+static bool cWrites(const CGen *g, int node, int symbol, bool calls) {
+    if (node == AST_NONE) {
+        return false;
+    }
+    const AstNode *n = cNode(g, node);
+    switch (n->kind) {
+        case AST_ASSIGN: case AST_FOR:
+            return n->a == symbol || (n->kind == AST_FOR && cWrites(g, n->c, symbol, calls));
+        case AST_CALL: {
+            if (n->a >= BUILTIN_COUNT && calls) {
+                return true;
+            }
+            unsigned varParams = n->a < BUILTIN_COUNT ? (n->a == BUILTIN_READ || n->a == BUILTIN_READLN)
+                                                      : g->c->procInfo[cSymbol(g, n->a)->info].varParams;
+            int i = 0;
+            for (int a = n->b; a != AST_NONE; a = cNode(g, a)->next, i++) {
+                if ((varParams >> i & 1) && cNode(g, a)->kind == AST_VARIABLE && cNode(g, a)->a == symbol) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        case AST_BEGIN:
+            for (int s = n->a; s != AST_NONE; s = cNode(g, s)->next) {
+                if (cWrites(g, s, symbol, calls)) return true;
+            }
+            return false;
+        case AST_IF:
+            return cWrites(g, n->b, symbol, calls) || cWrites(g, n->c, symbol, calls);
+        case AST_WHILE:
+            return cWrites(g, n->b, symbol, calls);
+        default:
+            return false;
+    }
+}
+
+static void cStatement(CGen *g, int node);
+
+static void cFor(CGen *g, const AstNode *n) {
+    int symbol = n->a, end = cNode(g, n->b)->next;
+    const Symbol *v = cSymbol(g, symbol);
+    CText variable = {NULL, 0, 0}, limit = {NULL, 0, 0};
+    cAssign(g, symbol, AST_NONE, n->b);
+
+    // The body sees the variable between the bounds if nothing but the loop
+    // changes it: not the body, and not a procedure it calls.
+    int64_t startLow, startHigh, limitLow, limitHigh;
+    bool local = !g->reference[symbol] && ((v->level == g->level && !g->captured[symbol]) || v->level == 0);
+    bool fixed = local && !cWrites(g, n->c, symbol, v->level == 0);
+    bool bounded = fixed && cBounds(g, n->b, &startLow, &startHigh) && cBounds(g, end, &limitLow, &limitHigh);
+    int value;
+    bool opened = false;
+    if (constantValue(g->c, end, &value)) {
+        cNumber(g, &limit, value);
+    } else {
+        CText expression = {NULL, 0, 0};
+        cExpression(g, &expression, end);
+        cTemporary(g, &limit, "int32_t", &expression);
+        free(expression.text);
+        opened = cBeginStatement(g);
+    }
+    cScalar(g, &variable, symbol);
+    const char *x = cString(&variable);
+    if (bounded && limitHigh < INT32_MAX) {
+        cLine(g, "for (; %s <= %s; %s++) {", x, cString(&limit), x);
+    } else {
+        cLine(g, "for (; %s <= %s; %s = pl0_add(%s, 1)) {", x, cString(&limit), x, x);
+    }
+    CRange outer = g->range[symbol];
+    if (bounded) {
+        g->range[symbol].low = (int32_t)startLow;
+        g->range[symbol].high = (int32_t)limitHigh;
+        g->range[symbol].known = true;
+    }
+    g->indent++;
+    cStatement(g, n->c);
+    g->indent--;
+    g->range[symbol] = outer;
+    cLine(g, "}");
+    cEndStatement(g, opened);
+    free(variable.text);
+    free(limit.text);
+}
+
+static void cStatement(CGen *g, int node) {
+    if (node == AST_NONE) {
+        return;
+    }
+    const AstNode *n = cNode(g, node);
+    CText condition = {NULL, 0, 0};
+    bool opened;
+    g->line = n->line;
+    switch (n->kind) {
+        case AST_ASSIGN:
+            cAssign(g, n->a, n->b, n->c);
+            break;
+        case AST_CALL:
+            cCall(g, n);
+            break;
+        case AST_BEGIN:
+            for (int s = n->a; s != AST_NONE; s = cNode(g, s)->next) {
+                cStatement(g, s);
+            }
+            break;
+        case AST_IF:
+            cExpression(g, &condition, n->a);
+            opened = cBeginStatement(g);
+            cLine(g, "if %s {", cString(&condition));
+            g->indent++;
+            cStatement(g, n->b);
+            g->indent--;
+            if (n->c != AST_NONE) {
+                cLine(g, "} else {");
+                g->indent++;
+                cStatement(g, n->c);
+                g->indent--;
+            }
+            cLine(g, "}");
+            cEndStatement(g, opened);
+            break;
+        case AST_WHILE:
+            cExpression(g, &condition, n->a);
+            if (g->prefix.length == 0) {
+                cLine(g, "while %s {", cString(&condition));
+                g->indent++;
+            } else {
+                // The temporaries the condition needs are computed on every test.
+                cLine(g, "for (;;) {");
+                g->indent++;
+                cPrefix(g);
+                cLine(g, "if (!%s) break;", cString(&condition));
+            }
+            cStatement(g, n->b);
+            g->indent--;
+            cLine(g, "}");
+            break;
+        case AST_FOR:
+            cFor(g, n);
+            break;
+        default:
+            break;
+    }
+    free(condition.text);
+}
+
+// A value as a C operand: the constant itself, or its local.
+static void cIrValue(CGen *g, CText *t, const IrFunction *f, int value) {
+    int32_t k;
+    if (irConstantValue(f, value, &k)) {
+        cNumber(g, t, k);
+    } else {
+        cText(g, t, "v%d", value);
+    }
+}
+
+// An element of 'array' at 'index', checked unless the index is a constant inside it.
+static void cIrElement(CGen *g, CText *t, const IrFunction *f, int array, int index, int line) {
+    int32_t k;
+    cPlace(g, t, array);
+    cText(g, t, "[");
+    if (irConstantValue(f, index, &k) && k >= 0 && k < cArraySize(g, array)) {
+        cText(g, t, "%d", k);
+    } else {
+        cText(g, t, "pl0_index(");
+        cIrValue(g, t, f, index);
+        cText(g, t, ", %d, %d)", cArraySize(g, array), line);
+    }
+    cText(g, t, "]");
+}
+
+// The assignments of the phis of 'to' something uses, for the edge from 'from', through
+// temporaries if one reads a phi another assigns.
+static void cIrCopies(CGen *g, const IrFunction *f, int from, int to) {
+    bool swap = false;
+    for (int pass = 0; pass < 3; pass++) {
+        if (pass == 1 && swap) {
+            cLine(g, "{");
+            g->indent++;
+        }
+        for (int i = f->blocks[to].first; i != IR_NONE; i = f->code[i].next) {
+            const IrInstruction *in = &f->code[i];
+            if (in->op == IR_NOP) continue;
+            if (in->op != IR_PHI) break;
+            if (!g->irUsed[i]) continue;
+            int value = irPredIndex(f, to, from) == 0 ? in->a : in->b;
+            CText source = {NULL, 0, 0};
+            cIrValue(g, &source, f, value);
+            if (pass == 0) {
+                swap = swap || (f->code[value].op == IR_PHI && f->code[value].block == to && value != i);
+            } else if (pass == 1 && swap) {
+                cLine(g, "int32_t t%d = %s;", i, cString(&source));
+            } else if (pass == 2 && value != i) {
+                if (swap) {
+                    cLine(g, "v%d = t%d;", i, i);
+                } else {
+                    cLine(g, "v%d = %s;", i, cString(&source));
+                }
+            }
+            free(source.text);
+        }
+    }
+    if (swap) {
+        g->indent--;
+        cLine(g, "}");
+    }
+}
+
+static bool cIrHasCopies(const IrFunction *f, int to) {
+    int first = f->blocks[to].first;
+    while (first != IR_NONE && f->code[first].op == IR_NOP) {
+        first = f->code[first].next;
+    }
+    return first != IR_NONE && f->code[first].op == IR_PHI;
+}
+
+// Whether the branch ending a block is written as 'if (!(c)) goto ifFalse'.
+static bool cIrFallsThrough(const IrFunction *f, int block, int next) {
+    const IrBlock *b = &f->blocks[block];
+    return b->succ[0] == next && !cIrHasCopies(f, b->succ[0]) && !cIrHasCopies(f, b->succ[1]);
+}
+
+static void cIrInstruction(CGen *g, const IrFunction *f, int i, int next) {
+    const IrInstruction *in = &f->code[i];
+    const IrBlock *block = &f->blocks[in->block];
+    CText t = {NULL, 0, 0}, a = {NULL, 0, 0}, b = {NULL, 0, 0};
+    char target[24];
+    int32_t k;
+    // A value nothing uses is still computed for the runtime error it may raise.
+    snprintf(target, sizeof(target), g->irUsed[i] ? "v%d = " : "(void)(", i);
+    const char *close = g->irUsed[i] ? "" : ")";
+    if (in->a != IR_NONE && in->op != IR_PHI) cIrValue(g, &a, f, in->a);
+    if (in->b != IR_NONE && in->op != IR_PHI) cIrValue(g, &b, f, in->b);
+    switch ((IrOpcode)in->op) {
+        case IR_PARAM:
+            cName(g, &t, in->symbol);
+            cLine(g, "%s%s%s;", target, cString(&t), close);
+            break;
+        case IR_COPY:
+            cLine(g, "%s%s%s;", target, cString(&a), close);
+            break;
+        case IR_LOAD:
+            cScalar(g, &t, in->symbol);
+            cLine(g, "%s%s%s;", target, cString(&t), close);
+            break;
+        case IR_STORE:
+            cScalar(g, &t, in->symbol);
+            cLine(g, "%s = %s;", cString(&t), cString(&a));
+            break;
+        case IR_LOADX:
+            cIrElement(g, &t, f, in->symbol, in->a, in->line);
+            cLine(g, "%s%s%s;", target, cString(&t), close);
+            break;
+        case IR_STOREX:
+            cIrElement(g, &t, f, in->symbol, in->a, in->line);
+            cLine(g, "%s = %s;", cString(&t), cString(&b));
+            break;
+        case IR_CHECK:
+            cLine(g, "pl0_index(%s, %d, %d);", cString(&a), cArraySize(g, in->symbol), in->line);
+            break;
+        case IR_ADDRESS:
+            if (in->a != IR_NONE) {
+                cText(g, &t, "&");
+                cIrElement(g, &t, f, in->symbol, in->a, in->line);
+            } else if (g->reference[in->symbol]) {
+                cPlace(g, &t, in->symbol);
+            } else {
+                cText(g, &t, "&");
+                cPlace(g, &t, in->symbol);
+            }
+            cLine(g, "%s%s%s;", target, cString(&t), close);
+            break;
+        case IR_NEG:
+            cLine(g, "%spl0_neg(%s)%s;", target, cString(&a), close);
+            break;
+        case IR_ADD: case IR_SUB: case IR_MUL:
+            cLine(g, "%spl0_%s(%s, %s)%s;", target, in->op == IR_ADD ? "add" : in->op == IR_SUB ? "sub" : "mul",
+                  cString(&a), cString(&b), close);
+            break;
+        case IR_DIV: case IR_MOD:
+            if (irConstantValue(f, in->b, &k) && k != 0 && k != -1) {
+                cLine(g, in->op == IR_DIV ? "%s%s / %s%s;" : "%s%s %% %s%s;", target, cString(&a), cString(&b), close);
+            } else {
+                cLine(g, "%spl0_%s(%s, %s, %d)%s;", target, in->op == IR_DIV ? "div" : "mod", cString(&a),
+                      cString(&b), in->line, close);
+            }
+            break;
+        case IR_READ:
+            cLine(g, "pl0_read(&v%d, %d, %d);", i, in->k, in->line);
+            break;
+        case IR_WRITE:
+            cLine(g, "pl0_write(%s, %d);", cString(&a), in->k);
+            break;
+        case IR_CALL:
+            cName(g, &t, in->symbol);
+            cText(g, &t, "(");
+            if (cHasEnv(g, in->symbol)) {
+                cFrameAt(g, &t, cSymbol(g, in->symbol)->level);
+            }
+            for (int j = 0; j < f->arguments[in->k]; j++) {
+                cText(g, &t, j > 0 || cHasEnv(g, in->symbol) ? ", " : "");
+                cIrValue(g, &t, f, f->arguments[in->k + 1 + j]);
+            }
+            cLine(g, "%s);", cString(&t));
+            break;
+        case IR_JUMP:
+            cIrCopies(g, f, in->block, block->succ[0]);
+            if (block->succ[0] != next) cLine(g, "goto b%d;", block->succ[0]);
+            break;
+        case IR_BRANCH:
+            if (in->k == ODD) {
+                cText(g, &t, "(%s & 1)", cString(&a));
+            } else {
+                cText(g, &t, "%s %s %s", cString(&a), cRelation((TokenType)in->k), cString(&b));
+            }
+            if (cIrFallsThrough(f, in->block, next)) {
+                cLine(g, "if (!(%s)) goto b%d;", cString(&t), block->succ[1]);
+                break;
+            }
+            if (!cIrHasCopies(f, block->succ[0])) {
+                cLine(g, "if (%s) goto b%d;", cString(&t), block->succ[0]);
+            } else {
+                cLine(g, "if (%s) {", cString(&t));
+                g->indent++;
+                cIrCopies(g, f, in->block, block->succ[0]);
+                cLine(g, "goto b%d;", block->succ[0]);
+                g->indent--;
+                cLine(g, "}");
+            }
+            cIrCopies(g, f, in->block, block->succ[1]);
+            if (block->succ[1] != next) cLine(g, "goto b%d;", block->succ[1]);
+            break;
+        case IR_RETURN:
+            if (f->symbol != IR_NONE) {
+                cLine(g, "pl0_cells -= %d;", f->variables + g->c->procInfo[cSymbol(g, f->symbol)->info].numParams);
+            }
+            cLine(g, "return;");
+            break;
+        default:
+            break;
+    }
+    free(t.text);
+    free(a.text);
+    free(b.text);
+}
+
+// The body of a function from its IR, ending at its IR_RETURN.
+static void cIrFunction(CGen *g, IrFunction *f) {
+    int32_t *order = malloc((size_t)f->blockCount * sizeof(int32_t));
+    bool *label = calloc((size_t)f->blockCount, sizeof(bool));
+    bool *used = calloc((size_t)(f->count ? f->count : 1), sizeof(bool));
+    int32_t *work = malloc((size_t)(f->count ? f->count : 1) * sizeof(int32_t));
+    int count = order != NULL && label != NULL && used != NULL && work != NULL ? irReversePostorder(f, order) : -1;
+    if (count < 0) {
+        g->outOfMemory = true;
+        free(order);
+        free(label);
+        free(used);
+        free(work);
+        return;
+    }
+    // A phi is used only if something other than an unused phi reads it.
+    int top = 0;
+    for (int i = 0; i < f->count; i++) {
+        int32_t *operands[MAX_PARAMS + 2];
+        int n = f->code[i].op != IR_NOP && f->code[i].op != IR_PHI && f->code[i].block != IR_NONE
+                    ? irOperands(f, &f->code[i], operands) : 0;
+        for (int j = 0; j < n; j++) {
+            if (!used[*operands[j]] && f->code[*operands[j]].op == IR_PHI) work[top++] = *operands[j];
+            used[*operands[j]] = true;
+        }
+        while (top > 0) {
+            int32_t *phi[MAX_PARAMS + 2];
+            int m = irOperands(f, &f->code[work[--top]], phi);
+            for (int j = 0; j < m; j++) {
+                if (!used[*phi[j]] && f->code[*phi[j]].op == IR_PHI) work[top++] = *phi[j];
+                used[*phi[j]] = true;
+            }
+        }
+    }
+    free(work);
+    g->irUsed = used;
+    CText values = {NULL, 0, 0}, addresses = {NULL, 0, 0};
+    for (int o = 0; o < count; o++) {
+        int b = order[o], next = o + 1 < count ? order[o + 1] : IR_NONE;
+        const IrBlock *block = &f->blocks[b];
+        for (int i = block->first; i != IR_NONE; i = f->code[i].next) {
+            int op = f->code[i].op;
+            if (irHasValue(op) && op != IR_CONST && (used[i] || op == IR_READ)) {
+                CText *list = op == IR_ADDRESS ? &addresses : &values;
+                cText(g, list, list->length > 0 ? ", %sv%d" : "%sv%d", op == IR_ADDRESS ? "*" : "", i);
+            }
+        }
+        int op = f->code[block->last].op;
+        if (op == IR_BRANCH) {
+            label[block->succ[0]] |= !cIrFallsThrough(f, b, next);
+            label[block->succ[1]] |= block->succ[1] != next || cIrFallsThrough(f, b, next);
+        } else if (op == IR_JUMP && block->succ[0] != next) {
+            label[block->succ[0]] = true;
+        }
+    }
+    if (values.length > 0) cLine(g, "int32_t %s;", cString(&values));
+    if (addresses.length > 0) cLine(g, "int32_t %s;", cString(&addresses));
+    free(values.text);
+    free(addresses.text);
+    for (int o = 0; o < count; o++) {
+        int b = order[o], next = o + 1 < count ? order[o + 1] : IR_NONE;
+        if (label[b]) {
+            g->indent--;
+            cLine(g, "b%d:", b);
+            g->indent++;
+        }
+        for (int i = f->blocks[b].first; i != IR_NONE; i = f->code[i].next) {
+            if (f->code[i].op != IR_NOP) cIrInstruction(g, f, i, next);
+        }
+    }
+    free(order);
+    free(label);
+    free(used);
+    g->irUsed = NULL;
+}
+
+// Record the uses of variables in a statement or expression of the block at 'level'.
+static void cScan(CGen *g, int node, int level) {
+    if (node == AST_NONE) {
+        return;
+    }
+    const AstNode *n = cNode(g, node);
+    switch (n->kind) {
+        case AST_ASSIGN: case AST_FOR: case AST_VARIABLE: case AST_ELEMENT: {
+            int symbolLevel = cSymbol(g, n->a)->level;
+            g->used[n->a] = true;
+            if (symbolLevel > 0 && symbolLevel < level) {
+                g->captured[n->a] = true;
+            }
+            if (n->kind == AST_FOR) {
+                cScan(g, n->b, level);
+                cScan(g, cNode(g, n->b)->next, level);
+                cScan(g, n->c, level);
+            } else {
+                cScan(g, n->b, level);
+                if (n->kind == AST_ASSIGN) cScan(g, n->c, level);
+            }
+            break;
+        }
+        case AST_CALL:
+            g->reads |= n->a == BUILTIN_READ || n->a == BUILTIN_READLN;
+            g->writes |= n->a == BUILTIN_WRITE || n->a == BUILTIN_WRITELN;
+            for (int a = n->b; a != AST_NONE; a = cNode(g, a)->next) {
+                cScan(g, a, level);
+            }
+            break;
+        case AST_BEGIN:
+            for (int s = n->a; s != AST_NONE; s = cNode(g, s)->next) {
+                cScan(g, s, level);
+            }
+            break;
+        case AST_IF: case AST_WHILE: case AST_COMPARE: case AST_BINARY:
+            cScan(g, n->a, level);
+            cScan(g, n->b, level);
+            if (n->kind == AST_IF) cScan(g, n->c, level);
+            break;
+        case AST_ODD: case AST_NEGATE:
+            cScan(g, n->a, level);
+            break;
+        default:
+            break;
+    }
+}
+
+// Record the uses of variables in a block and the blocks nested in it, and which
+// procedure declares each procedure.
+static void cScanBlock(CGen *g, int block, int level, int procedure) {
+    const AstNode *n = cNode(g, block);
+    for (int p = n->a; p != AST_NONE; p = cNode(g, p)->next) {
+        const AstNode *proc = cNode(g, p);
+        g->parent[proc->a] = procedure;
+        cScanBlock(g, proc->b, cSymbol(g, proc->a)->level + 1, proc->a);
+    }
+    cScan(g, n->b, level);
+}
+
+// Whether a variable of the block at 'level' whose scope starts at 'first' is captured.
+static bool cCapturesAny(const CGen *g, int first, int level) {
+    for (int s = first; s < g->c->symbolCount && cSymbol(g, s)->level >= level; s++) {
+        if (cSymbol(g, s)->level == level && cSymbol(g, s)->kind == KIND_VAR && g->captured[s]) return true;
+    }
+    return false;
+}
+
+// Decide which procedures keep a frame struct, outside in: those with variables
+// nested procedures use, and those with an env pointer to pass on to procedures
+// nested in them.
+static void cFrames(CGen *g, int block) {
+    for (int p = cNode(g, block)->a; p != AST_NONE; p = cNode(g, p)->next) {
+        const AstNode *proc = cNode(g, p);
+        g->framed[proc->a] = (cHasEnv(g, proc->a) && cNode(g, proc->b)->a != AST_NONE) ||
+                             cCapturesAny(g, cNode(g, proc->b)->c, cSymbol(g, proc->a)->level + 1);
+        cFrames(g, proc->b);
+    }
+}
+
+// Record how the procedure 'symbol' uses variables, env and its frame in a
+// statement or expression of its body.
+static void cAccess(CGen *g, int node, int symbol) {
+    if (node == AST_NONE) {
+        return;
+    }
+    const AstNode *n = cNode(g, node);
+    switch (n->kind) {
+        case AST_ASSIGN: case AST_FOR: case AST_VARIABLE: case AST_ELEMENT: {
+            int level = cSymbol(g, n->a)->level;
+            g->usesEnv |= level > 0 && level < g->level;
+            // Storing through a VAR parameter reads the pointer.
+            g->access[n->a] |= n->kind == AST_ASSIGN && !g->reference[n->a] ? C_WRITTEN : C_READ;
+            if (n->kind == AST_FOR) {
+                cAccess(g, n->b, symbol);
+                cAccess(g, cNode(g, n->b)->next, symbol);
+                cAccess(g, n->c, symbol);
+            } else {
+                cAccess(g, n->b, symbol);
+                if (n->kind == AST_ASSIGN) cAccess(g, n->c, symbol);
+            }
+            break;
+        }
+        case AST_CALL:
+            if (n->a >= BUILTIN_COUNT && cHasEnv(g, n->a)) {
+                g->inFrame |= g->parent[n->a] == symbol;
+                g->usesEnv |= g->parent[n->a] != symbol;
+            }
+            for (int a = n->b; a != AST_NONE; a = cNode(g, a)->next) {
+                cAccess(g, a, symbol);
+            }
+            break;
+        case AST_BEGIN:
+            for (int s = n->a; s != AST_NONE; s = cNode(g, s)->next) {
+                cAccess(g, s, symbol);
+            }
+            break;
+        case AST_IF: case AST_WHILE: case AST_COMPARE: case AST_BINARY:
+            cAccess(g, n->a, symbol);
+            cAccess(g, n->b, symbol);
+            if (n->kind == AST_IF) cAccess(g, n->c, symbol);
+            break;
+        case AST_ODD: case AST_NEGATE:
+            cAccess(g, n->a, symbol);
+            break;
+        default:
+            break;
+    }
+}
+
+// cAccess over the IR of the procedure 'symbol', which may have dropped uses the tree has.
+static void cIrAccess(CGen *g, const IrFunction *f, int symbol) {
+    for (int i = 0; i < f->count; i++) {
+        const IrInstruction *in = &f->code[i];
+        if (in->op == IR_NOP || in->block == IR_NONE) {
+            continue;
+        }
+        switch ((IrOpcode)in->op) {
+            case IR_PARAM: case IR_LOAD: case IR_STORE: case IR_LOADX: case IR_STOREX: case IR_ADDRESS: {
+                int level = cSymbol(g, in->symbol)->level;
+                g->usesEnv |= level > 0 && level < g->level;
+                g->access[in->symbol] |= in->op == IR_STORE && !g->reference[in->symbol] ? C_WRITTEN : C_READ;
+                break;
+            }
+            case IR_CALL:
+                if (cHasEnv(g, in->symbol)) {
+                    g->inFrame |= g->parent[in->symbol] == symbol;
+                    g->usesEnv |= g->parent[in->symbol] != symbol;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Declare a variable: 'member' for a frame struct, or as a local or global zeroed.
+static void cDeclare(CGen *g, int symbol, bool member, const char *storage) {
+    CText name = {NULL, 0, 0};
+    cName(g, &name, symbol);
+    if (cSymbol(g, symbol)->type == TYPE_ARRAY) {
+        if (member) {
+            cLine(g, "int32_t %s[%d];", cString(&name), cArraySize(g, symbol));
+        } else {
+            cLine(g, "%sint32_t %s[%d] = {0};", storage, cString(&name), cArraySize(g, symbol));
+        }
+    } else if (g->reference[symbol]) {
+        cLine(g, "int32_t *%s;", cString(&name));
+    } else if (member) {
+        cLine(g, "int32_t %s;", cString(&name));
+    } else {
+        cLine(g, "%sint32_t %s = 0;", storage, cString(&name));
+    }
+    free(name.text);
+}
+
+// The signature of the procedure's function.
+static void cSignature(CGen *g, CText *t, int symbol) {
+    const ProcInfo *proc = &g->c->procInfo[cSymbol(g, symbol)->info];
+    cText(g, t, "static void ");
+    cName(g, t, symbol);
+    cText(g, t, "(");
+    if (cHasEnv(g, symbol)) {
+        cText(g, t, "struct frame_%d *env", g->parent[symbol]);
+    }
+    for (int i = 0; i < proc->numParams; i++) {
+        cText(g, t, i > 0 || cHasEnv(g, symbol) ? ", " : "");
+        cText(g, t, proc->varParams >> i & 1 ? "int32_t *" : "int32_t ");
+        cName(g, t, symbol + 1 + i);
+    }
+    cText(g, t, proc->numParams == 0 && !cHasEnv(g, symbol) ? "void)" : ")");
+}
+
+// Frame structs and prototypes of the procedures declared in a block and in the
+// blocks nested in it.
+static void cDeclarations(CGen *g, int block, bool prototypes) {
+    for (int p = cNode(g, block)->a; p != AST_NONE; p = cNode(g, p)->next) {
+        const AstNode *proc = cNode(g, p);
+        int symbol = proc->a, level = cSymbol(g, symbol)->level + 1;
+        if (prototypes) {
+            CText signature = {NULL, 0, 0};
+            cSignature(g, &signature, symbol);
+            cLine(g, "%s;", cString(&signature));
+            free(signature.text);
+        } else if (g->framed[symbol]) {
+            cLine(g, "struct frame_%d {", symbol);
+            g->indent++;
+            if (cHasEnv(g, symbol)) {
+                cLine(g, "struct frame_%d *up;", g->parent[symbol]);
+            }
+            for (int s = cNode(g, proc->b)->c; s < g->c->symbolCount && cSymbol(g, s)->level >= level; s++) {
+                if (cSymbol(g, s)->level == level && cSymbol(g, s)->kind == KIND_VAR && g->captured[s]) {
+                    cDeclare(g, s, true, "");
+                }
+            }
+            g->indent--;
+            cLine(g, "};");
+            cLine(g, "");
+        }
+        cDeclarations(g, proc->b, prototypes);
+    }
+}
+
+// The function of each procedure declared in a block, then of the procedures nested in those.
+static void cProcedures(CGen *g, int block) {
+    for (int p = cNode(g, block)->a; p != AST_NONE; p = cNode(g, p)->next) {
+        const AstNode *proc = cNode(g, p);
+        const AstNode *body = cNode(g, proc->b);
+        int symbol = proc->a, level = cSymbol(g, symbol)->level + 1;
+        int numParams = g->c->procInfo[cSymbol(g, symbol)->info].numParams;
+        CText signature = {NULL, 0, 0};
+        cSignature(g, &signature, symbol);
+        cLine(g, "%s {", cString(&signature));
+        free(signature.text);
+        g->indent++;
+        g->level = level;
+        g->temporaries = 0;
+        int end = body->c;
+        while (end < g->c->symbolCount && cSymbol(g, end)->level >= level) {
+            end++;
+        }
+        for (int s = body->c; s < end; s++) {
+            g->access[s] = 0;
+        }
+        g->inFrame = g->usesEnv = false;
+        if (g->ir != NULL) {
+            cIrAccess(g, &g->ir->functions[g->ir->function[symbol]], symbol);
+        } else {
+            cAccess(g, body->b, symbol);
+        }
+        if (g->inFrame) {
+            cLine(g, "struct frame_%d frame = {0};", symbol);
+            if (cHasEnv(g, symbol)) {
+                cLine(g, "frame.up = env;");
+            }
+        }
+        for (int s = body->c; s < end; s++) {
+            if (cSymbol(g, s)->level != level || cSymbol(g, s)->kind != KIND_VAR) {
+                continue;
+            }
+            bool parameter = s <= symbol + numParams, member = g->inFrame && g->captured[s];
+            if (parameter && member) {
+                CText name = {NULL, 0, 0};
+                cName(g, &name, s);
+                cLine(g, "frame.%s = %s;", cString(&name), cString(&name));
+                free(name.text);
+            } else if (!parameter && !member && g->access[s] != 0 && !(g->ir != NULL && g->ir->inSsa[s])) {
+                cDeclare(g, s, false, "");
+            }
+        }
+        // Keep the C compiler quiet about what only the procedures nested here use, or nothing does.
+        if (cHasEnv(g, symbol) && !g->inFrame && !g->usesEnv) {
+            cLine(g, "(void)env;");
+        }
+        for (int s = body->c; s < end; s++) {
+            if (cSymbol(g, s)->level != level || cSymbol(g, s)->kind != KIND_VAR || cSymbol(g, s)->type == TYPE_ARRAY) {
+                continue;
+            }
+            bool parameter = s <= symbol + numParams, member = g->inFrame && g->captured[s];
+            bool local = !member && g->access[s] != 0 && !(g->ir != NULL && g->ir->inSsa[s]);
+            if ((parameter || local) && !member && !(g->access[s] & C_READ)) {
+                CText name = {NULL, 0, 0};
+                cName(g, &name, s);
+                cLine(g, "(void)%s;", cString(&name));
+                free(name.text);
+            }
+        }
+        cLine(g, "pl0_enter(%d, %d);", proc->c + numParams, body->line);
+        if (g->ir != NULL) {
+            cIrFunction(g, &g->ir->functions[g->ir->function[symbol]]);
+        } else {
+            cStatement(g, body->b);
+            cLine(g, "pl0_cells -= %d;", proc->c + numParams);
+        }
+        g->indent--;
+        cLine(g, "}");
+        cLine(g, "");
+        cProcedures(g, proc->b);
+    }
+}
+
+// Write a program analyzed without errors as C, from its IR if 'ir' is not NULL.
+// Returns 0, or -1 if memory ran out or writing failed.
+static int emitC(const Compiler *c, const IrProgram *ir, FILE *out) {
+    CGen g;
+    memset(&g, 0, sizeof(g));
+    g.c = c;
+    g.out = out;
+    g.ir = ir;
+    size_t n = (size_t)c->symbolCount + 1;
+    g.reference = calloc(n, sizeof(bool));
+    g.used = calloc(n, sizeof(bool));
+    g.captured = calloc(n, sizeof(bool));
+    g.framed = calloc(n, sizeof(bool));
+    g.parent = calloc(n, sizeof(int));
+    g.range = calloc(n, sizeof(CRange));
+    g.access = calloc(n, 1);
+    int rc = -1;
+    if (g.reference != NULL && g.used != NULL && g.captured != NULL && g.framed != NULL && g.parent != NULL &&
+        g.range != NULL && g.access != NULL && c->ast.root != AST_NONE) {
+        markReferenceParameters(c, g.reference);
+        const AstNode *program = cNode(&g, c->ast.root);
+        const AstNode *block = cNode(&g, program->a);
+        cScanBlock(&g, program->a, 0, -1);
+        cFrames(&g, program->a);
+        if (ir != NULL) {
+            // The passes may have removed the input and output of code that never runs.
+            g.reads = g.writes = false;
+            for (int f = 0; f < ir->count; f++) {
+                for (int i = 0; i < ir->functions[f].count; i++) {
+                    g.reads |= ir->functions[f].code[i].op == IR_READ;
+                    g.writes |= ir->functions[f].code[i].op == IR_WRITE;
+                }
+            }
+        }
+
+        fprintf(out, "/* PL/0 program translated to C by semantic_analyzer_ver2 -E (see pl0_cgen.h). */\n\n");
+        fprintf(out, "%s#define PL0_STACK_CELLS %d\n%s%s%s", cHeaders, VM_STACK_CELLS, cRuntime,
+                g.reads ? cReadRuntime : "", g.writes ? cWriteRuntime : "");
+        cLine(&g, "");
+        bool globals = false;
+        for (int s = block->c; s < c->symbolCount; s++) {
+            if (cSymbol(&g, s)->level == 0 && cSymbol(&g, s)->kind == KIND_VAR && g.used[s] && !(ir != NULL && ir->inSsa[s])) {
+                cDeclare(&g, s, false, "static ");
+                globals = true;
+            }
+        }
+        if (globals) {
+            cLine(&g, "");
+        }
+        cDeclarations(&g, program->a, false);
+        cDeclarations(&g, program->a, true);
+        if (block->a != AST_NONE) {
+            cLine(&g, "");
+        }
+        cProcedures(&g, program->a);
+
+        cLine(&g, "static void pl0_program(void) {");
+        g.indent = 1;
+        g.level = 0;
+        g.temporaries = 0;
+        cLine(&g, "pl0_enter(%d, %d);", program->b, block->line);
+        if (ir != NULL) {
+            cIrFunction(&g, &ir->functions[ir->count - 1]);
+        } else {
+            cStatement(&g, block->b);
+        }
+        g.indent = 0;
+        cLine(&g, "}");
+        cLine(&g, "");
+        fputs(cMain, out);
+        rc = g.outOfMemory || ferror(out) ? -1 : 0;
+    }
+    free(g.reference);
+    free(g.used);
+    free(g.captured);
+    free(g.framed);
+    free(g.parent);
+    free(g.range);
+    free(g.access);
+    free(g.prefix.text);
+    return rc;
+}
+
+#endif
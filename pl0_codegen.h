@@ -0,0 +1,533 @@
+/*
+Code generation: lowers the syntax tree of a checked program to p-code.
+
+The target is a stack machine in the style of Wirth's PL/0 machine. Code is one
+dense array of 8-byte Instructions; an instruction that addresses a variable
+names it by static level difference (how many static links to follow from the
+current frame) and offset in that frame, Symbol.level and Symbol.address as the
+analyzer assigned them. Every frame starts with FRAME_HEADER link cells:
+
+  base + 0   static link: frame of the enclosing block
+  base + 1   dynamic link: frame of the caller
+  base + 2   return address
+
+A caller pushes the arguments and then CALs; the callee's frame starts just
+above them, so they are at negative offsets, and RET drops them. A VAR
+parameter holds the absolute stack address of its variable and is accessed
+through LDI and STI. Code starts with a JMP to the main program, which ends
+with HLT; procedures are laid out before the body of the block declaring them.
+*/
+
+#ifndef PL0_CODEGEN_H
+#define PL0_CODEGEN_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pl0_compiler.h"
+
+typedef enum {
+    OP_LIT,     // push a
+    OP_LOD,     // push the variable at level difference l, offset a
+    OP_STO,     // pop into the variable at l, a
+    OP_LDA,     // push the stack address of the variable at l, a
+    OP_LDI,     // replace the address on top with the value stored there
+    OP_STI,     // pop a value, then an address, and store the value there
+    OP_LDX,     // replace the index on top with that element of the array at l, a
+    OP_STX,     // pop a value, then an index, and store into that element of the array at l, a
+    OP_CHK,     // stop with an error unless 0 <= top < a (array index check)
+    OP_INT,     // grow the stack by a cells (a frame's variables)
+    OP_CAL,     // call the procedure at a, whose static link is l levels up
+    OP_RET,     // return from a procedure, dropping its a arguments
+    OP_JMP,     // jump to a
+    OP_JPC,     // pop, and jump to a if it was 0
+    OP_NEG,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,     // stops with an error on a zero divisor, as does OP_MOD
+    OP_MOD,
+    OP_ODD,
+    OP_EQL,
+    OP_NEQ,
+    OP_LSS,
+    OP_LEQ,
+    OP_GTR,
+    OP_GEQ,
+    OP_RED,     // read an integer and push it
+    OP_RDL,     // read an integer, skip the rest of its line and push it
+    OP_WRT,     // pop and write an integer
+    OP_WRL,     // pop and write an integer and a newline
+    OP_HLT,     // end of the program
+
+    // Superinstructions, only ever made by fuseSuperinstructions (pl0_peephole.h) out
+    // of the instructions listed; those stay in place and hold the operands.
+    OP_INC,     // LOD 0 a; LIT k; ADD; STO 0 a: add k to the variable
+    OP_FOR,     // OP_INC; JMP to a FOR test LOD 0 a; LOD 0 limit; LEQ; JPC exit
+    OP_JRL,     // LOD 0 x; LOD 0 y; <relation l>; JPC t
+    OP_JRK,     // LOD 0 x; LIT k; <relation l>; JPC t
+    OP_JR,      // <relation l>; JPC t
+    OP_ADK,     // LIT k; ADD
+    OP_MLK,     // LIT k; MUL
+    OP_DVK,     // LIT k; DIV, with k not 0
+    OP_MDK,     // LIT k; MOD, with k not 0
+    OP_LXK,     // LIT k; LDX 0 a (an element at a constant index)
+    OP_LXL,     // LOD 0 i; CHK n; LDX 0 a (an element indexed by a variable)
+    OP_LAK,     // LOD 0 a; LIT k; ADD
+    OP_LL,      // LOD 0 a; LOD 0 b
+    OPCODE_COUNT
+} Opcode;
+
+static const char *const opcodeNames[OPCODE_COUNT] = {
+    "LIT", "LOD", "STO", "LDA", "LDI", "STI", "LDX", "STX", "CHK", "INT", "CAL", "RET",
+    "JMP", "JPC", "NEG", "ADD", "SUB", "MUL", "DIV", "MOD", "ODD", "EQL", "NEQ", "LSS",
+    "LEQ", "GTR", "GEQ", "RED", "RDL", "WRT", "WRL", "HLT",
+    "INC", "FOR", "JRL", "JRK", "JR", "ADK", "MLK", "DVK", "MDK", "LXK", "LXL", "LAK", "LL"
+};
+
+// Instructions a superinstruction covers, itself included; 0 for the others.
+static const unsigned char fusedLength[OPCODE_COUNT] = {
+    [OP_INC] = 4, [OP_FOR] = 5, [OP_JRL] = 4, [OP_JRK] = 4, [OP_JR] = 2, [OP_ADK] = 2,
+    [OP_MLK] = 2, [OP_DVK] = 2, [OP_MDK] = 2, [OP_LXK] = 2, [OP_LXL] = 3,
+    [OP_LAK] = 3, [OP_LL] = 2
+};
+
+static inline int instructionLength(int op) {
+    return fusedLength[op] ? fusedLength[op] : 1;
+}
+
+// Cells each instruction adds to the operand stack (CAL also drops its arguments).
+static const signed char stackEffect[OPCODE_COUNT] = {
+    [OP_LIT] = 1, [OP_LOD] = 1, [OP_STO] = -1, [OP_LDA] = 1, [OP_STI] = -2, [OP_STX] = -2,
+    [OP_JPC] = -1, [OP_ADD] = -1, [OP_SUB] = -1, [OP_MUL] = -1, [OP_DIV] = -1, [OP_MOD] = -1,
+    [OP_EQL] = -1, [OP_NEQ] = -1, [OP_LSS] = -1, [OP_LEQ] = -1, [OP_GTR] = -1, [OP_GEQ] = -1,
+    [OP_RED] = 1, [OP_RDL] = 1, [OP_WRT] = -1, [OP_WRL] = -1
+};
+
+typedef struct {
+    uint8_t op;         // Opcode
+    uint8_t level;      // Static level difference for variable access and CAL
+    uint16_t reserved;
+    int32_t a;          // Operand: value, offset, code address or cell count
+} Instruction;
+
+typedef struct {
+    Instruction *code;
+    int32_t *lines;     // Source line of each instruction, for runtime errors
+    int count;
+    int capacity;
+    int maxDepth;       // Most operand cells any block has on the stack above its frame
+} Code;
+
+typedef struct {
+    const Compiler *c;
+    Code *code;
+    int *entry;         // Code address of each procedure symbol
+    bool *reference;    // Per symbol: a VAR parameter, which holds an address
+    int level;          // Level of the block being generated
+    int variables;      // Cells of the block's frame taken by links and variables
+    int temporaries;    // Hidden cells in use past the variables (FOR limits)
+    int frameSize;      // Cells the block's frame needs so far
+    int line;           // Source line of the construct being generated
+    int depth;          // Operand cells on the stack above the frame
+    bool outOfMemory;
+} CodeGen;
+
+static inline void freeCode(Code *code) {
+    free(code->code);
+    free(code->lines);
+    memset(code, 0, sizeof(*code));
+}
+
+// Append an instruction and return its address.
+static int emit(CodeGen *g, Opcode op, int level, int a) {
+    Code *code = g->code;
+    if (code->count == code->capacity) {
+        int capacity = code->capacity ? code->capacity * 2 : 1024;
+        Instruction *grown = realloc(code->code, (size_t)capacity * sizeof(Instruction));
+        if (grown != NULL) code->code = grown;
+        int32_t *grownLines = grown != NULL ? realloc(code->lines, (size_t)capacity * sizeof(int32_t)) : NULL;
+        if (grownLines != NULL) code->lines = grownLines;
+        if (grownLines == NULL) {
+            // Carry on over the same slots so the walk can finish; the result is discarded.
+            g->outOfMemory = true;
+            code->count = 0;
+            if (code->capacity == 0) return 0;
+        } else {
+            code->capacity = capacity;
+        }
+    }
+    g->depth += stackEffect[op];
+    if (g->depth > code->maxDepth) {
+        code->maxDepth = g->depth;
+    }
+    Instruction *in = &code->code[code->count];
+    in->op = (uint8_t)op;
+    in->level = (uint8_t)level;
+    in->reserved = 0;
+    in->a = a;
+    code->lines[code->count] = g->line;
+    return code->count++;
+}
+
+// Point the jump at 'at' to the next instruction.
+static void patchHere(CodeGen *g, int at) {
+    if (!g->outOfMemory) {
+        g->code->code[at].a = g->code->count;
+    }
+}
+
+static const AstNode *genNode(const CodeGen *g, int node) {
+    return &g->c->ast.nodes[node];
+}
+
+// Value of a subtree made only of numbers and operators. Only an operator whose
+// operands are both constant is folded, and the analyzer has rejected those that
+// divide by zero.
+static bool constantValue(const Compiler *c, int node, int *value) {
+    const AstNode *n = &c->ast.nodes[node];
+    int left, right;
+    switch (n->kind) {
+        case AST_NUMBER:
+            *value = n->a;
+            return true;
+        case AST_NEGATE:
+            if (!constantValue(c, n->a, &left)) return false;
+            *value = foldSign(MINUS, left);
+            return true;
+        case AST_BINARY:
+            if (!constantValue(c, n->a, &left) || !constantValue(c, n->b, &right)) return false;
+            if (right == 0 && operatorInfo((TokenType)n->op)->zeroDivisor != NULL) return false;
+            *value = foldOperator((TokenType)n->op, left, right);
+            return true;
+        default:
+            return false;
+    }
+}
+
+// True if evaluating the expression can stop with a runtime error: it divides by
+// something other than a nonzero constant, or reads an array element at an index
+// that is not a constant inside the array. The backends use it to keep the VM's
+// order, which checks an element's index before evaluating the value stored there.
+static inline bool exprMayFail(const Compiler *c, int node) {
+    const AstNode *n = &c->ast.nodes[node];
+    int value;
+    if (constantValue(c, node, &value)) {
+        return false;
+    }
+    switch (n->kind) {
+        case AST_ELEMENT:
+            return !constantValue(c, n->b, &value) || value < 0
+                || value >= c->arrayInfo[c->symbolTable[n->a].info].size;
+        case AST_NEGATE: case AST_ODD:
+            return exprMayFail(c, n->a);
+        case AST_BINARY: case AST_COMPARE:
+            if ((n->op == SLASH || n->op == PERCENT) && (!constantValue(c, n->b, &value) || value == 0)) {
+                return true;
+            }
+            return exprMayFail(c, n->a) || exprMayFail(c, n->b);
+        default:
+            return false;
+    }
+}
+
+static Opcode operatorOpcode(TokenType op) {
+    switch (op) {
+        case PLUS:    return OP_ADD;
+        case MINUS:   return OP_SUB;
+        case TIMES:   return OP_MUL;
+        case SLASH:   return OP_DIV;
+        case PERCENT: return OP_MOD;
+        case EQU:     return OP_EQL;
+        case NEQ:     return OP_NEQ;
+        case LSS:     return OP_LSS;
+        case LEQ:     return OP_LEQ;
+        case GTR:     return OP_GTR;
+        default:      return OP_GEQ;
+    }
+}
+
+// Set reference[p] for every VAR parameter p. The parameters of a procedure are
+// the first symbols of its scope, right after it.
+static void markReferenceParameters(const Compiler *c, bool *reference) {
+    for (int i = BUILTIN_COUNT; i < c->symbolCount; i++) {
+        if (c->symbolTable[i].kind == KIND_PROC) {
+            const ProcInfo *proc = &c->procInfo[c->symbolTable[i].info];
+            for (int p = 0; p < proc->numParams && p < MAX_PARAMS; p++) {
+                reference[i + 1 + p] = proc->varParams >> p & 1;
+            }
+        }
+    }
+}
+
+static int levelOf(const CodeGen *g, int symbol) {
+    return g->level - g->c->symbolTable[symbol].level;
+}
+
+static int addressOf(const CodeGen *g, int symbol) {
+    return g->c->symbolTable[symbol].address;
+}
+
+static void genExpression(CodeGen *g, int node);
+
+// Push an array index, checked against the array's bounds unless it is a constant
+// known to be inside them.
+static void genIndex(CodeGen *g, int array, int index) {
+    int size = g->c->arrayInfo[g->c->symbolTable[array].info].size, value;
+    genExpression(g, index);
+    if (!constantValue(g->c, index, &value) || value < 0 || value >= size) {
+        emit(g, OP_CHK, 0, size);
+    }
+}
+
+// Push the value of a scalar variable.
+static void genLoad(CodeGen *g, int symbol) {
+    emit(g, OP_LOD, levelOf(g, symbol), addressOf(g, symbol));
+    if (g->reference[symbol]) {
+        emit(g, OP_LDI, 0, 0);
+    }
+}
+
+static void genExpression(CodeGen *g, int node) {
+    const AstNode *n = genNode(g, node);
+    int value;
+    if (constantValue(g->c, node, &value)) {
+        emit(g, OP_LIT, 0, value);
+        return;
+    }
+    switch (n->kind) {
+        case AST_VARIABLE:
+            genLoad(g, n->a);
+            break;
+        case AST_ELEMENT:
+            genIndex(g, n->a, n->b);
+            emit(g, OP_LDX, levelOf(g, n->a), addressOf(g, n->a));
+            break;
+        case AST_NEGATE:
+            genExpression(g, n->a);
+            emit(g, OP_NEG, 0, 0);
+            break;
+        case AST_ODD:
+            genExpression(g, n->a);
+            emit(g, OP_ODD, 0, 0);
+            break;
+        case AST_BINARY: case AST_COMPARE:
+            genExpression(g, n->a);
+            genExpression(g, n->b);
+            emit(g, operatorOpcode((TokenType)n->op), 0, 0);
+            break;
+        default:
+            break;
+    }
+}
+
+// Push the stack address of a variable or array element, for a VAR argument.
+static void genAddress(CodeGen *g, int node) {
+    const AstNode *n = genNode(g, node);
+    if (n->kind == AST_VARIABLE && g->reference[n->a]) {
+        emit(g, OP_LOD, levelOf(g, n->a), addressOf(g, n->a));
+        return;
+    }
+    int size = n->kind == AST_ELEMENT ? g->c->arrayInfo[g->c->symbolTable[n->a].info].size : 1, value = 0;
+    if (n->kind == AST_VARIABLE || (constantValue(g->c, n->b, &value) && value >= 0 && value < size)) {
+        emit(g, OP_LDA, levelOf(g, n->a), addressOf(g, n->a) + value);
+        return;
+    }
+    emit(g, OP_LDA, levelOf(g, n->a), addressOf(g, n->a));
+    genIndex(g, n->a, n->b);
+    emit(g, OP_ADD, 0, 0);
+}
+
+// Store into a variable, or an array element if 'index' is not AST_NONE. The value
+// is the expression 'value', or else what the instruction 'produce' pushes.
+static void genStore(CodeGen *g, int symbol, int index, int value, Opcode produce) {
+    int level = levelOf(g, symbol), address = addressOf(g, symbol);
+    if (index != AST_NONE) {
+        genIndex(g, symbol, index);
+    } else if (g->reference[symbol]) {
+        emit(g, OP_LOD, level, address);
+    }
+    if (value != AST_NONE) {
+        genExpression(g, value);
+    } else {
+        emit(g, produce, 0, 0);
+    }
+    if (index != AST_NONE) {
+        emit(g, OP_STX, level, address);
+    } else if (g->reference[symbol]) {
+        emit(g, OP_STI, 0, 0);
+    } else {
+        emit(g, OP_STO, level, address);
+    }
+}
+
+static void genCall(CodeGen *g, const AstNode *n) {
+    int argument = n->b;
+    if (n->a < BUILTIN_COUNT) {
+        const AstNode *arg = genNode(g, argument);
+        switch ((Builtin)n->a) {
+            case BUILTIN_READ: case BUILTIN_READLN:
+                genStore(g, arg->a, arg->kind == AST_ELEMENT ? arg->b : AST_NONE, AST_NONE,
+                         n->a == BUILTIN_READ ? OP_RED : OP_RDL);
+                break;
+            case BUILTIN_WRITE: case BUILTIN_WRITELN:
+                genExpression(g, argument);
+                emit(g, n->a == BUILTIN_WRITE ? OP_WRT : OP_WRL, 0, 0);
+                break;
+            default:
+                break;
+        }
+        return;
+    }
+    unsigned varParams = g->c->procInfo[g->c->symbolTable[n->a].info].varParams;
+    for (int i = 0; argument != AST_NONE; argument = genNode(g, argument)->next, i++) {
+        if (varParams >> i & 1) {
+            genAddress(g, argument);
+        } else {
+            genExpression(g, argument);
+        }
+    }
+    emit(g, OP_CAL, levelOf(g, n->a), n->a); // The symbol, replaced by its entry once all code is out
+    g->depth -= g->c->procInfo[g->c->symbolTable[n->a].info].numParams;
+}
+
+static void genStatement(CodeGen *g, int node) {
+    if (node == AST_NONE) {
+        return;
+    }
+    const AstNode *n = genNode(g, node);
+    int jump, loop, limit;
+    g->line = n->line;
+    switch (n->kind) {
+        case AST_ASSIGN:
+            genStore(g, n->a, n->b, n->c, OP_HLT);
+            break;
+        case AST_CALL:
+            genCall(g, n);
+            break;
+        case AST_BEGIN:
+            for (int s = n->a; s != AST_NONE; s = genNode(g, s)->next) {
+                genStatement(g, s);
+            }
+            break;
+        case AST_IF:
+            genExpression(g, n->a);
+            jump = emit(g, OP_JPC, 0, 0);
+            genStatement(g, n->b);
+            if (n->c != AST_NONE) {
+                int skipElse = emit(g, OP_JMP, 0, 0);
+                patchHere(g, jump);
+                genStatement(g, n->c);
+                jump = skipElse;
+            }
+            patchHere(g, jump);
+            break;
+        case AST_WHILE:
+            loop = g->code->count;
+            genExpression(g, n->a);
+            jump = emit(g, OP_JPC, 0, 0);
+            genStatement(g, n->b);
+            emit(g, OP_JMP, 0, loop);
+            patchHere(g, jump);
+            break;
+        case AST_FOR:
+            // FOR v := start TO limit DO body, with the limit evaluated once into a
+            // hidden cell of the frame: v := start; while v <= limit: body; v := v + 1.
+            genStore(g, n->a, AST_NONE, n->b, OP_HLT);
+            limit = g->variables + g->temporaries++;
+            if (limit + 1 > g->frameSize) {
+                g->frameSize = limit + 1;
+            }
+            genExpression(g, genNode(g, n->b)->next);
+            emit(g, OP_STO, 0, limit);
+            loop = g->code->count;
+            genLoad(g, n->a);
+            emit(g, OP_LOD, 0, limit);
+            emit(g, OP_LEQ, 0, 0);
+            jump = emit(g, OP_JPC, 0, 0);
+            genStatement(g, n->c);
+            g->line = n->line;
+            if (g->reference[n->a]) {
+                emit(g, OP_LOD, levelOf(g, n->a), addressOf(g, n->a));
+                genLoad(g, n->a);
+                emit(g, OP_LIT, 0, 1);
+                emit(g, OP_ADD, 0, 0);
+                emit(g, OP_STI, 0, 0);
+            } else {
+                genLoad(g, n->a);
+                emit(g, OP_LIT, 0, 1);
+                emit(g, OP_ADD, 0, 0);
+                emit(g, OP_STO, levelOf(g, n->a), addressOf(g, n->a));
+            }
+            emit(g, OP_JMP, 0, loop);
+            patchHere(g, jump);
+            g->temporaries--;
+            break;
+        default:
+            break;
+    }
+}
+
+// Generate the procedures declared by a block, then its body, whose frame has
+// 'variables' cells at level 'level'. Returns the body's entry address.
+static int genBlock(CodeGen *g, int block, int variables, int level) {
+    const AstNode *n = genNode(g, block);
+    for (int p = n->a; p != AST_NONE; p = genNode(g, p)->next) {
+        const AstNode *proc = genNode(g, p);
+        int symbol = proc->a;
+        g->entry[symbol] = genBlock(g, proc->b, proc->c, g->c->symbolTable[symbol].level + 1);
+        g->line = proc->line;
+        emit(g, OP_RET, 0, g->c->procInfo[g->c->symbolTable[symbol].info].numParams);
+    }
+    g->level = level;
+    g->variables = g->frameSize = variables;
+    g->temporaries = 0;
+    g->line = n->line;
+    int entry = emit(g, OP_INT, 0, 0);
+    genStatement(g, n->b);
+    if (!g->outOfMemory) {
+        g->code->code[entry].a = g->frameSize;
+    }
+    return entry;
+}
+
+// Generate the code of a program analyzed without errors into 'code', replacing
+// what it held. Returns 0, or -1 if memory ran out.
+static int generateCode(const Compiler *c, Code *code) {
+    CodeGen g;
+    memset(&g, 0, sizeof(g));
+    g.c = c;
+    g.code = code;
+    code->count = code->maxDepth = 0;
+    g.entry = calloc((size_t)c->symbolCount + 1, sizeof(int));
+    g.reference = calloc((size_t)c->symbolCount + 1, sizeof(bool));
+    if (g.entry == NULL || g.reference == NULL || c->ast.root == AST_NONE) {
+        free(g.entry);
+        free(g.reference);
+        return -1;
+    }
+    markReferenceParameters(c, g.reference);
+
+    const AstNode *program = genNode(&g, c->ast.root);
+    g.line = program->line;
+    int start = emit(&g, OP_JMP, 0, 0);
+    int entry = genBlock(&g, program->a, program->b, 0);
+    emit(&g, OP_HLT, 0, 0);
+    if (!g.outOfMemory) {
+        code->code[start].a = entry;
+        for (int i = 0; i < code->count; i++) {
+            if (code->code[i].op == OP_CAL) {
+                code->code[i].a = g.entry[code->code[i].a];
+            }
+        }
+    }
+    free(g.entry);
+    free(g.reference);
+    if (g.outOfMemory) {
+        code->count = 0;
+        return -1;
+    }
+    return 0;
+}
+
+#endif
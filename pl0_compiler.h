@@ -0,0 +1,1428 @@
+/*
+Semantic analyzer for PL/0 as a reentrant compiler.
+
+All state of one compilation (the current and previous token, the lexer and
+interner, the symbol tables, scope stack and error flag) lives in a Compiler
+context that is passed to every routine, so nothing here touches a global and
+any number of compilations can run side by side, one Compiler per thread.
+
+Errors never end the process, and one pass reports as many of them as it can.
+A syntax error is printed to the context's diagnostics stream and unwinds with
+longjmp to the innermost recovery point: the statement, declaration or
+procedure heading being parsed is abandoned, tokens are skipped up to one in
+its synchronizing set (see pl0_sync.h) and parsing goes on from there. Other
+errors are printed, flagged and parsing simply goes on. A fatal error (running
+out of memory, nesting too deep, a syntax error outside any recovery point, or
+reaching the error limit) unwinds back to compileSource.
+*/
+
+#ifndef PL0_COMPILER_H
+#define PL0_COMPILER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <setjmp.h>
+#include "pl0_lexer.h"
+#include "pl0_pipeline.h"
+#include "pl0_ast.h"
+#include "pl0_operators.h"
+#include "pl0_sync.h"
+
+#define MAX_PARAMS 10
+#define MAX_NESTING_DEPTH 100 
+#define MAX_EXPRESSION_DEPTH 10000 // Nested parentheses and subscripts; about 400 bytes of stack each
+#define MAX_FRAME_SIZE (1 << 24)   // Cells in the frame of one block
+
+// A block's frame holds FRAME_HEADER link cells (static link, dynamic link,
+// return address) followed by its variables; Symbol.address of a variable is its
+// offset from the frame base. Parameters are pushed by the caller just below the
+// frame, so parameter i of n is at offset i - n.
+#define FRAME_HEADER 3
+
+typedef enum { KIND_CONST, KIND_VAR, KIND_PROC } ObjectKind;
+typedef enum { TYPE_NONE, TYPE_INTEGER, TYPE_ARRAY, TYPE_ERROR } DataType;
+
+static const char *const DataTypeStrings[] = {
+    "NONE",
+    "INTEGER",
+    "ARRAY",
+    "TYPE_ERROR"
+};
+static const char* datatype_to_string(DataType type) {
+    if (type >= TYPE_NONE && type <= TYPE_ERROR) { 
+        return DataTypeStrings[type];
+    }
+    return "UNKNOWN_DATATYPE";
+}
+
+typedef struct {
+    DataType type;
+    int value; // For constants
+    bool isConst; // For constants
+    int node;     // Syntax tree node of the expression (see pl0_ast.h)
+} SemanticProperties;
+
+// Symbols are split by how often they are touched. Symbol holds what name
+// resolution and expression checking read on every use; array bounds and
+// procedure signatures live in side tables that Symbol.info indexes. All three
+// arrays grow on demand and are always addressed by index, so a pointer is
+// never held across an Enter.
+typedef struct {
+    int nameId;        // Interned identifier (see pl0_intern.h)
+    int shadowed;      // Binding of the same name this declaration hides (index + 1, 0 if none)
+    ObjectKind kind;
+    DataType type;     // Data type of the identifier
+    int level;         // Scope level
+    int address;       // Offset of a variable in its block's frame (first element of an array)
+    int value;         // For constants
+    int info;          // Index into arrayInfo (arrays) or procInfo (procedures), -1 otherwise
+} Symbol;
+
+typedef struct {
+    int size;
+    DataType elementType; // Type of elements
+} ArrayInfo;
+
+typedef struct {
+    int numParams;
+    unsigned varParams;   // Bit i set if parameter i is a VAR (by reference) parameter
+    DataType formalParamTypes[MAX_PARAMS];
+} ProcInfo;
+
+// The built-in procedures are the first symbols of every compilation, in this order.
+typedef enum { BUILTIN_READLN, BUILTIN_WRITELN, BUILTIN_READ, BUILTIN_WRITE, BUILTIN_COUNT } Builtin;
+
+typedef enum {
+    COMPILE_OK = 0,
+    COMPILE_ERRORS,   // Errors were reported but the whole program was analyzed
+    COMPILE_ABORTED   // Stopped at a fatal error
+} CompileStatus;
+
+typedef struct {
+    FILE *diagnostics;         // Where errors are reported
+    SourceBuffer *source;      // Program being compiled (owned by the caller)
+    Interner names;
+    Lexer lexer;
+    bool pipelined;            // Lex on a thread of its own (see pl0_pipeline.h)
+    TokenPipeline pipeline;
+    Token currentToken;
+    Token previousToken;
+
+    Symbol *symbolTable;
+    int symbolCount;
+    int symbolCapacity;
+    ArrayInfo *arrayInfo;
+    int arrayCount;
+    int arrayCapacity;
+    ProcInfo *procInfo;
+    int procCount;
+    int procCapacity;
+    int currentLevel;
+    Ast ast;                   // Tree of the program, with names resolved to symbol indices
+
+    // Scoped lookup. Interned names are dense integers, so the name -> declaration
+    // map is a plain array indexed by name ID: nameBinding[id] is the innermost
+    // visible declaration (symbol index + 1, 0 if none) and each symbol links to the
+    // declaration it shadows. scopeBindings logs the symbols bound since each scope
+    // was opened, so closing a scope restores the outer bindings in O(declarations).
+    int *nameBinding;
+    int nameBindingCapacity;
+    int *scopeBindings;
+    int scopeBindingCount;
+    int scopeBindingCapacity;
+    int scope_stack[MAX_NESTING_DEPTH];
+    int scope_binding_mark[MAX_NESTING_DEPTH]; // scopeBindingCount when each scope was opened
+    int scope_frame_size[MAX_NESTING_DEPTH];   // Frame cells allocated so far by each scope's variables
+    int scope_stack_ptr;
+    int expressionDepth;       // Expressions being parsed, one per enclosing '(' or '['
+
+    bool compilationErrorOccurred;
+    int errorCount;            // Errors reported so far
+    int maxErrors;             // Give up after this many errors, 0 for no limit
+    long tokenCount;           // Tokens consumed so far
+    long quietAt;              // No diagnostics while tokenCount is still this (see skipTo)
+    jmp_buf *recovery;         // Innermost recovery point, NULL outside any
+    jmp_buf abort;             // Set by compileSource; fatal errors jump back to it
+} Compiler;
+
+// A point that parsing resumes from after a syntax error. It saves the parser
+// state that nests with the source, so scopes opened by the abandoned construct
+// are closed again.
+typedef struct {
+    jmp_buf resume;
+    jmp_buf *outer;
+    int scopeDepth;
+    int level;
+    int expressionDepth;
+    long start;                // tokenCount when the construct began
+} Recovery;
+
+// Report an error the analysis cannot continue past and abandon the compilation.
+static void fatalError(Compiler *c, const char *msg) {
+    fprintf(c->diagnostics, "%s\n", msg);
+    c->compilationErrorOccurred = true;
+    longjmp(c->abort, 1);
+}
+
+// Make room for one more element in a growable table, doubling its capacity.
+static void *reserveSlot(Compiler *c, void *table, int count, int *capacity, size_t elementSize) {
+    if (count < *capacity) {
+        return table;
+    }
+    int grownCapacity = *capacity ? *capacity * 2 : 256;
+    void *grown = realloc(table, (size_t)grownCapacity * elementSize);
+    if (grown == NULL) {
+        fatalError(c, "Out of memory");
+    }
+    *capacity = grownCapacity;
+    return grown;
+}
+
+static ProcInfo *procInfoOf(Compiler *c, int idx) {
+    return &c->procInfo[c->symbolTable[idx].info];
+}
+
+static ArrayInfo *arrayInfoOf(Compiler *c, int idx) {
+    return &c->arrayInfo[c->symbolTable[idx].info];
+}
+
+static void bindSymbol(Compiler *c, int idx) {
+    int nameId = c->symbolTable[idx].nameId;
+    if (nameId >= c->nameBindingCapacity) {
+        int capacity = c->nameBindingCapacity ? c->nameBindingCapacity : 256;
+        while (capacity <= nameId) capacity *= 2;
+        int *grown = realloc(c->nameBinding, capacity * sizeof(int));
+        if (grown == NULL) {
+            fatalError(c, "Out of memory");
+        }
+        memset(grown + c->nameBindingCapacity, 0, (capacity - c->nameBindingCapacity) * sizeof(int));
+        c->nameBinding = grown;
+        c->nameBindingCapacity = capacity;
+    }
+    c->symbolTable[idx].shadowed = c->nameBinding[nameId];
+    c->nameBinding[nameId] = idx + 1;
+    c->scopeBindings = reserveSlot(c, c->scopeBindings, c->scopeBindingCount, &c->scopeBindingCapacity, sizeof(int));
+    c->scopeBindings[c->scopeBindingCount++] = idx;
+}
+
+static void openScope(Compiler *c) {
+    c->scope_stack[c->scope_stack_ptr] = c->symbolCount;
+    c->scope_binding_mark[c->scope_stack_ptr] = c->scopeBindingCount;
+    c->scope_frame_size[c->scope_stack_ptr] = FRAME_HEADER;
+}
+
+// Drop the declarations of the innermost scope from the name bindings and pop it.
+static void closeScope(Compiler *c) {
+    int mark = c->scope_binding_mark[c->scope_stack_ptr];
+    while (c->scopeBindingCount > mark) {
+        Symbol *sym = &c->symbolTable[c->scopeBindings[--c->scopeBindingCount]];
+        c->nameBinding[sym->nameId] = sym->shadowed;
+    }
+    c->scope_stack_ptr--;
+}
+
+static void Enter(Compiler *c, int nameId, ObjectKind kind, DataType type, int value, int size) {
+    c->symbolTable = reserveSlot(c, c->symbolTable, c->symbolCount, &c->symbolCapacity, sizeof(Symbol));
+    c->symbolTable[c->symbolCount].nameId = nameId;
+    c->symbolTable[c->symbolCount].kind = kind;
+    c->symbolTable[c->symbolCount].type = type;
+    c->symbolTable[c->symbolCount].level = c->currentLevel;
+    c->symbolTable[c->symbolCount].address = 0;
+    c->symbolTable[c->symbolCount].value = value;
+    c->symbolTable[c->symbolCount].info = -1;
+
+    if (type == TYPE_ARRAY) {
+        c->arrayInfo = reserveSlot(c, c->arrayInfo, c->arrayCount, &c->arrayCapacity, sizeof(ArrayInfo));
+        c->arrayInfo[c->arrayCount].size = size;
+        c->arrayInfo[c->arrayCount].elementType = TYPE_INTEGER;
+        c->symbolTable[c->symbolCount].info = c->arrayCount++;
+    } else if (kind == KIND_PROC) {
+        c->procInfo = reserveSlot(c, c->procInfo, c->procCount, &c->procCapacity, sizeof(ProcInfo));
+        c->procInfo[c->procCount].numParams = 0;
+        c->procInfo[c->procCount].varParams = 0;
+        c->symbolTable[c->symbolCount].info = c->procCount++;
+    }
+
+    if (kind == KIND_VAR && c->scope_stack_ptr >= 0) {
+        c->symbolTable[c->symbolCount].address = c->scope_frame_size[c->scope_stack_ptr];
+        c->scope_frame_size[c->scope_stack_ptr] += type == TYPE_ARRAY ? size : 1;
+    }
+
+    bindSymbol(c, c->symbolCount);
+    c->symbolCount++;
+}
+
+// Append a syntax tree node and return its index.
+static int newNode(Compiler *c, AstKind kind, int line, int x, int y, int z) {
+    c->ast.nodes = reserveSlot(c, c->ast.nodes, c->ast.count, &c->ast.capacity, sizeof(AstNode));
+    AstNode *n = &c->ast.nodes[c->ast.count];
+    n->kind = (uint8_t)kind;
+    n->op = 0;
+    n->reserved = 0;
+    n->line = line;
+    n->a = x;
+    n->b = y;
+    n->c = z;
+    n->next = AST_NONE;
+    return c->ast.count++;
+}
+
+// Binary operator node; op is the operator token.
+static int newOperatorNode(Compiler *c, AstKind kind, Token op, int left, int right) {
+    int node = newNode(c, kind, op.line, left, right, AST_NONE);
+    c->ast.nodes[node].op = (uint8_t)op.type;
+    return node;
+}
+
+// Innermost declaration of the name visible from the current scope (index + 1), 0 if undeclared.
+static int Location(Compiler *c, int nameId) {
+    if (c->scope_stack_ptr < 0 || nameId >= c->nameBindingCapacity) {
+        return 0;
+    }
+    return c->nameBinding[nameId];
+}
+
+// 1 if the name is already declared in the current scope. Only the innermost binding
+// can be: any declaration in this scope hides the outer ones.
+static int checkIdent(Compiler *c, int nameId) {
+    int loc = Location(c, nameId);
+    if (loc == 0) {
+        return 0;
+    }
+    return loc - 1 >= c->scope_stack[c->scope_stack_ptr] && c->symbolTable[loc - 1].level == c->currentLevel;
+}
+
+static inline ObjectKind getKind(const Compiler *c, int idx) {
+    if (idx > 0 && idx <= c->symbolCount) {
+        return c->symbolTable[idx - 1].kind;
+    }
+    return -1; // Invalid index
+}
+
+// Print the source line of a diagnostic with a caret under the column. The line
+// comes from the lexer's line index, so the file is never read again.
+static void showErrorContext(Compiler *c, int line, int col) {
+    const char *text;
+    int length;
+    LineIndex lines = c->pipeline.running ? tokenPipelineLines(&c->pipeline, line) : c->lexer.lines;
+    if (!getSourceLine(&lines, c->source, line, &text, &length)) return;
+    fprintf(c->diagnostics, "%.*s\n", length, text);
+    for (int i = 1; i < col; i++) fputc(' ', c->diagnostics);
+    fprintf(c->diagnostics, "^\n");
+}
+
+// Count a reported error, giving up once the limit is reached.
+static void countError(Compiler *c) {
+    c->compilationErrorOccurred = true;
+    if (++c->errorCount == c->maxErrors) {
+        fprintf(c->diagnostics, "Too many errors (%d), stopping.\n", c->errorCount);
+        longjmp(c->abort, 1);
+    }
+}
+
+static void reportLexicalError(Compiler *c, Token t) {
+    // The parser is bound to reject the bad token as well; that is not worth a second message.
+    c->quietAt = c->tokenCount;
+    switch (t.error) {
+        case LEX_IDENT_TOO_LONG:
+            fprintf(c->diagnostics, "Lexical Error at Line %d, Column %d: Identifier '%.*s' too long\n", t.line, t.col, t.length, t.lexeme);
+            break;
+        case LEX_NUMBER_TOO_LONG:
+            fprintf(c->diagnostics, "Lexical Error at Line %d, Column %d: Number '%.*s' too long\n", t.line, t.col, t.length, t.lexeme);
+            break;
+        case LEX_EXPECTED_ASSIGN:
+            fprintf(c->diagnostics, "Lexical Error at Line %d, Column %d: Unexpected character ':'\n", t.line, t.col);
+            break;
+        default:
+            fprintf(c->diagnostics, "Lexical Error at Line %d, Column %d: Unknown character '%c'\n", t.line, t.col, *t.lexeme);
+            break;
+    }
+    showErrorContext(c, t.line, t.col);
+    countError(c);
+}
+
+static Token getNextToken(Compiler *c) {
+    Token token = c->pipeline.running ? tokenPipelineNext(&c->pipeline) : lexNext(&c->lexer);
+    if (token.type == NONE) {
+        reportLexicalError(c, token);
+    }
+    return token;
+}
+
+static void addError(Compiler *c, Token t, const char *msg) {
+    c->compilationErrorOccurred = true;
+    if (c->tokenCount == c->quietAt) {
+        return;
+    }
+    fprintf(c->diagnostics, "Error at Line %d, Column %d (near token '%.*s'): %s\n",
+            t.line, t.col, t.length, t.lexeme, msg);
+    showErrorContext(c, t.line, t.col);
+    countError(c);
+}
+// Report a syntax error that parsing can carry on after.
+static void reportSyntaxError(Compiler *c, Token t, const char *msg) {
+    c->compilationErrorOccurred = true;
+    if (c->tokenCount == c->quietAt) {
+        return;
+    }
+    fprintf(c->diagnostics, "Syntax Error at Line %d, Column %d (near token '%.*s'): %s\n",
+            t.line, t.col, t.length, t.lexeme, msg);
+    showErrorContext(c, t.line, t.col);
+    countError(c);
+}
+// Error handling function: reports a syntax error and abandons the construct being
+// parsed, resuming at the innermost recovery point (the whole compilation if none).
+static void Error(Compiler *c, Token t, const char *msg) {
+    if (c->recovery == NULL) {
+        c->quietAt = -1; // An error that ends the compilation is always shown
+    }
+    reportSyntaxError(c, t, msg);
+    longjmp(c->recovery != NULL ? *c->recovery : c->abort, 1);
+}
+
+// Function to consume the current token and get the next one
+static void consumeToken(Compiler *c) {
+    c->tokenCount++;
+    c->previousToken = c->currentToken;
+    c->currentToken = getNextToken(c);
+}
+
+// Skip to the next token in 'sync'. Diagnostics are held back until a token past
+// it has been consumed, so that the construct resumed there does not report the
+// same breakage again.
+static void skipTo(Compiler *c, TokenSet sync) {
+    while (!inTokenSet(c->currentToken.type, sync)) {
+        consumeToken(c);
+    }
+    c->quietAt = c->tokenCount;
+}
+
+// Make r the innermost recovery point. Must come before the setjmp on r->resume,
+// so that nothing in r changes between that setjmp and a longjmp to it.
+static void enterRecovery(Compiler *c, Recovery *r) {
+    r->outer = c->recovery;
+    r->scopeDepth = c->scope_stack_ptr;
+    r->level = c->currentLevel;
+    r->expressionDepth = c->expressionDepth;
+    r->start = c->tokenCount;
+    c->recovery = &r->resume;
+}
+
+static void leaveRecovery(Compiler *c, Recovery *r) {
+    c->recovery = r->outer;
+}
+
+// Resume after a syntax error unwound to r: restore the saved state and skip to
+// 'sync', moving past at least one token so that the same error cannot recur forever.
+static void recoverAt(Compiler *c, Recovery *r, TokenSet sync) {
+    c->recovery = r->outer;
+    while (c->scope_stack_ptr > r->scopeDepth) {
+        closeScope(c);
+    }
+    c->currentLevel = r->level;
+    c->expressionDepth = r->expressionDepth;
+    if (c->tokenCount == r->start && c->currentToken.type != EOFS) {
+        consumeToken(c);
+    }
+    skipTo(c, sync);
+}
+
+static int block(Compiler *c);
+static int statement(Compiler *c);
+static void statementList(Compiler *c, AstList *list);
+static SemanticProperties expression(Compiler *c);
+static SemanticProperties condition(Compiler *c);
+static SemanticProperties factor(Compiler *c);
+
+static void compileDeclareVariable(Compiler *c) {
+    Token identToken;
+    if (c->currentToken.type == IDENT) {
+        identToken = c->currentToken;
+        
+        if (checkIdent(c, c->currentToken.id) != 0) {
+            Error(c, c->currentToken, "Variable name already declared in this scope");
+            return;
+        }
+        consumeToken(c);
+        int frameSize = c->scope_frame_size[c->scope_stack_ptr];
+        if (c->currentToken.type == LBRACK) {
+            // Array declaration handling (example: VAR arr[10];)
+            consumeToken(c);
+            if (c->currentToken.type == NUMBER) {
+                int arraySize = c->currentToken.numberValue;
+                if (arraySize > MAX_FRAME_SIZE - frameSize) {
+                    Error(c, c->currentToken, "Array too large: the variables of a block may take at most 16777216 cells");
+                }
+                consumeToken(c);
+                if (c->currentToken.type == RBRACK) {
+                    consumeToken(c);
+                    Enter(c, identToken.id, KIND_VAR, TYPE_ARRAY, 0, arraySize);
+                } else {
+                    Error(c, c->currentToken, "Expected ']' after array size");
+                }
+            } else {
+                Error(c, c->currentToken, "Expected array size after '['");
+            }
+        } else {
+            if (frameSize >= MAX_FRAME_SIZE) {
+                Error(c, identToken, "Too many variables: the variables of a block may take at most 16777216 cells");
+            }
+            Enter(c, identToken.id, KIND_VAR, TYPE_INTEGER, 0, 0);
+        }
+    } else {
+        Error(c, c->currentToken, "Missing variable name in declaration");
+    }
+}
+
+static void compileDeclareConstant(Compiler *c){
+    Token identToken;
+    int constValue;
+    if (c->currentToken.type == IDENT) {
+        identToken = c->currentToken;
+        if (checkIdent(c, c->currentToken.id) == 0) {
+            consumeToken(c);
+            if (c->currentToken.type == EQU) {
+                consumeToken(c);
+                if (c->currentToken.type == NUMBER) {
+                    constValue = c->currentToken.numberValue;
+                    consumeToken(c);
+                    Enter(c, identToken.id, KIND_CONST, TYPE_INTEGER, constValue, 0);
+                } else {
+                    Error(c, c->currentToken, "Expected constant value after '='");
+                }
+            }
+        } else {
+            Error(c, c->currentToken, "Constant name already declared in this scope");
+        }
+    } else {
+        Error(c, c->currentToken, "Missing constant name in declaration");
+    }
+}
+
+// The parameter list of a procedure, if any, parsed inside the procedure's own scope.
+static void procedureParameters(Compiler *c, int currentProcedureSymbol) {
+    if (c->currentToken.type == LPARENT) {
+        consumeToken(c);
+        if (c->currentToken.type == VAR || c->currentToken.type == IDENT) { 
+            do {
+                bool isVarParam = false; 
+                if (c->currentToken.type == VAR) {
+                    isVarParam = true;
+                    consumeToken(c);
+                }
+
+                if (c->currentToken.type == IDENT) {
+                    Token paramToken = c->currentToken;
+                    if (checkIdent(c, paramToken.id) != 0) {
+                        Error(c, paramToken, "Parameter name already declared in this procedure's scope");
+                    } else {
+                        Enter(c, paramToken.id, KIND_VAR, TYPE_INTEGER, 0, 0);
+
+                        if (currentProcedureSymbol >= 0) {
+                            ProcInfo *proc = procInfoOf(c, currentProcedureSymbol);
+                            if (proc->numParams < MAX_PARAMS) {
+                                proc->formalParamTypes[proc->numParams] = TYPE_INTEGER;
+                                if (isVarParam) {
+                                    proc->varParams |= 1u << proc->numParams;
+                                }
+                            } else {
+                                Error(c, paramToken, "Too many parameters for procedure.");
+                            }
+                            proc->numParams++;
+                        }
+                    }
+                    consumeToken(c); 
+                } else {
+                    Error(c, c->currentToken, "Expected parameter name (identifier).");
+                }
+
+                if (c->currentToken.type == SEMICOLON) { 
+                    consumeToken(c);
+                    if (c->currentToken.type != IDENT && c->currentToken.type != VAR) {
+                        Error(c, c->currentToken, "Expected parameter declaration after ';'.");
+                    }
+                } else if (c->currentToken.type != RPARENT) {
+                    Error(c, c->currentToken, "Expected ';' or ')' in parameter list.");
+                }
+            } while (c->currentToken.type != RPARENT);
+            if (c->currentToken.type == RPARENT) {
+            consumeToken(c); 
+            }  
+        } else {
+            Error(c, c->currentToken, "Expected parameter declaration (IDENT or VAR) after '('. An empty parameter list '()' is not allowed.");
+        }
+    }
+}
+
+// The rest of a procedure heading as a recovery point: a broken heading resumes at
+// its ')' or at the procedure's declarations or body.
+static void procedureHeading(Compiler *c, Token procIdentToken, int currentProcedureSymbol) {
+    Recovery r;
+    enterRecovery(c, &r);
+    if (setjmp(r.resume) != 0) {
+        recoverAt(c, &r, HEADING_SYNC);
+        if (c->currentToken.type == RPARENT) {
+            consumeToken(c);
+        }
+        return;
+    }
+    if (procIdentToken.type != IDENT) {
+        Error(c, procIdentToken, "Missing procedure name in declaration");
+    }
+    procedureParameters(c, currentProcedureSymbol);
+    leaveRecovery(c, &r);
+}
+
+// Returns the AST_PROCEDURE node. The procedure gets its scope even if its name is
+// missing or taken, so that its body can still be analyzed.
+static int compileDeclareProcedure(Compiler *c) {
+    Token procIdentToken = c->currentToken;
+    int currentProcedureSymbol = -1;
+    int previousLevel = c->currentLevel;
+
+    if (c->currentToken.type == IDENT) {
+        if (checkIdent(c, c->currentToken.id) == 0) {
+            Enter(c, c->currentToken.id, KIND_PROC, TYPE_NONE, 0, 0);
+            currentProcedureSymbol = c->symbolCount - 1;
+        } else {
+            addError(c, c->currentToken, "Procedure name already declared in this scope");
+        }
+        consumeToken(c);
+    }
+    c->currentLevel++;
+    c->scope_stack_ptr++;
+    if (c->scope_stack_ptr >= MAX_NESTING_DEPTH) {
+        char msg[100];
+        snprintf(msg, sizeof(msg), "Critical Error: Maximum nesting depth exceeded for procedure %.*s.", procIdentToken.length, procIdentToken.lexeme);
+        c->currentLevel = previousLevel;
+        c->scope_stack_ptr--; 
+        fatalError(c, msg);
+    }
+    openScope(c);
+
+    procedureHeading(c, procIdentToken, currentProcedureSymbol);
+
+    // Everything declared so far in the new scope is a parameter: they go below the frame.
+    int firstParam = c->scope_stack[c->scope_stack_ptr];
+    int paramCount = c->symbolCount - firstParam;
+    for (int i = 0; i < paramCount; i++) {
+        c->symbolTable[firstParam + i].address = i - paramCount;
+    }
+    c->scope_frame_size[c->scope_stack_ptr] = FRAME_HEADER;
+
+    if (c->currentToken.type == SEMICOLON) {
+        consumeToken(c);
+    } else {
+        addError(c, c->previousToken, "Expected ';' after procedure header.");
+    }
+    int body = block(c);
+    int frameSize = c->scope_frame_size[c->scope_stack_ptr];
+    c->currentLevel = previousLevel;
+    closeScope(c);
+    return newNode(c, AST_PROCEDURE, procIdentToken.line, currentProcedureSymbol, body, frameSize);
+}
+
+// Report operands of the wrong type for operator 'op' at token 'at'; 'format' takes
+// the operator and the operand type names. Kept out of line so that the routines of
+// the expression recursion do not each carry a message buffer in their stack frame.
+static __attribute__((noinline)) void operandTypeError(Compiler *c, Token at, TokenType op, const char *format, DataType left, DataType right) {
+    char msg[200];
+    sprintf(msg, format, token_to_string(op), datatype_to_string(left), datatype_to_string(right));
+    Error(c, at, msg);
+}
+
+// Out of line for the same reason as operandTypeError.
+static __attribute__((noinline)) void indexOutOfBounds(Compiler *c, Token identToken, int arrayIdx, int indexValue) {
+    char msg[150];
+    sprintf(msg, "Semantic error: Array index [%d] for array '%s' is out of bounds (size: %d, valid indices: 0..%d).",
+            indexValue, identToken.lexeme, arrayInfoOf(c, arrayIdx)->size, arrayInfoOf(c, arrayIdx)->size - 1);
+    Error(c, identToken, msg);
+}
+
+static SemanticProperties factor(Compiler *c) {
+    SemanticProperties result;
+    result.type = TYPE_NONE; // Default type
+    result.isConst = false; // Default is not constant
+    result.node = AST_NONE;
+
+    Token identToken;
+
+    if (c->currentToken.type == IDENT) {
+        identToken = c->currentToken;
+        int p = Location(c, c->currentToken.id);
+            if (p == 0) {
+                Error(c, c->currentToken, "Variable not declared before use");
+            }
+            Symbol* sym = &c->symbolTable[p - 1];
+            consumeToken(c); 
+
+            if (sym->kind == KIND_CONST){
+                result.type = TYPE_INTEGER;
+                result.value = sym->value;
+                result.isConst = true;
+                result.node = newNode(c, AST_NUMBER, identToken.line, sym->value, p - 1, AST_NONE);
+                if (c->currentToken.type == LBRACK) {
+                    Error(c, identToken, "Constant is not an array, cannot use subscript.");       
+                }
+            } else if (sym->kind == KIND_VAR) {
+                if (sym->type == TYPE_INTEGER){
+                    result.type = TYPE_INTEGER;
+                    result.node = newNode(c, AST_VARIABLE, identToken.line, p - 1, AST_NONE, AST_NONE);
+                    if (c->currentToken.type == LBRACK) {
+                        Error(c, identToken, "Variable is not an array (it's an INTEGER), cannot use subscript.");
+                    }
+                } else if (sym->type == TYPE_ARRAY){
+
+                    result.isConst = false;
+
+                    if (c->currentToken.type == LBRACK){
+                        consumeToken(c);
+                        SemanticProperties indexProps = expression(c);
+
+                        if (indexProps.type != TYPE_INTEGER) {
+                            Error(c, c->currentToken, "Array index must be an integer expression");
+                            result.type = TYPE_ERROR;
+                    } else {
+                        if (indexProps.isConst) {
+                            int indexValue = indexProps.value;
+                            if (indexValue < 0 || indexValue >= arrayInfoOf(c, p - 1)->size) {
+                                indexOutOfBounds(c, identToken, p - 1, indexValue);
+                                result.type = TYPE_ERROR; 
+                            }
+                        }
+                    }
+                    if (result.type != TYPE_ERROR) {
+                        result.type = arrayInfoOf(c, p - 1)->elementType;
+                    }
+                    result.node = newNode(c, AST_ELEMENT, identToken.line, p - 1, indexProps.node, AST_NONE);
+                    if (c->currentToken.type == RBRACK) {
+                        consumeToken(c);
+                    } else {
+                        Error(c, c->currentToken, "Expected ']' after array index expression");
+                        result.type = TYPE_ERROR;
+                    }  
+                } else{
+                    Error(c, identToken, "Cannot use an entire array in this expression context");
+                    result.type = TYPE_ERROR;
+                }
+            } else{
+                Error(c, identToken, "Identifier is not a variable or constant");
+                result.type = TYPE_ERROR;
+            }
+        }  
+    } else if (c->currentToken.type == NUMBER) {
+        result.type = TYPE_INTEGER;
+        result.value = c->currentToken.numberValue;
+        result.isConst = true;
+        result.node = newNode(c, AST_NUMBER, c->currentToken.line, result.value, AST_NONE, AST_NONE);
+        consumeToken(c); 
+    } else if (c->currentToken.type == LPARENT) {
+        consumeToken(c); 
+        result = expression(c);  
+        if (c->currentToken.type == RPARENT) { 
+            consumeToken(c); 
+        } else {
+            Error(c, c->previousToken, "Expected ')' after expression in parentheses");
+            result.type = TYPE_ERROR;
+            result.isConst = false;
+        }
+    } else {
+        Error(c, c->previousToken, "Invalid factor: Expected Identifier, Number, or '('");
+        result.type = TYPE_ERROR;
+        result.isConst = false;
+    }
+
+    return result;
+}
+
+// Combine two operands with a binary operator: type check, then fold when both are constant.
+static SemanticProperties applyOperator(Compiler *c, Token op, SemanticProperties left, SemanticProperties right) {
+    const OperatorInfo *info = operatorInfo(op.type);
+    left.node = newOperatorNode(c, AST_BINARY, op, left.node, right.node);
+    if (left.type != TYPE_INTEGER || right.type != TYPE_INTEGER) {
+        if (left.type != TYPE_ERROR && right.type != TYPE_ERROR) {
+            operandTypeError(c, op, op.type, info->mismatch, left.type, right.type);
+        }
+        left.type = TYPE_ERROR;
+        left.isConst = false;
+        return left;
+    }
+    if (info->zeroDivisor != NULL && right.isConst && right.value == 0) {
+        Error(c, op, info->zeroDivisor);
+        left.type = TYPE_ERROR;
+        left.isConst = false;
+        return left;
+    }
+    left.isConst = left.isConst && right.isConst;
+    if (left.isConst) {
+        left.value = foldOperator(op.type, left.value, right.value);
+    }
+    return left;
+}
+
+// Precedence climbing: extend 'left' with every following operator that binds at
+// least as tightly as minPrecedence. A right operand only recurses when the next
+// operator binds tighter than the one before it, so a flat run of operators at
+// one level is a loop, not a chain of calls.
+static SemanticProperties climbOperators(Compiler *c, SemanticProperties left, int minPrecedence) {
+    int precedence;
+    while ((precedence = operatorInfo(c->currentToken.type)->precedence) >= minPrecedence) {
+        Token op = c->currentToken;
+        consumeToken(c);
+        SemanticProperties right = factor(c);
+        while (operatorInfo(c->currentToken.type)->precedence > precedence) {
+            right = climbOperators(c, right, precedence + 1);
+        }
+        left = applyOperator(c, op, left, right);
+    }
+    return left;
+}
+
+// expression = [ "+" | "-" ] term { ("+" | "-") term }, where a sign applies to the first term.
+static SemanticProperties expression(Compiler *c) {
+    if (++c->expressionDepth > MAX_EXPRESSION_DEPTH) {
+        Error(c, c->currentToken, "Expression nested too deeply");
+    }
+    Token sign = c->currentToken;
+    bool hasSign = operatorInfo(sign.type)->sign;
+    if (hasSign) {
+        consumeToken(c);
+    }
+    SemanticProperties result = climbOperators(c, factor(c), PREC_MULTIPLICATIVE);
+    if (hasSign) {
+        if (sign.type == MINUS) {
+            result.node = newNode(c, AST_NEGATE, sign.line, result.node, AST_NONE, AST_NONE);
+        }
+        if (result.type != TYPE_INTEGER) {
+            if (result.type != TYPE_ERROR) {
+                operandTypeError(c, c->previousToken, sign.type,
+                                 "Unary operator '%s' can only be applied to an INTEGER, but found '%s'.",
+                                 result.type, TYPE_NONE);
+                result.type = TYPE_ERROR;
+            }
+            result.isConst = false;
+        } else if (result.isConst) {
+            result.value = foldSign(sign.type, result.value);
+        }
+    }
+    result = climbOperators(c, result, PREC_ADDITIVE);
+    c->expressionDepth--;
+    return result;
+}
+
+static SemanticProperties condition(Compiler *c) {
+    SemanticProperties result;
+    result.type = TYPE_NONE; 
+    result.isConst = false;  
+    result.value = 0; 
+    result.node = AST_NONE;
+    Token errorReportingToken;
+    if (c->currentToken.type == ODD) { 
+        errorReportingToken = c->currentToken;
+        consumeToken(c); 
+        SemanticProperties exprProps = expression(c);
+        result.node = newNode(c, AST_ODD, errorReportingToken.line, exprProps.node, AST_NONE, AST_NONE);
+        if (exprProps.type == TYPE_ERROR) {
+            result.type = TYPE_ERROR; 
+            return result;
+        }
+        if (exprProps.type != TYPE_INTEGER) {
+            result.type = TYPE_ERROR;
+            char msg[150];
+            sprintf(msg, "Operand for ODD must be an INTEGER expression, but found '%s'.", datatype_to_string(exprProps.type));
+            Error(c, errorReportingToken, msg);
+        }
+    } else { 
+        SemanticProperties leftExprProps = expression(c);
+        if (isRelationalOperator(c->currentToken.type)) {
+            Token relOpToken = c->currentToken; 
+            consumeToken(c); 
+            SemanticProperties rightExprProps = expression(c);
+            result.node = newOperatorNode(c, AST_COMPARE, relOpToken, leftExprProps.node, rightExprProps.node);
+            if (leftExprProps.type == TYPE_ERROR || rightExprProps.type == TYPE_ERROR) {
+                result.type = TYPE_ERROR;
+                return result;
+            }
+
+            if (leftExprProps.type != TYPE_INTEGER || rightExprProps.type != TYPE_INTEGER) {
+                result.type = TYPE_ERROR;
+                operandTypeError(c, relOpToken, relOpToken.type, operatorInfo(relOpToken.type)->mismatch,
+                                 leftExprProps.type, rightExprProps.type);
+            }
+        } else {
+            result.type = TYPE_ERROR;
+            Error(c, c->previousToken, "Expected a relational operator (=, <>, <, <=, >, >=) in condition");
+        }
+    }
+    return result;
+}
+
+// Returns the statement's syntax tree node, AST_NONE for an empty statement.
+static int parseStatement(Compiler *c) {
+    Token identToken; 
+    int loc;
+    Symbol* sym;
+    SemanticProperties props, props2, indexProps;
+    int line = c->currentToken.line;
+    int node = AST_NONE, body, elseBody = AST_NONE;
+    AstList list = emptyAstList();
+
+    switch (c->currentToken.type) {
+        case IDENT: 
+            identToken = c->currentToken;
+            loc = Location(c, identToken.id);
+
+            if (loc == 0) {
+                Error(c, identToken, "Identifier not declared (used in assignment)");
+                return AST_NONE;
+            }
+            sym = &c->symbolTable[loc - 1];
+
+            if (sym->kind != KIND_VAR) {
+                Error(c, identToken, "Identifier on the left side of assignment must be a variable.");
+                return AST_NONE;
+            }
+
+            consumeToken(c); 
+
+            if (c->currentToken.type == LBRACK) { 
+                if (sym->type != TYPE_ARRAY) {
+                    Error(c, identToken, "Identifier is not an array, cannot use subscript.");
+                    return AST_NONE;
+                }
+                consumeToken(c); 
+                indexProps = expression(c); 
+
+                if (indexProps.type != TYPE_INTEGER) {
+                    Error(c, c->currentToken, "Array index must be an integer expression.");
+                }
+
+                if (c->currentToken.type == RBRACK) {
+                    consumeToken(c); 
+                } else {
+                    Error(c, c->currentToken, "Expected ']' after array index.");
+                    return AST_NONE;
+                }
+
+                if (c->currentToken.type == ASSIGN) {
+                    consumeToken(c); 
+                    props = expression(c); 
+                    node = newNode(c, AST_ASSIGN, line, loc - 1, indexProps.node, props.node);
+
+                    if (arrayInfoOf(c, loc - 1)->elementType != props.type && props.type != TYPE_ERROR) {
+                        Error(c, identToken, "Type mismatch in assignment to array element.");
+                    }
+                } else {
+                    Error(c, c->currentToken, "Expected ':=' after array element access in assignment.");
+                }
+
+            } else { 
+                if (sym->type == TYPE_ARRAY) {
+                    Error(c, identToken, "Cannot assign to an entire array. Must specify an index or use a scalar variable.");
+
+                    return AST_NONE;
+                }
+                if (c->currentToken.type == ASSIGN) {
+                    consumeToken(c); 
+                    props = expression(c); 
+                    node = newNode(c, AST_ASSIGN, line, loc - 1, AST_NONE, props.node);
+
+                    if (sym->type != props.type && props.type != TYPE_ERROR) {
+                        Error(c, identToken, "Type mismatch in assignment.");
+                    }
+                } else {
+                    Error(c, c->currentToken, "Expected ':=' after variable name in assignment.");
+                }
+            }
+            break;
+
+        case CALL:
+            consumeToken(c); 
+            if (c->currentToken.type == IDENT) {
+                identToken = c->currentToken;
+                loc = Location(c, identToken.id);
+                if (loc == 0) {
+                    Error(c, identToken, "Procedure not declared.");
+                    return AST_NONE;
+                }
+                sym = &c->symbolTable[loc - 1];
+                if (sym->kind != KIND_PROC) {
+                    Error(c, identToken, "Identifier is not a procedure.");
+                    return AST_NONE;
+                }
+                consumeToken(c); 
+
+                int actualParamCount = 0;
+                SemanticProperties actualParamProps[MAX_PARAMS]; 
+
+                if (c->currentToken.type == LPARENT) {
+                    consumeToken(c); 
+                    if (c->currentToken.type != RPARENT) { 
+                        do {
+                            if (actualParamCount > 0) { 
+                                if (c->currentToken.type == COMMA) {
+                                    consumeToken(c); 
+                                } else {
+                                    Error(c, c->currentToken, "Expected ',' or ')' in procedure call arguments.");
+                                    return AST_NONE;
+                                }
+                            }
+                            if (actualParamCount < MAX_PARAMS) {
+                                actualParamProps[actualParamCount] = expression(c);
+                                appendAstList(&c->ast, &list, actualParamProps[actualParamCount].node);
+                            } else {
+                                Error(c, c->currentToken, "Too many arguments in procedure call (exceeds internal limit).");
+                                expression(c);
+                            }
+                            actualParamCount++;
+                        } while (c->currentToken.type == COMMA);
+                    }
+                    if (c->currentToken.type == RPARENT) {
+                        consumeToken(c); 
+                    } else {
+                        Error(c, c->currentToken, "Expected ')' after procedure call arguments.");
+                        return AST_NONE;
+                    }
+                } 
+                node = newNode(c, AST_CALL, line, loc - 1, list.head, AST_NONE);
+                ProcInfo *proc = procInfoOf(c, loc - 1);
+                if (actualParamCount != proc->numParams) {
+                    char msg[100];
+                    sprintf(msg, "Incorrect number of arguments for procedure '%s'. Expected %d, got %d.",
+                            identToken.lexeme, proc->numParams, actualParamCount);
+                    Error(c, identToken, msg);
+                } else {
+                    for (int i = 0; i < actualParamCount; i++) {
+                        if (actualParamProps[i].type != proc->formalParamTypes[i] && actualParamProps[i].type != TYPE_ERROR) {
+                            char msg[150];
+                            sprintf(msg, "Type mismatch for argument %d of procedure '%s'. Expected '%s', got '%s'.",
+                                    i + 1, identToken.lexeme,
+                                    datatype_to_string(proc->formalParamTypes[i]),
+                                    datatype_to_string(actualParamProps[i].type));
+                            Error(c, identToken, msg);
+                        }
+                        int kind = actualParamProps[i].node != AST_NONE ? c->ast.nodes[actualParamProps[i].node].kind : AST_NONE;
+                        if ((proc->varParams >> i & 1) && kind != AST_VARIABLE && kind != AST_ELEMENT &&
+                            actualParamProps[i].type != TYPE_ERROR) {
+                            char msg[150];
+                            snprintf(msg, sizeof(msg), "Argument %d of procedure '%s' is a VAR parameter and must be a variable or an array element.",
+                                     i + 1, identToken.lexeme);
+                            Error(c, identToken, msg);
+                        }
+                    }
+                }
+            } else {
+                Error(c, c->currentToken, "Expected procedure name after CALL.");
+            }
+            break;
+
+        case BEGIN:
+            consumeToken(c);
+            statementList(c, &list);
+            if (c->currentToken.type == END) {
+                consumeToken(c);
+            } else {
+                Token errorToken = (c->currentToken.type == PERIOD || c->currentToken.type == EOFS) ? c->currentToken : c->previousToken;
+                addError(c, errorToken, "Expected 'END' keyword to close BEGIN...END statement.");
+            }
+            node = newNode(c, AST_BEGIN, line, list.head, AST_NONE, AST_NONE);
+            break;
+
+        case IF:
+            consumeToken(c);
+            props = condition(c);
+            if (c->currentToken.type == THEN) {
+                consumeToken(c);
+            } else {
+                Error(c, c->previousToken, "Expected 'THEN' after condition in IF statement");
+            }
+            body = statement(c);
+            if (c->currentToken.type == ELSE) {
+                consumeToken(c);
+                elseBody = statement(c);
+            }
+            node = newNode(c, AST_IF, line, props.node, body, elseBody);
+            break;
+
+        case WHILE:
+            consumeToken(c);
+            props = condition(c);
+            if (c->currentToken.type == DO) {
+                consumeToken(c);
+            } else {
+                Error(c, c->previousToken, "Expected 'DO' after condition in WHILE statement");
+            }
+            body = statement(c);
+            node = newNode(c, AST_WHILE, line, props.node, body, AST_NONE);
+            break;
+
+        case FOR:
+            consumeToken(c);
+            if (c->currentToken.type == IDENT) {
+                identToken = c->currentToken;
+                loc = Location(c, identToken.id);
+                if (loc == 0) {
+                    Error(c, identToken, "Variable not declared for loop variable");
+                    return AST_NONE;
+                } else {
+                    sym = &c->symbolTable[loc - 1];
+                    if (sym->kind != KIND_VAR || sym->type != TYPE_INTEGER) {
+                        Error(c, identToken, "Loop control variable must be an INTEGER variable");
+                        return AST_NONE;
+                    }
+                }
+                consumeToken(c);
+            } else {
+                Error(c, c->previousToken, "Expected identifier for loop variable after FOR");
+            }
+            if (c->currentToken.type == ASSIGN) {
+                consumeToken(c);
+            } else {
+                Error(c, c->previousToken, "Expected ':=' after loop variable in FOR statement");
+            }
+            
+            props = expression(c);
+            if (props.type != TYPE_INTEGER && props.type != TYPE_ERROR) {
+                Error(c, c->previousToken, "FOR loop start expression must be INTEGER type");
+                return AST_NONE;
+            }
+            if (c->currentToken.type == TO) {
+                consumeToken(c);
+            } else {
+                Error(c, c->previousToken, "Expected 'TO' after starting value in FOR statement");
+            }
+            props2 = expression(c);
+            if (props2.type != TYPE_INTEGER && props2.type != TYPE_ERROR) {
+                Error(c, c->previousToken, "FOR loop end expression must be INTEGER type.");
+            }
+            if (c->currentToken.type == DO) {
+                consumeToken(c);
+            } else {
+                Error(c, c->previousToken, "Expected 'DO' after ending value in FOR statement");
+            }
+            body = statement(c);
+            if (props.node != AST_NONE) {
+                c->ast.nodes[props.node].next = props2.node; // The end value follows the start value
+            }
+            node = newNode(c, AST_FOR, line, loc - 1, props.node, body);
+            break;
+
+        default:
+            break;
+    }
+    return node;
+}
+
+// A statement that is a recovery point: after a syntax error inside it, parsing
+// resumes at the next token in STATEMENT_SYNC and the statement yields AST_NONE.
+static int statement(Compiler *c) {
+    Recovery r;
+    enterRecovery(c, &r);
+    if (setjmp(r.resume) != 0) {
+        recoverAt(c, &r, STATEMENT_SYNC);
+        return AST_NONE;
+    }
+    int node = parseStatement(c);
+    leaveRecovery(c, &r);
+    return node;
+}
+
+// The statements of a BEGIN...END, up to the END (which is left to the caller).
+// A missing ';' is reported and the next statement parsed anyway; a token that
+// can neither follow a statement nor start one is reported and skipped.
+static void statementList(Compiler *c, AstList *list) {
+    if (isStartOfStatement(c->currentToken.type)) {
+        appendAstList(&c->ast, list, statement(c));
+    } else if (c->currentToken.type != END) {
+        addError(c, c->currentToken, "Expected a statement or END after BEGIN.");
+        if (inTokenSet(c->currentToken.type, INPUT_END)) {
+            return;
+        }
+        skipTo(c, STATEMENT_SYNC);
+    }
+    for (;;) {
+        if (c->currentToken.type == SEMICOLON) {
+            consumeToken(c);
+            if (c->currentToken.type == END) {
+                return;
+            }
+            if (!isStartOfStatement(c->currentToken.type)) {
+                addError(c, c->currentToken, "Expected a statement or END after ';'.");
+                if (inTokenSet(c->currentToken.type, INPUT_END)) {
+                    return;
+                }
+                skipTo(c, STATEMENT_SYNC);
+                continue;
+            }
+        } else if (isStartOfStatement(c->currentToken.type)) {
+            addError(c, c->currentToken, "Missing ';' before this statement.");
+        } else if (c->currentToken.type == END || inTokenSet(c->currentToken.type, INPUT_END)) {
+            return;
+        } else {
+            addError(c, c->currentToken, "Expected ';' or END after statement.");
+            consumeToken(c);
+            skipTo(c, STATEMENT_SYNC);
+            continue;
+        }
+        appendAstList(&c->ast, list, statement(c));
+    }
+}
+
+// One CONST or VAR declaration as a recovery point: after a syntax error in it,
+// parsing resumes at the next ',' or at the end of the section.
+static void declaration(Compiler *c, void (*declare)(Compiler *)) {
+    Recovery r;
+    enterRecovery(c, &r);
+    if (setjmp(r.resume) != 0) {
+        recoverAt(c, &r, DECLARATION_SYNC | TOKEN_BIT(COMMA));
+        return;
+    }
+    declare(c);
+    leaveRecovery(c, &r);
+}
+
+// A CONST or VAR section, from the keyword to the ';'. Anything after a declaration
+// but the ',' or ';' that should follow it is reported and skipped.
+static void declarationSection(Compiler *c, void (*declare)(Compiler *), const char *missingSemicolon) {
+    do {
+        consumeToken(c); // CONST, VAR or ','
+        declaration(c, declare);
+        if (c->currentToken.type != COMMA && !inTokenSet(c->currentToken.type, DECLARATION_SYNC)) {
+            addError(c, c->previousToken, missingSemicolon);
+            skipTo(c, DECLARATION_SYNC | TOKEN_BIT(COMMA));
+        }
+    } while (c->currentToken.type == COMMA);
+
+    if (c->currentToken.type == SEMICOLON) {
+        consumeToken(c);
+    } else {
+        addError(c, c->previousToken, missingSemicolon);
+    }
+}
+
+// A procedure declaration as a recovery point: after a syntax error that its
+// heading and statements could not recover from, parsing resumes at the next
+// declaration or at the body of the enclosing block.
+static int procedureDeclaration(Compiler *c) {
+    Recovery r;
+    enterRecovery(c, &r);
+    if (setjmp(r.resume) != 0) {
+        recoverAt(c, &r, DECLARATION_SYNC);
+        return AST_NONE;
+    }
+    int node = compileDeclareProcedure(c);
+    leaveRecovery(c, &r);
+    return node;
+}
+
+// Returns the AST_BLOCK node of the declarations and body that follow.
+static int block(Compiler *c) {
+    int line = c->currentToken.line;
+    int firstSymbol = c->scope_stack[c->scope_stack_ptr];
+    AstList procedures = emptyAstList(), body = emptyAstList();
+    int bodyNode = AST_NONE;
+
+    for (;;) {
+        if (c->currentToken.type == CONST) {
+            declarationSection(c, compileDeclareConstant, "Expected ';' after CONST declarations");
+        } 
+
+        if (c->currentToken.type == VAR) {
+            declarationSection(c, compileDeclareVariable, "Expected ';' after VAR declarations");
+        } 
+
+        while (c->currentToken.type == PROCEDURE) {
+            consumeToken(c); 
+            appendAstList(&c->ast, &procedures, procedureDeclaration(c));
+            
+            if (c->currentToken.type == SEMICOLON) {
+                consumeToken(c); 
+            } else {
+                addError(c, c->previousToken, "Expected ';' after procedure block");
+            }
+        } 
+
+        if (c->currentToken.type == BEGIN || c->currentToken.type == END ||
+            isStartOfStatement(c->currentToken.type) || inTokenSet(c->currentToken.type, INPUT_END)) {
+            break;
+        }
+        // Neither the body nor a declaration in order: report it, skip to the next
+        // declaration section (past a ';' ending the stray tokens) and go on from there.
+        reportSyntaxError(c, c->previousToken, "Expected 'BEGIN' keyword to start the block body after declarations");
+        skipTo(c, DECLARATION_START | STATEMENT_SYNC);
+        if (c->currentToken.type == SEMICOLON) {
+            consumeToken(c);
+            c->quietAt = c->tokenCount;
+        } else if (!inTokenSet(c->currentToken.type, DECLARATION_START)) {
+            break;
+        }
+    }
+
+    int bodyLine = c->currentToken.line;
+    if (c->currentToken.type == BEGIN) { 
+        consumeToken(c); 
+    } else { 
+        // Most often the BEGIN is just missing, so the body is parsed as if it were there.
+        reportSyntaxError(c, c->previousToken, "Expected 'BEGIN' keyword to start the block body after declarations"); 
+        skipTo(c, STATEMENT_SYNC | STATEMENT_START);
+        if (c->currentToken.type == BEGIN) {
+            consumeToken(c);
+        }
+    }
+    statementList(c, &body);
+    if (c->currentToken.type == END) {
+        consumeToken(c); 
+    } else {
+        Token errorToken = (c->currentToken.type == PERIOD || c->currentToken.type == EOFS) ? c->currentToken : c->previousToken;
+        addError(c, errorToken, "Expected 'END' keyword to close the block.");
+    }
+    bodyNode = newNode(c, AST_BEGIN, bodyLine, body.head, AST_NONE, AST_NONE);
+    return newNode(c, AST_BLOCK, line, procedures.head, bodyNode, firstSymbol);
+}
+
+// PROGRAM and the program name as a recovery point: a broken heading resumes at
+// the first declaration or at the body.
+static void programHeading(Compiler *c) {
+    Recovery r;
+    enterRecovery(c, &r);
+    if (setjmp(r.resume) != 0) {
+        recoverAt(c, &r, DECLARATION_SYNC);
+        return;
+    }
+    if (c->currentToken.type == PROGRAM) { 
+        consumeToken(c); 
+    } else {
+        Error(c, c->previousToken, "Program must start with 'PROGRAM' keyword");
+    }
+
+    if (c->currentToken.type == IDENT) { 
+        consumeToken(c); 
+    } else {
+        Error(c, c->previousToken, "Expected program name (identifier) after 'PROGRAM'");
+    }
+    leaveRecovery(c, &r);
+}
+
+static void program(Compiler *c) {
+    int line = c->currentToken.line;
+    programHeading(c);
+
+    if (c->currentToken.type == SEMICOLON) { 
+        consumeToken(c); 
+    } else {
+        addError(c, c->previousToken, "Expected ';' after program name. Continuing parse.");
+    }
+    c->currentLevel = 0;
+    c->scope_stack_ptr++;
+    if (c->scope_stack_ptr >= MAX_NESTING_DEPTH) {
+        fatalError(c, "Critical Error: Maximum nesting depth exceeded.");
+    }
+    openScope(c);
+    int body = block(c);
+
+    if (c->currentToken.type != PERIOD) { 
+        reportSyntaxError(c, c->previousToken, "Program must end with a '.'");
+    } else {
+        consumeToken(c);
+        if (c->currentToken.type != EOFS) {
+            reportSyntaxError(c, c->previousToken, "Unexpected tokens after the final '.'");
+        }
+    }
+    c->ast.root = newNode(c, AST_PROGRAM, line, body, c->scope_frame_size[c->scope_stack_ptr], AST_NONE);
+}
+
+// Enter the built-in procedures, in the order of Builtin. READ and READLN store
+// into their argument, so it is a VAR parameter.
+static void EnterInputOutputStatement(Compiler *c){
+    Enter(c, internName(&c->names, "READLN", 6), KIND_PROC, TYPE_NONE, 0, 0);
+    if (c->symbolCount > 0) {
+        ProcInfo* readln_sym = procInfoOf(c, c->symbolCount - 1);
+        readln_sym->numParams = 1;
+        readln_sym->formalParamTypes[0] = TYPE_INTEGER;
+        readln_sym->varParams = 1;
+    }
+    Enter(c, internName(&c->names, "WRITELN", 7), KIND_PROC, TYPE_NONE, 0, 0);
+    if (c->symbolCount > 0) {
+        ProcInfo* writeln_sym = procInfoOf(c, c->symbolCount - 1);
+        writeln_sym->numParams = 1;
+        writeln_sym->formalParamTypes[0] = TYPE_INTEGER;
+    }
+    Enter(c, internName(&c->names, "READ", 4), KIND_PROC, TYPE_NONE, 0, 0);
+    if (c->symbolCount > 0) {
+        ProcInfo* read_sym = procInfoOf(c, c->symbolCount - 1);
+        read_sym->numParams = 1;
+        read_sym->formalParamTypes[0] = TYPE_INTEGER;
+        read_sym->varParams = 1;
+    }
+    Enter(c, internName(&c->names, "WRITE", 5), KIND_PROC, TYPE_NONE, 0, 0);
+    if (c->symbolCount > 0) {
+        ProcInfo* write_sym = procInfoOf(c, c->symbolCount - 1);
+        write_sym->numParams = 1;
+        write_sym->formalParamTypes[0] = TYPE_INTEGER;
+    }
+}
+
+// Prepare an empty context that reports to 'diagnostics'. The tables, the name
+// pool and the line index it allocates are kept from one compileSource call to
+// the next.
+static void initCompiler(Compiler *c, FILE *diagnostics) {
+    memset(c, 0, sizeof(*c));
+    c->diagnostics = diagnostics;
+    c->scope_stack_ptr = -1;
+    c->ast.root = AST_NONE;
+    initInterner(&c->names);
+}
+
+static void freeCompiler(Compiler *c) {
+    freeTokenPipeline(&c->pipeline);
+    freeLexer(&c->lexer);
+    freeInterner(&c->names);
+    free(c->nameBinding);
+    free(c->scopeBindings);
+    free(c->symbolTable);
+    free(c->arrayInfo);
+    free(c->procInfo);
+    freeAst(&c->ast);
+    memset(c, 0, sizeof(*c));
+}
+
+// Analyze the program in 'source'. Afterwards the symbol table describes it (all of
+// it unless the compilation was aborted) until the next call.
+static CompileStatus compileSource(Compiler *c, SourceBuffer *source) {
+    resetInterner(&c->names);
+    if (c->nameBinding != NULL) {
+        memset(c->nameBinding, 0, (size_t)c->nameBindingCapacity * sizeof(int));
+    }
+    c->source = source;
+    c->symbolCount = c->arrayCount = c->procCount = 0;
+    c->scopeBindingCount = 0;
+    c->scope_stack_ptr = -1;
+    c->expressionDepth = 0;
+    c->currentLevel = 0;
+    c->compilationErrorOccurred = false;
+    c->errorCount = 0;
+    c->tokenCount = 0;
+    c->quietAt = -1;
+    c->recovery = NULL;
+    resetAst(&c->ast);
+    resetLexer(&c->lexer, source, &c->names);
+
+    if (setjmp(c->abort) != 0) {
+        stopTokenPipeline(&c->pipeline);
+        return COMPILE_ABORTED;
+    }
+    EnterInputOutputStatement(c);
+    // The built-in names are interned first: once the lexer thread runs, it is the
+    // only writer. If no thread can be started, tokens are lexed here as usual.
+    if (c->pipelined) {
+        startTokenPipeline(&c->pipeline, &c->lexer);
+    }
+    consumeToken(c);
+    program(c);
+    stopTokenPipeline(&c->pipeline);
+    return c->compilationErrorOccurred ? COMPILE_ERRORS : COMPILE_OK;
+}
+
+#endif
@@ -0,0 +1,118 @@
+/*
+Lists of source files for the tools that take many programs at once: the
+paths of a manifest (one per line; blank lines and lines starting with '#'
+are skipped) or every *.pl0 file in a directory, in name order.
+*/
+
+#ifndef PL0_FILES_H
+#define PL0_FILES_H
+
+#include <errno.h>
+#include "pl0_scan.h"
+#include "pl0_source.h"
+
+#if !defined(_WIN32)
+#include <dirent.h>
+#endif
+
+typedef struct {
+    char **paths;
+    size_t count;
+    size_t capacity;
+} FileList;
+
+static int addFile(FileList *list, const char *path, size_t length) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 256;
+        char **grown = realloc(list->paths, capacity * sizeof(char *));
+        if (grown == NULL) return -1;
+        list->paths = grown;
+        list->capacity = capacity;
+    }
+    char *copy = malloc(length + 1);
+    if (copy == NULL) return -1;
+    memcpy(copy, path, length);
+    copy[length] = '\0';
+    list->paths[list->count++] = copy;
+    return 0;
+}
+
+static void freeFileList(FileList *list) {
+    for (size_t i = 0; i < list->count; i++) free(list->paths[i]);
+    free(list->paths);
+    list->paths = NULL;
+    list->count = list->capacity = 0;
+}
+
+// Paths listed in a manifest file. Returns 0, or -1 with errno set.
+static int readManifest(FileList *list, const char *manifestPath) {
+    SourceBuffer manifest;
+    if (openSourceBuffer(&manifest, manifestPath) != 0) return -1;
+    int rc = 0;
+    const char *p = manifest.data, *end = manifest.end;
+    while (p < end && rc == 0) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (eol == NULL) eol = end;
+        const char *stop = eol;
+        while (p < stop && isSpaceByte((unsigned char)*p)) p++;
+        while (stop > p && isSpaceByte((unsigned char)stop[-1])) stop--;
+        if (stop > p && *p != '#') rc = addFile(list, p, (size_t)(stop - p));
+        p = eol + 1;
+    }
+    closeSourceBuffer(&manifest);
+    if (rc != 0) errno = ENOMEM;
+    return rc;
+}
+
+static int comparePaths(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Every *.pl0 file directly inside 'dir', sorted by name. Returns 0, or -1 with errno set.
+static int readDirectory(FileList *list, const char *dir) {
+#if !defined(_WIN32)
+    DIR *d = opendir(dir);
+    if (d == NULL) return -1;
+    size_t first = list->count, dirLength = strlen(dir);
+    int rc = 0;
+    struct dirent *entry;
+    while (rc == 0 && (entry = readdir(d)) != NULL) {
+        size_t nameLength = strlen(entry->d_name);
+        if (entry->d_name[0] == '.' || nameLength < 5 || strcmp(entry->d_name + nameLength - 4, ".pl0") != 0) {
+            continue;
+        }
+        char *path = malloc(dirLength + nameLength + 2);
+        if (path == NULL) {
+            rc = -1;
+            break;
+        }
+        sprintf(path, "%s/%s", dir, entry->d_name);
+        rc = addFile(list, path, dirLength + nameLength + 1);
+        free(path);
+    }
+    closedir(d);
+    if (rc != 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+    qsort(list->paths + first, list->count - first, sizeof(char *), comparePaths);
+    return 0;
+#else
+    (void)list;
+    (void)dir;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static inline int isDirectory(const char *path) {
+#if !defined(_WIN32)
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+#else
+    (void)path;
+    return 0;
+#endif
+}
+
+#endif
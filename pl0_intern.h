@@ -0,0 +1,180 @@
+/*
+Identifier interning for the PL/0 lexer and analyzers.
+
+Every distinct identifier (compared case-insensitively, like the language)
+gets a dense integer ID the first time the lexer sees it, so the analyzers
+compare names with a single integer compare. The canonical upper-case
+spelling is kept in a chunked string pool; chunks are never moved, so a
+pointer to an interned name stays valid until the interner is freed.
+*/
+
+#ifndef PL0_INTERN_H
+#define PL0_INTERN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERN_POOL_CHUNK 65536
+
+typedef struct InternChunk {
+    struct InternChunk *next;
+    size_t used;
+    size_t size;
+    char data[];
+} InternChunk;
+
+typedef struct {
+    int *slots;            // Open-addressing table of id + 1; 0 marks an empty slot
+    unsigned slotMask;     // Table size - 1 (a power of two)
+    unsigned *hashes;      // hashes[id]
+    const char **names;    // names[id]: NUL-terminated upper-case spelling
+    int *lengths;          // lengths[id]
+    int count;
+    int capacity;          // Size of the per-id arrays
+    InternChunk *pool;     // Chunk currently being filled (head of the chunk list)
+} Interner;
+
+static inline unsigned char foldIdentChar(unsigned char c) {
+    return (c >= 'a' && c <= 'z') ? (unsigned char)(c - ('a' - 'A')) : c;
+}
+
+// FNV-1a over the upper-cased spelling
+static inline unsigned hashIdent(const char *s, int len) {
+    unsigned h = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        h = (h ^ foldIdentChar((unsigned char)s[i])) * 16777619u;
+    }
+    return h;
+}
+
+static void internOutOfMemory(void) {
+    fprintf(stderr, "Out of memory while interning identifiers\n");
+    exit(EXIT_FAILURE);
+}
+
+static void initInterner(Interner *in) {
+    in->slotMask = 1023;
+    in->slots = calloc(in->slotMask + 1, sizeof(int));
+    in->capacity = 256;
+    in->hashes = malloc(in->capacity * sizeof(unsigned));
+    in->names = malloc(in->capacity * sizeof(const char *));
+    in->lengths = malloc(in->capacity * sizeof(int));
+    in->count = 0;
+    in->pool = NULL;
+    if (!in->slots || !in->hashes || !in->names || !in->lengths) internOutOfMemory();
+}
+
+static void freeInterner(Interner *in) {
+    while (in->pool != NULL) {
+        InternChunk *next = in->pool->next;
+        free(in->pool);
+        in->pool = next;
+    }
+    free(in->slots);
+    free(in->hashes);
+    free(in->names);
+    free(in->lengths);
+    in->slots = NULL;
+    in->hashes = NULL;
+    in->names = NULL;
+    in->lengths = NULL;
+    in->count = in->capacity = 0;
+}
+
+// Forget every name but keep the tables and the current pool chunk, so the
+// interner can be reused for another input without going back to malloc.
+static inline void resetInterner(Interner *in) {
+    memset(in->slots, 0, ((size_t)in->slotMask + 1) * sizeof(int));
+    if (in->pool != NULL) {
+        InternChunk *chunk = in->pool->next;
+        while (chunk != NULL) {
+            InternChunk *next = chunk->next;
+            free(chunk);
+            chunk = next;
+        }
+        in->pool->next = NULL;
+        in->pool->used = 0;
+    }
+    in->count = 0;
+}
+
+static char *internPoolAlloc(Interner *in, size_t n) {
+    if (in->pool == NULL || in->pool->size - in->pool->used < n) {
+        size_t size = n > INTERN_POOL_CHUNK ? n : INTERN_POOL_CHUNK;
+        InternChunk *chunk = malloc(sizeof(InternChunk) + size);
+        if (chunk == NULL) internOutOfMemory();
+        chunk->next = in->pool;
+        chunk->used = 0;
+        chunk->size = size;
+        in->pool = chunk;
+    }
+    char *p = in->pool->data + in->pool->used;
+    in->pool->used += n;
+    return p;
+}
+
+static void growInternSlots(Interner *in) {
+    unsigned mask = in->slotMask * 2 + 1;
+    int *slots = calloc(mask + 1, sizeof(int));
+    if (slots == NULL) internOutOfMemory();
+    for (int id = 0; id < in->count; id++) {
+        unsigned i = in->hashes[id] & mask;
+        while (slots[i] != 0) i = (i + 1) & mask;
+        slots[i] = id + 1;
+    }
+    free(in->slots);
+    in->slots = slots;
+    in->slotMask = mask;
+}
+
+static inline int sameIdent(const char *interned, const char *s, int len) {
+    for (int i = 0; i < len; i++) {
+        if (interned[i] != (char)foldIdentChar((unsigned char)s[i])) return 0;
+    }
+    return 1;
+}
+
+// ID of the identifier s[0..len), adding it if it has not been seen yet.
+static int internName(Interner *in, const char *s, int len) {
+    unsigned h = hashIdent(s, len);
+    unsigned i = h & in->slotMask;
+    for (int slot; (slot = in->slots[i]) != 0; i = (i + 1) & in->slotMask) {
+        int id = slot - 1;
+        if (in->hashes[id] == h && in->lengths[id] == len && sameIdent(in->names[id], s, len)) {
+            return id;
+        }
+    }
+
+    if (in->count == in->capacity) {
+        int capacity = in->capacity * 2;
+        unsigned *hashes = realloc(in->hashes, capacity * sizeof(unsigned));
+        if (hashes) in->hashes = hashes;
+        const char **names = realloc(in->names, capacity * sizeof(const char *));
+        if (names) in->names = names;
+        int *lengths = realloc(in->lengths, capacity * sizeof(int));
+        if (lengths) in->lengths = lengths;
+        if (!hashes || !names || !lengths) internOutOfMemory();
+        in->capacity = capacity;
+    }
+    int id = in->count++;
+    char *name = internPoolAlloc(in, (size_t)len + 1);
+    for (int k = 0; k < len; k++) {
+        name[k] = (char)foldIdentChar((unsigned char)s[k]);
+    }
+    name[len] = '\0';
+    in->hashes[id] = h;
+    in->names[id] = name;
+    in->lengths[id] = len;
+    in->slots[i] = id + 1;
+    if ((unsigned)in->count * 2 > in->slotMask) {
+        growInternSlots(in);
+    }
+    return id;
+}
+
+static inline const char *internedName(const Interner *in, int id) {
+    return in->names[id];
+}
+
+#endif
@@ -0,0 +1,849 @@
+/*
+SSA intermediate representation between the checked syntax tree and the backends.
+
+The program becomes one IrFunction per procedure, and one for the main
+program, in the order the register code lays them out (pl0_regcode.h). A
+function is a control-flow graph of basic blocks, block 0 its entry. A block
+is a list of instructions ending in exactly one terminator (JUMP, BRANCH or
+RETURN). Every instruction defines at most one value, named by the
+instruction's index, so an operand is just that index (printed vN).
+
+A scalar variable used only by its own block and never passed to a VAR
+parameter is in SSA form: it has no storage at all. An assignment makes
+whatever value was assigned its current value, and where control flow joins,
+a phi picks the value of the edge control came in on. Such a variable starts
+as 0, as a VM frame is zeroed, and a value parameter as IR_PARAM. Every other
+variable (one a nested procedure uses, a VAR parameter or what it is passed,
+an array) stays in memory, read and written by IR_LOAD and IR_STORE in the
+order of the source, as on the VM.
+
+IF, WHILE and FOR are the only control flow, so a block is entered by at most
+two edges and a phi has two operands: a for the edge from pred[0], b for the
+one from pred[1]. Loops are built rotated, testing once in front of the loop
+and then at the bottom of the body, like the register code: the first block of
+the body is the loop header, entered from in front and from the bottom.
+
+Passes (pl0_passes.h) remove an instruction by turning it into IR_NOP, so
+values keep their numbers; IR_COPY stands for a value until a pass replaces
+its uses by its operand.
+*/
+
+#ifndef PL0_IR_H
+#define PL0_IR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pl0_codegen.h"
+
+#define IR_NONE (-1)
+
+typedef enum {
+    IR_NOP,         // removed
+    IR_CONST,       // the constant k
+    IR_PARAM,       // the value parameter 'symbol' as passed
+    IR_PHI,         // a if control came from pred[0], b if from pred[1]
+    IR_COPY,        // a
+    IR_LOAD,        // the variable 'symbol', in memory
+    IR_STORE,       // variable 'symbol' := a
+    IR_LOADX,       // element a of the array 'symbol', stopping unless 0 <= a < its size
+    IR_STOREX,      // element a of the array 'symbol' := b, checked the same way
+    IR_CHECK,       // stop unless a is an index of the array 'symbol'
+    IR_ADDRESS,     // stack address of the variable 'symbol', or of its element a (checked)
+    IR_NEG,         // -a
+    IR_ADD,         // a + b, wrapping around like the VM
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,         // stops on a zero divisor, as does IR_MOD
+    IR_MOD,
+    IR_READ,        // an integer read from input; with k the rest of the line is skipped
+    IR_WRITE,       // write a; with k a newline
+    IR_CALL,        // call the procedure 'symbol'; its arguments follow arguments[k] (their count)
+    IR_JUMP,        // to succ[0] of the block
+    IR_BRANCH,      // to succ[0] if a k b (k: EQU ... GEQ, or ODD testing a alone), else to succ[1]
+    IR_RETURN,      // end of the procedure or program
+    IR_OPCODE_COUNT
+} IrOpcode;
+
+static const char *const irOpcodeNames[IR_OPCODE_COUNT] = {
+    "nop", "const", "param", "phi", "copy", "load", "store", "loadx", "storex", "check", "address",
+    "neg", "add", "sub", "mul", "div", "mod", "read", "write", "call", "jump", "branch", "return"
+};
+
+typedef struct {
+    uint8_t op;         // IrOpcode
+    uint8_t reserved[3];
+    int32_t a, b;       // Operand values, IR_NONE where absent
+    int32_t k;          // Constant, relation or flag, see IrOpcode
+    int32_t symbol;     // Variable, array or procedure, IR_NONE where absent
+    int32_t block;      // Block holding the instruction
+    int32_t next;       // Next instruction of the block, IR_NONE after the terminator
+    int32_t line;       // Source line, for runtime errors
+} IrInstruction;
+
+typedef struct {
+    int32_t first;      // First instruction, IR_NONE while empty
+    int32_t last;       // Last instruction: the terminator once the block is complete
+    int32_t succ[2];    // IR_NONE where absent
+    int32_t pred[2];    // In the order of phi operands; IR_NONE where absent
+} IrBlock;
+
+typedef struct {
+    int symbol;         // The procedure, IR_NONE for the main program
+    int level;          // Level of its block, the Symbol.level of its variables
+    int variables;      // Cells of its frame taken by links and variables (AST_PROCEDURE c)
+    int scope;          // First symbol its block declares (AST_BLOCK c)
+    int line;
+    IrInstruction *code;
+    int count;
+    int capacity;
+    IrBlock *blocks;
+    int blockCount;
+    int blockCapacity;
+    int32_t *arguments; // Argument lists of the calls, each a count and then the values
+    int argumentCount;
+    int argumentCapacity;
+} IrFunction;
+
+typedef struct {
+    const Compiler *c;
+    IrFunction *functions;
+    int count;
+    int *function;      // Per procedure symbol: index of its function
+    bool *reference;    // Per symbol: a VAR parameter
+    bool *inSsa;        // Per symbol: a variable in SSA form
+} IrProgram;
+
+typedef struct {
+    IrProgram *p;
+    IrFunction *f;
+    const Compiler *c;
+    int block;          // Block being appended to
+    int line;
+    int32_t *current;   // Per variable in SSA form: its value where the builder is
+    int32_t *journal;   // Variable and previous value of each assignment, undone at joins
+    int journalCount;
+    int journalCapacity;
+    int32_t *pending;   // Variable and value pairs of the joins being built, a stack
+    int pendingCount;
+    int pendingCapacity;
+    int32_t *seen;      // Per symbol: stamp of the last list it was put in
+    int stamp;
+    bool outOfMemory;
+} IrBuilder;
+
+// Make room for 'needed' items of 'size' bytes in *array. Returns false if memory ran out.
+static bool irReserve(void **array, int *capacity, int needed, size_t size) {
+    if (needed <= *capacity) {
+        return true;
+    }
+    int grown = *capacity ? *capacity : 64;
+    while (grown < needed) {
+        grown *= 2;
+    }
+    void *bigger = realloc(*array, (size_t)grown * size);
+    if (bigger == NULL) {
+        return false;
+    }
+    *array = bigger;
+    *capacity = grown;
+    return true;
+}
+
+static inline bool irIsTerminator(int op) {
+    return op == IR_JUMP || op == IR_BRANCH || op == IR_RETURN;
+}
+
+// True if the instruction defines a value.
+static inline bool irHasValue(int op) {
+    return op != IR_NOP && op != IR_STORE && op != IR_STOREX && op != IR_CHECK && op != IR_WRITE &&
+           op != IR_CALL && !irIsTerminator(op);
+}
+
+// The operands of an instruction, as pointers a pass can rewrite them through.
+// Returns their count.
+static int irOperands(IrFunction *f, IrInstruction *in, int32_t *operands[MAX_PARAMS + 2]) {
+    int n = 0;
+    if (in->op == IR_CALL) {
+        for (int i = 0; i < f->arguments[in->k]; i++) {
+            operands[n++] = &f->arguments[in->k + 1 + i];
+        }
+        return n;
+    }
+    if (in->a != IR_NONE) operands[n++] = &in->a;
+    if (in->b != IR_NONE) operands[n++] = &in->b;
+    return n;
+}
+
+// Index of the edge from 'from' among the predecessors of 'to'.
+static inline int irPredIndex(const IrFunction *f, int to, int from) {
+    return f->blocks[to].pred[0] == from ? 0 : 1;
+}
+
+// The operator of IR_ADD ... IR_MOD, for foldOperator.
+static inline TokenType irOperator(int op) {
+    static const TokenType operators[] = {PLUS, MINUS, TIMES, SLASH, PERCENT};
+    return operators[op - IR_ADD];
+}
+
+static inline bool irConstantValue(const IrFunction *f, int value, int32_t *k) {
+    if (value == IR_NONE || f->code[value].op != IR_CONST) {
+        return false;
+    }
+    *k = f->code[value].k;
+    return true;
+}
+
+static int irArraySize(const Compiler *c, int symbol) {
+    return c->arrayInfo[c->symbolTable[symbol].info].size;
+}
+
+// True if the instruction does nothing but compute its value, so that it can
+// go when the value is unused without changing what the program does, not
+// even which runtime error stops it.
+static bool irPure(const IrProgram *p, const IrFunction *f, const IrInstruction *in) {
+    int32_t k;
+    switch (in->op) {
+        case IR_CONST: case IR_PARAM: case IR_PHI: case IR_COPY: case IR_LOAD:
+        case IR_NEG: case IR_ADD: case IR_SUB: case IR_MUL:
+            return true;
+        case IR_DIV: case IR_MOD:
+            return irConstantValue(f, in->b, &k) && k != 0;
+        case IR_LOADX: case IR_ADDRESS:
+            return in->a == IR_NONE || (irConstantValue(f, in->a, &k) && k >= 0 && k < irArraySize(p->c, in->symbol));
+        default:
+            return false;
+    }
+}
+
+// The blocks reachable from the entry in reverse postorder, the false edge of a
+// branch visited first so that THEN comes before ELSE and a loop's body before
+// what follows the loop. Fills 'order' and returns its length, or -1 if memory
+// ran out.
+static int irReversePostorder(const IrFunction *f, int32_t *order) {
+    int32_t *stack = malloc((size_t)f->blockCount * sizeof(int32_t));
+    uint8_t *edge = calloc((size_t)f->blockCount, 1); // Successors visited, 3 once on the stack
+    if (stack == NULL || edge == NULL) {
+        free(stack);
+        free(edge);
+        return -1;
+    }
+    int depth = 0, count = 0;
+    stack[depth++] = 0;
+    edge[0] = 4;
+    while (depth > 0) {
+        int block = stack[depth - 1];
+        int visited = edge[block] & 3;
+        if (visited < 2) {
+            edge[block]++;
+            int successor = f->blocks[block].succ[1 - visited];
+            if (successor != IR_NONE && edge[successor] == 0) {
+                edge[successor] = 4;
+                stack[depth++] = successor;
+            }
+        } else {
+            order[count++] = block;
+            depth--;
+        }
+    }
+    for (int i = 0; i < count / 2; i++) {
+        int32_t t = order[i];
+        order[i] = order[count - 1 - i];
+        order[count - 1 - i] = t;
+    }
+    free(stack);
+    free(edge);
+    return count;
+}
+
+// Remove the edge from 'from' to 'to'. The phis of 'to' keep the operand of
+// its other edge, as copies.
+static void irRemoveEdge(IrFunction *f, int from, int to) {
+    IrBlock *target = &f->blocks[to];
+    int which = irPredIndex(f, to, from);
+    for (int i = target->first; i != IR_NONE; i = f->code[i].next) {
+        IrInstruction *in = &f->code[i];
+        if (in->op == IR_PHI) {
+            in->op = IR_COPY;
+            in->a = which == 0 ? in->b : in->a;
+            in->b = IR_NONE;
+        } else if (in->op != IR_NOP && in->op != IR_COPY) {
+            break;
+        }
+    }
+    if (which == 0) {
+        target->pred[0] = target->pred[1];
+    }
+    target->pred[1] = IR_NONE;
+    for (int s = 0; s < 2; s++) {
+        if (f->blocks[from].succ[s] == to) {
+            f->blocks[from].succ[s] = IR_NONE;
+            break;
+        }
+    }
+}
+
+static int irNewBlock(IrBuilder *b) {
+    IrFunction *f = b->f;
+    if (!irReserve((void **)&f->blocks, &f->blockCapacity, f->blockCount + 1, sizeof(IrBlock))) {
+        b->outOfMemory = true;
+        return 0;
+    }
+    IrBlock *block = &f->blocks[f->blockCount];
+    block->first = block->last = IR_NONE;
+    block->succ[0] = block->succ[1] = block->pred[0] = block->pred[1] = IR_NONE;
+    return f->blockCount++;
+}
+
+// Append an instruction to the current block and return its value.
+static int irEmit(IrBuilder *b, IrOpcode op, int a, int operand, int k, int symbol) {
+    IrFunction *f = b->f;
+    if (b->outOfMemory || !irReserve((void **)&f->code, &f->capacity, f->count + 1, sizeof(IrInstruction))) {
+        // The walk goes on over nothing so it can finish; the result is discarded.
+        b->outOfMemory = true;
+        return IR_NONE;
+    }
+    IrInstruction *in = &f->code[f->count];
+    memset(in, 0, sizeof(*in));
+    in->op = (uint8_t)op;
+    in->a = a;
+    in->b = operand;
+    in->k = k;
+    in->symbol = symbol;
+    in->block = b->block;
+    in->next = IR_NONE;
+    in->line = b->line;
+    IrBlock *block = &f->blocks[b->block];
+    if (block->last == IR_NONE) {
+        block->first = f->count;
+    } else {
+        f->code[block->last].next = f->count;
+    }
+    block->last = f->count;
+    return f->count++;
+}
+
+static int irConstant(IrBuilder *b, int value) {
+    return irEmit(b, IR_CONST, IR_NONE, IR_NONE, value, IR_NONE);
+}
+
+static void irAddEdge(IrBuilder *b, int from, int to, int which) {
+    if (b->outOfMemory) return;
+    IrBlock *target = &b->f->blocks[to];
+    b->f->blocks[from].succ[which] = to;
+    target->pred[target->pred[0] == IR_NONE ? 0 : 1] = from;
+}
+
+static void irJump(IrBuilder *b, int to) {
+    irEmit(b, IR_JUMP, IR_NONE, IR_NONE, 0, IR_NONE);
+    irAddEdge(b, b->block, to, 0);
+}
+
+// Make a variable in SSA form hold 'value' from here on.
+static void irAssign(IrBuilder *b, int symbol, int value) {
+    if (!irReserve((void **)&b->journal, &b->journalCapacity, b->journalCount + 2, sizeof(int32_t))) {
+        b->outOfMemory = true;
+        return;
+    }
+    b->journal[b->journalCount++] = symbol;
+    b->journal[b->journalCount++] = b->current[symbol];
+    b->current[symbol] = value;
+}
+
+// Undo the assignments since the journal held 'mark' entries.
+static void irUndo(IrBuilder *b, int mark) {
+    while (b->journalCount > mark) {
+        b->journalCount -= 2;
+        b->current[b->journal[b->journalCount]] = b->journal[b->journalCount + 1];
+    }
+}
+
+static void irPush(IrBuilder *b, int symbol, int value) {
+    if (!irReserve((void **)&b->pending, &b->pendingCapacity, b->pendingCount + 2, sizeof(int32_t))) {
+        b->outOfMemory = true;
+        return;
+    }
+    b->pending[b->pendingCount++] = symbol;
+    b->pending[b->pendingCount++] = value;
+}
+
+// A phi in 'block' taking 'fromA' on the edge from 'blockA' and 'fromB' on the other.
+static int irPhi(IrBuilder *b, int blockA, int fromA, int fromB) {
+    int block = b->block;
+    if (b->outOfMemory) return IR_NONE;
+    bool swapped = b->f->blocks[block].pred[0] != blockA;
+    return irEmit(b, IR_PHI, swapped ? fromB : fromA, swapped ? fromA : fromB, 0, IR_NONE);
+}
+
+static const AstNode *irNode(const IrBuilder *b, int node) {
+    return &b->c->ast.nodes[node];
+}
+
+static bool irConstantIndex(const IrBuilder *b, int array, int index) {
+    int value;
+    return constantValue(b->c, index, &value) && value >= 0 && value < irArraySize(b->c, array);
+}
+
+static int irLoadVariable(IrBuilder *b, int symbol) {
+    if (b->p->inSsa[symbol]) {
+        return b->current[symbol];
+    }
+    return irEmit(b, IR_LOAD, IR_NONE, IR_NONE, 0, symbol);
+}
+
+static int irExpression(IrBuilder *b, int node) {
+    const AstNode *n = irNode(b, node);
+    int value;
+    if (constantValue(b->c, node, &value)) {
+        return irConstant(b, value);
+    }
+    switch (n->kind) {
+        case AST_VARIABLE:
+            return irLoadVariable(b, n->a);
+        case AST_ELEMENT:
+            value = irExpression(b, n->b);
+            return irEmit(b, IR_LOADX, value, IR_NONE, 0, n->a);
+        case AST_NEGATE:
+            return irEmit(b, IR_NEG, irExpression(b, n->a), IR_NONE, 0, IR_NONE);
+        case AST_BINARY: {
+            int left = irExpression(b, n->a);
+            int right = irExpression(b, n->b);
+            IrOpcode op = n->op == PLUS ? IR_ADD : n->op == MINUS ? IR_SUB : n->op == TIMES ? IR_MUL
+                        : n->op == SLASH ? IR_DIV : IR_MOD;
+            return irEmit(b, op, left, right, 0, IR_NONE);
+        }
+        default:
+            // Conditions are only built as branches (see irCondition).
+            return irConstant(b, 0);
+    }
+}
+
+// End the current block with a branch on the condition.
+static void irCondition(IrBuilder *b, int node, int ifTrue, int ifFalse) {
+    const AstNode *n = irNode(b, node);
+    if (n->kind == AST_ODD) {
+        irEmit(b, IR_BRANCH, irExpression(b, n->a), IR_NONE, ODD, IR_NONE);
+    } else {
+        int left = irExpression(b, n->a);
+        int right = irExpression(b, n->b);
+        irEmit(b, IR_BRANCH, left, right, n->op, IR_NONE);
+    }
+    int block = b->block;
+    irAddEdge(b, block, ifTrue, 0);
+    irAddEdge(b, block, ifFalse, 1);
+}
+
+// Store into a variable, or an array element if 'index' is not AST_NONE. The value
+// is the expression 'value', or else an integer read from input.
+static void irStore(IrBuilder *b, int symbol, int index, int value, bool skipLine) {
+    int i = IR_NONE, v;
+    if (index != AST_NONE) {
+        i = irExpression(b, index);
+        // The VM checks the index before evaluating the value.
+        if (!irConstantIndex(b, symbol, index) && (value == AST_NONE || exprMayFail(b->c, value))) {
+            irEmit(b, IR_CHECK, i, IR_NONE, 0, symbol);
+        }
+    }
+    v = value != AST_NONE ? irExpression(b, value) : irEmit(b, IR_READ, IR_NONE, IR_NONE, skipLine, IR_NONE);
+    if (index != AST_NONE) {
+        irEmit(b, IR_STOREX, i, v, 0, symbol);
+    } else if (b->p->inSsa[symbol]) {
+        irAssign(b, symbol, v);
+    } else {
+        irEmit(b, IR_STORE, v, IR_NONE, 0, symbol);
+    }
+}
+
+static void irCall(IrBuilder *b, const AstNode *n) {
+    if (n->a < BUILTIN_COUNT) {
+        const AstNode *arg = irNode(b, n->b);
+        switch ((Builtin)n->a) {
+            case BUILTIN_READ: case BUILTIN_READLN:
+                irStore(b, arg->a, arg->kind == AST_ELEMENT ? arg->b : AST_NONE, AST_NONE, n->a == BUILTIN_READLN);
+                break;
+            case BUILTIN_WRITE: case BUILTIN_WRITELN:
+                irEmit(b, IR_WRITE, irExpression(b, n->b), IR_NONE, n->a == BUILTIN_WRITELN, IR_NONE);
+                break;
+            default:
+                break;
+        }
+        return;
+    }
+    const ProcInfo *proc = &b->c->procInfo[b->c->symbolTable[n->a].info];
+    int32_t values[MAX_PARAMS];
+    int count = 0;
+    for (int a = n->b; a != AST_NONE && count < MAX_PARAMS; a = irNode(b, a)->next, count++) {
+        const AstNode *arg = irNode(b, a);
+        if (!(proc->varParams >> count & 1)) {
+            values[count] = irExpression(b, a);
+        } else if (arg->kind == AST_ELEMENT) {
+            values[count] = irEmit(b, IR_ADDRESS, irExpression(b, arg->b), IR_NONE, 0, arg->a);
+        } else {
+            values[count] = irEmit(b, IR_ADDRESS, IR_NONE, IR_NONE, 0, arg->a);
+        }
+    }
+    IrFunction *f = b->f;
+    if (!irReserve((void **)&f->arguments, &f->argumentCapacity, f->argumentCount + count + 1, sizeof(int32_t))) {
+        b->outOfMemory = true;
+        return;
+    }
+    int first = f->argumentCount;
+    f->arguments[f->argumentCount++] = count;
+    memcpy(&f->arguments[f->argumentCount], values, (size_t)count * sizeof(int32_t));
+    f->argumentCount += count;
+    irEmit(b, IR_CALL, IR_NONE, IR_NONE, first, n->a);
+}
+
+
+// Push each variable in SSA form the journal assigned since 'mark' once, with
+// its current value, or with 'before' the value it had in front of them.
+static void irJournaled(IrBuilder *b, int mark, bool before) {
+    for (int i = mark; i < b->journalCount; i += 2) {
+        int symbol = b->journal[i];
+        if (b->seen[symbol] != b->stamp) {
+            b->seen[symbol] = b->stamp;
+            irPush(b, symbol, before ? b->journal[i + 1] : b->current[symbol]);
+        }
+    }
+}
+
+// Push each variable in SSA form the statement assigns once, with its current value.
+static void irAssigned(IrBuilder *b, int node) {
+    if (node == AST_NONE) {
+        return;
+    }
+    const AstNode *n = irNode(b, node);
+    int symbol = IR_NONE;
+    switch (n->kind) {
+        case AST_ASSIGN:
+            if (n->b == AST_NONE) symbol = n->a;
+            break;
+        case AST_FOR:
+            symbol = n->a;
+            irAssigned(b, n->c);
+            break;
+        case AST_CALL:
+            if ((n->a == BUILTIN_READ || n->a == BUILTIN_READLN) && irNode(b, n->b)->kind == AST_VARIABLE) {
+                symbol = irNode(b, n->b)->a;
+            }
+            break;
+        case AST_BEGIN:
+            for (int s = n->a; s != AST_NONE; s = irNode(b, s)->next) {
+                irAssigned(b, s);
+            }
+            break;
+        case AST_IF:
+            irAssigned(b, n->b);
+            irAssigned(b, n->c);
+            break;
+        case AST_WHILE:
+            irAssigned(b, n->b);
+            break;
+        default:
+            break;
+    }
+    if (symbol != IR_NONE && b->p->inSsa[symbol] && b->seen[symbol] != b->stamp) {
+        b->seen[symbol] = b->stamp;
+        irPush(b, symbol, b->current[symbol]);
+    }
+}
+
+// End the current block with the test of a loop: a WHILE's condition, or a
+// FOR variable <= 'limit'.
+static void irLoopTest(IrBuilder *b, const AstNode *loop, int limit, int header, int exit) {
+    if (loop->kind == AST_WHILE) {
+        irCondition(b, loop->a, header, exit);
+        return;
+    }
+    irEmit(b, IR_BRANCH, irLoadVariable(b, loop->a), limit, LEQ, IR_NONE);
+    int block = b->block;
+    irAddEdge(b, block, header, 0);
+    irAddEdge(b, block, exit, 1);
+}
+
+static void irStatement(IrBuilder *b, int node);
+
+// Build a WHILE or FOR loop in front of which the current block ends, and go on
+// after it.
+static void irLoop(IrBuilder *b, const AstNode *loop, int body, int limit) {
+    int header = irNewBlock(b), exit = irNewBlock(b);
+    int front = b->block, mark = b->journalCount, base = b->pendingCount;
+    b->stamp++;
+    if (loop->kind == AST_FOR && b->p->inSsa[loop->a]) {
+        b->seen[loop->a] = b->stamp;
+        irPush(b, loop->a, b->current[loop->a]);
+    }
+    irAssigned(b, body);
+    int top = b->pendingCount;
+    irLoopTest(b, loop, limit, header, exit);
+
+    // Every variable the loop assigns gets a phi in the header, whose operand
+    // from the bottom is only known once the body is built.
+    b->block = header;
+    for (int i = base; i < top && !b->outOfMemory; i += 2) {
+        int phi = irPhi(b, front, b->pending[i + 1], IR_NONE);
+        irAssign(b, b->pending[i], phi);
+        b->pending[i + 1] = phi;
+    }
+    irStatement(b, body);
+    b->line = loop->line;
+    if (loop->kind == AST_FOR) {
+        int next = irEmit(b, IR_ADD, irLoadVariable(b, loop->a), irConstant(b, 1), 0, IR_NONE);
+        if (b->p->inSsa[loop->a]) {
+            irAssign(b, loop->a, next);
+        } else {
+            irEmit(b, IR_STORE, next, IR_NONE, 0, loop->a);
+        }
+    }
+    irLoopTest(b, loop, limit, header, exit);
+    for (int i = base; i < top && !b->outOfMemory; i += 2) {
+        int value = b->current[b->pending[i]];
+        b->f->code[b->pending[i + 1]].b = value;
+        b->pending[i + 1] = value;
+    }
+
+    // After the loop each is its value in front of it or its value at the bottom.
+    irUndo(b, mark);
+    b->block = exit;
+    for (int i = base; i < top && !b->outOfMemory; i += 2) {
+        int symbol = b->pending[i];
+        irAssign(b, symbol, irPhi(b, front, b->current[symbol], b->pending[i + 1]));
+    }
+    b->pendingCount = base;
+}
+
+static void irStatement(IrBuilder *b, int node) {
+    if (node == AST_NONE || b->outOfMemory) {
+        return;
+    }
+    const AstNode *n = irNode(b, node);
+    b->line = n->line;
+    switch (n->kind) {
+        case AST_ASSIGN:
+            irStore(b, n->a, n->b, n->c, false);
+            break;
+        case AST_CALL:
+            irCall(b, n);
+            break;
+        case AST_BEGIN:
+            for (int s = n->a; s != AST_NONE; s = irNode(b, s)->next) {
+                irStatement(b, s);
+            }
+            break;
+        case AST_IF: {
+            int mark = b->journalCount, base = b->pendingCount;
+            int thenBlock = irNewBlock(b);
+            int elseBlock = n->c != AST_NONE ? irNewBlock(b) : IR_NONE;
+            int join = irNewBlock(b);
+            irCondition(b, n->a, thenBlock, elseBlock != IR_NONE ? elseBlock : join);
+            b->block = thenBlock;
+            irStatement(b, n->b);
+            int thenEnd = b->block;
+            irJump(b, join);
+
+            // The variables THEN assigns with their values at its end; ELSE
+            // starts from their values in front of the IF.
+            b->stamp++;
+            irJournaled(b, mark, false);
+            irUndo(b, mark);
+            if (elseBlock != IR_NONE) {
+                b->block = elseBlock;
+                irStatement(b, n->c);
+                irJump(b, join);
+                // Those only ELSE assigns are at the end of THEN what they were in
+                // front. Statements in ELSE took new stamps, so mark the list again.
+                b->stamp++;
+                for (int i = base; i < b->pendingCount; i += 2) {
+                    b->seen[b->pending[i]] = b->stamp;
+                }
+                irJournaled(b, mark, true);
+            }
+            b->block = join;
+            b->line = n->line;
+            for (int i = base; i < b->pendingCount && !b->outOfMemory; i += 2) {
+                int thenValue = b->pending[i + 1], elseValue = b->current[b->pending[i]];
+                if (thenValue != elseValue) {
+                    b->pending[i + 1] = irPhi(b, thenEnd, thenValue, elseValue);
+                }
+            }
+            irUndo(b, mark);
+            for (int i = base; i < b->pendingCount; i += 2) {
+                irAssign(b, b->pending[i], b->pending[i + 1]);
+            }
+            b->pendingCount = base;
+            break;
+        }
+        case AST_WHILE:
+            irLoop(b, n, n->b, IR_NONE);
+            break;
+        case AST_FOR: {
+            // FOR v := start TO limit DO body: v := start, the limit evaluated
+            // once, then the body as long as v <= limit, with v := v + 1 after it.
+            irStore(b, n->a, AST_NONE, n->b, false);
+            int limit = irExpression(b, irNode(b, n->b)->next);
+            irLoop(b, n, n->c, limit);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Build the function of a block whose frame has 'variables' cells.
+static void irFunction(IrBuilder *b, int block, int symbol, int level, int variables) {
+    IrProgram *p = b->p;
+    IrFunction *f = &p->functions[p->count];
+    memset(f, 0, sizeof(*f));
+    f->symbol = symbol;
+    f->level = level;
+    f->variables = variables;
+    f->scope = irNode(b, block)->c;
+    f->line = irNode(b, block)->line;
+    if (symbol != IR_NONE) {
+        p->function[symbol] = p->count;
+    }
+    p->count++;
+    b->f = f;
+    b->line = f->line;
+    b->block = irNewBlock(b);
+    b->journalCount = b->pendingCount = 0;
+
+    // Variables in SSA form start as 0, value parameters as passed.
+    const Symbol *table = b->c->symbolTable;
+    int zero = IR_NONE;
+    int numParams = symbol != IR_NONE ? b->c->procInfo[table[symbol].info].numParams : 0;
+    for (int s = f->scope; s < b->c->symbolCount && table[s].level >= level; s++) {
+        if (table[s].level != level || !p->inSsa[s]) {
+            continue;
+        }
+        if (symbol != IR_NONE && s <= symbol + numParams) {
+            b->current[s] = irEmit(b, IR_PARAM, IR_NONE, IR_NONE, 0, s);
+        } else {
+            if (zero == IR_NONE) zero = irConstant(b, 0);
+            b->current[s] = zero;
+        }
+    }
+    irStatement(b, irNode(b, block)->b);
+    irEmit(b, IR_RETURN, IR_NONE, IR_NONE, 0, IR_NONE);
+}
+
+// Build the functions of the procedures a block declares, depth first, then its own.
+static void irBlock(IrBuilder *b, int block, int symbol, int level, int variables) {
+    for (int p = irNode(b, block)->a; p != AST_NONE && !b->outOfMemory; p = irNode(b, p)->next) {
+        const AstNode *proc = irNode(b, p);
+        irBlock(b, proc->b, proc->a, b->c->symbolTable[proc->a].level + 1, proc->c);
+    }
+    if (!b->outOfMemory) {
+        irFunction(b, block, symbol, level, variables);
+    }
+}
+
+// Mark the variables that cannot be in SSA form: those used by a block nested
+// deeper than their own, and those passed to a VAR parameter.
+static void irScan(const Compiler *c, bool *inMemory, int node, int level) {
+    if (node == AST_NONE) {
+        return;
+    }
+    const AstNode *n = &c->ast.nodes[node];
+    switch (n->kind) {
+        case AST_ASSIGN: case AST_FOR: case AST_VARIABLE: case AST_ELEMENT:
+            if (c->symbolTable[n->a].level < level) {
+                inMemory[n->a] = true;
+            }
+            irScan(c, inMemory, n->b, level);
+            if (n->kind == AST_FOR) irScan(c, inMemory, c->ast.nodes[n->b].next, level);
+            if (n->kind == AST_ASSIGN || n->kind == AST_FOR) irScan(c, inMemory, n->c, level);
+            break;
+        case AST_CALL: {
+            unsigned varParams = n->a < BUILTIN_COUNT ? 0 : c->procInfo[c->symbolTable[n->a].info].varParams;
+            int i = 0;
+            for (int a = n->b; a != AST_NONE; a = c->ast.nodes[a].next, i++) {
+                if ((varParams >> i & 1) && c->ast.nodes[a].kind == AST_VARIABLE) {
+                    inMemory[c->ast.nodes[a].a] = true;
+                }
+                irScan(c, inMemory, a, level);
+            }
+            break;
+        }
+        case AST_BEGIN:
+            for (int s = n->a; s != AST_NONE; s = c->ast.nodes[s].next) {
+                irScan(c, inMemory, s, level);
+            }
+            break;
+        case AST_IF: case AST_WHILE: case AST_COMPARE: case AST_BINARY:
+            irScan(c, inMemory, n->a, level);
+            irScan(c, inMemory, n->b, level);
+            if (n->kind == AST_IF) irScan(c, inMemory, n->c, level);
+            break;
+        case AST_ODD: case AST_NEGATE:
+            irScan(c, inMemory, n->a, level);
+            break;
+        default:
+            break;
+    }
+}
+
+static void irScanBlock(const Compiler *c, bool *inMemory, int block, int level) {
+    const AstNode *n = &c->ast.nodes[block];
+    for (int p = n->a; p != AST_NONE; p = c->ast.nodes[p].next) {
+        const AstNode *proc = &c->ast.nodes[p];
+        irScanBlock(c, inMemory, proc->b, c->symbolTable[proc->a].level + 1);
+    }
+    irScan(c, inMemory, n->b, level);
+}
+
+static void freeIr(IrProgram *p) {
+    for (int i = 0; i < p->count; i++) {
+        free(p->functions[i].code);
+        free(p->functions[i].blocks);
+        free(p->functions[i].arguments);
+    }
+    free(p->functions);
+    free(p->function);
+    free(p->reference);
+    free(p->inSsa);
+    memset(p, 0, sizeof(*p));
+}
+
+// Build the IR of a program analyzed without errors into 'p'. Returns 0, or -1
+// if memory ran out.
+static int buildIr(const Compiler *c, IrProgram *p) {
+    IrBuilder b;
+    memset(&b, 0, sizeof(b));
+    memset(p, 0, sizeof(*p));
+    size_t n = (size_t)c->symbolCount + 1;
+    p->c = c;
+    p->functions = calloc((size_t)c->procCount + 1, sizeof(IrFunction));
+    p->function = calloc(n, sizeof(int));
+    p->reference = calloc(n, sizeof(bool));
+    p->inSsa = calloc(n, sizeof(bool));
+    b.current = calloc(n, sizeof(int32_t));
+    b.seen = calloc(n, sizeof(int32_t));
+    b.outOfMemory = p->functions == NULL || p->function == NULL || p->reference == NULL || p->inSsa == NULL ||
+                    b.current == NULL || b.seen == NULL || c->ast.root == AST_NONE;
+    if (!b.outOfMemory) {
+        const AstNode *program = &c->ast.nodes[c->ast.root];
+        markReferenceParameters(c, p->reference);
+        // inSsa first collects the variables that have to stay in memory.
+        irScanBlock(c, p->inSsa, program->a, 0);
+        for (int s = 0; s < c->symbolCount; s++) {
+            p->inSsa[s] = c->symbolTable[s].kind == KIND_VAR && c->symbolTable[s].type != TYPE_ARRAY &&
+                          !p->reference[s] && !p->inSsa[s];
+        }
+        b.p = p;
+        b.c = c;
+        irBlock(&b, program->a, IR_NONE, 0, program->b);
+    }
+    free(b.current);
+    free(b.seen);
+    free(b.journal);
+    free(b.pending);
+    if (b.outOfMemory) {
+        freeIr(p);
+        return -1;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,591 @@
+/*
+x86-64 JIT compiler for the register code of pl0_regcode.h.
+
+Each register instruction is translated into a short fixed sequence of machine
+code in one buffer, mapped executable once it is complete (never writable and
+executable at the same time). Every procedure of the program becomes a native
+function, so the register code's frames, links and the meaning of each
+instruction carry over unchanged and the result can be checked against the
+interpreters instruction for instruction. While compiled code runs:
+
+  rbx   base of the current frame, so register r is [rbx + 4r]
+  r12   the stack, the base of a stack address (VAR parameters, ADR)
+  r13   the JitContext
+  r14   the end of the stack, for the overflow check on entering a block
+  r15   scratch across calls into C
+
+CAL writes the callee's links like the interpreter does, moves rbx to the
+callee's frame and makes a native call; RET is a native return and the caller
+moves rbx back. Native calls run on a stack of their own, sized so that the
+deepest recursion the frame stack allows fits in it. The I/O instructions call
+back into C (jitRead, jitWrite).
+
+A runtime error stores the address of the failing register instruction in the
+context and unwinds straight back to runJit, which reports it like the
+interpreters do. Instructions are not counted.
+*/
+
+#ifndef PL0_JIT_H
+#define PL0_JIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pl0_regcode.h"
+#include "pl0_vm.h"
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define PL0_JIT_SUPPORTED 1
+#include <sys/mman.h>
+#else
+#define PL0_JIT_SUPPORTED 0
+#endif
+
+typedef struct {
+    int32_t *stack;
+    int32_t *stackEnd;
+    void *savedRsp;             // Host stack pointer when the program was entered
+    void *nativeStackTop;       // Where native calls of the program start
+    FILE *input;
+    FILE *output;
+    int32_t errorAt;            // Register code address of the instruction that failed
+} JitContext;
+
+typedef struct {
+    int32_t *stack;
+    size_t stackCells;
+    uint8_t *nativeStack;
+    size_t nativeStackSize;
+    FILE *input;
+    FILE *output;
+    size_t codeSize;            // Bytes of machine code made by the last run
+    const char *error;          // Runtime error that stopped the last run, NULL if none
+    int errorLine;              // Source line of that error
+} Jit;
+
+// Machine code being assembled.
+typedef struct {
+    uint8_t *bytes;
+    size_t count;
+    size_t capacity;
+    bool outOfMemory;
+} JitBuffer;
+
+// A rel32 operand at 'at' to point at register instruction 'target'.
+typedef struct {
+    size_t at;
+    int target;
+} JitFixup;
+
+enum { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+// Condition codes of Jcc and SETcc.
+enum { CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_A = 0x7, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF };
+
+#define NO_INDEX (-1)
+
+static int jitRead(JitContext *context, int32_t *cell, int skipLine) {
+    if (vmReadInteger(context->input, cell) != 0) {
+        return -1;
+    }
+    if (skipLine) {
+        vmSkipLine(context->input);
+    }
+    return 0;
+}
+
+static void jitWrite(JitContext *context, int32_t value, int newline) {
+    fprintf(context->output, newline ? "%d\n" : "%d", value);
+}
+
+static void jitByte(JitBuffer *b, int byte) {
+    if (b->count == b->capacity) {
+        size_t capacity = b->capacity ? b->capacity * 2 : 4096;
+        uint8_t *grown = realloc(b->bytes, capacity);
+        if (grown == NULL) {
+            // Carry on over the same bytes so translation can finish; the result is discarded.
+            b->outOfMemory = true;
+            b->count = 0;
+            if (b->capacity == 0) return;
+        } else {
+            b->bytes = grown;
+            b->capacity = capacity;
+        }
+    }
+    b->bytes[b->count++] = (uint8_t)byte;
+}
+
+static void jitInt32(JitBuffer *b, int32_t value) {
+    uint32_t u = (uint32_t)value;
+    for (int i = 0; i < 4; i++) {
+        jitByte(b, (int)(u >> (8 * i) & 0xFF));
+    }
+}
+
+static void jitInt64(JitBuffer *b, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        jitByte(b, (int)(value >> (8 * i) & 0xFF));
+    }
+}
+
+static void jitPatch32(JitBuffer *b, size_t at, int32_t value) {
+    if (!b->outOfMemory) {
+        uint32_t u = (uint32_t)value;
+        for (int i = 0; i < 4; i++) {
+            b->bytes[at + i] = (uint8_t)(u >> (8 * i));
+        }
+    }
+}
+
+static void jitOpcode(JitBuffer *b, int rex, int op) {
+    if (rex != 0x40) jitByte(b, rex);
+    if (op > 0xFF) jitByte(b, op >> 8);
+    jitByte(b, op & 0xFF);
+}
+
+// An instruction with a memory operand [base + index * 2^scale + disp]. 'reg'
+// is the register operand or the opcode extension; 'wide' selects 64 bits.
+static void jitMem(JitBuffer *b, bool wide, int op, int reg, int base, int index, int scale, int32_t disp) {
+    int rex = 0x40 | (wide ? 8 : 0) | (reg & 8 ? 4 : 0) | (index != NO_INDEX && (index & 8) ? 2 : 0) | (base & 8 ? 1 : 0);
+    jitOpcode(b, rex, op);
+    int mod = disp == 0 && (base & 7) != RBP ? 0 : disp >= -128 && disp <= 127 ? 1 : 2;
+    bool sib = index != NO_INDEX || (base & 7) == RSP;
+    jitByte(b, mod << 6 | (reg & 7) << 3 | (sib ? 4 : base & 7));
+    if (sib) {
+        jitByte(b, scale << 6 | ((index != NO_INDEX ? index : RSP) & 7) << 3 | (base & 7));
+    }
+    if (mod == 1) {
+        jitByte(b, disp & 0xFF);
+    } else if (mod == 2) {
+        jitInt32(b, disp);
+    }
+}
+
+// An instruction with two register operands.
+static void jitReg(JitBuffer *b, bool wide, int op, int reg, int rm) {
+    jitOpcode(b, 0x40 | (wide ? 8 : 0) | (reg & 8 ? 4 : 0) | (rm & 8 ? 1 : 0), op);
+    jitByte(b, 0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+
+// Register r of the current frame as a memory operand.
+static void jitCell(JitBuffer *b, int op, int reg, int r) {
+    jitMem(b, false, op, reg, RBX, NO_INDEX, 0, 4 * r);
+}
+
+static void jitLoad(JitBuffer *b, int reg, int r) {
+    jitCell(b, 0x8B, reg, r);
+}
+
+static void jitStore(JitBuffer *b, int r, int reg) {
+    jitCell(b, 0x89, reg, r);
+}
+
+static void jitMovImm(JitBuffer *b, int reg, int32_t value) {
+    jitOpcode(b, reg & 8 ? 0x41 : 0x40, 0xB8 + (reg & 7));
+    jitInt32(b, value);
+}
+
+// Compare reg with a constant.
+static void jitCmpImm(JitBuffer *b, int reg, int32_t value) {
+    jitReg(b, false, 0x81, 7, reg);
+    jitInt32(b, value);
+}
+
+static void jitJump(JitBuffer *b, size_t to) {
+    jitByte(b, 0xE9);
+    jitInt32(b, (int32_t)((int64_t)to - (int64_t)(b->count + 4)));
+}
+
+// A jump or call to register instruction 'target', resolved once all code is out.
+static void jitJumpTo(JitBuffer *b, JitFixup *fixups, int *fixupCount, int op, int target) {
+    jitOpcode(b, 0x40, op);
+    fixups[*fixupCount].at = b->count;
+    fixups[*fixupCount].target = target;
+    (*fixupCount)++;
+    jitInt32(b, 0);
+}
+
+// Leave through 'errorExit', blaming register instruction 'at', if condition 'cc' holds.
+static void jitFailIf(JitBuffer *b, int cc, int at, size_t errorExit) {
+    jitByte(b, 0x70 + (cc ^ 1)); // Short jump over the next 10 bytes unless cc
+    jitByte(b, 10);
+    jitMovImm(b, RSI, at);
+    jitJump(b, errorExit);
+}
+
+// rax := base of the frame 'levels' static links up from the current one.
+static void jitFrame(JitBuffer *b, int levels) {
+    jitReg(b, true, 0x8B, RAX, RBX);
+    for (int l = 0; l < levels; l++) {
+        jitMem(b, false, 0x8B, RAX, RAX, NO_INDEX, 0, 0);
+        jitMem(b, true, 0x8D, RAX, R12, RAX, 2, 0);
+    }
+}
+
+// reg (64 bits) := stack address of the cell reg points to.
+static void jitStackAddress(JitBuffer *b, int reg) {
+    jitReg(b, true, 0x29, R12, reg);
+    jitReg(b, true, 0xC1, 5, reg);
+    jitByte(b, 2);
+}
+
+static void jitCallC(JitBuffer *b, const void *function) {
+    jitReg(b, true, 0x8B, R15, RSP);
+    jitReg(b, true, 0x83, 4, RSP); // and rsp, -16
+    jitByte(b, 0xF0);
+    jitOpcode(b, 0x48, 0xB8 + RAX);
+    jitInt64(b, (uint64_t)(uintptr_t)function);
+    jitReg(b, false, 0xFF, 2, RAX);
+    jitReg(b, true, 0x8B, RSP, R15);
+}
+
+// eax := b / c or edx := b % c, with the divisor in ecx and not 0.
+static void jitDivide(JitBuffer *b, int dividend, bool modulo) {
+    jitLoad(b, RAX, dividend);
+    jitReg(b, false, 0x83, 7, RCX); // cmp ecx, -1
+    jitByte(b, 0xFF);
+    jitByte(b, 0x75); // jne: the quotient of -1 would trap on INT_MIN
+    jitByte(b, 4);
+    if (modulo) {
+        jitReg(b, false, 0x31, RDX, RDX);
+    } else {
+        jitReg(b, false, 0xF7, 3, RAX);
+    }
+    jitByte(b, 0xEB); // jmp over the division
+    jitByte(b, 3);
+    jitByte(b, 0x99);
+    jitReg(b, false, 0xF7, 7, RCX);
+}
+
+static int jitRelationCondition(RegOpcode op) {
+    switch (op) {
+        case R_JEQ: case R_JEQK: return CC_E;
+        case R_JNE: case R_JNEK: return CC_NE;
+        case R_JLT: case R_JLTK: return CC_L;
+        case R_JLE: case R_JLEK: return CC_LE;
+        case R_JGT: case R_JGTK: return CC_G;
+        default:                 return CC_GE;
+    }
+}
+
+// Translate register instruction 'at'.
+static void jitInstruction(JitBuffer *b, const RegInstruction *in, int at, size_t errorExit, size_t exit,
+                           JitFixup *fixups, int *fixupCount) {
+    switch ((RegOpcode)in->op) {
+        case R_LDK:
+            jitCell(b, 0xC7, 0, in->a);
+            jitInt32(b, in->b);
+            break;
+        case R_MOV:
+            jitLoad(b, RAX, in->b);
+            jitStore(b, in->a, RAX);
+            break;
+        case R_LDU:
+            jitFrame(b, in->c);
+            jitMem(b, false, 0x8B, RCX, RAX, NO_INDEX, 0, 4 * in->b);
+            jitStore(b, in->a, RCX);
+            break;
+        case R_STU:
+            jitFrame(b, in->c);
+            jitLoad(b, RCX, in->a);
+            jitMem(b, false, 0x89, RCX, RAX, NO_INDEX, 0, 4 * in->b);
+            break;
+        case R_ADR:
+            jitFrame(b, in->c);
+            jitStackAddress(b, RAX);
+            jitReg(b, false, 0x81, 0, RAX);
+            jitInt32(b, in->b);
+            jitStore(b, in->a, RAX);
+            break;
+        case R_LDI:
+            jitLoad(b, RAX, in->b);
+            jitMem(b, false, 0x8B, RAX, R12, RAX, 2, 0);
+            jitStore(b, in->a, RAX);
+            break;
+        case R_STI:
+            jitLoad(b, RAX, in->b);
+            jitLoad(b, RCX, in->a);
+            jitMem(b, false, 0x89, RCX, R12, RAX, 2, 0);
+            break;
+        case R_LDX: case R_STX: case R_LDXI: case R_STXI:
+            jitLoad(b, RAX, in->c);
+            jitCmpImm(b, RAX, in->d);
+            jitFailIf(b, CC_AE, at, errorExit);
+            if (in->op == R_LDX) {
+                jitMem(b, false, 0x8B, RAX, RBX, RAX, 2, 4 * in->b);
+                jitStore(b, in->a, RAX);
+            } else if (in->op == R_STX) {
+                jitLoad(b, RCX, in->a);
+                jitMem(b, false, 0x89, RCX, RBX, RAX, 2, 4 * in->b);
+            } else {
+                jitCell(b, 0x03, RAX, in->b);
+                if (in->op == R_LDXI) {
+                    jitMem(b, false, 0x8B, RAX, R12, RAX, 2, 0);
+                    jitStore(b, in->a, RAX);
+                } else {
+                    jitLoad(b, RCX, in->a);
+                    jitMem(b, false, 0x89, RCX, R12, RAX, 2, 0);
+                }
+            }
+            break;
+        case R_CHK:
+            jitLoad(b, RAX, in->a);
+            jitCmpImm(b, RAX, in->b);
+            jitFailIf(b, CC_AE, at, errorExit);
+            break;
+        case R_NEG:
+            jitLoad(b, RAX, in->b);
+            jitReg(b, false, 0xF7, 3, RAX);
+            jitStore(b, in->a, RAX);
+            break;
+        case R_ADD: case R_SUB: case R_MUL:
+            jitLoad(b, RAX, in->b);
+            jitCell(b, in->op == R_ADD ? 0x03 : in->op == R_SUB ? 0x2B : 0x0FAF, RAX, in->c);
+            jitStore(b, in->a, RAX);
+            break;
+        case R_DIV: case R_MOD:
+            jitLoad(b, RCX, in->c);
+            jitReg(b, false, 0x85, RCX, RCX);
+            jitFailIf(b, CC_E, at, errorExit);
+            jitDivide(b, in->b, in->op == R_MOD);
+            jitStore(b, in->a, in->op == R_MOD ? RDX : RAX);
+            break;
+        case R_ADDK:
+            jitLoad(b, RAX, in->b);
+            jitReg(b, false, 0x81, 0, RAX);
+            jitInt32(b, in->c);
+            jitStore(b, in->a, RAX);
+            break;
+        case R_MULK:
+            jitCell(b, 0x69, RAX, in->b);
+            jitInt32(b, in->c);
+            jitStore(b, in->a, RAX);
+            break;
+        case R_DIVK: case R_MODK:
+            jitMovImm(b, RCX, in->c);
+            jitDivide(b, in->b, in->op == R_MODK);
+            jitStore(b, in->a, in->op == R_MODK ? RDX : RAX);
+            break;
+        case R_JEQ: case R_JNE: case R_JLT: case R_JLE: case R_JGT: case R_JGE:
+            jitLoad(b, RAX, in->a);
+            jitCell(b, 0x3B, RAX, in->b);
+            jitJumpTo(b, fixups, fixupCount, 0x0F80 + jitRelationCondition((RegOpcode)in->op), in->c);
+            break;
+        case R_JEQK: case R_JNEK: case R_JLTK: case R_JLEK: case R_JGTK: case R_JGEK:
+            jitCell(b, 0x81, 7, in->a);
+            jitInt32(b, in->b);
+            jitJumpTo(b, fixups, fixupCount, 0x0F80 + jitRelationCondition((RegOpcode)in->op), in->c);
+            break;
+        case R_JODD: case R_JEVEN:
+            jitCell(b, 0xF6, 0, in->a); // test byte [cell], 1
+            jitByte(b, 1);
+            jitJumpTo(b, fixups, fixupCount, 0x0F80 + (in->op == R_JODD ? CC_NE : CC_E), in->c);
+            break;
+        case R_JMP:
+            jitJumpTo(b, fixups, fixupCount, 0xE9, in->c);
+            break;
+        case R_ENT:
+            jitMem(b, true, 0x8D, RAX, RBX, NO_INDEX, 0, 4 * (in->a + FRAME_HEADER));
+            jitReg(b, true, 0x39, R14, RAX);
+            jitFailIf(b, CC_A, at, errorExit);
+            if (in->a - FRAME_HEADER <= 16) {
+                for (int r = FRAME_HEADER; r < in->a; r++) {
+                    jitCell(b, 0xC7, 0, r);
+                    jitInt32(b, 0);
+                }
+            } else {
+                jitMem(b, true, 0x8D, RDI, RBX, NO_INDEX, 0, 4 * FRAME_HEADER);
+                jitMovImm(b, RCX, in->a - FRAME_HEADER);
+                jitReg(b, false, 0x31, RAX, RAX);
+                jitByte(b, 0xF3); // rep stosd
+                jitByte(b, 0xAB);
+            }
+            break;
+        case R_CAL:
+            jitFrame(b, in->b);
+            jitStackAddress(b, RAX);
+            jitStore(b, in->a, RAX);
+            jitReg(b, true, 0x8B, RCX, RBX);
+            jitStackAddress(b, RCX);
+            jitStore(b, in->a + 1, RCX);
+            jitCell(b, 0xC7, 0, in->a + 2);
+            jitInt32(b, at + 1);
+            jitReg(b, true, 0x81, 0, RBX);
+            jitInt32(b, 4 * in->a);
+            jitJumpTo(b, fixups, fixupCount, 0xE8, in->c);
+            jitReg(b, true, 0x81, 5, RBX);
+            jitInt32(b, 4 * in->a);
+            break;
+        case R_RET:
+            jitByte(b, 0xC3);
+            break;
+        case R_RED: case R_RDL:
+            jitReg(b, true, 0x8B, RDI, R13);
+            jitMem(b, true, 0x8D, RSI, RBX, NO_INDEX, 0, 4 * in->a);
+            jitMovImm(b, RDX, in->op == R_RDL);
+            jitCallC(b, (const void *)jitRead);
+            jitReg(b, false, 0x85, RAX, RAX);
+            jitFailIf(b, CC_NE, at, errorExit);
+            break;
+        case R_WRT: case R_WRL:
+            jitReg(b, true, 0x8B, RDI, R13);
+            jitLoad(b, RSI, in->a);
+            jitMovImm(b, RDX, in->op == R_WRL);
+            jitCallC(b, (const void *)jitWrite);
+            break;
+        case R_HLT:
+            jitReg(b, false, 0x31, RAX, RAX);
+            jitJump(b, exit);
+            break;
+        default:
+            break;
+    }
+}
+
+// Translate a whole program: the entry int enter(JitContext *), then the code
+// of every register instruction. offsets[i] is where instruction i starts.
+static void jitProgram(JitBuffer *b, const RegCode *code, size_t *offsets, JitFixup *fixups, int *fixupCount) {
+    static const int saved[] = {RBX, RBP, R12, R13, R14, R15};
+    for (int i = 0; i < 6; i++) {
+        jitOpcode(b, saved[i] & 8 ? 0x41 : 0x40, 0x50 + (saved[i] & 7));
+    }
+    jitReg(b, true, 0x83, 5, RSP); // sub rsp, 8: 16-byte alignment for calls
+    jitByte(b, 8);
+    jitReg(b, true, 0x8B, R13, RDI);
+    jitMem(b, true, 0x89, RSP, R13, NO_INDEX, 0, offsetof(JitContext, savedRsp));
+    jitMem(b, true, 0x8B, R12, R13, NO_INDEX, 0, offsetof(JitContext, stack));
+    jitReg(b, true, 0x8B, RBX, R12);
+    jitMem(b, true, 0x8B, R14, R13, NO_INDEX, 0, offsetof(JitContext, stackEnd));
+    jitMem(b, true, 0x8B, RSP, R13, NO_INDEX, 0, offsetof(JitContext, nativeStackTop));
+    jitJumpTo(b, fixups, fixupCount, 0xE8, 0);
+
+    size_t exit = b->count; // Result in eax
+    jitMem(b, true, 0x8B, RSP, R13, NO_INDEX, 0, offsetof(JitContext, savedRsp));
+    jitReg(b, true, 0x83, 0, RSP);
+    jitByte(b, 8);
+    for (int i = 5; i >= 0; i--) {
+        jitOpcode(b, saved[i] & 8 ? 0x41 : 0x40, 0x58 + (saved[i] & 7));
+    }
+    jitByte(b, 0xC3);
+
+    size_t errorExit = b->count; // Failing instruction in esi
+    jitMem(b, false, 0x89, RSI, R13, NO_INDEX, 0, offsetof(JitContext, errorAt));
+    jitMovImm(b, RAX, -1);
+    jitJump(b, exit);
+
+    for (int i = 0; i < code->count; i++) {
+        offsets[i] = b->count;
+        jitInstruction(b, &code->code[i], i, errorExit, exit, fixups, fixupCount);
+    }
+    for (int i = 0; i < *fixupCount; i++) {
+        jitPatch32(b, fixups[i].at, (int32_t)((int64_t)offsets[fixups[i].target] - (int64_t)(fixups[i].at + 4)));
+    }
+}
+
+static int initJit(Jit *jit, size_t stackCells, FILE *input, FILE *output) {
+    memset(jit, 0, sizeof(*jit));
+    jit->stack = malloc(stackCells * sizeof(int32_t));
+    if (jit->stack == NULL) {
+        return -1;
+    }
+    jit->stackCells = stackCells;
+    jit->input = input;
+    jit->output = output;
+#if PL0_JIT_SUPPORTED
+    // A native call per frame, every frame at least FRAME_HEADER cells, and room for the C library.
+    jit->nativeStackSize = (stackCells / FRAME_HEADER + 1) * 8 + ((size_t)1 << 20);
+    void *nativeStack = mmap(NULL, jit->nativeStackSize, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (nativeStack == MAP_FAILED) {
+        free(jit->stack);
+        return -1;
+    }
+    jit->nativeStack = nativeStack;
+#endif
+    return 0;
+}
+
+static void freeJit(Jit *jit) {
+    free(jit->stack);
+#if PL0_JIT_SUPPORTED
+    if (jit->nativeStack != NULL) {
+        munmap(jit->nativeStack, jit->nativeStackSize);
+    }
+#endif
+    memset(jit, 0, sizeof(*jit));
+}
+
+static const char *jitErrorMessage(RegOpcode op) {
+    switch (op) {
+        case R_DIV: return "Division by zero";
+        case R_MOD: return "Modulo by zero";
+        case R_ENT: return "Stack overflow";
+        case R_RED: case R_RDL: return "Expected an integer on input";
+        default: return "Array index out of bounds";
+    }
+}
+
+// Compile register code to machine code and run it to its HLT. Returns 0, or
+// -1 after a runtime error (jit->error and jit->errorLine say which), if memory
+// ran out or if this is not an x86-64 host.
+static int runJit(Jit *jit, const RegCode *code) {
+    jit->error = NULL;
+    jit->errorLine = 0;
+    jit->codeSize = 0;
+#if PL0_JIT_SUPPORTED
+    JitBuffer b = {NULL, 0, 0, false};
+    size_t *offsets = malloc(((size_t)code->count + 1) * sizeof(size_t));
+    JitFixup *fixups = malloc(((size_t)code->count + 1) * sizeof(JitFixup));
+    int fixupCount = 0;
+    void *memory = MAP_FAILED;
+    if (offsets != NULL && fixups != NULL && code->count > 0) {
+        jitProgram(&b, code, offsets, fixups, &fixupCount);
+        if (!b.outOfMemory) {
+            memory = mmap(NULL, b.count, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+    }
+    free(offsets);
+    free(fixups);
+    if (memory != MAP_FAILED) {
+        memcpy(memory, b.bytes, b.count);
+        if (mprotect(memory, b.count, PROT_READ | PROT_EXEC) != 0) {
+            munmap(memory, b.count);
+            memory = MAP_FAILED;
+        }
+    }
+    free(b.bytes);
+    if (memory == MAP_FAILED) {
+        jit->error = "Out of memory";
+        return -1;
+    }
+    jit->codeSize = b.count;
+
+    JitContext context;
+    memset(&context, 0, sizeof(context));
+    context.stack = jit->stack;
+    context.stackEnd = jit->stack + jit->stackCells;
+    context.nativeStackTop = (void *)((uintptr_t)(jit->nativeStack + jit->nativeStackSize) & ~(uintptr_t)15);
+    context.input = jit->input;
+    context.output = jit->output;
+    jit->stack[0] = jit->stack[1] = jit->stack[2] = 0; // The main program's links
+
+    int (*enter)(JitContext *);
+    memcpy(&enter, &memory, sizeof(enter));
+    int rc = enter(&context);
+    munmap(memory, b.count);
+    if (rc != 0) {
+        jit->error = jitErrorMessage((RegOpcode)code->code[context.errorAt].op);
+        jit->errorLine = code->lines[context.errorAt];
+        return -1;
+    }
+    return 0;
+#else
+    (void)code;
+    jit->error = "The JIT compiler needs an x86-64 host";
+    return -1;
+#endif
+}
+
+#endif
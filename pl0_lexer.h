@@ -0,0 +1,235 @@
+/*
+Table-driven PL/0 lexer shared by the three analyzers.
+
+Every token starts with one lookup in a 256-entry character-class table.
+Letters and digits run to the end of the identifier/number with the bulk
+scanners, single-character tokens come straight out of a second table, and
+the two-character operators (<=, <>, >=, :=) are a two-state DFA whose
+transition table is indexed by the class of the following byte. No byte is
+ever pushed back.
+
+Identifiers are interned as they are scanned: an IDENT token carries the
+name's integer ID and its lexeme points at the canonical upper-case spelling
+owned by the interner, so the analyzers never copy or re-compare names.
+
+The lexer does not print anything: a malformed token comes back as NONE with
+'error' set, and each analyzer reports it in its own format.
+*/
+
+#ifndef PL0_LEXER_H
+#define PL0_LEXER_H
+
+#include "pl0_source.h"
+#include "pl0_token.h"
+#include "pl0_scan.h"
+#include "pl0_intern.h"
+
+#define MAX_IDENT_LEN 11
+#define MAX_NUM_LEN 6
+
+typedef enum {
+    LEX_OK = 0,
+    LEX_IDENT_TOO_LONG,   // More than MAX_IDENT_LEN letters/digits
+    LEX_NUMBER_TOO_LONG,  // More than MAX_NUM_LEN digits
+    LEX_EXPECTED_ASSIGN,  // ':' not followed by '='
+    LEX_UNKNOWN_CHAR
+} LexError;
+
+typedef struct {
+    TokenType type;
+    const char *lexeme;              // Start of the lexeme (not NUL-terminated); the interned name for IDENT
+    int length;                      // Lexeme length in bytes
+    int numberValue;                 // Save number value for NUMBER
+    int id;                          // Interned name ID for IDENT, -1 otherwise
+    int line;
+    int col;
+    LexError error;                  // Why the token is NONE
+} Token;
+
+typedef struct {
+    SourceBuffer *source;
+    int line;  // Current position, 1-based; the column counts TAB_WIDTH per tab
+    int col;
+    LineIndex lines; // Start of every line passed so far
+    Interner *names; // Identifier table shared with the analyzer
+} Lexer;
+
+typedef enum {
+    CC_OTHER = 0, CC_SPACE, CC_LETTER, CC_DIGIT, CC_SINGLE,
+    CC_LT, CC_GT, CC_COLON, CC_EQ, CC_EOF,
+    CC_COUNT
+} CharClass;
+
+static const unsigned char charClass[256] = {
+    [' '] = CC_SPACE, ['\t'] = CC_SPACE, ['\n'] = CC_SPACE, ['\v'] = CC_SPACE, ['\f'] = CC_SPACE, ['\r'] = CC_SPACE,
+    ['A' ... 'Z'] = CC_LETTER, ['a' ... 'z'] = CC_LETTER,
+    ['0' ... '9'] = CC_DIGIT,
+    ['+'] = CC_SINGLE, ['-'] = CC_SINGLE, ['*'] = CC_SINGLE, ['/'] = CC_SINGLE, ['%'] = CC_SINGLE,
+    ['('] = CC_SINGLE, [')'] = CC_SINGLE, ['['] = CC_SINGLE, [']'] = CC_SINGLE,
+    [','] = CC_SINGLE, [';'] = CC_SINGLE, ['.'] = CC_SINGLE,
+    ['<'] = CC_LT, ['>'] = CC_GT, [':'] = CC_COLON, ['='] = CC_EQ,
+};
+
+static const TokenType singleCharToken[256] = {
+    ['+'] = PLUS, ['-'] = MINUS, ['*'] = TIMES, ['/'] = SLASH, ['%'] = PERCENT,
+    ['('] = LPARENT, [')'] = RPARENT, ['['] = LBRACK, [']'] = RBRACK,
+    [','] = COMMA, [';'] = SEMICOLON, ['.'] = PERIOD, ['='] = EQU,
+};
+
+typedef struct {
+    TokenType type;   // Token produced; NONE means a lexical error
+    int consume;      // 1 if the lookahead byte belongs to the token
+} OperatorTransition;
+
+// Rows: state after '<', '>' or ':'. Columns: class of the next byte.
+static const OperatorTransition operatorDfa[3][CC_COUNT] = {
+    /* '<' */ {
+        [CC_OTHER] = {LSS, 0}, [CC_SPACE] = {LSS, 0}, [CC_LETTER] = {LSS, 0}, [CC_DIGIT] = {LSS, 0},
+        [CC_SINGLE] = {LSS, 0}, [CC_LT] = {LSS, 0}, [CC_GT] = {NEQ, 1}, [CC_COLON] = {LSS, 0},
+        [CC_EQ] = {LEQ, 1}, [CC_EOF] = {LSS, 0},
+    },
+    /* '>' */ {
+        [CC_OTHER] = {GTR, 0}, [CC_SPACE] = {GTR, 0}, [CC_LETTER] = {GTR, 0}, [CC_DIGIT] = {GTR, 0},
+        [CC_SINGLE] = {GTR, 0}, [CC_LT] = {GTR, 0}, [CC_GT] = {GTR, 0}, [CC_COLON] = {GTR, 0},
+        [CC_EQ] = {GEQ, 1}, [CC_EOF] = {GTR, 0},
+    },
+    /* ':' */ {
+        [CC_OTHER] = {NONE, 0}, [CC_SPACE] = {NONE, 0}, [CC_LETTER] = {NONE, 0}, [CC_DIGIT] = {NONE, 0},
+        [CC_SINGLE] = {NONE, 0}, [CC_LT] = {NONE, 0}, [CC_GT] = {NONE, 0}, [CC_COLON] = {NONE, 0},
+        [CC_EQ] = {ASSIGN, 1}, [CC_EOF] = {NONE, 0},
+    },
+};
+
+static void initLexer(Lexer *lx, SourceBuffer *source, Interner *names) {
+    lx->source = source;
+    lx->names = names;
+    lx->line = 1;
+    lx->col = 1;
+    initLineIndex(&lx->lines, source);
+}
+
+static void freeLexer(Lexer *lx) {
+    freeLineIndex(&lx->lines);
+}
+
+// Restart lx on another source, keeping the line index allocated for the last one.
+static inline void resetLexer(Lexer *lx, SourceBuffer *source, Interner *names) {
+    if (lx->lines.starts == NULL) {
+        initLexer(lx, source, names);
+        return;
+    }
+    lx->source = source;
+    lx->names = names;
+    lx->line = 1;
+    lx->col = 1;
+    lx->lines.base = source->data;
+    lx->lines.count = 1; // starts[0] is always line 1
+}
+
+// A letter/digit run that is too long: report it at the column where the limit
+// was hit, then move the position past the whole run.
+static Token lexRunTooLong(Lexer *lx, Token token, LexError error, int limit, int len) {
+    lx->col += limit - 1;
+    token.type = NONE;
+    token.error = error;
+    token.length = limit;
+    token.line = lx->line;
+    token.col = lx->col;
+    lx->col += len - limit;
+    return token;
+}
+
+static Token lexNext(Lexer *lx) {
+    SourceBuffer *source = lx->source;
+    const char *end = source->end;
+    Token token = {NONE, "", 0, 0, -1, 0, 0, LEX_OK};
+
+    const char *p = scanSkipSpace(source->cur, end, &lx->line, &lx->col, &lx->lines);
+    token.lexeme = p;
+    if (p >= end) {
+        source->cur = p;
+        token.type = EOFS;
+        token.line = lx->line;
+        token.col = lx->col + 1;
+        return token;
+    }
+
+    const char *start = p;
+    unsigned char ch = (unsigned char)*p++;
+    lx->col++;
+    int len;
+
+    switch (charClass[ch]) {
+        case CC_LETTER:
+            p = scanAlnum(p, end);
+            source->cur = p;
+            len = (int)(p - start);
+            if (len > MAX_IDENT_LEN) {
+                return lexRunTooLong(lx, token, LEX_IDENT_TOO_LONG, MAX_IDENT_LEN, len);
+            }
+            lx->col += len - 1;
+            token.type = classifyKeyword(start, len);
+            token.length = len;
+            if (token.type == IDENT) {
+                token.id = internName(lx->names, start, len);
+                token.lexeme = internedName(lx->names, token.id);
+            }
+            break;
+
+        case CC_DIGIT:
+            p = scanDigits(p, end);
+            source->cur = p;
+            len = (int)(p - start);
+            for (int i = 0; i < len && i < MAX_NUM_LEN; i++) {
+                token.numberValue = token.numberValue * 10 + (start[i] - '0');
+            }
+            if (len > MAX_NUM_LEN) {
+                return lexRunTooLong(lx, token, LEX_NUMBER_TOO_LONG, MAX_NUM_LEN, len);
+            }
+            lx->col += len - 1;
+            token.type = NUMBER;
+            token.length = len;
+            break;
+
+        case CC_SINGLE:
+        case CC_EQ:
+            source->cur = p;
+            token.type = singleCharToken[ch];
+            token.length = 1;
+            break;
+
+        case CC_LT:
+        case CC_GT:
+        case CC_COLON: {
+            int next = (p < end) ? charClass[(unsigned char)*p] : CC_EOF;
+            const OperatorTransition *t = &operatorDfa[charClass[ch] - CC_LT][next];
+            token.line = lx->line;
+            token.col = lx->col;
+            p += t->consume;
+            lx->col += t->consume;
+            source->cur = p;
+            token.type = t->type;
+            token.length = 1 + t->consume;
+            if (t->type == NONE) {
+                token.error = LEX_EXPECTED_ASSIGN;
+                return token;
+            }
+            break;
+        }
+
+        default:
+            source->cur = p;
+            token.type = NONE;
+            token.error = LEX_UNKNOWN_CHAR;
+            token.length = 1;
+            token.line = lx->line;
+            token.col = lx->col;
+            return token;
+    }
+
+    token.line = lx->line;
+    token.col = lx->col;
+    return token;
+}
+
+#endif
@@ -0,0 +1,824 @@
+/*
+Lowering of the SSA form (pl0_ir.h) to register code (pl0_regcode.h), which
+the register VM, the JIT and the assembly backend then run as they run the
+code generated from the syntax tree.
+
+A function's blocks are laid out in the order irReversePostorder gives, and
+every value gets a frame cell by linear scan over that layout. A value is
+live from its definition to its last use, taking in every block it is live
+across: a value used after a loop or carried around it covers the whole loop.
+Values whose intervals do not overlap share a cell, so the cells of the
+variables in SSA form are reused like any other. A phi and the values it
+takes prefer each other's cell, so that most edges need no copy; those that
+do get them on the edge, as a parallel copy. The cells of variables that stay
+in memory are never handed out.
+
+Some values take no cell of their own:
+  - constants, which become the constant operand of an instruction, or are
+    loaded where a register is needed;
+  - a load of a variable held in a register of the frame, when every use
+    follows in the same block before anything could change the variable: the
+    uses read that register, as the register code from the tree does;
+  - a value the next instruction stores into such a variable, which is
+    computed right into its register;
+  - an argument used only by its call, computed into its parameter cell.
+Three scratch cells above those allocated hold what an instruction needs in a
+register for a moment; the argument cells of calls come after them.
+*/
+
+#ifndef PL0_LOWER_H
+#define PL0_LOWER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "pl0_ir.h"
+#include "pl0_regcode.h"
+
+#define LOWER_UNALLOCATED INT32_MIN
+
+typedef enum {
+    LOWER_CELL,         // In a cell of its own, allocated
+    LOWER_NONE,         // A constant, or no value
+    LOWER_HOME,         // In the register of the variable it is loaded from
+    LOWER_INTO,         // Computed into the register of the variable it is stored into
+    LOWER_ARGUMENT      // In the parameter cell of its call
+} LowerKind;
+
+// A min-heap of values ordered by key[value], or of cells if key is NULL.
+typedef struct {
+    int32_t *items;
+    int count;
+    int capacity;
+} LowerHeap;
+
+typedef struct {
+    const IrProgram *p;
+    IrFunction *f;
+    RegGen g;           // Only its code, line and outOfMemory are used
+    uint8_t *kind;      // Per value: LowerKind
+    int32_t *cell;      // Per value: its cell; an argument's index until the frame is laid out
+    int32_t *uses;      // Per value
+    int32_t *phiUser;   // Per value: a phi taking it, IR_NONE if none
+    int32_t *position;  // Per instruction, in layout order; the phis of a block share one
+    int32_t *end;       // Per value: position of its last use
+    int32_t *order;     // Blocks in layout order
+    int blocks;
+    int32_t *start;     // Per block: position of its phis, IR_NONE if unreachable
+    int32_t *stop;      // Per block: position of its terminator
+    int32_t *visited;   // Per block: value whose liveness last reached it
+    int32_t *address;   // Per block: its code address
+    int32_t *fixups;    // Jumps and their target blocks, in pairs
+    int fixupCount;
+    int fixupCapacity;
+    int32_t *copies;    // Targets and sources of a parallel copy, in pairs
+    int copyCapacity;
+    int scratch;        // First of the three scratch cells
+    int arguments;      // First argument cell of calls
+    int frameSize;
+    bool outOfMemory;
+} Lowering;
+
+static bool lowerHeapPush(LowerHeap *h, const int32_t *key, int32_t item) {
+    if (!irReserve((void **)&h->items, &h->capacity, h->count + 1, sizeof(int32_t))) {
+        return false;
+    }
+    int i = h->count++;
+    int32_t itemKey = key ? key[item] : item;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        int32_t parentKey = key ? key[h->items[parent]] : h->items[parent];
+        if (parentKey <= itemKey) break;
+        h->items[i] = h->items[parent];
+        i = parent;
+    }
+    h->items[i] = item;
+    return true;
+}
+
+static int32_t lowerHeapPop(LowerHeap *h, const int32_t *key) {
+    int32_t top = h->items[0], item = h->items[--h->count];
+    int32_t itemKey = key ? key[item] : item;
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= h->count) break;
+        if (child + 1 < h->count && (key ? key[h->items[child + 1]] < key[h->items[child]]
+                                         : h->items[child + 1] < h->items[child])) {
+            child++;
+        }
+        if ((key ? key[h->items[child]] : h->items[child]) >= itemKey) break;
+        h->items[i] = h->items[child];
+        i = child;
+    }
+    if (h->count > 0) h->items[i] = item;
+    return top;
+}
+
+static RegPlace lowerPlace(const Lowering *L, int symbol, int offset) {
+    const Symbol *s = &L->p->c->symbolTable[symbol];
+    RegPlace place;
+    place.level = L->f->level - s->level;
+    place.address = s->address + offset;
+    place.reference = L->p->reference[symbol];
+    return place;
+}
+
+static inline bool lowerIsRegister(RegPlace place) {
+    return place.level == 0 && !place.reference;
+}
+
+// Where the variable or element a LOAD, LOADX, STORE or STOREX accesses lives, if it
+// is a scalar or an element with a constant index inside its array.
+static bool lowerScalar(const Lowering *L, const IrInstruction *in, RegPlace *place) {
+    int32_t k = 0;
+    if ((in->op == IR_LOADX || in->op == IR_STOREX) &&
+        (!irConstantValue(L->f, in->a, &k) || k < 0 || k >= irArraySize(L->p->c, in->symbol))) {
+        return false;
+    }
+    *place = lowerPlace(L, in->symbol, k);
+    return true;
+}
+
+// The value an instruction stores, if it is a STORE or STOREX.
+static int lowerStored(const IrInstruction *in) {
+    return in->op == IR_STORE ? in->a : in->op == IR_STOREX ? in->b : IR_NONE;
+}
+
+static int lowerNextLive(const IrFunction *f, int i) {
+    for (i = f->code[i].next; i != IR_NONE && f->code[i].op == IR_NOP; i = f->code[i].next) {
+    }
+    return i;
+}
+
+// Number the instructions in layout order.
+static bool lowerLayout(Lowering *L) {
+    IrFunction *f = L->f;
+    L->blocks = irReversePostorder(f, L->order);
+    if (L->blocks < 0) {
+        return false;
+    }
+    for (int b = 0; b < f->blockCount; b++) {
+        L->start[b] = L->stop[b] = IR_NONE;
+        L->visited[b] = IR_NONE;
+    }
+    int position = 0;
+    for (int o = 0; o < L->blocks; o++) {
+        int b = L->order[o];
+        bool phis = false;
+        L->start[b] = position;
+        for (int i = f->blocks[b].first; i != IR_NONE; i = f->code[i].next) {
+            if (f->code[i].op == IR_NOP) continue;
+            if (f->code[i].op == IR_PHI) {
+                L->position[i] = position;
+                phis = true;
+                continue;
+            }
+            if (phis) {
+                position++;
+                phis = false;
+            }
+            L->position[i] = position++;
+        }
+        L->stop[b] = position - 1;
+    }
+    return true;
+}
+
+// Extend the interval of 'value' over the blocks it is live across to reach
+// 'block', where it is used or live at the end.
+static void lowerLiveIn(Lowering *L, int value, int block, int32_t *stack) {
+    int def = L->f->code[value].block, depth = 0;
+    if (block == def || L->visited[block] == value) {
+        return;
+    }
+    L->visited[block] = value;
+    stack[depth++] = block;
+    while (depth > 0) {
+        const IrBlock *b = &L->f->blocks[stack[--depth]];
+        for (int w = 0; w < 2; w++) {
+            int pred = b->pred[w];
+            if (pred == IR_NONE || L->start[pred] == IR_NONE) continue;
+            if (L->stop[pred] > L->end[value]) L->end[value] = L->stop[pred];
+            if (pred != def && L->visited[pred] != value) {
+                L->visited[pred] = value;
+                stack[depth++] = pred;
+            }
+        }
+    }
+}
+
+static bool lowerLiveness(Lowering *L) {
+    IrFunction *f = L->f;
+    int32_t *stack = malloc((size_t)f->blockCount * sizeof(int32_t));
+    if (stack == NULL) {
+        return false;
+    }
+    for (int i = 0; i < f->count; i++) {
+        L->end[i] = L->position[i];
+        L->uses[i] = 0;
+        L->phiUser[i] = IR_NONE;
+    }
+    for (int o = 0; o < L->blocks; o++) {
+        int b = L->order[o];
+        for (int i = f->blocks[b].first; i != IR_NONE; i = f->code[i].next) {
+            IrInstruction *in = &f->code[i];
+            int32_t *operands[MAX_PARAMS + 2];
+            int n = in->op == IR_NOP ? 0 : irOperands(f, in, operands);
+            for (int j = 0; j < n; j++) {
+                int value = *operands[j], at = L->position[i], from = b;
+                L->uses[value]++;
+                if (in->op == IR_PHI) {
+                    // Used at the end of the block the edge comes from.
+                    from = f->blocks[b].pred[j];
+                    if (from == IR_NONE || L->start[from] == IR_NONE) continue;
+                    at = L->stop[from];
+                    if (L->phiUser[value] == IR_NONE) L->phiUser[value] = i;
+                }
+                if (at > L->end[value]) L->end[value] = at;
+                lowerLiveIn(L, value, from, stack);
+            }
+        }
+    }
+    free(stack);
+    return true;
+}
+
+// True if nothing between 'value' and its last use in its block could change
+// the variable or element at 'symbol' it was loaded from.
+static bool lowerUnchanged(const Lowering *L, int value, int symbol) {
+    const IrFunction *f = L->f;
+    for (int i = lowerNextLive(f, value); i != IR_NONE && L->position[i] < L->end[value]; i = lowerNextLive(f, i)) {
+        const IrInstruction *in = &f->code[i];
+        if (in->op == IR_CALL || ((in->op == IR_STORE || in->op == IR_STOREX) && in->symbol == symbol)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Argument index of 'value' if its only use is a call later in its block with
+// no call in between, else -1.
+static int lowerArgument(const Lowering *L, int value) {
+    const IrFunction *f = L->f;
+    for (int i = lowerNextLive(f, value); i != IR_NONE && L->position[i] <= L->end[value]; i = lowerNextLive(f, i)) {
+        const IrInstruction *in = &f->code[i];
+        if (in->op != IR_CALL) continue;
+        if (L->position[i] != L->end[value]) return -1;
+        for (int a = 0; a < f->arguments[in->k]; a++) {
+            if (f->arguments[in->k + 1 + a] == value) return a;
+        }
+        return -1;
+    }
+    return -1;
+}
+
+// Decide which values need a cell of their own.
+static void lowerClassify(Lowering *L) {
+    IrFunction *f = L->f;
+    for (int o = 0; o < L->blocks; o++) {
+        int b = L->order[o];
+        for (int i = f->blocks[b].first; i != IR_NONE; i = f->code[i].next) {
+            IrInstruction *in = &f->code[i];
+            RegPlace place;
+            L->cell[i] = LOWER_UNALLOCATED;
+            L->kind[i] = LOWER_CELL;
+            if (!irHasValue(in->op) || in->op == IR_CONST) {
+                L->kind[i] = LOWER_NONE;
+                continue;
+            }
+            bool local = L->phiUser[i] == IR_NONE && L->end[i] <= L->stop[b];
+            if ((in->op == IR_LOAD || in->op == IR_LOADX) && local && lowerScalar(L, in, &place) &&
+                lowerIsRegister(place) && lowerUnchanged(L, i, in->symbol)) {
+                L->kind[i] = LOWER_HOME;
+                L->cell[i] = place.address;
+                continue;
+            }
+            if (in->op == IR_PHI || in->op == IR_PARAM || !local || L->uses[i] != 1) {
+                continue;
+            }
+            int next = lowerNextLive(f, i);
+            if (next != IR_NONE && lowerStored(&f->code[next]) == i && lowerScalar(L, &f->code[next], &place) &&
+                lowerIsRegister(place)) {
+                L->kind[i] = LOWER_INTO;
+                L->cell[i] = place.address;
+                continue;
+            }
+            int argument = lowerArgument(L, i);
+            if (argument >= 0) {
+                L->kind[i] = LOWER_ARGUMENT;
+                L->cell[i] = argument;
+            }
+        }
+    }
+}
+
+// Linear scan over the values in cells of their own. Returns the number of
+// cells the frame needs below the scratch cells, or -1 if memory ran out.
+static int lowerAllocate(Lowering *L) {
+    IrFunction *f = L->f;
+    const Compiler *c = L->p->c;
+    int params = f->symbol != IR_NONE ? c->procInfo[c->symbolTable[f->symbol].info].numParams : 0;
+    int next = f->variables, base = params;
+    // Cells from -params up to every one a value could take.
+    uint8_t *isFree = calloc((size_t)(params + f->variables + f->count + 1), 1);
+    LowerHeap pool = {NULL, 0, 0}, active = {NULL, 0, 0};
+    bool ok = isFree != NULL;
+
+    // The cells of the variables in SSA form are free; the parameters' are
+    // taken by their IR_PARAM values.
+    for (int s = f->scope; ok && s < c->symbolCount && c->symbolTable[s].level >= f->level; s++) {
+        const Symbol *symbol = &c->symbolTable[s];
+        if (symbol->level == f->level && symbol->kind == KIND_VAR && L->p->inSsa[s] && symbol->address >= FRAME_HEADER) {
+            isFree[symbol->address + base] = 1;
+            ok = lowerHeapPush(&pool, NULL, symbol->address);
+        }
+    }
+    for (int o = 0; ok && o < L->blocks; o++) {
+        int b = L->order[o];
+        for (int i = f->blocks[b].first; ok && i != IR_NONE; i = f->code[i].next) {
+            IrInstruction *in = &f->code[i];
+            if (in->op == IR_NOP || L->kind[i] != LOWER_CELL) continue;
+            int at = L->position[i];
+
+            // Free the cells of the values dead here. A phi is defined on the
+            // edge, before the block, so only values dead before it make room.
+            while (active.count > 0 && (in->op == IR_PHI ? L->end[active.items[0]] < at : L->end[active.items[0]] <= at)) {
+                int cell = L->cell[lowerHeapPop(&active, L->end)];
+                isFree[cell + base] = 1;
+                ok = lowerHeapPush(&pool, NULL, cell);
+            }
+            int cell = LOWER_UNALLOCATED;
+            if (in->op == IR_PARAM) {
+                cell = c->symbolTable[in->symbol].address;
+            }
+            int phi = L->phiUser[i];
+            if (cell == LOWER_UNALLOCATED && phi != IR_NONE) {
+                // The cell of the phi it goes to, or of the phi's other operand.
+                int candidates[3] = {phi, f->code[phi].a, f->code[phi].b};
+                for (int j = 0; j < 3 && cell == LOWER_UNALLOCATED; j++) {
+                    int v = candidates[j];
+                    if (v != IR_NONE && v != i && L->kind[v] == LOWER_CELL && L->cell[v] != LOWER_UNALLOCATED &&
+                        isFree[L->cell[v] + base]) {
+                        cell = L->cell[v];
+                    }
+                }
+            }
+            if (cell == LOWER_UNALLOCATED) {
+                // The cell of a phi's operand, or of an operand dying here.
+                int operands[2] = {in->a, in->b};
+                for (int j = 0; j < 2 && cell == LOWER_UNALLOCATED; j++) {
+                    int v = operands[j];
+                    if (v != IR_NONE && L->kind[v] == LOWER_CELL && L->cell[v] != LOWER_UNALLOCATED &&
+                        isFree[L->cell[v] + base] && (in->op == IR_PHI || L->end[v] == at)) {
+                        cell = L->cell[v];
+                    }
+                }
+            }
+            while (cell == LOWER_UNALLOCATED && pool.count > 0) {
+                int candidate = lowerHeapPop(&pool, NULL);
+                if (isFree[candidate + base]) cell = candidate;
+            }
+            if (cell == LOWER_UNALLOCATED) {
+                cell = next++;
+            }
+            isFree[cell + base] = 0;
+            L->cell[i] = cell;
+            ok = ok && lowerHeapPush(&active, L->end, i);
+        }
+    }
+    free(isFree);
+    free(pool.items);
+    free(active.items);
+    return ok ? next : -1;
+}
+
+// Register holding 'value', a constant loaded into 'scratch' first.
+static int lowerOperand(Lowering *L, int value, int scratch) {
+    int32_t k;
+    if (irConstantValue(L->f, value, &k)) {
+        emitReg(&L->g, R_LDK, scratch, k, 0, 0);
+        return scratch;
+    }
+    return L->cell[value];
+}
+
+// Put 'value' in register 'target'.
+static void lowerMove(Lowering *L, int target, int value) {
+    int32_t k;
+    if (irConstantValue(L->f, value, &k)) {
+        emitReg(&L->g, R_LDK, target, k, 0, 0);
+    } else if (L->cell[value] != target) {
+        emitReg(&L->g, R_MOV, target, L->cell[value], 0, 0);
+    }
+}
+
+static void lowerLoad(Lowering *L, RegPlace place, int target) {
+    if (lowerIsRegister(place)) {
+        if (place.address != target) emitReg(&L->g, R_MOV, target, place.address, 0, 0);
+    } else if (place.level == 0) {
+        emitReg(&L->g, R_LDI, target, place.address, 0, 0);
+    } else {
+        emitReg(&L->g, R_LDU, target, place.address, place.level, 0);
+        if (place.reference) emitReg(&L->g, R_LDI, target, target, 0, 0);
+    }
+}
+
+static void lowerStore(Lowering *L, RegPlace place, int value) {
+    if (lowerIsRegister(place)) {
+        lowerMove(L, place.address, value);
+        return;
+    }
+    int r = lowerOperand(L, value, L->scratch);
+    if (place.level == 0) {
+        emitReg(&L->g, R_STI, r, place.address, 0, 0);
+    } else if (!place.reference) {
+        emitReg(&L->g, R_STU, r, place.address, place.level, 0);
+    } else {
+        emitReg(&L->g, R_LDU, L->scratch + 1, place.address, place.level, 0);
+        emitReg(&L->g, R_STI, r, L->scratch + 1, 0, 0);
+    }
+}
+
+static void lowerFixup(Lowering *L, int jump, int block) {
+    if (!irReserve((void **)&L->fixups, &L->fixupCapacity, L->fixupCount + 2, sizeof(int32_t))) {
+        L->outOfMemory = true;
+        return;
+    }
+    L->fixups[L->fixupCount++] = jump;
+    L->fixups[L->fixupCount++] = block;
+}
+
+static void lowerJump(Lowering *L, int block) {
+    lowerFixup(L, emitReg(&L->g, R_JMP, 0, 0, 0, 0), block);
+}
+
+// Operand of the phi at 'phi' for the edge from 'from'.
+static int lowerPhiOperand(const Lowering *L, int phi, int from) {
+    const IrInstruction *in = &L->f->code[phi];
+    return irPredIndex(L->f, in->block, from) == 0 ? in->a : in->b;
+}
+
+// True if entering 'to' from 'from' needs any copy for its phis.
+static bool lowerHasCopies(const Lowering *L, int from, int to) {
+    const IrFunction *f = L->f;
+    for (int i = f->blocks[to].first; i != IR_NONE; i = f->code[i].next) {
+        if (f->code[i].op == IR_NOP) continue;
+        if (f->code[i].op != IR_PHI) break;
+        int value = lowerPhiOperand(L, i, from);
+        if (f->code[value].op == IR_CONST || L->cell[value] != L->cell[i]) return true;
+    }
+    return false;
+}
+
+// The copies of the phis of 'to' on the edge from 'from', as if all at once: a
+// copy waits while another still has to read its target, and a cycle of copies
+// is broken through the first scratch cell. Constants come last.
+static void lowerCopies(Lowering *L, int from, int to) {
+    IrFunction *f = L->f;
+    int pending = 0;
+    for (int i = f->blocks[to].first; i != IR_NONE; i = f->code[i].next) {
+        if (f->code[i].op == IR_NOP) continue;
+        if (f->code[i].op != IR_PHI) break;
+        int value = lowerPhiOperand(L, i, from);
+        if (f->code[value].op == IR_CONST || L->cell[value] == L->cell[i]) continue;
+        if (!irReserve((void **)&L->copies, &L->copyCapacity, 2 * pending + 2, sizeof(int32_t))) {
+            L->outOfMemory = true;
+            return;
+        }
+        L->copies[2 * pending] = L->cell[i];
+        L->copies[2 * pending + 1] = L->cell[value];
+        pending++;
+    }
+    int32_t *copy = L->copies;
+    while (pending > 0) {
+        int ready = -1;
+        for (int j = 0; j < pending && ready < 0; j++) {
+            bool read = false;
+            for (int m = 0; m < pending && !read; m++) {
+                read = m != j && copy[2 * m + 1] == copy[2 * j];
+            }
+            if (!read) ready = j;
+        }
+        if (ready < 0) {
+            // Every target is still to be read: save one and read it from there.
+            int32_t saved = copy[0];
+            emitReg(&L->g, R_MOV, L->scratch, saved, 0, 0);
+            for (int m = 0; m < pending; m++) {
+                if (copy[2 * m + 1] == saved) copy[2 * m + 1] = L->scratch;
+            }
+            ready = 0;
+        }
+        emitReg(&L->g, R_MOV, copy[2 * ready], copy[2 * ready + 1], 0, 0);
+        pending--;
+        copy[2 * ready] = copy[2 * pending];
+        copy[2 * ready + 1] = copy[2 * pending + 1];
+    }
+    for (int i = f->blocks[to].first; i != IR_NONE; i = f->code[i].next) {
+        if (f->code[i].op == IR_NOP) continue;
+        if (f->code[i].op != IR_PHI) break;
+        int value = lowerPhiOperand(L, i, from);
+        if (f->code[value].op == IR_CONST) {
+            emitReg(&L->g, R_LDK, L->cell[i], f->code[value].k, 0, 0);
+        }
+    }
+}
+
+// Go from 'from' to 'to', where 'next' is the block laid out after 'from'.
+static void lowerEdge(Lowering *L, int from, int to, int next) {
+    lowerCopies(L, from, to);
+    if (to != next) {
+        lowerJump(L, to);
+    }
+}
+
+// Jump taken if the branch's relation is 'sense'. Returns its address.
+static int lowerConditionalJump(Lowering *L, const IrInstruction *in, bool sense) {
+    int32_t k;
+    if (in->k == ODD) {
+        return emitReg(&L->g, sense ? R_JODD : R_JEVEN, L->cell[in->a], 0, 0, 0);
+    }
+    TokenType op = (TokenType)in->k;
+    if (irConstantValue(L->f, in->b, &k)) {
+        return emitReg(&L->g, (RegOpcode)(relationOpcode(op, !sense) + (R_JEQK - R_JEQ)), L->cell[in->a], k, 0, 0);
+    }
+    if (irConstantValue(L->f, in->a, &k)) {
+        return emitReg(&L->g, (RegOpcode)(relationOpcode(swappedRelation(op), !sense) + (R_JEQK - R_JEQ)),
+                       L->cell[in->b], k, 0, 0);
+    }
+    return emitReg(&L->g, relationOpcode(op, !sense), L->cell[in->a], L->cell[in->b], 0, 0);
+}
+
+static void lowerBranch(Lowering *L, const IrInstruction *in, int block, int next) {
+    const IrBlock *b = &L->f->blocks[block];
+    int ifTrue = b->succ[0], ifFalse = b->succ[1];
+    int32_t left, right = 0;
+    if (irConstantValue(L->f, in->a, &left) && (in->k == ODD || irConstantValue(L->f, in->b, &right))) {
+        bool taken = in->k == ODD ? (left & 1) != 0 : foldOperator((TokenType)in->k, left, right) != 0;
+        lowerEdge(L, block, taken ? ifTrue : ifFalse, next);
+        return;
+    }
+    bool copiesTrue = lowerHasCopies(L, block, ifTrue), copiesFalse = lowerHasCopies(L, block, ifFalse);
+    if (!copiesTrue && (ifFalse == next || copiesFalse)) {
+        lowerFixup(L, lowerConditionalJump(L, in, true), ifTrue);
+        lowerEdge(L, block, ifFalse, next);
+    } else if (!copiesFalse) {
+        lowerFixup(L, lowerConditionalJump(L, in, false), ifFalse);
+        lowerEdge(L, block, ifTrue, next);
+    } else {
+        int jump = lowerConditionalJump(L, in, false);
+        lowerCopies(L, block, ifTrue);
+        lowerJump(L, ifTrue);
+        patchRegHere(&L->g, jump);
+        lowerEdge(L, block, ifFalse, next);
+    }
+}
+
+static void lowerArithmetic(Lowering *L, const IrInstruction *in, int target) {
+    int32_t left, right;
+    bool constantLeft = irConstantValue(L->f, in->a, &left), constantRight = irConstantValue(L->f, in->b, &right);
+    bool division = in->op == IR_DIV || in->op == IR_MOD;
+    TokenType op = irOperator(in->op);
+    if (constantLeft && constantRight && !(division && right == 0)) {
+        emitReg(&L->g, R_LDK, target, foldOperator(op, left, right), 0, 0);
+        return;
+    }
+    if (constantRight && !(division && right == 0)) {
+        if (op == MINUS) {
+            op = PLUS;
+            right = foldSign(MINUS, right);
+        }
+        emitReg(&L->g, arithmeticOpcode(op, true), target, L->cell[in->a], right, 0);
+        return;
+    }
+    if (constantLeft && (op == PLUS || op == TIMES)) {
+        emitReg(&L->g, arithmeticOpcode(op, true), target, L->cell[in->b], left, 0);
+        return;
+    }
+    int a = lowerOperand(L, in->a, L->scratch);
+    int b = lowerOperand(L, in->b, L->scratch + 1);
+    emitReg(&L->g, arithmeticOpcode(op, false), target, a, b, 0);
+}
+
+static void lowerInstruction(Lowering *L, int i, int next) {
+    IrFunction *f = L->f;
+    const IrInstruction *in = &f->code[i];
+    const Compiler *c = L->p->c;
+    int target = L->cell[i], s0 = L->scratch, s1 = L->scratch + 1, s2 = L->scratch + 2;
+    int32_t k;
+    RegPlace place;
+    L->g.line = in->line;
+    switch ((IrOpcode)in->op) {
+        case IR_COPY:
+            lowerMove(L, target, in->a);
+            break;
+        case IR_LOAD: case IR_LOADX:
+            if (L->kind[i] == LOWER_HOME) {
+                break;
+            }
+            if (lowerScalar(L, in, &place)) {
+                lowerLoad(L, place, target);
+            } else {
+                int index = lowerOperand(L, in->a, s0);
+                place = lowerPlace(L, in->symbol, 0);
+                if (place.level == 0) {
+                    emitReg(&L->g, R_LDX, target, place.address, index, irArraySize(c, in->symbol));
+                } else {
+                    emitReg(&L->g, R_ADR, s1, place.address, place.level, 0);
+                    emitReg(&L->g, R_LDXI, target, s1, index, irArraySize(c, in->symbol));
+                }
+            }
+            break;
+        case IR_STORE: case IR_STOREX:
+            if (lowerScalar(L, in, &place)) {
+                lowerStore(L, place, lowerStored(in));
+            } else {
+                int index = lowerOperand(L, in->a, s0);
+                int value = lowerOperand(L, in->b, s1);
+                place = lowerPlace(L, in->symbol, 0);
+                if (place.level == 0) {
+                    emitReg(&L->g, R_STX, value, place.address, index, irArraySize(c, in->symbol));
+                } else {
+                    emitReg(&L->g, R_ADR, s2, place.address, place.level, 0);
+                    emitReg(&L->g, R_STXI, value, s2, index, irArraySize(c, in->symbol));
+                }
+            }
+            break;
+        case IR_CHECK:
+            if (!irConstantValue(f, in->a, &k) || k < 0 || k >= irArraySize(c, in->symbol)) {
+                emitReg(&L->g, R_CHK, lowerOperand(L, in->a, s0), irArraySize(c, in->symbol), 0, 0);
+            }
+            break;
+        case IR_ADDRESS:
+            if (in->a == IR_NONE || (irConstantValue(f, in->a, &k) && k >= 0 && k < irArraySize(c, in->symbol))) {
+                place = lowerPlace(L, in->symbol, in->a == IR_NONE ? 0 : k);
+                if (!place.reference) {
+                    emitReg(&L->g, R_ADR, target, place.address, place.level, 0);
+                } else if (place.level == 0) {
+                    emitReg(&L->g, R_MOV, target, place.address, 0, 0);
+                } else {
+                    emitReg(&L->g, R_LDU, target, place.address, place.level, 0);
+                }
+            } else {
+                int index = lowerOperand(L, in->a, s0);
+                place = lowerPlace(L, in->symbol, 0);
+                emitReg(&L->g, R_CHK, index, irArraySize(c, in->symbol), 0, 0);
+                emitReg(&L->g, R_ADR, s1, place.address, place.level, 0);
+                emitReg(&L->g, R_ADD, target, s1, index, 0);
+            }
+            break;
+        case IR_NEG:
+            if (irConstantValue(f, in->a, &k)) {
+                emitReg(&L->g, R_LDK, target, foldSign(MINUS, k), 0, 0);
+            } else {
+                emitReg(&L->g, R_NEG, target, L->cell[in->a], 0, 0);
+            }
+            break;
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+            lowerArithmetic(L, in, target);
+            break;
+        case IR_READ:
+            emitReg(&L->g, in->k ? R_RDL : R_RED, target, 0, 0, 0);
+            break;
+        case IR_WRITE:
+            emitReg(&L->g, in->k ? R_WRL : R_WRT, lowerOperand(L, in->a, s0), 0, 0, 0);
+            break;
+        case IR_CALL: {
+            int count = f->arguments[in->k];
+            for (int a = 0; a < count; a++) {
+                lowerMove(L, L->arguments + a, f->arguments[in->k + 1 + a]);
+            }
+            // The symbol, replaced by its entry once all code is out
+            emitReg(&L->g, R_CAL, L->arguments + count, f->level - c->symbolTable[in->symbol].level, in->symbol, 0);
+            break;
+        }
+        case IR_JUMP:
+            lowerEdge(L, in->block, f->blocks[in->block].succ[0], next);
+            break;
+        case IR_BRANCH:
+            lowerBranch(L, in, in->block, next);
+            break;
+        case IR_RETURN:
+            emitReg(&L->g, f->symbol != IR_NONE ? R_RET : R_HLT, 0, 0, 0, 0);
+            break;
+        default:
+            break;
+    }
+}
+
+// Lower one function. Returns its entry address, or -1 if memory ran out.
+static int lowerFunction(Lowering *L) {
+    IrFunction *f = L->f;
+    size_t values = (size_t)(f->count ? f->count : 1), blocks = (size_t)f->blockCount;
+    L->kind = malloc(values);
+    L->cell = malloc(values * sizeof(int32_t));
+    L->uses = malloc(values * sizeof(int32_t));
+    L->phiUser = malloc(values * sizeof(int32_t));
+    L->position = calloc(values, sizeof(int32_t));
+    L->end = malloc(values * sizeof(int32_t));
+    L->order = malloc(blocks * sizeof(int32_t));
+    L->start = malloc(blocks * sizeof(int32_t));
+    L->stop = malloc(blocks * sizeof(int32_t));
+    L->visited = malloc(blocks * sizeof(int32_t));
+    L->address = malloc(blocks * sizeof(int32_t));
+    L->fixupCount = 0;
+    int entry = -1;
+    bool ok = L->kind && L->cell && L->uses && L->phiUser && L->position && L->end && L->order && L->start &&
+              L->stop && L->visited && L->address && lowerLayout(L) && lowerLiveness(L);
+    int cells = -1;
+    if (ok) {
+        lowerClassify(L);
+        cells = lowerAllocate(L);
+    }
+    if (cells >= 0) {
+        int maxArguments = 0;
+        for (int i = 0; i < f->count; i++) {
+            if (f->code[i].op == IR_CALL && f->arguments[f->code[i].k] > maxArguments) {
+                maxArguments = f->arguments[f->code[i].k];
+            }
+        }
+        L->scratch = cells;
+        L->arguments = cells + 3;
+        L->frameSize = L->arguments + maxArguments;
+        for (int i = 0; i < f->count; i++) {
+            if (f->code[i].op != IR_NOP && f->code[i].block != IR_NONE && L->start[f->code[i].block] != IR_NONE &&
+                L->kind[i] == LOWER_ARGUMENT) {
+                L->cell[i] += L->arguments;
+            }
+        }
+        L->g.line = f->line;
+        entry = emitReg(&L->g, R_ENT, L->frameSize, 0, 0, 0);
+        for (int o = 0; o < L->blocks; o++) {
+            int b = L->order[o], next = o + 1 < L->blocks ? L->order[o + 1] : IR_NONE;
+            L->address[b] = L->g.code->count;
+            for (int i = f->blocks[b].first; i != IR_NONE; i = f->code[i].next) {
+                if (f->code[i].op != IR_NOP) lowerInstruction(L, i, next);
+            }
+        }
+        if (!L->g.outOfMemory && !L->outOfMemory) {
+            for (int j = 0; j < L->fixupCount; j += 2) {
+                L->g.code->code[L->fixups[j]].c = L->address[L->fixups[j + 1]];
+            }
+        }
+    }
+    free(L->kind);
+    free(L->cell);
+    free(L->uses);
+    free(L->phiUser);
+    free(L->position);
+    free(L->end);
+    free(L->order);
+    free(L->start);
+    free(L->stop);
+    free(L->visited);
+    free(L->address);
+    return L->outOfMemory ? -1 : entry;
+}
+
+// Lower a program's IR to register code in 'code', replacing what it held.
+// Returns 0, or -1 if memory ran out.
+static int lowerIr(const IrProgram *p, RegCode *code) {
+    Lowering L;
+    memset(&L, 0, sizeof(L));
+    L.p = p;
+    L.g.c = p->c;
+    L.g.code = code;
+    code->count = 0;
+    int *entry = calloc((size_t)p->c->symbolCount + 1, sizeof(int));
+    if (entry == NULL || p->count == 0) {
+        free(entry);
+        return -1;
+    }
+    L.g.line = p->functions[p->count - 1].line;
+    int start = emitReg(&L.g, R_JMP, 0, 0, 0, 0), program = -1;
+    for (int i = 0; i < p->count && !L.outOfMemory && !L.g.outOfMemory; i++) {
+        L.f = &p->functions[i];
+        int address = lowerFunction(&L);
+        if (address < 0) {
+            L.outOfMemory = true;
+        } else if (L.f->symbol != IR_NONE) {
+            entry[L.f->symbol] = address;
+        } else {
+            program = address;
+        }
+    }
+    bool failed = L.outOfMemory || L.g.outOfMemory;
+    if (!failed) {
+        code->code[start].c = program;
+        for (int i = 0; i < code->count; i++) {
+            if (code->code[i].op == R_CAL) {
+                code->code[i].c = entry[code->code[i].c];
+            }
+        }
+    }
+    free(entry);
+    free(L.fixups);
+    free(L.copies);
+    if (failed) {
+        code->count = 0;
+        return -1;
+    }
+    return 0;
+}
+
+#endif
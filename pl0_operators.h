@@ -0,0 +1,87 @@
+/*
+Binary and sign operators of PL/0 expressions, described by one table.
+
+operatorTable is indexed by token type. An operator's entry gives its
+precedence (which drives the precedence-climbing expression parser), the
+message reported when an operand is not an INTEGER, and, for '/' and '%', the
+message for a constant zero divisor. foldOperator computes an operator's
+result and is shared by constant folding and anything else that evaluates
+expressions, so all of them agree on the arithmetic:
+
+  - results wrap around in 32 bits instead of overflowing;
+  - '/' and '%' truncate toward zero, and INT_MIN / -1 wraps to INT_MIN
+    (INT_MIN % -1 is 0);
+  - a relational operator yields 1 or 0.
+*/
+
+#ifndef PL0_OPERATORS_H
+#define PL0_OPERATORS_H
+
+#include <limits.h>
+#include <stdbool.h>
+#include "pl0_token.h"
+
+typedef enum {
+    PREC_NONE = 0,          // Not a binary operator
+    PREC_RELATIONAL,        // = <> < <= > >=, only between the two sides of a condition
+    PREC_ADDITIVE,          // + -
+    PREC_MULTIPLICATIVE     // * / %
+} Precedence;
+
+typedef struct {
+    unsigned char precedence;   // Precedence, PREC_NONE for other tokens
+    bool sign;                  // May also start an expression as a unary sign
+    const char *mismatch;       // Format for an operand that is not an INTEGER: operator, left type, right type
+    const char *zeroDivisor;    // Error for a constant zero right operand, NULL if zero is allowed
+} OperatorInfo;
+
+#define ARITHMETIC_MISMATCH "Type mismatch for operator '%s'. Both operands must be INTEGER, but found '%s' and '%s'."
+#define ADDITIVE_MISMATCH "Type mismatch for binary operator '%s'. Both operands must be INTEGER, but found '%s' and '%s'."
+#define RELATIONAL_MISMATCH "Type mismatch for relational operator '%s'. Both operands must be INTEGER, but found '%s' and '%s'."
+
+static const OperatorInfo operatorTable[EOFS + 1] = {
+    [PLUS]    = {PREC_ADDITIVE, true, ADDITIVE_MISMATCH, NULL},
+    [MINUS]   = {PREC_ADDITIVE, true, ADDITIVE_MISMATCH, NULL},
+    [TIMES]   = {PREC_MULTIPLICATIVE, false, ARITHMETIC_MISMATCH, NULL},
+    [SLASH]   = {PREC_MULTIPLICATIVE, false, ARITHMETIC_MISMATCH, "Semantic error: Division by constant zero."},
+    [PERCENT] = {PREC_MULTIPLICATIVE, false, ARITHMETIC_MISMATCH, "Semantic error: Modulo by constant zero."},
+    [EQU]     = {PREC_RELATIONAL, false, RELATIONAL_MISMATCH, NULL},
+    [NEQ]     = {PREC_RELATIONAL, false, RELATIONAL_MISMATCH, NULL},
+    [LSS]     = {PREC_RELATIONAL, false, RELATIONAL_MISMATCH, NULL},
+    [LEQ]     = {PREC_RELATIONAL, false, RELATIONAL_MISMATCH, NULL},
+    [GTR]     = {PREC_RELATIONAL, false, RELATIONAL_MISMATCH, NULL},
+    [GEQ]     = {PREC_RELATIONAL, false, RELATIONAL_MISMATCH, NULL},
+};
+
+static inline const OperatorInfo *operatorInfo(TokenType type) {
+    return &operatorTable[type];
+}
+
+static inline bool isRelationalOperator(TokenType type) {
+    return operatorInfo(type)->precedence == PREC_RELATIONAL;
+}
+
+// Value of 'left op right'. The divisor of '/' and '%' must not be zero.
+static inline int foldOperator(TokenType op, int left, int right) {
+    switch (op) {
+        case PLUS:    return (int)((unsigned)left + (unsigned)right);
+        case MINUS:   return (int)((unsigned)left - (unsigned)right);
+        case TIMES:   return (int)((unsigned)left * (unsigned)right);
+        case SLASH:   return right == -1 ? (int)(0u - (unsigned)left) : left / right;
+        case PERCENT: return right == -1 ? 0 : left % right;
+        case EQU:     return left == right;
+        case NEQ:     return left != right;
+        case LSS:     return left < right;
+        case LEQ:     return left <= right;
+        case GTR:     return left > right;
+        case GEQ:     return left >= right;
+        default:      return 0;
+    }
+}
+
+// Value of a unary sign applied to 'operand'.
+static inline int foldSign(TokenType sign, int operand) {
+    return sign == MINUS ? (int)(0u - (unsigned)operand) : operand;
+}
+
+#endif
@@ -0,0 +1,262 @@
+/*
+Parallel lexing of one large source buffer.
+
+No PL/0 token contains whitespace, so the buffer is cut into one chunk per
+thread at whitespace bytes and the chunks are lexed concurrently. The first
+chunk is lexed by the caller's own Lexer straight into the output array; every
+other chunk gets a private Lexer and Interner, starts from line 1, column 1,
+and produces its own token array. Those arrays are then stitched on:
+
+  - the start position of each chunk follows from the end position of the
+    chunk before it, so line numbers are shifted by the lines above the chunk
+    and columns on its first line by the column it starts at;
+  - chunk-local name IDs are re-interned in chunk order, which hands out the
+    shared IDs in order of first appearance, exactly as one sequential lexer
+    would;
+  - the per-chunk line indexes are rebased and appended to the Lexer's.
+
+The merged array is token-for-token what repeated lexNext calls return, and the
+Lexer is left at the end of the input with its line index filled in.
+*/
+
+#ifndef PL0_PARLEX_H
+#define PL0_PARLEX_H
+
+#include "pl0_lexer.h"
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#ifndef PARLEX_MIN_CHUNK
+#define PARLEX_MIN_CHUNK (1 << 18) // Bytes per thread below which another thread is not worth it
+#endif
+#define PARLEX_MAX_THREADS 64
+
+typedef struct {
+    Token *tokens;
+    size_t count;
+    size_t capacity;
+} TokenArray;
+
+static inline int pushToken(TokenArray *a, Token t) {
+    if (a->count == a->capacity) {
+        size_t capacity = a->capacity ? a->capacity * 2 : 4096;
+        Token *grown = realloc(a->tokens, capacity * sizeof(Token));
+        if (grown == NULL) return -1;
+        a->tokens = grown;
+        a->capacity = capacity;
+    }
+    a->tokens[a->count++] = t;
+    return 0;
+}
+
+static inline void freeTokenArray(TokenArray *a) {
+    free(a->tokens);
+    a->tokens = NULL;
+    a->count = a->capacity = 0;
+}
+
+typedef struct {
+    Lexer *lexer;         // The caller's Lexer for the first chunk, &own otherwise
+    TokenArray *tokens;   // The output array for the first chunk, &ownTokens otherwise
+    SourceBuffer source;  // View of the chunk inside the whole buffer
+    Lexer own;
+    Interner names;       // Chunk-local name IDs
+    TokenArray ownTokens;
+    Token eof;            // The chunk's EOFS, which is not stored in 'tokens'
+    int *globalId;        // Chunk-local name ID -> shared name ID
+    int startLine;        // Position of the chunk's first byte in the whole input
+    int startCol;
+    Token *merged;        // Where the chunk's tokens go in the output array
+    const Interner *shared;
+    int failed;
+} LexChunk;
+
+static void *lexChunk(void *arg) {
+    LexChunk *c = arg;
+    Token t;
+    while ((t = lexNext(c->lexer)).type != EOFS) {
+        if (pushToken(c->tokens, t) != 0) {
+            c->failed = 1;
+            return NULL;
+        }
+    }
+    c->eof = t;
+    return NULL;
+}
+
+static inline void rebaseToken(const LexChunk *c, Token *t) {
+    if (t->line == 1) t->col += c->startCol - 1;
+    t->line += c->startLine - 1;
+    if (t->type == IDENT) {
+        t->id = c->globalId[t->id];
+        t->lexeme = internedName(c->shared, t->id);
+    }
+}
+
+static void *stitchChunk(void *arg) {
+    LexChunk *c = arg;
+    for (size_t i = 0; i < c->ownTokens.count; i++) {
+        c->merged[i] = c->ownTokens.tokens[i];
+        rebaseToken(c, &c->merged[i]);
+    }
+    freeTokenArray(&c->ownTokens);
+    return NULL;
+}
+
+// Run fn on each of the n elements of 'args': one thread per element, the caller taking the first.
+static void runParallel(void *(*fn)(void *), void *args, size_t argSize, int n) {
+#if !defined(_WIN32)
+    pthread_t threads[PARLEX_MAX_THREADS];
+    int started[PARLEX_MAX_THREADS] = {0};
+    for (int i = 1; i < n; i++) {
+        started[i] = pthread_create(&threads[i], NULL, fn, (char *)args + i * argSize) == 0;
+        if (!started[i]) fn((char *)args + i * argSize);
+    }
+    fn(args);
+    for (int i = 1; i < n; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+#else
+    for (int i = 0; i < n; i++) fn((char *)args + i * argSize);
+#endif
+}
+
+static inline int defaultLexThreads(void) {
+#if !defined(_WIN32)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#else
+    return 1;
+#endif
+}
+
+// Lex the rest of lx's source on up to 'threads' threads into 'out' (EOFS last).
+// Returns 0, or -1 if memory ran out.
+static int lexParallel(Lexer *lx, int threads, TokenArray *out) {
+    SourceBuffer *source = lx->source;
+    const char *begin = source->cur, *end = source->end;
+    size_t size = (size_t)(end - begin);
+    if (threads > PARLEX_MAX_THREADS) threads = PARLEX_MAX_THREADS;
+    if ((size_t)threads > size / PARLEX_MIN_CHUNK) threads = (int)(size / PARLEX_MIN_CHUNK);
+    if (threads < 1) threads = 1;
+
+    LexChunk *chunks = calloc((size_t)threads, sizeof(LexChunk));
+    if (chunks == NULL) return -1;
+    out->count = 0;
+    int n = 0;
+    const char *from = begin;
+    do {
+        const char *to = (n + 1 == threads) ? end : begin + size / threads * (n + 1);
+        if (to < from) to = from;
+        while (to < end && !isSpaceByte((unsigned char)*to)) to++;
+        LexChunk *c = &chunks[n++];
+        initSourceBuffer(&c->source, from, (size_t)(to - from), 0);
+        if (n == 1) {
+            c->lexer = lx;
+            c->tokens = out;
+        } else {
+            initInterner(&c->names);
+            initLexer(&c->own, &c->source, &c->names);
+            c->lexer = &c->own;
+            c->tokens = &c->ownTokens;
+        }
+        from = to;
+    } while (n < threads && from < end);
+
+    // The first chunk runs on lx itself, so its view of the buffer ends where the chunk does.
+    source->end = chunks[0].source.end;
+    runParallel(lexChunk, chunks, sizeof(LexChunk), n);
+    source->end = end;
+
+    // Chunk start positions, shared name IDs and output offsets, in file order.
+    int failed = chunks[0].failed, linesLost = (lx->lines.starts == NULL);
+    int line = lx->line, col = lx->col;
+    size_t total = out->count;
+    int lineCount = lx->lines.count;
+    for (int i = 1; i < n; i++) {
+        LexChunk *c = &chunks[i];
+        failed |= c->failed;
+        c->startLine = line;
+        c->startCol = col;
+        if (c->own.line > 1) {
+            line += c->own.line - 1;
+            col = c->own.col;
+        } else {
+            col += c->own.col - 1;
+        }
+        c->globalId = malloc(((size_t)c->names.count + 1) * sizeof(int));
+        if (c->globalId == NULL) {
+            failed = 1;
+            continue;
+        }
+        for (int id = 0; id < c->names.count; id++) {
+            c->globalId[id] = internName(lx->names, c->names.names[id], c->names.lengths[id]);
+        }
+        c->shared = lx->names;
+        total += c->ownTokens.count;
+        lineCount += c->own.lines.count - 1;
+        linesLost |= (c->own.lines.starts == NULL);
+    }
+
+    if (!failed && total + 1 > out->capacity) {
+        Token *grown = realloc(out->tokens, (total + 1) * sizeof(Token));
+        if (grown == NULL) {
+            failed = 1;
+        } else {
+            out->tokens = grown;
+            out->capacity = total + 1;
+        }
+    }
+
+    if (!failed) {
+        size_t offset = out->count;
+        for (int i = 1; i < n; i++) {
+            chunks[i].merged = out->tokens + offset;
+            offset += chunks[i].ownTokens.count;
+        }
+        if (n > 1) {
+            runParallel(stitchChunk, chunks + 1, sizeof(LexChunk), n - 1);
+        }
+        Token eof = chunks[n - 1].eof;
+        if (n > 1) rebaseToken(&chunks[n - 1], &eof);
+        out->tokens[total] = eof;
+        out->count = total + 1;
+
+        // Append the other chunks' line starts, rebased onto the whole buffer.
+        if (linesLost) {
+            freeLineIndex(&lx->lines);
+        } else if (n > 1) {
+            size_t *starts = realloc(lx->lines.starts, (size_t)lineCount * sizeof(size_t));
+            if (starts == NULL) {
+                freeLineIndex(&lx->lines);
+            } else {
+                lx->lines.starts = starts;
+                lx->lines.capacity = lineCount;
+                for (int i = 1; i < n; i++) {
+                    const LexChunk *c = &chunks[i];
+                    size_t base = (size_t)(c->source.data - lx->lines.base);
+                    for (int k = 1; k < c->own.lines.count; k++) {
+                        lx->lines.starts[lx->lines.count++] = base + c->own.lines.starts[k];
+                    }
+                }
+            }
+        }
+        lx->line = line;
+        lx->col = col;
+        source->cur = end;
+    }
+
+    for (int i = 1; i < n; i++) {
+        freeTokenArray(&chunks[i].ownTokens);
+        freeLexer(&chunks[i].own);
+        freeInterner(&chunks[i].names);
+        free(chunks[i].globalId);
+    }
+    free(chunks);
+    return failed ? -1 : 0;
+}
+
+#endif
@@ -0,0 +1,514 @@
+/*
+Optimization passes over the SSA form of pl0_ir.h, and the pass manager that
+runs them in order and times them.
+
+A pass takes one function and rewrites it in place, returning how many
+instructions it removed or rewrote. The pipeline is:
+
+  sccp   sparse conditional constant propagation: find the values that are
+         constant on every path that can run, taking a branch on a constant
+         only the way it goes, then turn those values into constants and
+         the branches into jumps
+  phis   replace a phi whose operands are all one value (or itself), and every
+         copy, by that value
+  dce    remove the instructions whose value nothing that matters uses, when
+         computing it cannot stop the program
+  cfg    drop unreachable blocks, merge a block into the one jumping to it
+         when it has no other way in, and number the blocks in the order the
+         backends lay them out (irReversePostorder)
+
+Each leaves the function valid for the next and for the backends, which only
+need the phis of a block first and every block ending in its terminator.
+*/
+
+#ifndef PL0_PASSES_H
+#define PL0_PASSES_H
+
+#include <stdlib.h>
+#include <time.h>
+#include "pl0_ir.h"
+
+typedef struct {
+    const char *name;
+    // Returns the instructions removed or rewritten, or -1 if memory ran out.
+    int (*run)(const IrProgram *p, IrFunction *f);
+} IrPass;
+
+// What a pass did over the whole program.
+typedef struct {
+    const char *name;
+    double seconds;
+    long changed;
+    long before;        // Instructions in the program before it, see irInstructionCount
+    long after;
+} IrPassRun;
+
+// Instructions left in the program, those removed as IR_NOP not counted.
+static long irInstructionCount(const IrProgram *p) {
+    long count = 0;
+    for (int i = 0; i < p->count; i++) {
+        for (int j = 0; j < p->functions[i].count; j++) {
+            count += p->functions[i].code[j].op != IR_NOP;
+        }
+    }
+    return count;
+}
+
+// Lattice of a value for irPropagateConstants: not known to be computed yet,
+// known to be one constant, or taking more than one value.
+enum { IR_UNKNOWN, IR_KNOWN, IR_VARYING };
+
+typedef struct {
+    IrFunction *f;
+    uint8_t *state;     // Per value: IR_UNKNOWN, IR_KNOWN or IR_VARYING
+    int32_t *value;     // Per value: its constant while IR_KNOWN
+    uint8_t *taken;     // Per block: bit 2 once it can run, bit s once its edge to succ[s] can be taken
+    int32_t *userStart; // Per value: its first user in users; the last entry ends the list
+    int32_t *users;     // Instructions using each value
+    int32_t *edges;     // Worklist of edges, as 2 * block + successor
+    int edgeCount;
+    int32_t *values;    // Worklist of values whose state changed
+    int valueCount;
+} IrSccp;
+
+// Lower 'value' in the lattice to 'state' (with constant k), queuing its users if that changes it.
+static void irSccpSet(IrSccp *s, int value, int state, int32_t k) {
+    if (state == IR_KNOWN && s->state[value] == IR_KNOWN && s->value[value] != k) {
+        state = IR_VARYING;
+    }
+    if (state <= s->state[value]) {
+        return;
+    }
+    s->state[value] = (uint8_t)state;
+    s->value[value] = k;
+    s->values[s->valueCount++] = value;
+}
+
+static void irSccpTake(IrSccp *s, int block, int successor) {
+    if (!(s->taken[block] >> successor & 1)) {
+        s->taken[block] |= (uint8_t)(1 << successor);
+        s->edges[s->edgeCount++] = 2 * block + successor;
+    }
+}
+
+// True if the edge from 'from' into 'to' can be taken.
+static bool irSccpEdge(const IrSccp *s, int from, int to) {
+    return from != IR_NONE && (s->taken[from] >> (s->f->blocks[from].succ[0] == to ? 0 : 1) & 1);
+}
+
+static void irSccpVisit(IrSccp *s, int i) {
+    const IrFunction *f = s->f;
+    const IrInstruction *in = &f->code[i];
+    int state = IR_VARYING;
+    int32_t k = 0, a = 0, b = 0;
+    int sa = in->a != IR_NONE ? s->state[in->a] : IR_KNOWN, sb = in->b != IR_NONE ? s->state[in->b] : IR_KNOWN;
+    if (in->a != IR_NONE) a = s->value[in->a];
+    if (in->b != IR_NONE) b = s->value[in->b];
+    switch (in->op) {
+        case IR_CONST:
+            state = IR_KNOWN;
+            k = in->k;
+            break;
+        case IR_PHI: {
+            // Meet of the operands on the edges that can be taken.
+            const IrBlock *block = &f->blocks[in->block];
+            state = IR_UNKNOWN;
+            for (int j = 0; j < 2; j++) {
+                int operand = j == 0 ? in->a : in->b;
+                if (!irSccpEdge(s, block->pred[j], in->block) || s->state[operand] == IR_UNKNOWN) continue;
+                if (s->state[operand] == IR_VARYING || (state == IR_KNOWN && s->value[operand] != k)) {
+                    state = IR_VARYING;
+                } else if (state == IR_UNKNOWN) {
+                    state = IR_KNOWN;
+                    k = s->value[operand];
+                }
+            }
+            break;
+        }
+        case IR_COPY:
+            state = sa;
+            k = a;
+            break;
+        case IR_NEG: case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+            if (in->op == IR_MUL && ((sa == IR_KNOWN && a == 0) || (sb == IR_KNOWN && b == 0))) {
+                state = IR_KNOWN;
+                k = 0;
+            } else if (sa == IR_UNKNOWN || sb == IR_UNKNOWN) {
+                state = IR_UNKNOWN;
+            } else if (sa == IR_KNOWN && sb == IR_KNOWN && !((in->op == IR_DIV || in->op == IR_MOD) && b == 0)) {
+                state = IR_KNOWN;
+                k = in->op == IR_NEG ? foldSign(MINUS, a) : foldOperator(irOperator(in->op), a, b);
+            }
+            break;
+        case IR_JUMP:
+            irSccpTake(s, in->block, 0);
+            return;
+        case IR_BRANCH:
+            if (sa == IR_UNKNOWN || sb == IR_UNKNOWN) {
+                return;
+            }
+            if (sa == IR_KNOWN && sb == IR_KNOWN) {
+                bool holds = in->k == ODD ? (a & 1) != 0 : foldOperator((TokenType)in->k, a, b) != 0;
+                irSccpTake(s, in->block, holds ? 0 : 1);
+            } else {
+                irSccpTake(s, in->block, 0);
+                irSccpTake(s, in->block, 1);
+            }
+            return;
+        default:
+            if (!irHasValue(in->op)) return;
+            break;
+    }
+    irSccpSet(s, i, state, k);
+}
+
+// A constant in front of everything else of the function, for a phi found
+// constant to copy. Returns its value, or IR_NONE if memory ran out.
+static int irSccpConstant(IrFunction *f, int32_t k) {
+    if (!irReserve((void **)&f->code, &f->capacity, f->count + 1, sizeof(IrInstruction))) {
+        return IR_NONE;
+    }
+    IrInstruction *in = &f->code[f->count];
+    memset(in, 0, sizeof(*in));
+    in->op = IR_CONST;
+    in->a = in->b = in->symbol = IR_NONE;
+    in->k = k;
+    in->block = 0;
+    in->line = f->line;
+    in->next = f->blocks[0].first;
+    f->blocks[0].first = f->count;
+    return f->count++;
+}
+
+static int irPropagateConstants(const IrProgram *p, IrFunction *f) {
+    (void)p;
+    IrSccp s;
+    size_t values = (size_t)(f->count ? f->count : 1);
+    memset(&s, 0, sizeof(s));
+    s.f = f;
+    s.state = calloc(values, 1);
+    s.value = calloc(values, sizeof(int32_t));
+    s.taken = calloc((size_t)f->blockCount, 1);
+    s.userStart = calloc(values + 1, sizeof(int32_t));
+    s.edges = malloc(2 * (size_t)f->blockCount * sizeof(int32_t));
+    s.values = malloc(2 * values * sizeof(int32_t));
+    int changed = -1;
+    if (s.state == NULL || s.value == NULL || s.taken == NULL || s.userStart == NULL || s.edges == NULL ||
+        s.values == NULL) {
+        goto done;
+    }
+
+    // Users of each value, counted then placed.
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < f->count; i++) {
+            int32_t *operands[MAX_PARAMS + 2];
+            int n = f->code[i].op == IR_NOP ? 0 : irOperands(f, &f->code[i], operands);
+            for (int j = 0; j < n; j++) {
+                if (pass == 0) s.userStart[*operands[j] + 1]++;
+                else s.users[s.userStart[*operands[j]]++] = i;
+            }
+        }
+        if (pass == 0) {
+            for (int v = 0; v < f->count; v++) {
+                s.userStart[v + 1] += s.userStart[v];
+            }
+            s.users = malloc((size_t)(s.userStart[f->count] ? s.userStart[f->count] : 1) * sizeof(int32_t));
+            if (s.users == NULL) goto done;
+        }
+    }
+    for (int v = f->count; v > 0; v--) {
+        s.userStart[v] = s.userStart[v - 1];
+    }
+    s.userStart[0] = 0;
+
+    // Run the blocks an edge can reach and the users of values that change,
+    // until neither has anything left.
+    s.taken[0] = 4;
+    for (int i = f->blocks[0].first; i != IR_NONE; i = f->code[i].next) {
+        irSccpVisit(&s, i);
+    }
+    while (s.edgeCount > 0 || s.valueCount > 0) {
+        if (s.edgeCount > 0) {
+            int edge = s.edges[--s.edgeCount];
+            int to = f->blocks[edge / 2].succ[edge % 2];
+            bool first = !(s.taken[to] & 4);
+            s.taken[to] |= 4;
+            for (int i = f->blocks[to].first; i != IR_NONE; i = f->code[i].next) {
+                if (first || f->code[i].op == IR_PHI) irSccpVisit(&s, i);
+            }
+            continue;
+        }
+        int value = s.values[--s.valueCount];
+        for (int u = s.userStart[value]; u < s.userStart[value + 1]; u++) {
+            if (s.taken[f->code[s.users[u]].block] & 4) irSccpVisit(&s, s.users[u]);
+        }
+    }
+
+    // Constant values become constants and decided branches jumps. A phi
+    // becomes a copy of a constant, as it has to stay among the phis.
+    changed = 0;
+    int count = f->count;
+    for (int i = 0; i < count && changed >= 0; i++) {
+        IrInstruction *in = &f->code[i];
+        if (in->op == IR_NOP || in->op == IR_CONST || !(s.taken[in->block] & 4)) {
+            continue;
+        }
+        if (in->op == IR_BRANCH && (s.taken[in->block] & 3) != 3) {
+            int keep = s.taken[in->block] & 1 ? 0 : 1, block = in->block;
+            irRemoveEdge(f, block, f->blocks[block].succ[1 - keep]);
+            f->blocks[block].succ[0] = f->blocks[block].succ[keep];
+            f->blocks[block].succ[1] = IR_NONE;
+            in->op = IR_JUMP;
+            in->a = in->b = IR_NONE;
+            changed++;
+        } else if (irHasValue(in->op) && s.state[i] == IR_KNOWN) {
+            if (in->op == IR_PHI) {
+                int constant = irSccpConstant(f, s.value[i]);
+                if (constant == IR_NONE) {
+                    changed = -1;
+                    break;
+                }
+                in = &f->code[i];
+                in->op = IR_COPY;
+                in->a = constant;
+                in->b = IR_NONE;
+            } else {
+                in->op = IR_CONST;
+                in->k = s.value[i];
+                in->a = in->b = IR_NONE;
+            }
+            changed++;
+        }
+    }
+
+done:
+    free(s.state);
+    free(s.value);
+    free(s.taken);
+    free(s.userStart);
+    free(s.users);
+    free(s.edges);
+    free(s.values);
+    return changed;
+}
+
+static int32_t irRepresentative(int32_t *same, int32_t value) {
+    while (same[value] != value) {
+        same[value] = same[same[value]];
+        value = same[value];
+    }
+    return value;
+}
+
+static int irSimplifyPhis(const IrProgram *p, IrFunction *f) {
+    (void)p;
+    int32_t *same = malloc((size_t)(f->count ? f->count : 1) * sizeof(int32_t));
+    if (same == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < f->count; i++) {
+        same[i] = i;
+    }
+    // Replacing one phi can make another trivial, so go over them until none is.
+    int removed = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < f->count; i++) {
+            IrInstruction *in = &f->code[i];
+            int32_t value;
+            if (in->op == IR_COPY) {
+                value = irRepresentative(same, in->a);
+            } else if (in->op == IR_PHI) {
+                int32_t a = irRepresentative(same, in->a), b = irRepresentative(same, in->b);
+                if (a == b || b == i) {
+                    value = a;
+                } else if (a == i) {
+                    value = b;
+                } else {
+                    continue;
+                }
+            } else {
+                continue;
+            }
+            same[i] = value;
+            in->op = IR_NOP;
+            removed++;
+            changed = true;
+        }
+    }
+    if (removed > 0) {
+        for (int i = 0; i < f->count; i++) {
+            int32_t *operands[MAX_PARAMS + 2];
+            IrInstruction *in = &f->code[i];
+            if (in->op == IR_NOP) continue;
+            int n = irOperands(f, in, operands);
+            for (int j = 0; j < n; j++) {
+                *operands[j] = irRepresentative(same, *operands[j]);
+            }
+        }
+    }
+    free(same);
+    return removed;
+}
+
+// Mark what the instructions with an effect use, directly or not, and remove
+// the rest. Unlike counting uses this also removes values only a dead loop
+// passes around through its phis.
+static int irRemoveDeadCode(const IrProgram *p, IrFunction *f) {
+    uint8_t *live = calloc((size_t)(f->count ? f->count : 1), 1);
+    int32_t *stack = malloc((size_t)(f->count ? f->count : 1) * sizeof(int32_t));
+    if (live == NULL || stack == NULL) {
+        free(live);
+        free(stack);
+        return -1;
+    }
+    int depth = 0, removed = 0;
+    for (int i = 0; i < f->count; i++) {
+        if (f->code[i].op != IR_NOP && !irPure(p, f, &f->code[i])) {
+            live[i] = 1;
+            stack[depth++] = i;
+        }
+    }
+    while (depth > 0) {
+        int32_t *operands[MAX_PARAMS + 2];
+        int n = irOperands(f, &f->code[stack[--depth]], operands);
+        for (int j = 0; j < n; j++) {
+            if (!live[*operands[j]]) {
+                live[*operands[j]] = 1;
+                stack[depth++] = *operands[j];
+            }
+        }
+    }
+    for (int i = 0; i < f->count; i++) {
+        if (f->code[i].op != IR_NOP && !live[i]) {
+            f->code[i].op = IR_NOP;
+            removed++;
+        }
+    }
+    free(live);
+    free(stack);
+    return removed;
+}
+
+// Append block 'from', which only 'into' jumps to, to 'into' in place of the jump.
+static void irMergeBlock(IrFunction *f, int into, int from) {
+    IrBlock *block = &f->blocks[into], *next = &f->blocks[from];
+    f->code[block->last].op = IR_NOP;
+    f->code[block->last].next = next->first;
+    for (int i = next->first; i != IR_NONE; i = f->code[i].next) {
+        f->code[i].block = into;
+    }
+    block->last = next->last;
+    for (int s = 0; s < 2; s++) {
+        int target = block->succ[s] = next->succ[s];
+        if (target == IR_NONE) continue;
+        for (int w = 0; w < 2; w++) {
+            if (f->blocks[target].pred[w] == from) f->blocks[target].pred[w] = into;
+        }
+    }
+    next->first = next->last = IR_NONE;
+    next->succ[0] = next->succ[1] = next->pred[0] = next->pred[1] = IR_NONE;
+}
+
+static int irSimplifyCfg(const IrProgram *p, IrFunction *f) {
+    (void)p;
+    int changed = 0;
+    int32_t *order = malloc((size_t)f->blockCount * sizeof(int32_t));
+    int32_t *index = malloc((size_t)f->blockCount * sizeof(int32_t));
+    IrBlock *blocks = malloc((size_t)f->blockCount * sizeof(IrBlock));
+    int count = order != NULL && index != NULL && blocks != NULL ? irReversePostorder(f, order) : -1;
+
+    // Drop the unreachable blocks first, so that their edges do not keep a
+    // block from merging, then number what is left after merging.
+    for (int pass = 0; pass < 2 && count >= 0; pass++) {
+        for (int b = 0; b < f->blockCount; b++) {
+            index[b] = IR_NONE;
+        }
+        for (int i = 0; i < count; i++) {
+            index[order[i]] = i;
+        }
+        if (pass == 1) break;
+        for (int b = 0; b < f->blockCount; b++) {
+            if (index[b] != IR_NONE) continue;
+            for (int s = 0; s < 2; s++) {
+                int target = f->blocks[b].succ[s];
+                if (target != IR_NONE && index[target] != IR_NONE) irRemoveEdge(f, b, target);
+            }
+            for (int i = f->blocks[b].first; i != IR_NONE; i = f->code[i].next) {
+                if (f->code[i].op != IR_NOP) {
+                    f->code[i].op = IR_NOP;
+                    changed++;
+                }
+                f->code[i].block = IR_NONE;
+            }
+        }
+        for (int b = 0; b < f->blockCount; b++) {
+            while (f->blocks[b].last != IR_NONE && f->code[f->blocks[b].last].op == IR_JUMP) {
+                int next = f->blocks[b].succ[0];
+                if (next == b || next == 0 || f->blocks[next].pred[1] != IR_NONE) break;
+                irMergeBlock(f, b, next);
+                changed++;
+            }
+        }
+        count = irReversePostorder(f, order);
+    }
+    if (count < 0) {
+        free(order);
+        free(index);
+        free(blocks);
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        IrBlock *block = &blocks[i];
+        *block = f->blocks[order[i]];
+        for (int s = 0; s < 2; s++) {
+            if (block->succ[s] != IR_NONE) block->succ[s] = index[block->succ[s]];
+            if (block->pred[s] != IR_NONE) block->pred[s] = index[block->pred[s]];
+        }
+        for (int j = block->first; j != IR_NONE; j = f->code[j].next) {
+            f->code[j].block = i;
+        }
+    }
+    free(f->blocks);
+    f->blocks = blocks;
+    f->blockCount = f->blockCapacity = count;
+    free(order);
+    free(index);
+    return changed;
+}
+
+static const IrPass irPipeline[] = {
+    {"sccp", irPropagateConstants},
+    {"phis", irSimplifyPhis},
+    {"dce", irRemoveDeadCode},
+    {"cfg", irSimplifyCfg},
+};
+
+#define IR_PIPELINE_LENGTH ((int)(sizeof(irPipeline) / sizeof(irPipeline[0])))
+
+// Run 'count' passes in order, each over every function, and record what each
+// did in runs[]. Returns 0, or -1 if memory ran out.
+static int runIrPasses(IrProgram *p, const IrPass *passes, int count, IrPassRun *runs) {
+    for (int i = 0; i < count; i++) {
+        struct timespec start, stop;
+        IrPassRun *run = &runs[i];
+        run->name = passes[i].name;
+        run->changed = 0;
+        run->before = irInstructionCount(p);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int j = 0; j < p->count; j++) {
+            int changed = passes[i].run(p, &p->functions[j]);
+            if (changed < 0) {
+                return -1;
+            }
+            run->changed += changed;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        run->seconds = (double)(stop.tv_sec - start.tv_sec) + (double)(stop.tv_nsec - start.tv_nsec) / 1e9;
+        run->after = irInstructionCount(p);
+    }
+    return 0;
+}
+
+#endif
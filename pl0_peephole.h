@@ -0,0 +1,148 @@
+/*
+Peephole pass fusing common p-code sequences into superinstructions.
+
+The sequences are the most frequent ones dispatched on benchmarks/, as counted
+by opcode_stats.c (before fusion, share of all dispatches):
+
+  LOD0 LIT ADD STO0   x := x + k, 3.1%          -> INC
+  ... JMP LOD0 LOD0 LEQ JPC   step of a FOR loop -> FOR
+  LOD0 LOD0 <rel> JPC, LOD0 LIT <rel> JPC       -> JRL, JRK
+  <rel> JPC   (EQL JPC alone 2.9%)              -> JR
+  LIT ADD 5.0%, LIT MOD 4.3%, LIT SUB 2.2%      -> ADK, MDK, ADK (k negated)
+  LOD0 CHK LDX0   a[i], 1.1%                    -> LXL
+  LIT LDX0    a[k], which needs no CHK          -> LXK
+
+and, counted again once those were fused, the most frequent that were left:
+
+  LOD0 LOD0   13.3%                             -> LL
+  LOD0 LIT ADD, LOD0 LIT SUB   7.1%             -> LAK
+
+The pass works in place. A fused sequence keeps its length and its
+instructions; only the first one's opcode changes, to a superinstruction that
+does the work of all of them and then carries on after the last. The
+instructions it covers stay where they were and hold its operands, so no code
+address changes and no jump needs retargeting. A sequence is only fused if no
+jump lands inside it.
+*/
+
+#ifndef PL0_PEEPHOLE_H
+#define PL0_PEEPHOLE_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include "pl0_codegen.h"
+
+static bool isLocalAccess(const Instruction *in, Opcode op) {
+    return in->op == op && in->level == 0;
+}
+
+static bool isRelation(const Instruction *in) {
+    return in->op >= OP_EQL && in->op <= OP_GEQ;
+}
+
+// The next 'length' instructions from 'at' exist and no jump lands after the first.
+static bool fusable(const Code *code, const bool *target, int at, int length) {
+    if (at + length > code->count) {
+        return false;
+    }
+    for (int i = at + 1; i < at + length; i++) {
+        if (target[i]) return false;
+    }
+    return true;
+}
+
+// x := x + k or x := x - k, as LOD 0 x; LIT k; ADD; STO 0 x with the sign
+// folded into k.
+static bool matchIncrement(Code *code, int at) {
+    Instruction *in = &code->code[at];
+    if (!isLocalAccess(&in[0], OP_LOD) || in[1].op != OP_LIT || (in[2].op != OP_ADD && in[2].op != OP_SUB) ||
+        !isLocalAccess(&in[3], OP_STO) || in[3].a != in[0].a) {
+        return false;
+    }
+    if (in[2].op == OP_SUB) {
+        in[1].a = foldSign(MINUS, in[1].a);
+        in[2].op = OP_ADD;
+    }
+    return true;
+}
+
+// The test at the top of a FOR loop over the local 'variable' (see genStatement).
+static bool isForTest(const Code *code, int at, int variable) {
+    const Instruction *in = &code->code[at];
+    return at + 4 <= code->count && (isLocalAccess(&in[0], OP_LOD) || (in[0].op == OP_JRL && in[0].level == OP_LEQ)) &&
+           in[0].a == variable && isLocalAccess(&in[1], OP_LOD) && in[2].op == OP_LEQ && in[3].op == OP_JPC;
+}
+
+// Fuse superinstructions into generated code. Returns how many were made, or
+// -1 if memory ran out (the code is left as it was).
+static int fuseSuperinstructions(Code *code) {
+    bool *target = calloc((size_t)code->count + 1, sizeof(bool));
+    if (target == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < code->count; i++) {
+        const Instruction *in = &code->code[i];
+        if (in->op == OP_JMP || in->op == OP_JPC || in->op == OP_CAL) {
+            target[in->a] = true;
+        }
+        if (in->op == OP_CAL) {
+            target[i + 1] = true; // The return address
+        }
+    }
+
+    int fused = 0;
+    for (int i = 0; i < code->count; ) {
+        Instruction *in = &code->code[i];
+        Opcode op = (Opcode)in->op;
+        int level = in->level;
+        if (fusable(code, target, i, 5) && matchIncrement(code, i) && in[4].op == OP_JMP &&
+            isForTest(code, in[4].a, in->a)) {
+            op = OP_FOR;
+        } else if (fusable(code, target, i, 4) && matchIncrement(code, i)) {
+            op = OP_INC;
+        } else if (fusable(code, target, i, 4) && isLocalAccess(&in[0], OP_LOD) &&
+                   (isLocalAccess(&in[1], OP_LOD) || in[1].op == OP_LIT) && isRelation(&in[2]) && in[3].op == OP_JPC) {
+            op = in[1].op == OP_LIT ? OP_JRK : OP_JRL;
+            level = in[2].op;
+        } else if (fusable(code, target, i, 3) && isLocalAccess(&in[0], OP_LOD) && in[1].op == OP_CHK &&
+                   isLocalAccess(&in[2], OP_LDX)) {
+            op = OP_LXL;
+        } else if (fusable(code, target, i, 3) && isLocalAccess(&in[0], OP_LOD) && in[1].op == OP_LIT &&
+                   (in[2].op == OP_ADD || in[2].op == OP_SUB)) {
+            if (in[2].op == OP_SUB) {
+                in[1].a = foldSign(MINUS, in[1].a);
+                in[2].op = OP_ADD;
+            }
+            op = OP_LAK;
+        } else if (fusable(code, target, i, 2) && isLocalAccess(&in[0], OP_LOD) && isLocalAccess(&in[1], OP_LOD)) {
+            op = OP_LL;
+        } else if (fusable(code, target, i, 2) && isRelation(&in[0]) && in[1].op == OP_JPC) {
+            op = OP_JR;
+            level = in[0].op;
+        } else if (fusable(code, target, i, 2) && in[0].op == OP_LIT) {
+            switch (in[1].op) {
+                case OP_SUB:
+                    in[0].a = foldSign(MINUS, in[0].a);
+                    in[1].op = OP_ADD;
+                    op = OP_ADK;
+                    break;
+                case OP_ADD: op = OP_ADK; break;
+                case OP_MUL: op = OP_MLK; break;
+                case OP_DIV: if (in[0].a != 0) op = OP_DVK; break;
+                case OP_MOD: if (in[0].a != 0) op = OP_MDK; break;
+                case OP_LDX: if (in[1].level == 0) op = OP_LXK; break;
+                default: break;
+            }
+        }
+        if (op != in->op) {
+            in->op = (uint8_t)op;
+            in->level = (uint8_t)level;
+            fused++;
+        }
+        i += instructionLength(in->op);
+    }
+    free(target);
+    return fused;
+}
+
+#endif
@@ -0,0 +1,186 @@
+/*
+Pipelined lexing: a lexer thread feeding the parser through a lock-free
+single-producer/single-consumer token ring.
+
+The producer lexes ahead into a fixed power-of-two ring and the consumer pops
+tokens from it, so lexing overlaps with analysis. Each side works on private
+copies of the two ring indexes and only touches the shared ones once per
+TOKEN_RING_BATCH tokens: the producer publishes 'head' with a release store
+after every batch (and at EOFS), the consumer returns free slots the same way
+through 'tail'. The shared indexes sit on separate cache lines, so in the
+steady state a line changes hands once per batch, not once per token.
+
+The lexer's line index is reserved for the whole input before the thread
+starts, so it is never reallocated while the parser reads from it: the start
+of every line up to the last token received was recorded before that token
+was published.
+*/
+
+#ifndef PL0_PIPELINE_H
+#define PL0_PIPELINE_H
+
+#include "pl0_lexer.h"
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#endif
+
+#define TOKEN_RING_SIZE 4096   // Slots; must be a power of two
+#define TOKEN_RING_BATCH 64    // Tokens per publication; divides TOKEN_RING_SIZE
+#define CACHE_LINE 64
+
+typedef struct {
+    Token *slots;
+    Lexer *lexer;              // Owned by the lexer thread while it runs
+    LineIndex lines;           // The lexer's line index as reserved at start
+    int running;
+#if !defined(_WIN32)
+    pthread_t thread;
+
+    // Producer side
+    _Alignas(CACHE_LINE) _Atomic size_t head;   // Tokens published
+    size_t written;                              // Tokens stored, published or not
+    size_t tailSeen;                             // Last value read from 'tail'
+
+    // Consumer side
+    _Alignas(CACHE_LINE) _Atomic size_t tail;   // Tokens consumed and handed back
+    size_t read;                                 // Tokens popped
+    size_t headSeen;                             // Last value read from 'head'
+
+    _Alignas(CACHE_LINE) _Atomic int stop;      // Set by the consumer to make the producer quit
+#endif
+} TokenPipeline;
+
+#if !defined(_WIN32)
+
+static inline void pipelinePause(int spins) {
+    if (spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    } else {
+        sched_yield();
+    }
+}
+
+static void *pipelineProducer(void *arg) {
+    TokenPipeline *p = arg;
+    size_t published = 0;
+    for (;;) {
+        Token t = lexNext(p->lexer);
+        for (int spins = 0; p->written - p->tailSeen >= TOKEN_RING_SIZE; spins++) {
+            if (published != p->written) {
+                published = p->written;
+                atomic_store_explicit(&p->head, published, memory_order_release);
+            }
+            if (atomic_load_explicit(&p->stop, memory_order_relaxed)) return NULL;
+            p->tailSeen = atomic_load_explicit(&p->tail, memory_order_acquire);
+            if (p->written - p->tailSeen >= TOKEN_RING_SIZE) pipelinePause(spins);
+        }
+        p->slots[p->written++ & (TOKEN_RING_SIZE - 1)] = t;
+        if (t.type == EOFS || p->written - published >= TOKEN_RING_BATCH) {
+            published = p->written;
+            atomic_store_explicit(&p->head, published, memory_order_release);
+            if (atomic_load_explicit(&p->stop, memory_order_relaxed)) return NULL;
+        }
+        if (t.type == EOFS) return NULL;
+    }
+}
+
+#endif
+
+// Start lexing the rest of lx's source on its own thread. Until stopTokenPipeline
+// the Lexer belongs to that thread. Returns 0, or -1 if the pipeline could not be
+// started (the caller then keeps calling lexNext itself).
+static int startTokenPipeline(TokenPipeline *p, Lexer *lx) {
+#if !defined(_WIN32)
+    if (p->slots == NULL) {
+        p->slots = malloc(TOKEN_RING_SIZE * sizeof(Token));
+        if (p->slots == NULL) return -1;
+    }
+
+    // One line start per newline still ahead, so addLineStart never moves the index.
+    if (lx->lines.starts != NULL) {
+        size_t newlines = 0;
+        const char *q = lx->source->cur, *end = lx->source->end;
+        while ((q = memchr(q, '\n', (size_t)(end - q))) != NULL) {
+            newlines++;
+            q++;
+        }
+        size_t need = (size_t)lx->lines.count + newlines;
+        if (need > (size_t)lx->lines.capacity) {
+            size_t *grown = need <= (size_t)0x7fffffff ? realloc(lx->lines.starts, need * sizeof(size_t)) : NULL;
+            if (grown == NULL) {
+                freeLineIndex(&lx->lines);
+            } else {
+                lx->lines.starts = grown;
+                lx->lines.capacity = (int)need;
+            }
+        }
+    }
+
+    p->lexer = lx;
+    p->lines = lx->lines;
+    p->written = p->tailSeen = p->read = p->headSeen = 0;
+    atomic_store(&p->head, 0);
+    atomic_store(&p->tail, 0);
+    atomic_store(&p->stop, 0);
+    if (pthread_create(&p->thread, NULL, pipelineProducer, p) != 0) return -1;
+    p->running = 1;
+    return 0;
+#else
+    (void)p;
+    (void)lx;
+    return -1;
+#endif
+}
+
+// Next token from the ring, waiting for the lexer thread if it is behind.
+// Once EOFS has been popped it is returned again on every call.
+static inline Token tokenPipelineNext(TokenPipeline *p) {
+#if !defined(_WIN32)
+    if (p->read == p->headSeen) {
+        atomic_store_explicit(&p->tail, p->read, memory_order_release);
+        for (int spins = 0; (p->headSeen = atomic_load_explicit(&p->head, memory_order_acquire)) == p->read; spins++) {
+            pipelinePause(spins);
+        }
+    }
+    Token t = p->slots[p->read & (TOKEN_RING_SIZE - 1)];
+    if (t.type != EOFS && (++p->read & (TOKEN_RING_BATCH - 1)) == 0) {
+        atomic_store_explicit(&p->tail, p->read, memory_order_release);
+    }
+    return t;
+#else
+    return lexNext(p->lexer);
+#endif
+}
+
+// Line index the consumer may read while the lexer thread runs, covering every
+// line up to 'line' (the line of a token it has received).
+static inline LineIndex tokenPipelineLines(const TokenPipeline *p, int line) {
+    LineIndex view = p->lines;
+    if (view.starts != NULL && line <= view.capacity) view.count = line;
+    return view;
+}
+
+// Stop the lexer thread, whether or not it has reached the end, and hand the Lexer back.
+static void stopTokenPipeline(TokenPipeline *p) {
+#if !defined(_WIN32)
+    if (!p->running) return;
+    atomic_store_explicit(&p->stop, 1, memory_order_relaxed);
+    pthread_join(p->thread, NULL);
+    p->running = 0;
+#else
+    (void)p;
+#endif
+}
+
+static void freeTokenPipeline(TokenPipeline *p) {
+    stopTokenPipeline(p);
+    free(p->slots);
+    p->slots = NULL;
+}
+
+#endif
@@ -0,0 +1,633 @@
+/*
+Register code: a three-address alternative to the p-code of pl0_codegen.h.
+
+An instruction names its operands as registers, and a register is a cell of the
+current frame: register r is frame cell r, laid out exactly as for the stack
+machine (FRAME_HEADER link cells, then the variables at Symbol.address, so the
+parameters are the registers just below 0). An expression needs no operand
+stack: a local variable is already a register, and each intermediate result
+gets a temporary register past the block's variables, reused as soon as the
+result is consumed. So 'x := y + z * 2' is two instructions, MULK t, z, 2 and
+ADD x, y, t, instead of the stack machine's seven.
+
+Only variables of the current frame are registers. Those of enclosing blocks
+are copied in and out with LDU and STU, a VAR parameter is dereferenced with
+LDI and STI, and an array of an enclosing block is indexed through its stack
+address (ADR, then LDXI or STXI).
+
+A call evaluates its arguments into consecutive temporaries at the top of the
+caller's frame and starts the callee's frame right above them, so they become
+its parameters without being copied. Every jump keeps its target in operand c,
+and conditions compile to compare-and-branch instructions: a WHILE or FOR loop
+tests at the bottom, one dispatch per iteration.
+*/
+
+#ifndef PL0_REGCODE_H
+#define PL0_REGCODE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pl0_codegen.h"
+
+typedef enum {
+    R_LDK,      // a := constant b
+    R_MOV,      // a := b
+    R_LDU,      // a := cell b of the frame c static levels up
+    R_STU,      // cell b of the frame c static levels up := a
+    R_ADR,      // a := stack address of cell b of the frame c static levels up
+    R_LDI,      // a := the cell at the stack address in b
+    R_STI,      // the cell at the stack address in b := a
+    R_LDX,      // a := element c of the array at b, stopping unless 0 <= c < d
+    R_STX,      // element c of the array at b := a, checked the same way
+    R_LDXI,     // a := element c of the array at the stack address in b, checked against d
+    R_STXI,     // element c of the array at the stack address in b := a, checked the same way
+    R_CHK,      // stop with an error unless 0 <= a < b
+    R_NEG,      // a := -b
+    R_ADD,      // a := b + c
+    R_SUB,
+    R_MUL,
+    R_DIV,      // stops with an error on a zero divisor, as does R_MOD
+    R_MOD,
+    R_ADDK,     // a := b + constant c
+    R_MULK,
+    R_DIVK,     // the constant is never 0, as for R_MODK
+    R_MODK,
+    R_JEQ,      // jump to c if a = b
+    R_JNE,
+    R_JLT,
+    R_JLE,
+    R_JGT,
+    R_JGE,
+    R_JEQK,     // jump to c if a = constant b
+    R_JNEK,
+    R_JLTK,
+    R_JLEK,
+    R_JGTK,
+    R_JGEK,
+    R_JODD,     // jump to c if a is odd
+    R_JEVEN,    // jump to c if a is even
+    R_JMP,      // jump to c
+    R_ENT,      // enter a block whose frame takes a cells
+    R_CAL,      // call the procedure at c with its frame at cell a, static link b levels up
+    R_RET,
+    R_RED,      // read an integer into a
+    R_RDL,      // read an integer into a and skip the rest of its line
+    R_WRT,      // write a
+    R_WRL,      // write a and a newline
+    R_HLT,
+    REG_OPCODE_COUNT
+} RegOpcode;
+
+static const char *const regOpcodeNames[REG_OPCODE_COUNT] = {
+    "LDK", "MOV", "LDU", "STU", "ADR", "LDI", "STI", "LDX", "STX", "LDXI", "STXI", "CHK",
+    "NEG", "ADD", "SUB", "MUL", "DIV", "MOD", "ADDK", "MULK", "DIVK", "MODK",
+    "JEQ", "JNE", "JLT", "JLE", "JGT", "JGE", "JEQK", "JNEK", "JLTK", "JLEK", "JGTK", "JGEK",
+    "JODD", "JEVEN", "JMP", "ENT", "CAL", "RET", "RED", "RDL", "WRT", "WRL", "HLT"
+};
+
+typedef struct {
+    uint8_t op;         // RegOpcode
+    uint8_t reserved[3];
+    int32_t a, b, c, d; // Registers, constants, offsets, levels or a code address, see RegOpcode
+} RegInstruction;
+
+typedef struct {
+    RegInstruction *code;
+    int32_t *lines;     // Source line of each instruction, for runtime errors
+    int count;
+    int capacity;
+} RegCode;
+
+typedef struct {
+    const Compiler *c;
+    RegCode *code;
+    int *entry;         // Code address of each procedure symbol
+    bool *reference;    // Per symbol: a VAR parameter, which holds an address
+    int level;          // Level of the block being generated
+    int variables;      // Cells of the block's frame taken by links and variables
+    int temporaries;    // Temporary registers in use past the variables
+    int frameSize;      // Cells the block's frame needs so far
+    int line;           // Source line of the construct being generated
+    bool outOfMemory;
+} RegGen;
+
+// Where a scalar lives: a register of the current frame, a cell of an enclosing
+// block's frame, or the cell a VAR parameter points to.
+typedef struct {
+    int level;          // Static level difference of the frame holding it
+    int address;        // Offset in that frame
+    bool reference;     // That cell holds the variable's stack address
+} RegPlace;
+
+static inline void freeRegCode(RegCode *code) {
+    free(code->code);
+    free(code->lines);
+    memset(code, 0, sizeof(*code));
+}
+
+// Append an instruction and return its address.
+static int emitReg(RegGen *g, RegOpcode op, int a, int b, int c, int d) {
+    RegCode *code = g->code;
+    if (code->count == code->capacity) {
+        int capacity = code->capacity ? code->capacity * 2 : 1024;
+        RegInstruction *grown = realloc(code->code, (size_t)capacity * sizeof(RegInstruction));
+        if (grown != NULL) code->code = grown;
+        int32_t *grownLines = grown != NULL ? realloc(code->lines, (size_t)capacity * sizeof(int32_t)) : NULL;
+        if (grownLines != NULL) code->lines = grownLines;
+        if (grownLines == NULL) {
+            // Carry on over the same slots so the walk can finish; the result is discarded.
+            g->outOfMemory = true;
+            code->count = 0;
+            if (code->capacity == 0) return 0;
+        } else {
+            code->capacity = capacity;
+        }
+    }
+    RegInstruction *in = &code->code[code->count];
+    memset(in, 0, sizeof(*in));
+    in->op = (uint8_t)op;
+    in->a = a;
+    in->b = b;
+    in->c = c;
+    in->d = d;
+    code->lines[code->count] = g->line;
+    return code->count++;
+}
+
+// Point the jump at 'at' to the next instruction.
+static void patchRegHere(RegGen *g, int at) {
+    if (!g->outOfMemory) {
+        g->code->code[at].c = g->code->count;
+    }
+}
+
+static const AstNode *regNode(const RegGen *g, int node) {
+    return &g->c->ast.nodes[node];
+}
+
+static bool regConstant(const RegGen *g, int node, int *value) {
+    return constantValue(g->c, node, value);
+}
+
+static int newTemporary(RegGen *g) {
+    int r = g->variables + g->temporaries++;
+    if (r + 1 > g->frameSize) {
+        g->frameSize = r + 1;
+    }
+    return r;
+}
+
+static int arraySizeOf(const RegGen *g, int symbol) {
+    return g->c->arrayInfo[g->c->symbolTable[symbol].info].size;
+}
+
+static RegPlace scalarPlace(const RegGen *g, int symbol, int offset) {
+    RegPlace place;
+    place.level = g->level - g->c->symbolTable[symbol].level;
+    place.address = g->c->symbolTable[symbol].address + offset;
+    place.reference = g->reference[symbol];
+    return place;
+}
+
+// Where an element with a constant index lives, if the index is inside the
+// array, so it is accessed like a scalar.
+static bool constantElement(const RegGen *g, const AstNode *n, RegPlace *place) {
+    int value;
+    if (!regConstant(g, n->b, &value) || value < 0 || value >= arraySizeOf(g, n->a)) {
+        return false;
+    }
+    *place = scalarPlace(g, n->a, value);
+    return true;
+}
+
+// Register holding the value at 'place', loading it into 'target' (or a new
+// temporary if 'target' is negative) unless it is a register already.
+static int loadPlace(RegGen *g, RegPlace place, int target) {
+    if (place.level == 0 && !place.reference) {
+        return place.address;
+    }
+    if (target < 0) target = newTemporary(g);
+    if (place.level == 0) {
+        emitReg(g, R_LDI, target, place.address, 0, 0);
+    } else {
+        emitReg(g, R_LDU, target, place.address, place.level, 0);
+        if (place.reference) emitReg(g, R_LDI, target, target, 0, 0);
+    }
+    return target;
+}
+
+// Store register 'value' at 'place'.
+static void storePlace(RegGen *g, RegPlace place, int value) {
+    if (place.level == 0 && !place.reference) {
+        if (value != place.address) emitReg(g, R_MOV, place.address, value, 0, 0);
+    } else if (place.level == 0) {
+        emitReg(g, R_STI, value, place.address, 0, 0);
+    } else if (!place.reference) {
+        emitReg(g, R_STU, value, place.address, place.level, 0);
+    } else {
+        int address = newTemporary(g);
+        emitReg(g, R_LDU, address, place.address, place.level, 0);
+        emitReg(g, R_STI, value, address, 0, 0);
+        g->temporaries--;
+    }
+}
+
+static int regExpression(RegGen *g, int node, int target);
+
+// Register holding an array index, which the instruction using it checks.
+static int regIndex(RegGen *g, int index) {
+    return regExpression(g, index, -1);
+}
+
+static RegOpcode arithmeticOpcode(TokenType op, bool constant) {
+    switch (op) {
+        case PLUS:  return constant ? R_ADDK : R_ADD;
+        case MINUS: return R_SUB;
+        case TIMES: return constant ? R_MULK : R_MUL;
+        case SLASH: return constant ? R_DIVK : R_DIV;
+        default:    return constant ? R_MODK : R_MOD;
+    }
+}
+
+// Evaluate an expression. The result is left in 'target', or if 'target' is
+// negative in whatever register holds it: the variable itself, or a new
+// temporary past those in use. Only the last instruction writes 'target'.
+static int regExpression(RegGen *g, int node, int target) {
+    const AstNode *n = regNode(g, node);
+    int value, mark = g->temporaries;
+    RegPlace place;
+    if (regConstant(g, node, &value)) {
+        if (target < 0) target = newTemporary(g);
+        emitReg(g, R_LDK, target, value, 0, 0);
+        return target;
+    }
+    switch (n->kind) {
+        case AST_VARIABLE:
+            return loadPlace(g, scalarPlace(g, n->a, 0), target);
+        case AST_ELEMENT: {
+            if (constantElement(g, n, &place)) {
+                return loadPlace(g, place, target);
+            }
+            RegPlace array = scalarPlace(g, n->a, 0);
+            int index = regIndex(g, n->b), address = 0;
+            if (array.level > 0) {
+                address = newTemporary(g);
+                emitReg(g, R_ADR, address, array.address, array.level, 0);
+            }
+            g->temporaries = mark;
+            if (target < 0) target = newTemporary(g);
+            if (array.level > 0) {
+                emitReg(g, R_LDXI, target, address, index, arraySizeOf(g, n->a));
+            } else {
+                emitReg(g, R_LDX, target, array.address, index, arraySizeOf(g, n->a));
+            }
+            return target;
+        }
+        case AST_NEGATE: {
+            int operand = regExpression(g, n->a, -1);
+            g->temporaries = mark;
+            if (target < 0) target = newTemporary(g);
+            emitReg(g, R_NEG, target, operand, 0, 0);
+            return target;
+        }
+        case AST_BINARY: {
+            TokenType op = (TokenType)n->op;
+            int left, right, constant;
+            bool commutes = op == PLUS || op == TIMES;
+            if (regConstant(g, n->b, &constant) && !(constant == 0 && (op == SLASH || op == PERCENT))) {
+                left = regExpression(g, n->a, -1);
+                if (op == MINUS) {
+                    op = PLUS;
+                    constant = foldSign(MINUS, constant);
+                }
+            } else if (commutes && regConstant(g, n->a, &constant)) {
+                left = regExpression(g, n->b, -1);
+            } else {
+                left = regExpression(g, n->a, -1);
+                right = regExpression(g, n->b, -1);
+                g->temporaries = mark;
+                if (target < 0) target = newTemporary(g);
+                emitReg(g, arithmeticOpcode(op, false), target, left, right, 0);
+                return target;
+            }
+            g->temporaries = mark;
+            if (target < 0) target = newTemporary(g);
+            emitReg(g, arithmeticOpcode(op, true), target, left, constant, 0);
+            return target;
+        }
+        default:
+            // Conditions are only compiled as jumps (see regCondition).
+            return target < 0 ? newTemporary(g) : target;
+    }
+}
+
+// Evaluate into 'target' exactly.
+static void regExpressionInto(RegGen *g, int node, int target) {
+    int r = regExpression(g, node, target);
+    if (r != target) {
+        emitReg(g, R_MOV, target, r, 0, 0);
+    }
+}
+
+static RegOpcode relationOpcode(TokenType op, bool negate) {
+    if (negate) {
+        switch (op) {
+            case EQU: op = NEQ; break;
+            case NEQ: op = EQU; break;
+            case LSS: op = GEQ; break;
+            case LEQ: op = GTR; break;
+            case GTR: op = LEQ; break;
+            default:  op = LSS; break;
+        }
+    }
+    switch (op) {
+        case EQU: return R_JEQ;
+        case NEQ: return R_JNE;
+        case LSS: return R_JLT;
+        case LEQ: return R_JLE;
+        case GTR: return R_JGT;
+        default:  return R_JGE;
+    }
+}
+
+// The same relation with its operands swapped: k < x is x > k.
+static TokenType swappedRelation(TokenType op) {
+    switch (op) {
+        case LSS: return GTR;
+        case LEQ: return GEQ;
+        case GTR: return LSS;
+        case GEQ: return LEQ;
+        default:  return op;
+    }
+}
+
+// Jump if the condition is 'sense'. Returns the jump to patch.
+static int regCondition(RegGen *g, int node, bool sense) {
+    const AstNode *n = regNode(g, node);
+    int mark = g->temporaries, jump, constant;
+    if (n->kind == AST_ODD) {
+        int operand = regExpression(g, n->a, -1);
+        jump = emitReg(g, sense ? R_JODD : R_JEVEN, operand, 0, 0, 0);
+    } else {
+        TokenType op = (TokenType)n->op;
+        int variable = n->a;
+        bool withConstant = regConstant(g, n->b, &constant);
+        if (!withConstant && regConstant(g, n->a, &constant)) {
+            withConstant = true;
+            variable = n->b;
+            op = swappedRelation(op);
+        }
+        if (withConstant) {
+            int left = regExpression(g, variable, -1);
+            jump = emitReg(g, (RegOpcode)(relationOpcode(op, !sense) + (R_JEQK - R_JEQ)), left, constant, 0, 0);
+        } else {
+            int left = regExpression(g, n->a, -1);
+            int right = regExpression(g, n->b, -1);
+            jump = emitReg(g, relationOpcode(op, !sense), left, right, 0, 0);
+        }
+    }
+    g->temporaries = mark;
+    return jump;
+}
+
+// Store into a variable, or an array element if 'index' is not AST_NONE. The value
+// is the expression 'value', or else what the instruction 'produce' reads.
+static void regStore(RegGen *g, int symbol, int index, int value, RegOpcode produce) {
+    int mark = g->temporaries;
+    RegPlace place;
+    const AstNode element = {AST_ELEMENT, 0, 0, 0, symbol, index, AST_NONE, AST_NONE};
+    bool scalar = index == AST_NONE || constantElement(g, &element, &place);
+    if (index == AST_NONE) {
+        place = scalarPlace(g, symbol, 0);
+    }
+    if (scalar) {
+        int r;
+        if (value != AST_NONE) {
+            r = regExpression(g, value, place.level == 0 && !place.reference ? place.address : -1);
+        } else {
+            r = place.level == 0 && !place.reference ? place.address : newTemporary(g);
+            emitReg(g, produce, r, 0, 0, 0);
+        }
+        storePlace(g, place, r);
+        g->temporaries = mark;
+        return;
+    }
+
+    // The stack machine checks the index before evaluating the value, so the
+    // check moves ahead of a value that could fail too.
+    RegPlace array = scalarPlace(g, symbol, 0);
+    int size = arraySizeOf(g, symbol), address = 0, r;
+    int i = regIndex(g, index);
+    if (value == AST_NONE || exprMayFail(g->c, value)) {
+        emitReg(g, R_CHK, i, size, 0, 0);
+    }
+    if (array.level > 0) {
+        address = newTemporary(g);
+        emitReg(g, R_ADR, address, array.address, array.level, 0);
+    }
+    if (value != AST_NONE) {
+        r = regExpression(g, value, -1);
+    } else {
+        r = newTemporary(g);
+        emitReg(g, produce, r, 0, 0, 0);
+    }
+    if (array.level > 0) {
+        emitReg(g, R_STXI, r, address, i, size);
+    } else {
+        emitReg(g, R_STX, r, array.address, i, size);
+    }
+    g->temporaries = mark;
+}
+
+// Put the stack address of a variable or array element, for a VAR argument, into 'target'.
+static void regAddress(RegGen *g, int node, int target) {
+    const AstNode *n = regNode(g, node);
+    RegPlace place;
+    if (n->kind == AST_VARIABLE || constantElement(g, n, &place)) {
+        if (n->kind == AST_VARIABLE) place = scalarPlace(g, n->a, 0);
+        if (!place.reference) {
+            emitReg(g, R_ADR, target, place.address, place.level, 0);
+        } else if (place.level == 0) {
+            emitReg(g, R_MOV, target, place.address, 0, 0);
+        } else {
+            emitReg(g, R_LDU, target, place.address, place.level, 0);
+        }
+        return;
+    }
+    int mark = g->temporaries;
+    place = scalarPlace(g, n->a, 0);
+    emitReg(g, R_ADR, target, place.address, place.level, 0);
+    int i = regIndex(g, n->b);
+    emitReg(g, R_CHK, i, arraySizeOf(g, n->a), 0, 0);
+    emitReg(g, R_ADD, target, target, i, 0);
+    g->temporaries = mark;
+}
+
+static void regCall(RegGen *g, const AstNode *n) {
+    int argument = n->b, mark = g->temporaries;
+    if (n->a < BUILTIN_COUNT) {
+        const AstNode *arg = regNode(g, argument);
+        switch ((Builtin)n->a) {
+            case BUILTIN_READ: case BUILTIN_READLN:
+                regStore(g, arg->a, arg->kind == AST_ELEMENT ? arg->b : AST_NONE, AST_NONE,
+                         n->a == BUILTIN_READ ? R_RED : R_RDL);
+                break;
+            case BUILTIN_WRITE: case BUILTIN_WRITELN:
+                emitReg(g, n->a == BUILTIN_WRITE ? R_WRT : R_WRL, regExpression(g, argument, -1), 0, 0, 0);
+                break;
+            default:
+                break;
+        }
+        g->temporaries = mark;
+        return;
+    }
+    const ProcInfo *proc = &g->c->procInfo[g->c->symbolTable[n->a].info];
+    int first = g->variables + g->temporaries;
+    for (int i = 0; argument != AST_NONE; argument = regNode(g, argument)->next, i++) {
+        int slot = newTemporary(g);
+        if (proc->varParams >> i & 1) {
+            regAddress(g, argument, slot);
+        } else {
+            regExpressionInto(g, argument, slot);
+        }
+    }
+    // The symbol, replaced by its entry once all code is out
+    emitReg(g, R_CAL, first + proc->numParams, g->level - g->c->symbolTable[n->a].level, n->a, 0);
+    g->temporaries = mark;
+}
+
+static void regStatement(RegGen *g, int node) {
+    if (node == AST_NONE) {
+        return;
+    }
+    const AstNode *n = regNode(g, node);
+    int jump, loop, limit = 0, mark = g->temporaries, constant;
+    g->line = n->line;
+    switch (n->kind) {
+        case AST_ASSIGN:
+            regStore(g, n->a, n->b, n->c, R_HLT);
+            break;
+        case AST_CALL:
+            regCall(g, n);
+            break;
+        case AST_BEGIN:
+            for (int s = n->a; s != AST_NONE; s = regNode(g, s)->next) {
+                regStatement(g, s);
+            }
+            break;
+        case AST_IF:
+            jump = regCondition(g, n->a, false);
+            regStatement(g, n->b);
+            if (n->c != AST_NONE) {
+                int skipElse = emitReg(g, R_JMP, 0, 0, 0, 0);
+                patchRegHere(g, jump);
+                regStatement(g, n->c);
+                jump = skipElse;
+            }
+            patchRegHere(g, jump);
+            break;
+        case AST_WHILE:
+            jump = emitReg(g, R_JMP, 0, 0, 0, 0);
+            loop = g->code->count;
+            regStatement(g, n->b);
+            g->line = n->line;
+            patchRegHere(g, jump);
+            jump = regCondition(g, n->a, true);
+            if (!g->outOfMemory) g->code->code[jump].c = loop;
+            break;
+        case AST_FOR: {
+            // FOR v := start TO limit DO body, with a limit that is not constant
+            // evaluated once into a temporary: v := start; if v <= limit, repeat
+            // body; v := v + 1 until v > limit.
+            RegPlace v = scalarPlace(g, n->a, 0);
+            int end = regNode(g, n->b)->next;
+            bool constantLimit = regConstant(g, end, &constant);
+            regStore(g, n->a, AST_NONE, n->b, R_HLT);
+            if (!constantLimit) {
+                limit = newTemporary(g);
+                regExpressionInto(g, end, limit);
+            }
+            int counter = v.level == 0 && !v.reference ? v.address : newTemporary(g);
+            int r = loadPlace(g, v, counter);
+            jump = constantLimit ? emitReg(g, R_JGTK, r, constant, 0, 0) : emitReg(g, R_JGT, r, limit, 0, 0);
+            loop = g->code->count;
+            regStatement(g, n->c);
+            g->line = n->line;
+            r = loadPlace(g, v, counter);
+            emitReg(g, R_ADDK, r, r, 1, 0);
+            storePlace(g, v, r);
+            int back = constantLimit ? emitReg(g, R_JLEK, r, constant, 0, 0) : emitReg(g, R_JLE, r, limit, 0, 0);
+            if (!g->outOfMemory) g->code->code[back].c = loop;
+            patchRegHere(g, jump);
+            break;
+        }
+        default:
+            break;
+    }
+    g->temporaries = mark;
+}
+
+// Generate the procedures declared by a block, then its body, whose frame has
+// 'variables' cells at level 'level'. Returns the body's entry address.
+static int regBlock(RegGen *g, int block, int variables, int level) {
+    const AstNode *n = regNode(g, block);
+    for (int p = n->a; p != AST_NONE; p = regNode(g, p)->next) {
+        const AstNode *proc = regNode(g, p);
+        int symbol = proc->a;
+        g->entry[symbol] = regBlock(g, proc->b, proc->c, g->c->symbolTable[symbol].level + 1);
+        g->line = proc->line;
+        emitReg(g, R_RET, 0, 0, 0, 0);
+    }
+    g->level = level;
+    g->variables = g->frameSize = variables;
+    g->temporaries = 0;
+    g->line = n->line;
+    int entry = emitReg(g, R_ENT, 0, 0, 0, 0);
+    regStatement(g, n->b);
+    if (!g->outOfMemory) {
+        g->code->code[entry].a = g->frameSize;
+    }
+    return entry;
+}
+
+// Generate the register code of a program analyzed without errors into 'code',
+// replacing what it held. Returns 0, or -1 if memory ran out.
+static int generateRegCode(const Compiler *c, RegCode *code) {
+    RegGen g;
+    memset(&g, 0, sizeof(g));
+    g.c = c;
+    g.code = code;
+    code->count = 0;
+    g.entry = calloc((size_t)c->symbolCount + 1, sizeof(int));
+    g.reference = calloc((size_t)c->symbolCount + 1, sizeof(bool));
+    if (g.entry == NULL || g.reference == NULL || c->ast.root == AST_NONE) {
+        free(g.entry);
+        free(g.reference);
+        return -1;
+    }
+    markReferenceParameters(c, g.reference);
+
+    const AstNode *program = regNode(&g, c->ast.root);
+    g.line = program->line;
+    int start = emitReg(&g, R_JMP, 0, 0, 0, 0);
+    int entry = regBlock(&g, program->a, program->b, 0);
+    emitReg(&g, R_HLT, 0, 0, 0, 0);
+    if (!g.outOfMemory) {
+        code->code[start].c = entry;
+        for (int i = 0; i < code->count; i++) {
+            if (code->code[i].op == R_CAL) {
+                code->code[i].c = g.entry[code->code[i].c];
+            }
+        }
+    }
+    free(g.entry);
+    free(g.reference);
+    if (g.outOfMemory) {
+        code->count = 0;
+        return -1;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,321 @@
+/*
+Virtual machine for the register code of pl0_regcode.h.
+
+Dispatch is the same as in pl0_vm.h (direct threading with computed goto, or a
+switch loop with PL0_VM_SWITCH), and so are the stack layout, the links of a
+frame and the way executed instructions are counted; the reading of integers is
+shared with it. What differs is that there is no operand stack: every operand
+is a cell at a fixed offset from the frame base 'bp', so an instruction does
+all its work in one dispatch and nothing is pushed or popped.
+
+A frame is entered with its cells cleared, and the stack is checked once per
+call, for the callee's frame and the links of the next call above it.
+*/
+
+#ifndef PL0_REGVM_H
+#define PL0_REGVM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pl0_regcode.h"
+#include "pl0_vm.h"
+
+typedef struct {
+#if PL0_VM_THREADED
+    const void *handler;
+#else
+    int op;
+#endif
+    int32_t a, b, c, d;
+} RegVMInstruction;
+
+typedef struct {
+    int32_t *stack;
+    size_t stackCells;
+    RegVMInstruction *threaded; // Translated code of the last run
+    int32_t *runCount;          // Per instruction: its position in its straight-line run, from 1
+    int threadedCapacity;
+    FILE *input;
+    FILE *output;
+    uint64_t executed;          // Instructions executed by the last run
+    const char *error;          // Runtime error that stopped the last run, NULL if none
+    int errorLine;              // Source line of that error
+} RegVM;
+
+static int initRegVM(RegVM *vm, size_t stackCells, FILE *input, FILE *output) {
+    memset(vm, 0, sizeof(*vm));
+    vm->stack = malloc(stackCells * sizeof(int32_t));
+    if (vm->stack == NULL) {
+        return -1;
+    }
+    vm->stackCells = stackCells;
+    vm->input = input;
+    vm->output = output;
+    return 0;
+}
+
+static void freeRegVM(RegVM *vm) {
+    free(vm->stack);
+    free(vm->threaded);
+    free(vm->runCount);
+    memset(vm, 0, sizeof(*vm));
+}
+
+static bool isRegControl(int op) {
+    return (op >= R_JEQ && op <= R_JMP) || op == R_CAL || op == R_RET || op == R_HLT;
+}
+
+// Translate 'code' into vm->threaded. 'handlers' maps each opcode to its label
+// (threaded dispatch) and is NULL for the switch loop.
+static int regVMTranslate(RegVM *vm, const RegCode *code, const void *const *handlers) {
+    if (code->count > vm->threadedCapacity) {
+        RegVMInstruction *grown = realloc(vm->threaded, (size_t)code->count * sizeof(RegVMInstruction));
+        if (grown == NULL) {
+            return -1;
+        }
+        vm->threaded = grown;
+        int32_t *grownCounts = realloc(vm->runCount, (size_t)code->count * sizeof(int32_t));
+        if (grownCounts == NULL) {
+            return -1;
+        }
+        vm->runCount = grownCounts;
+        vm->threadedCapacity = code->count;
+    }
+    int32_t run = 0;
+    for (int i = 0; i < code->count; i++) {
+        const RegInstruction *in = &code->code[i];
+        vm->runCount[i] = ++run;
+        if (isRegControl(in->op)) {
+            run = 0;
+        }
+#if PL0_VM_THREADED
+        vm->threaded[i].handler = handlers[in->op];
+#else
+        (void)handlers;
+        vm->threaded[i].op = in->op;
+#endif
+        vm->threaded[i].a = in->a;
+        vm->threaded[i].b = in->b;
+        vm->threaded[i].c = in->c;
+        vm->threaded[i].d = in->d;
+    }
+    return 0;
+}
+
+// Run register code to its HLT. Returns 0, or -1 after a runtime error
+// (vm->error and vm->errorLine say which) or if memory ran out.
+static int runRegVM(RegVM *vm, const RegCode *code) {
+#if PL0_VM_THREADED
+    static const void *const handlers[REG_OPCODE_COUNT] = {
+        [R_LDK] = &&do_R_LDK, [R_MOV] = &&do_R_MOV, [R_LDU] = &&do_R_LDU, [R_STU] = &&do_R_STU,
+        [R_ADR] = &&do_R_ADR, [R_LDI] = &&do_R_LDI, [R_STI] = &&do_R_STI, [R_LDX] = &&do_R_LDX,
+        [R_STX] = &&do_R_STX, [R_LDXI] = &&do_R_LDXI, [R_STXI] = &&do_R_STXI, [R_CHK] = &&do_R_CHK,
+        [R_NEG] = &&do_R_NEG, [R_ADD] = &&do_R_ADD, [R_SUB] = &&do_R_SUB, [R_MUL] = &&do_R_MUL,
+        [R_DIV] = &&do_R_DIV, [R_MOD] = &&do_R_MOD, [R_ADDK] = &&do_R_ADDK, [R_MULK] = &&do_R_MULK,
+        [R_DIVK] = &&do_R_DIVK, [R_MODK] = &&do_R_MODK, [R_JEQ] = &&do_R_JEQ, [R_JNE] = &&do_R_JNE,
+        [R_JLT] = &&do_R_JLT, [R_JLE] = &&do_R_JLE, [R_JGT] = &&do_R_JGT, [R_JGE] = &&do_R_JGE,
+        [R_JEQK] = &&do_R_JEQK, [R_JNEK] = &&do_R_JNEK, [R_JLTK] = &&do_R_JLTK, [R_JLEK] = &&do_R_JLEK,
+        [R_JGTK] = &&do_R_JGTK, [R_JGEK] = &&do_R_JGEK, [R_JODD] = &&do_R_JODD, [R_JEVEN] = &&do_R_JEVEN,
+        [R_JMP] = &&do_R_JMP, [R_ENT] = &&do_R_ENT, [R_CAL] = &&do_R_CAL, [R_RET] = &&do_R_RET,
+        [R_RED] = &&do_R_RED, [R_RDL] = &&do_R_RDL, [R_WRT] = &&do_R_WRT, [R_WRL] = &&do_R_WRL,
+        [R_HLT] = &&do_R_HLT
+    };
+#define CASE(name) do_##name:
+#define DISPATCH() goto *pc->handler
+#else
+    static const void *const *const handlers = NULL;
+#define CASE(name) case name:
+#define DISPATCH() goto dispatch
+#endif
+#define NEXT() do { pc++; DISPATCH(); } while (0)
+#define COUNT_RUN() (executed += (uint64_t)runCount[pc - base])
+#define JUMP(target) do { pc = base + (target); executed -= (uint64_t)runCount[pc - base] - 1; DISPATCH(); } while (0)
+#define BRANCH(condition) do { COUNT_RUN(); if (condition) JUMP(pc->c); NEXT(); } while (0)
+#define VM_ERROR(msg) do { vm->error = (msg); goto fail; } while (0)
+#define R(field) bp[pc->field]
+
+    vm->error = NULL;
+    vm->executed = 0;
+    if (code->count == 0 || regVMTranslate(vm, code, handlers) != 0) {
+        vm->error = "Out of memory";
+        vm->errorLine = 0;
+        return -1;
+    }
+
+    const RegVMInstruction *const base = vm->threaded;
+    const RegVMInstruction *pc = base;
+    const int32_t *const runCount = vm->runCount;
+    int32_t *const stack = vm->stack;
+    int32_t *bp = stack;        // Base of the current frame
+    uint64_t executed = 0;
+
+    bp[0] = bp[1] = bp[2] = 0; // The main program's links
+
+#if PL0_VM_THREADED
+    goto *pc->handler;
+#else
+dispatch:
+    switch (pc->op) {
+#endif
+
+    CASE(R_LDK)
+        R(a) = pc->b;
+        NEXT();
+    CASE(R_MOV)
+        R(a) = R(b);
+        NEXT();
+    CASE(R_LDU) {
+        int32_t *frame = bp;
+        for (int l = pc->c; l > 0; l--) frame = stack + frame[0];
+        R(a) = frame[pc->b];
+        NEXT();
+    }
+    CASE(R_STU) {
+        int32_t *frame = bp;
+        for (int l = pc->c; l > 0; l--) frame = stack + frame[0];
+        frame[pc->b] = R(a);
+        NEXT();
+    }
+    CASE(R_ADR) {
+        int32_t *frame = bp;
+        for (int l = pc->c; l > 0; l--) frame = stack + frame[0];
+        R(a) = (int32_t)(frame + pc->b - stack);
+        NEXT();
+    }
+    CASE(R_LDI)
+        R(a) = stack[R(b)];
+        NEXT();
+    CASE(R_STI)
+        stack[R(b)] = R(a);
+        NEXT();
+    CASE(R_LDX)
+        if ((uint32_t)R(c) >= (uint32_t)pc->d) VM_ERROR("Array index out of bounds");
+        R(a) = bp[pc->b + R(c)];
+        NEXT();
+    CASE(R_STX)
+        if ((uint32_t)R(c) >= (uint32_t)pc->d) VM_ERROR("Array index out of bounds");
+        bp[pc->b + R(c)] = R(a);
+        NEXT();
+    CASE(R_LDXI)
+        if ((uint32_t)R(c) >= (uint32_t)pc->d) VM_ERROR("Array index out of bounds");
+        R(a) = stack[R(b) + R(c)];
+        NEXT();
+    CASE(R_STXI)
+        if ((uint32_t)R(c) >= (uint32_t)pc->d) VM_ERROR("Array index out of bounds");
+        stack[R(b) + R(c)] = R(a);
+        NEXT();
+    CASE(R_CHK)
+        if ((uint32_t)R(a) >= (uint32_t)pc->b) VM_ERROR("Array index out of bounds");
+        NEXT();
+    CASE(R_NEG)
+        R(a) = (int32_t)(0u - (uint32_t)R(b));
+        NEXT();
+    CASE(R_ADD)
+        R(a) = (int32_t)((uint32_t)R(b) + (uint32_t)R(c));
+        NEXT();
+    CASE(R_SUB)
+        R(a) = (int32_t)((uint32_t)R(b) - (uint32_t)R(c));
+        NEXT();
+    CASE(R_MUL)
+        R(a) = (int32_t)((uint32_t)R(b) * (uint32_t)R(c));
+        NEXT();
+    CASE(R_DIV)
+        if (R(c) == 0) VM_ERROR("Division by zero");
+        R(a) = foldOperator(SLASH, R(b), R(c));
+        NEXT();
+    CASE(R_MOD)
+        if (R(c) == 0) VM_ERROR("Modulo by zero");
+        R(a) = foldOperator(PERCENT, R(b), R(c));
+        NEXT();
+    CASE(R_ADDK)
+        R(a) = (int32_t)((uint32_t)R(b) + (uint32_t)pc->c);
+        NEXT();
+    CASE(R_MULK)
+        R(a) = (int32_t)((uint32_t)R(b) * (uint32_t)pc->c);
+        NEXT();
+    CASE(R_DIVK)
+        R(a) = foldOperator(SLASH, R(b), pc->c);
+        NEXT();
+    CASE(R_MODK)
+        R(a) = foldOperator(PERCENT, R(b), pc->c);
+        NEXT();
+    CASE(R_JEQ)  BRANCH(R(a) == R(b));
+    CASE(R_JNE)  BRANCH(R(a) != R(b));
+    CASE(R_JLT)  BRANCH(R(a) < R(b));
+    CASE(R_JLE)  BRANCH(R(a) <= R(b));
+    CASE(R_JGT)  BRANCH(R(a) > R(b));
+    CASE(R_JGE)  BRANCH(R(a) >= R(b));
+    CASE(R_JEQK) BRANCH(R(a) == pc->b);
+    CASE(R_JNEK) BRANCH(R(a) != pc->b);
+    CASE(R_JLTK) BRANCH(R(a) < pc->b);
+    CASE(R_JLEK) BRANCH(R(a) <= pc->b);
+    CASE(R_JGTK) BRANCH(R(a) > pc->b);
+    CASE(R_JGEK) BRANCH(R(a) >= pc->b);
+    CASE(R_JODD) BRANCH(R(a) & 1);
+    CASE(R_JEVEN) BRANCH(!(R(a) & 1));
+    CASE(R_JMP)
+        COUNT_RUN();
+        JUMP(pc->c);
+    CASE(R_ENT)
+        if ((size_t)(bp - stack) + (size_t)pc->a + FRAME_HEADER > vm->stackCells) VM_ERROR("Stack overflow");
+        memset(bp + FRAME_HEADER, 0, (size_t)(pc->a - FRAME_HEADER) * sizeof(int32_t));
+        NEXT();
+    CASE(R_CAL) {
+        int32_t *frame = bp;
+        for (int l = pc->b; l > 0; l--) frame = stack + frame[0];
+        int32_t *callee = bp + pc->a;
+        callee[0] = (int32_t)(frame - stack);
+        callee[1] = (int32_t)(bp - stack);
+        callee[2] = (int32_t)(pc - base) + 1;
+        bp = callee;
+        COUNT_RUN();
+        JUMP(pc->c);
+    }
+    CASE(R_RET)
+        COUNT_RUN();
+        pc = base + bp[2];
+        bp = stack + bp[1];
+        DISPATCH();
+    CASE(R_RED)
+        if (vmReadInteger(vm->input, &R(a)) != 0) VM_ERROR("Expected an integer on input");
+        NEXT();
+    CASE(R_RDL)
+        if (vmReadInteger(vm->input, &R(a)) != 0) VM_ERROR("Expected an integer on input");
+        vmSkipLine(vm->input);
+        NEXT();
+    CASE(R_WRT)
+        fprintf(vm->output, "%d", R(a));
+        NEXT();
+    CASE(R_WRL)
+        fprintf(vm->output, "%d\n", R(a));
+        NEXT();
+    CASE(R_HLT)
+        COUNT_RUN();
+        vm->executed = executed;
+        return 0;
+
+#if !PL0_VM_THREADED
+        default:
+            VM_ERROR("Invalid instruction");
+    }
+#endif
+
+fail:
+    COUNT_RUN();
+    vm->executed = executed;
+    vm->errorLine = code->lines[pc - base];
+    return -1;
+
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+#undef COUNT_RUN
+#undef JUMP
+#undef BRANCH
+#undef VM_ERROR
+#undef R
+}
+
+#endif
@@ -0,0 +1,53 @@
+// gcc -O2 -c pl0_runtime.c
+// ./semantic_analyzer_ver2 -S source.txt > program.s
+// gcc program.s pl0_runtime.o -o program        (or as, then ld with the C library)
+//
+// Runtime of PL/0 programs compiled to assembly (see pl0_asm.h). It sets up the
+// frame stack and a native stack for the program's calls, enters the program,
+// and does its I/O for it through stdio: READ and READLN read integers from
+// stdin as the VM does, WRITE and WRITELN write to stdout. A runtime error is
+// reported like the VM reports it, with exit status 1.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "pl0_runtime.h"
+
+int pl0_enter(RuntimeContext *context);
+
+int pl0_read(int32_t *cell, int skipLine) {
+    if (vmReadInteger(stdin, cell) != 0) {
+        return -1;
+    }
+    if (skipLine) {
+        vmSkipLine(stdin);
+    }
+    return 0;
+}
+
+void pl0_write(int32_t value, int newline) {
+    printf(newline ? "%d\n" : "%d", value);
+}
+
+int main(void) {
+    // A native call per frame, every frame at least the 3 cells of its links, and room for the C library.
+    size_t nativeStackSize = (VM_STACK_CELLS / 3 + 1) * sizeof(void *) + ((size_t)1 << 20);
+    int32_t *stack = malloc(VM_STACK_CELLS * sizeof(int32_t));
+    char *nativeStack = malloc(nativeStackSize);
+    if (stack == NULL || nativeStack == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    RuntimeContext context = {stack, stack + VM_STACK_CELLS, NULL, NULL, 0, 0};
+    context.nativeStackTop = (void *)((uintptr_t)(nativeStack + nativeStackSize) & ~(uintptr_t)15);
+    stack[0] = stack[1] = stack[2] = 0; // The main program's links
+
+    int rc = pl0_enter(&context);
+    fflush(stdout);
+    if (rc != 0) {
+        fprintf(stderr, "Runtime Error at Line %d: %s\n", context.errorLine, runtimeErrorMessages[context.error]);
+    }
+    free(nativeStack);
+    free(stack);
+    return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
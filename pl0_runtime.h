@@ -0,0 +1,84 @@
+/*
+What a running PL/0 program needs, whichever way it runs: reading the
+integers of READ and READLN, the size of the frame stack, and the interface
+between natively compiled code (pl0_asm.h) and its runtime (pl0_runtime.c).
+
+This header does not depend on the compiler, so the runtime can be built
+without it.
+*/
+
+#ifndef PL0_RUNTIME_H
+#define PL0_RUNTIME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <ctype.h>
+
+#define VM_STACK_CELLS (1 << 24)
+
+// Runtime errors natively compiled code can stop with.
+typedef enum {
+    RUNTIME_BOUNDS,
+    RUNTIME_DIVISION,
+    RUNTIME_MODULO,
+    RUNTIME_STACK,
+    RUNTIME_INPUT
+} RuntimeError;
+
+static const char *const runtimeErrorMessages[] = {
+    "Array index out of bounds", "Division by zero", "Modulo by zero", "Stack overflow",
+    "Expected an integer on input"
+};
+
+// Passed by the runtime to the compiled program's entry, pl0_enter.
+typedef struct {
+    int32_t *stack;
+    int32_t *stackEnd;
+    void *savedRsp;             // Host stack pointer when the program was entered
+    void *nativeStackTop;       // Where native calls of the program start
+    int32_t errorLine;          // Source line of the runtime error that stopped the program
+    int32_t error;              // Its RuntimeError
+} RuntimeContext;
+
+// Read an optionally signed decimal integer, skipping white space before it.
+// Returns 0, or -1 at the end of input, on a malformed number or out of range.
+static int vmReadInteger(FILE *in, int32_t *value) {
+    int ch;
+    do {
+        ch = getc(in);
+    } while (ch != EOF && isspace(ch));
+    bool negative = ch == '-';
+    if (ch == '-' || ch == '+') {
+        ch = getc(in);
+    }
+    if (ch == EOF || !isdigit(ch)) {
+        return -1;
+    }
+    int64_t n = 0;
+    for (; ch != EOF && isdigit(ch); ch = getc(in)) {
+        n = n * 10 + (ch - '0');
+        if (n > (int64_t)INT32_MAX + 1) {
+            return -1;
+        }
+    }
+    if (ch != EOF) {
+        ungetc(ch, in);
+    }
+    if (negative) {
+        n = -n;
+    }
+    if (n > INT32_MAX) {
+        return -1;
+    }
+    *value = (int32_t)n;
+    return 0;
+}
+
+static void vmSkipLine(FILE *in) {
+    int ch;
+    while ((ch = getc(in)) != EOF && ch != '\n') {
+    }
+}
+
+#endif
@@ -0,0 +1,247 @@
+/*
+Bulk scanning primitives for the PL/0 lexers.
+
+The lexers spend most of their time in three kinds of runs: whitespace
+(including deep indentation), identifier characters and digits. The helpers
+below find the end of such a run 16 bytes (SSE2) or 32 bytes (AVX2) at a time
+and, for whitespace, update the line/column position with a popcount instead
+of a branch per byte. The implementation is picked once at start-up from what
+the CPU supports; other targets use the scalar loops.
+
+Character classes follow the "C" locale used by the analyzers: whitespace is
+' ', '\t', '\n', '\v', '\f', '\r'; identifier characters are ASCII letters and
+digits. A tab advances the column by TAB_WIDTH, a newline starts a new line
+at column 1 and every other whitespace byte advances the column by one.
+Newlines passed while skipping whitespace are recorded in a LineIndex.
+Setting PL0_SCALAR_SCAN in the environment forces the scalar loops.
+*/
+
+#ifndef PL0_SCAN_H
+#define PL0_SCAN_H
+
+#include <stdlib.h>
+#include "pl0_source.h"
+
+#define TAB_WIDTH 4
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define PL0_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+static inline int isSpaceByte(unsigned char c) {
+    return c == ' ' || (unsigned char)(c - '\t') <= '\r' - '\t';
+}
+
+static inline int isAlnumByte(unsigned char c) {
+    return (unsigned char)((c | 0x20) - 'a') <= 'z' - 'a' || (unsigned char)(c - '0') <= 9;
+}
+
+static inline int isDigitByte(unsigned char c) {
+    return (unsigned char)(c - '0') <= 9;
+}
+
+// ---- Scalar implementation ----
+
+static const char *skipSpaceScalar(const char *p, const char *end, int *line, int *col, LineIndex *lines) {
+    while (p < end && isSpaceByte((unsigned char)*p)) {
+        if (*p == '\t') {
+            *col += TAB_WIDTH;
+        } else if (*p == '\n') {
+            (*line)++;
+            *col = 1;
+            addLineStart(lines, p + 1);
+        } else {
+            (*col)++;
+        }
+        p++;
+    }
+    return p;
+}
+
+static const char *scanAlnumScalar(const char *p, const char *end) {
+    while (p < end && isAlnumByte((unsigned char)*p)) p++;
+    return p;
+}
+
+static const char *scanDigitsScalar(const char *p, const char *end) {
+    while (p < end && isDigitByte((unsigned char)*p)) p++;
+    return p;
+}
+
+#ifdef PL0_SCAN_X86
+
+// Update line/col for one block at p: 'len' leading whitespace bytes, with newline
+// and tab positions given as bitmasks already limited to those bytes.
+static inline void accountBlock(const char *p, unsigned nlBits, unsigned tabBits, int len, int *line, int *col, LineIndex *lines) {
+    if (nlBits) {
+        int last = 31 - __builtin_clz(nlBits);
+        *line += __builtin_popcount(nlBits);
+        for (unsigned bits = nlBits; bits; bits &= bits - 1) {
+            addLineStart(lines, p + __builtin_ctz(bits) + 1);
+        }
+        tabBits &= ~((2u << last) - 1); // Only tabs after the last newline count
+        *col = 1 + (len - last - 1) + (TAB_WIDTH - 1) * __builtin_popcount(tabBits);
+    } else {
+        *col += len + (TAB_WIDTH - 1) * __builtin_popcount(tabBits);
+    }
+}
+
+// ---- SSE2 implementation (always available on x86-64) ----
+
+static inline __m128i inRange128(__m128i v, char lo, char span) {
+    __m128i d = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(span)), d);
+}
+
+static const char *skipSpaceSSE2(const char *p, const char *end, int *line, int *col, LineIndex *lines) {
+    if (p >= end || !isSpaceByte((unsigned char)*p)) return p;
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), inRange128(v, '\t', '\r' - '\t'));
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(ws) & 0xFFFFu;
+        int len = stop ? __builtin_ctz(stop) : 16;
+        unsigned valid = (len == 16) ? 0xFFFFu : ((1u << len) - 1);
+        unsigned nlBits = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))) & valid;
+        unsigned tabBits = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))) & valid;
+        accountBlock(p, nlBits, tabBits, len, line, col, lines);
+        p += len;
+        if (stop) return p;
+    }
+    return skipSpaceScalar(p, end, line, col, lines);
+}
+
+static const char *scanAlnumSSE2(const char *p, const char *end) {
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i ok = _mm_or_si128(inRange128(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z' - 'a'),
+                                  inRange128(v, '0', 9));
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(ok) & 0xFFFFu;
+        if (stop) return p + __builtin_ctz(stop);
+        p += 16;
+    }
+    return scanAlnumScalar(p, end);
+}
+
+static const char *scanDigitsSSE2(const char *p, const char *end) {
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(inRange128(v, '0', 9)) & 0xFFFFu;
+        if (stop) return p + __builtin_ctz(stop);
+        p += 16;
+    }
+    return scanDigitsScalar(p, end);
+}
+
+// ---- AVX2 implementation (selected at run time) ----
+
+#define PL0_AVX2 __attribute__((target("avx2,popcnt")))
+
+PL0_AVX2 static inline __m256i inRange256(__m256i v, char lo, char span) {
+    __m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(span)), d);
+}
+
+PL0_AVX2 static const char *skipSpaceAVX2(const char *p, const char *end, int *line, int *col, LineIndex *lines) {
+    if (p >= end || !isSpaceByte((unsigned char)*p)) return p;
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), inRange256(v, '\t', '\r' - '\t'));
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(ws);
+        int len = stop ? __builtin_ctz(stop) : 32;
+        unsigned valid = (len == 32) ? 0xFFFFFFFFu : ((1u << len) - 1);
+        unsigned nlBits = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))) & valid;
+        unsigned tabBits = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))) & valid;
+        accountBlock(p, nlBits, tabBits, len, line, col, lines);
+        p += len;
+        if (stop) return p;
+    }
+    return skipSpaceSSE2(p, end, line, col, lines);
+}
+
+PL0_AVX2 static const char *scanAlnumAVX2(const char *p, const char *end) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i ok = _mm256_or_si256(inRange256(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z' - 'a'),
+                                     inRange256(v, '0', 9));
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(ok);
+        if (stop) return p + __builtin_ctz(stop);
+        p += 32;
+    }
+    return scanAlnumSSE2(p, end);
+}
+
+PL0_AVX2 static const char *scanDigitsAVX2(const char *p, const char *end) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(inRange256(v, '0', 9));
+        if (stop) return p + __builtin_ctz(stop);
+        p += 32;
+    }
+    return scanDigitsSSE2(p, end);
+}
+
+#endif
+
+// ---- Run-time dispatch ----
+
+typedef struct {
+    const char *name;
+    const char *(*skipSpace)(const char *p, const char *end, int *line, int *col, LineIndex *lines);
+    const char *(*scanAlnum)(const char *p, const char *end);
+    const char *(*scanDigits)(const char *p, const char *end);
+} ScanOps;
+
+static const ScanOps scanOpsScalar = {"scalar", skipSpaceScalar, scanAlnumScalar, scanDigitsScalar};
+
+#ifdef PL0_SCAN_X86
+static const ScanOps scanOpsSSE2 = {"sse2", skipSpaceSSE2, scanAlnumSSE2, scanDigitsSSE2};
+static const ScanOps scanOpsAVX2 = {"avx2", skipSpaceAVX2, scanAlnumAVX2, scanDigitsAVX2};
+static const ScanOps *scanOps = &scanOpsSSE2;
+
+// Runs before main, so the choice is made once and never races with lexer threads.
+__attribute__((constructor)) static void selectScanOps(void) {
+    __builtin_cpu_init();
+    if (getenv("PL0_SCALAR_SCAN") != NULL) {
+        scanOps = &scanOpsScalar;
+    } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        scanOps = &scanOpsAVX2;
+    }
+}
+#else
+static const ScanOps *scanOps = &scanOpsScalar;
+#endif
+
+// Runs in real code are mostly short (one blank, a few letters), so the wrappers
+// handle those inline and only hand longer runs to the bulk implementation.
+
+// Skip a whitespace run starting at p, advancing *line/*col and recording new lines
+// in 'lines'; returns the first non-blank byte.
+static inline const char *scanSkipSpace(const char *p, const char *end, int *line, int *col, LineIndex *lines) {
+    if (p < end && !isSpaceByte((unsigned char)*p)) return p;
+    if (end - p >= 2 && p[0] == ' ' && !isSpaceByte((unsigned char)p[1])) {
+        (*col)++;
+        return p + 1;
+    }
+    return scanOps->skipSpace(p, end, line, col, lines);
+}
+
+#define SCAN_INLINE_BYTES 8
+
+// End of the run of letters/digits starting at p.
+static inline const char *scanAlnum(const char *p, const char *end) {
+    const char *limit = (end - p > SCAN_INLINE_BYTES) ? p + SCAN_INLINE_BYTES : end;
+    while (p < limit && isAlnumByte((unsigned char)*p)) p++;
+    if (p < limit || p == end) return p;
+    return scanOps->scanAlnum(p, end);
+}
+
+// End of the run of digits starting at p.
+static inline const char *scanDigits(const char *p, const char *end) {
+    const char *limit = (end - p > SCAN_INLINE_BYTES) ? p + SCAN_INLINE_BYTES : end;
+    while (p < limit && isDigitByte((unsigned char)*p)) p++;
+    if (p < limit || p == end) return p;
+    return scanOps->scanDigits(p, end);
+}
+
+#endif
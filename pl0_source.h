@@ -0,0 +1,183 @@
+/*
+Source buffer shared by the PL/0 analyzers.
+
+The whole input is mapped into memory once (mmap for regular files, a growing
+heap buffer for pipes and other streams) and the lexers walk it with a plain
+pointer instead of going through fgetc/ungetc for every byte.
+*/
+
+#ifndef PL0_SOURCE_H
+#define PL0_SOURCE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SOURCE_READ_CHUNK 65536
+
+typedef struct {
+    const char *data;  // First byte of the source text
+    const char *cur;   // Next byte the lexer will look at
+    const char *end;   // One past the last byte
+    size_t size;
+    int mapped;        // 1 if data is an mmap'd view, 0 if it was read into the heap
+} SourceBuffer;
+
+static void initSourceBuffer(SourceBuffer *sb, const char *data, size_t size, int mapped) {
+    sb->data = data;
+    sb->cur = data;
+    sb->end = data + size;
+    sb->size = size;
+    sb->mapped = mapped;
+}
+
+// Streaming fallback: read everything from 'stream' into one heap buffer.
+static int readSourceStream(SourceBuffer *sb, FILE *stream) {
+    size_t cap = SOURCE_READ_CHUNK, len = 0;
+    char *buf = malloc(cap);
+    if (buf == NULL) return -1;
+    for (;;) {
+        if (cap - len < SOURCE_READ_CHUNK) {
+            char *grown = realloc(buf, cap * 2);
+            if (grown == NULL) {
+                free(buf);
+                return -1;
+            }
+            buf = grown;
+            cap *= 2;
+        }
+        size_t n = fread(buf + len, 1, cap - len, stream);
+        len += n;
+        if (n == 0) break;
+    }
+    if (ferror(stream)) {
+        free(buf);
+        return -1;
+    }
+    if (len == 0) {
+        free(buf);
+        initSourceBuffer(sb, "", 0, 0);
+        return 0;
+    }
+    initSourceBuffer(sb, buf, len, 0);
+    return 0;
+}
+
+// Open 'path' ("-" means stdin). Returns 0 on success, -1 with errno set on failure.
+static int openSourceBuffer(SourceBuffer *sb, const char *path) {
+    if (strcmp(path, "-") == 0) {
+        return readSourceStream(sb, stdin);
+    }
+#if !defined(_WIN32)
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        if (st.st_size == 0) {
+            close(fd);
+            initSourceBuffer(sb, "", 0, 0);
+            return 0;
+        }
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            close(fd);
+#ifdef MADV_SEQUENTIAL
+            madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+            initSourceBuffer(sb, map, (size_t)st.st_size, 1);
+            return 0;
+        }
+    }
+    // Not a regular file (pipe, FIFO, device) or mmap refused: stream it.
+    FILE *stream = fdopen(fd, "rb");
+    if (stream == NULL) {
+        close(fd);
+        return -1;
+    }
+#else
+    FILE *stream = fopen(path, "rb");
+    if (stream == NULL) return -1;
+#endif
+    int rc = readSourceStream(sb, stream);
+    fclose(stream);
+    return rc;
+}
+
+static void closeSourceBuffer(SourceBuffer *sb) {
+#if !defined(_WIN32)
+    if (sb->mapped) {
+        munmap((void *)sb->data, sb->size);
+    } else
+#endif
+    if (sb->size > 0) {
+        free((void *)sb->data);
+    }
+    initSourceBuffer(sb, "", 0, 0);
+}
+
+// Line-start index, filled in by the lexer as it passes newlines, so that
+// diagnostics can print a source line without re-reading the file.
+typedef struct {
+    const char *base;   // Buffer the offsets refer to
+    size_t *starts;     // starts[i] is the offset of the first byte of line i + 1
+    int count;
+    int capacity;
+} LineIndex;
+
+static void initLineIndex(LineIndex *li, const SourceBuffer *sb) {
+    li->base = sb->data;
+    li->count = 0;
+    li->capacity = 256;
+    li->starts = malloc(li->capacity * sizeof(size_t));
+    if (li->starts != NULL) {
+        li->starts[li->count++] = 0; // Line 1
+    }
+}
+
+static void freeLineIndex(LineIndex *li) {
+    free(li->starts);
+    li->starts = NULL;
+    li->count = li->capacity = 0;
+}
+
+// Record that a new line begins at 'p'. If memory runs out the index is dropped
+// and diagnostics are printed without source context.
+static void addLineStart(LineIndex *li, const char *p) {
+    if (li->starts == NULL) return;
+    if (li->count == li->capacity) {
+        size_t *grown = realloc(li->starts, 2 * li->capacity * sizeof(size_t));
+        if (grown == NULL) {
+            freeLineIndex(li);
+            return;
+        }
+        li->starts = grown;
+        li->capacity *= 2;
+    }
+    li->starts[li->count++] = (size_t)(p - li->base);
+}
+
+// Text of a 1-based line without its line terminator. Returns 0 if the line is not indexed.
+static inline int getSourceLine(const LineIndex *li, const SourceBuffer *sb, int line, const char **text, int *length) {
+    if (line < 1 || line > li->count) return 0;
+    const char *start = li->base + li->starts[line - 1];
+    const char *stop = memchr(start, '\n', (size_t)(sb->end - start));
+    if (stop == NULL) stop = sb->end;
+    if (stop > start && stop[-1] == '\r') stop--;
+    *text = start;
+    *length = (int)(stop - start);
+    return 1;
+}
+
+// Look at the next byte without consuming it; EOF at the end of the buffer.
+static inline int sourcePeek(const SourceBuffer *sb) {
+    return sb->cur < sb->end ? (unsigned char)*sb->cur : EOF;
+}
+
+#endif
@@ -0,0 +1,46 @@
+/*
+Token sets for panic-mode error recovery.
+
+After a syntax error the parser abandons the construct it was in and skips
+tokens until one in a synchronizing set, from which the enclosing construct
+can go on. A TokenSet has bit t set for token type t, so membership is one
+shift and mask.
+*/
+
+#ifndef PL0_SYNC_H
+#define PL0_SYNC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pl0_token.h"
+
+typedef uint64_t TokenSet;
+#define TOKEN_BIT(t) ((TokenSet)1 << (t))
+
+#define STATEMENT_START (TOKEN_BIT(IDENT) | TOKEN_BIT(CALL) | TOKEN_BIT(BEGIN) | \
+                         TOKEN_BIT(IF) | TOKEN_BIT(WHILE) | TOKEN_BIT(FOR))
+#define DECLARATION_START (TOKEN_BIT(CONST) | TOKEN_BIT(VAR) | TOKEN_BIT(PROCEDURE))
+#define INPUT_END (TOKEN_BIT(PERIOD) | TOKEN_BIT(EOFS))
+
+// A failed statement resumes at the next ';' or END, or at a keyword that starts a
+// statement. Identifiers start statements too but are left out: most of them are
+// operands in the middle of the broken statement, not the start of the next one.
+#define STATEMENT_SYNC ((STATEMENT_START & ~TOKEN_BIT(IDENT)) | TOKEN_BIT(SEMICOLON) | TOKEN_BIT(END) | INPUT_END)
+
+// A failed declaration resumes at the end of its section or the next section.
+#define DECLARATION_SYNC (DECLARATION_START | TOKEN_BIT(SEMICOLON) | TOKEN_BIT(BEGIN) | INPUT_END)
+
+// A failed procedure heading resumes at the ')' closing its parameters, or at
+// the procedure's own declarations or body if that is missing. VAR and ';' are
+// left out because they also occur inside the parameter list.
+#define HEADING_SYNC (TOKEN_BIT(RPARENT) | TOKEN_BIT(CONST) | TOKEN_BIT(PROCEDURE) | TOKEN_BIT(BEGIN) | INPUT_END)
+
+static inline bool inTokenSet(TokenType type, TokenSet set) {
+    return (set >> type) & 1;
+}
+
+static inline bool isStartOfStatement(TokenType type) {
+    return inTokenSet(type, STATEMENT_START);
+}
+
+#endif
@@ -0,0 +1,88 @@
+/*
+Token types and keyword recognition shared by the PL/0 analyzers.
+
+Keywords are recognised with a perfect hash over the first two letters and
+the length of the word:
+
+    h = (s[0] + 2 * s[1] + 5 * len) & 31
+
+The 15 keywords land in distinct slots of a 32-entry table, so classifying
+an identifier costs one hash, one length check and at most one string
+compare, instead of a strcmp against every keyword.
+*/
+
+#ifndef PL0_TOKEN_H
+#define PL0_TOKEN_H
+
+typedef enum { // Token types in PL/0
+    NONE = 0, IDENT, NUMBER,
+    BEGIN, CALL, CONST, DO, ELSE, END, FOR, IF, ODD,
+    PROCEDURE, PROGRAM, THEN, TO, VAR, WHILE,
+    PLUS, MINUS, TIMES, SLASH, EQU, NEQ, LSS, LEQ, GTR, GEQ,
+    LPARENT, RPARENT, LBRACK, RBRACK, PERIOD, COMMA, SEMICOLON, ASSIGN, PERCENT,
+    EOFS
+} TokenType;
+
+static inline const char* token_to_string(TokenType type) {
+    static const char* TokenTypeStrings[] = {
+        "NONE", "IDENT", "NUMBER",
+        "BEGIN", "CALL", "CONST", "DO", "ELSE", "END", "FOR", "IF", "ODD",
+        "PROCEDURE", "PROGRAM", "THEN", "TO", "VAR", "WHILE",
+        "PLUS", "MINUS", "TIMES", "SLASH", "EQU", "NEQ", "LSS", "LEQ", "GTR", "GEQ",
+        "LPARENT", "RPARENT", "LBRACK", "RBRACK", "PERIOD", "COMMA", "SEMICOLON", "ASSIGN", "PERCENT",
+        "EOFS"
+    };
+    if (type >= NONE && type <= EOFS) { 
+        return TokenTypeStrings[type];
+    }
+    return "UNKNOWN_TOKEN"; 
+}
+
+#define KEYWORD_MIN_LEN 2
+#define KEYWORD_MAX_LEN 9
+#define KEYWORD_HASH(c0, c1, len) (((c0) + 2 * (c1) + 5 * (len)) & 31)
+
+typedef struct {
+    const char *name;
+    int length;
+    TokenType type;
+} KeywordSlot;
+
+// Slot i holds the keyword whose KEYWORD_HASH is i; empty slots have length 0.
+static const KeywordSlot keywordSlots[32] = {
+    [0]  = {"WHILE", 5, WHILE},
+    [1]  = {"PROCEDURE", 9, PROCEDURE},
+    [5]  = {"BEGIN", 5, BEGIN},
+    [6]  = {"ODD", 3, ODD},
+    [7]  = {"VAR", 3, VAR},
+    [12] = {"DO", 2, DO},
+    [16] = {"END", 3, END},
+    [17] = {"ELSE", 4, ELSE},
+    [19] = {"FOR", 3, FOR},
+    [23] = {"PROGRAM", 7, PROGRAM},
+    [24] = {"THEN", 4, THEN},
+    [25] = {"CALL", 4, CALL},
+    [26] = {"CONST", 5, CONST},
+    [28] = {"TO", 2, TO},
+    [31] = {"IF", 2, IF},
+};
+
+// Classify an identifier lexeme (letters/digits, any case) as a keyword or IDENT.
+static inline TokenType classifyKeyword(const char *s, int len) {
+    if (len < KEYWORD_MIN_LEN || len > KEYWORD_MAX_LEN) {
+        return IDENT;
+    }
+    // Clearing bit 5 upper-cases ASCII letters; digits never match a keyword letter afterwards.
+    const KeywordSlot *slot = &keywordSlots[KEYWORD_HASH(s[0] & 0xDF, s[1] & 0xDF, len)];
+    if (slot->length != len) {
+        return IDENT;
+    }
+    for (int i = 0; i < len; i++) {
+        if ((s[i] & 0xDF) != slot->name[i]) {
+            return IDENT;
+        }
+    }
+    return slot->type;
+}
+
+#endif
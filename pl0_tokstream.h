@@ -0,0 +1,249 @@
+/*
+Binary token stream written by "lexical_analyzer -b" and read back by the
+syntax analyzer in place of lexing the source again.
+
+Layout (native byte order, every field 4-byte aligned):
+
+    TokenStreamHeader                  magic, version and counts
+    TokenRecord[tokenCount]            one fixed-width record per token, EOFS included
+    uint32_t offsets[stringCount + 1]  start of each string; the last entry is stringBytes
+    char strings[stringBytes]          NUL-terminated strings
+
+Strings 0 .. nameCount - 1 are the interned identifier names in ID order, so an
+IDENT record's id is both its name ID and its string index. The text of each
+malformed token follows the names; a NONE record's id counts from nameCount.
+
+The reader maps the file and hands out records in place: nothing is decoded
+up front, and lexemes point straight into the mapped string table.
+*/
+
+#ifndef PL0_TOKSTREAM_H
+#define PL0_TOKSTREAM_H
+
+#include <stdint.h>
+#include "pl0_lexer.h"
+
+#define TOKEN_STREAM_VERSION 1
+#define TOKEN_WRITER_BUFFER (1 << 20)
+
+// 0x7F can never start a PL/0 source, so a stream is told apart by its first byte.
+static const char tokenStreamMagic[8] = "\177PL0TOK";
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t tokenCount;
+    uint32_t nameCount;
+    uint32_t stringCount;
+    uint32_t stringBytes;
+    uint32_t reserved;
+} TokenStreamHeader;
+
+typedef struct {
+    int32_t type;
+    int32_t id;     // Name ID for IDENT, error text index for NONE, -1 otherwise
+    int32_t value;  // numberValue for NUMBER, LexError for NONE
+    int32_t line;
+    int32_t col;
+} TokenRecord;
+
+// ---- Writer ----
+
+typedef struct {
+    FILE *out;
+    char *buf;            // Output is staged here and written TOKEN_WRITER_BUFFER bytes at a time
+    size_t used;
+    int failed;
+    uint32_t tokenCount;
+    char *errorText;      // Text of each NONE token in record order, each as a uint32_t length, the bytes and a NUL
+    size_t errorBytes;
+    size_t errorCapacity;
+    uint32_t errorCount;
+} TokenWriter;
+
+static void tokenWriterFlush(TokenWriter *w) {
+    if (w->used > 0 && fwrite(w->buf, 1, w->used, w->out) != w->used) {
+        w->failed = 1;
+    }
+    w->used = 0;
+}
+
+static void tokenWriterPut(TokenWriter *w, const void *data, size_t n) {
+    const char *p = data;
+    while (n > 0) {
+        if (w->used == TOKEN_WRITER_BUFFER) tokenWriterFlush(w);
+        size_t chunk = TOKEN_WRITER_BUFFER - w->used;
+        if (chunk > n) chunk = n;
+        memcpy(w->buf + w->used, p, chunk);
+        w->used += chunk;
+        p += chunk;
+        n -= chunk;
+    }
+}
+
+// Start a stream on 'out', which must be seekable: the header is filled in by closeTokenWriter.
+static inline int openTokenWriter(TokenWriter *w, FILE *out) {
+    memset(w, 0, sizeof(*w));
+    w->out = out;
+    w->buf = malloc(TOKEN_WRITER_BUFFER);
+    if (w->buf == NULL) return -1;
+    TokenStreamHeader header;
+    memset(&header, 0, sizeof(header));
+    tokenWriterPut(w, &header, sizeof(header));
+    return 0;
+}
+
+static inline void writeTokenRecord(TokenWriter *w, const Token *t) {
+    TokenRecord rec = {t->type, -1, 0, t->line, t->col};
+    if (t->type == IDENT) {
+        rec.id = t->id;
+    } else if (t->type == NUMBER) {
+        rec.value = t->numberValue;
+    } else if (t->type == NONE) {
+        uint32_t length = (uint32_t)t->length;
+        size_t need = sizeof(length) + length + 1;
+        if (w->errorCapacity - w->errorBytes < need) {
+            size_t capacity = w->errorCapacity ? w->errorCapacity * 2 : 256;
+            while (capacity - w->errorBytes < need) capacity *= 2;
+            char *grown = realloc(w->errorText, capacity);
+            if (grown == NULL) {
+                w->failed = 1;
+                return;
+            }
+            w->errorText = grown;
+            w->errorCapacity = capacity;
+        }
+        char *p = w->errorText + w->errorBytes;
+        memcpy(p, &length, sizeof(length));
+        memcpy(p + sizeof(length), t->lexeme, length);
+        p[sizeof(length) + length] = '\0';
+        w->errorBytes += need;
+        rec.id = (int32_t)w->errorCount++;
+        rec.value = t->error;
+    }
+    tokenWriterPut(w, &rec, sizeof(rec));
+    w->tokenCount++;
+}
+
+// Append the string table, fill in the header and release the writer. Returns 0 on success.
+static inline int closeTokenWriter(TokenWriter *w, const Interner *names) {
+    uint32_t offset = 0;
+    for (int id = 0; id < names->count; id++) {
+        tokenWriterPut(w, &offset, sizeof(offset));
+        offset += (uint32_t)names->lengths[id] + 1;
+    }
+    uint32_t length;
+    for (size_t at = 0; at < w->errorBytes; at += sizeof(length) + length + 1) {
+        memcpy(&length, w->errorText + at, sizeof(length));
+        tokenWriterPut(w, &offset, sizeof(offset));
+        offset += length + 1;
+    }
+    tokenWriterPut(w, &offset, sizeof(offset));
+    for (int id = 0; id < names->count; id++) {
+        tokenWriterPut(w, names->names[id], (size_t)names->lengths[id] + 1);
+    }
+    for (size_t at = 0; at < w->errorBytes; at += sizeof(length) + length + 1) {
+        memcpy(&length, w->errorText + at, sizeof(length));
+        tokenWriterPut(w, w->errorText + at + sizeof(length), (size_t)length + 1);
+    }
+    tokenWriterFlush(w);
+
+    TokenStreamHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, tokenStreamMagic, sizeof(header.magic));
+    header.version = TOKEN_STREAM_VERSION;
+    header.tokenCount = w->tokenCount;
+    header.nameCount = (uint32_t)names->count;
+    header.stringCount = (uint32_t)names->count + w->errorCount;
+    header.stringBytes = offset;
+    if (fseek(w->out, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, w->out) != 1 || fflush(w->out) != 0) {
+        w->failed = 1;
+    }
+
+    free(w->buf);
+    free(w->errorText);
+    int rc = w->failed ? -1 : 0;
+    memset(w, 0, sizeof(*w));
+    return rc;
+}
+
+// ---- Reader ----
+
+typedef struct {
+    const TokenStreamHeader *header;
+    const TokenRecord *records;
+    const uint32_t *offsets;
+    const char *strings;
+    uint32_t next;        // Index of the next record to hand out
+} TokenStream;
+
+static inline int isTokenStream(const SourceBuffer *sb) {
+    return sb->size >= sizeof(tokenStreamMagic) && memcmp(sb->data, tokenStreamMagic, sizeof(tokenStreamMagic)) == 0;
+}
+
+// Point 'ts' into a stream already loaded in 'sb'. Only the header and the overall
+// size are checked here; returns -1 if they do not add up.
+static inline int openTokenStream(TokenStream *ts, const SourceBuffer *sb) {
+    if (!isTokenStream(sb) || sb->size < sizeof(TokenStreamHeader)) return -1;
+    const TokenStreamHeader *h = (const TokenStreamHeader *)sb->data;
+    uint64_t expected = sizeof(TokenStreamHeader) + (uint64_t)h->tokenCount * sizeof(TokenRecord) +
+                        ((uint64_t)h->stringCount + 1) * sizeof(uint32_t) + h->stringBytes;
+    if (h->version != TOKEN_STREAM_VERSION || h->nameCount > h->stringCount || h->tokenCount == 0 || expected != sb->size) {
+        return -1;
+    }
+    ts->header = h;
+    ts->records = (const TokenRecord *)(h + 1);
+    ts->offsets = (const uint32_t *)(ts->records + h->tokenCount);
+    ts->strings = (const char *)(ts->offsets + h->stringCount + 1);
+    ts->next = 0;
+    if (ts->offsets[h->stringCount] != h->stringBytes || (h->stringBytes > 0 && ts->strings[h->stringBytes - 1] != '\0')) {
+        return -1;
+    }
+    return 0;
+}
+
+static void tokenStreamCorrupt(const TokenStream *ts) {
+    fprintf(stderr, "Malformed token stream at record %u\n", ts->next);
+    exit(EXIT_FAILURE);
+}
+
+static inline void tokenStreamText(const TokenStream *ts, uint32_t index, Token *t) {
+    if (index >= ts->header->stringCount || ts->offsets[index] >= ts->header->stringBytes ||
+        ts->offsets[index + 1] <= ts->offsets[index]) {
+        tokenStreamCorrupt(ts);
+    }
+    t->lexeme = ts->strings + ts->offsets[index];
+    t->length = (int)(ts->offsets[index + 1] - ts->offsets[index] - 1);
+}
+
+// Next token, in the same form lexNext returns it. Only IDENT and NONE tokens carry
+// text; once the final EOFS is reached it is returned again on every call.
+static inline Token tokenStreamNext(TokenStream *ts) {
+    const TokenRecord *rec = &ts->records[ts->next];
+    Token token = {NONE, "", 0, 0, -1, rec->line, rec->col, LEX_OK};
+    if (rec->type < NONE || rec->type > EOFS) tokenStreamCorrupt(ts);
+    token.type = (TokenType)rec->type;
+    switch (token.type) {
+        case IDENT:
+            if (rec->id < 0 || (uint32_t)rec->id >= ts->header->nameCount) tokenStreamCorrupt(ts);
+            token.id = rec->id;
+            tokenStreamText(ts, (uint32_t)rec->id, &token);
+            break;
+        case NUMBER:
+            token.numberValue = rec->value;
+            break;
+        case NONE:
+            if (rec->id < 0) tokenStreamCorrupt(ts);
+            tokenStreamText(ts, ts->header->nameCount + (uint32_t)rec->id, &token);
+            token.error = (LexError)rec->value;
+            break;
+        default:
+            break;
+    }
+    if (ts->next + 1 < ts->header->tokenCount) {
+        ts->next++;
+    }
+    return token;
+}
+
+#endif
@@ -0,0 +1,484 @@
+/*
+Virtual machine for the p-code of pl0_codegen.h.
+
+Before running, the code is translated once into threaded form: with GCC or
+Clang each instruction carries the address of the label that implements it and
+every handler ends by jumping straight to the next one (direct threading with
+computed goto); elsewhere, or with PL0_VM_SWITCH defined, a switch loop runs the
+same instructions. Translation also picks a specialized handler for variables of
+the current frame (level difference 0), so the common case never walks static
+links. A superinstruction (see pl0_peephole.h) gets one handler per relation
+in the same way, and goes on past the instructions it covers.
+
+The stack is one contiguous array of cells allocated up front. The top of the
+operand stack is kept in a local (a register) and the rest in memory below it;
+'sp' points at the highest cell in memory. A frame is entered with its cells
+cleared, so every variable starts at 0. Overflow is checked once per call, for
+the callee's frame plus the most operand cells any block pushes (Code.maxDepth),
+never on a push.
+
+Executed instructions are counted a straight-line run at a time, not one by one:
+only JMP, JPC, CAL, RET and HLT add to the count, each the length of the run it
+ends, and a jump into the middle of a run takes back the part it skipped.
+
+Defining PL0_VM_PROFILE(vm, at) before including this header selects the switch
+loop and calls it before each instruction is dispatched, with its code address
+(see opcode_stats.c).
+*/
+
+#ifndef PL0_VM_H
+#define PL0_VM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pl0_codegen.h"
+#include "pl0_runtime.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(PL0_VM_SWITCH) && !defined(PL0_VM_PROFILE)
+#define PL0_VM_THREADED 1
+#else
+#define PL0_VM_THREADED 0
+#endif
+
+// Handlers past the p-code opcodes: variable access in the current frame, and
+// compare-and-jump superinstructions by relation, in the order OP_EQL to OP_GEQ.
+enum {
+    VM_LOD0 = OPCODE_COUNT,
+    VM_STO0,
+    VM_LDX0,
+    VM_STX0,
+    VM_JRL_EQL, VM_JRL_NEQ, VM_JRL_LSS, VM_JRL_LEQ, VM_JRL_GTR, VM_JRL_GEQ,
+    VM_JRK_EQL, VM_JRK_NEQ, VM_JRK_LSS, VM_JRK_LEQ, VM_JRK_GTR, VM_JRK_GEQ,
+    VM_JR_EQL, VM_JR_NEQ, VM_JR_LSS, VM_JR_LEQ, VM_JR_GTR, VM_JR_GEQ,
+    VM_HANDLER_COUNT
+};
+
+static bool isControlOpcode(int op) {
+    return op == OP_JMP || op == OP_JPC || op == OP_CAL || op == OP_RET || op == OP_HLT ||
+           op == OP_FOR || op == OP_JRL || op == OP_JRK || op == OP_JR;
+}
+
+typedef struct {
+#if PL0_VM_THREADED
+    const void *handler;
+#else
+    int op;
+#endif
+    int32_t a;
+    int32_t level;
+} VMInstruction;
+
+typedef struct {
+    int32_t *stack;
+    size_t stackCells;
+    VMInstruction *threaded;    // Translated code of the last run
+    int32_t *runCount;          // Per instruction: its position in its straight-line run, from 1
+    int threadedCapacity;
+    FILE *input;
+    FILE *output;
+    uint64_t executed;          // Instructions executed by the last run
+    const char *error;          // Runtime error that stopped the last run, NULL if none
+    int errorLine;              // Source line of that error
+} VM;
+
+static int initVM(VM *vm, size_t stackCells, FILE *input, FILE *output) {
+    memset(vm, 0, sizeof(*vm));
+    vm->stack = malloc(stackCells * sizeof(int32_t));
+    if (vm->stack == NULL) {
+        return -1;
+    }
+    vm->stackCells = stackCells;
+    vm->input = input;
+    vm->output = output;
+    return 0;
+}
+
+static void freeVM(VM *vm) {
+    free(vm->stack);
+    free(vm->threaded);
+    free(vm->runCount);
+    memset(vm, 0, sizeof(*vm));
+}
+
+// Translate 'code' into vm->threaded. 'handlers' maps each VM handler number to
+// its label (threaded dispatch) and is NULL for the switch loop.
+static int vmTranslate(VM *vm, const Code *code, const void *const *handlers) {
+    if (code->count > vm->threadedCapacity) {
+        VMInstruction *grown = realloc(vm->threaded, (size_t)code->count * sizeof(VMInstruction));
+        if (grown == NULL) {
+            return -1;
+        }
+        vm->threaded = grown;
+        int32_t *grownCounts = realloc(vm->runCount, (size_t)code->count * sizeof(int32_t));
+        if (grownCounts == NULL) {
+            return -1;
+        }
+        vm->runCount = grownCounts;
+        vm->threadedCapacity = code->count;
+    }
+    int32_t run = 0;
+    int covered = 0;
+    for (int i = 0; i < code->count; i++) {
+        const Instruction *in = &code->code[i];
+        int op = in->op;
+        if (covered > 0) {
+            // Operands of the superinstruction before, never dispatched.
+            covered--;
+            vm->runCount[i] = 0;
+        } else {
+            vm->runCount[i] = ++run;
+            covered = instructionLength(op) - 1;
+            if (isControlOpcode(op)) {
+                run = 0;
+            }
+        }
+        switch (op) {
+            case OP_JRL: op = VM_JRL_EQL + (in->level - OP_EQL); break;
+            case OP_JRK: op = VM_JRK_EQL + (in->level - OP_EQL); break;
+            case OP_JR:  op = VM_JR_EQL + (in->level - OP_EQL); break;
+            default: break;
+        }
+        if (in->level == 0) {
+            switch (op) {
+                case OP_LOD: op = VM_LOD0; break;
+                case OP_STO: op = VM_STO0; break;
+                case OP_LDX: op = VM_LDX0; break;
+                case OP_STX: op = VM_STX0; break;
+                default: break;
+            }
+        }
+#if PL0_VM_THREADED
+        vm->threaded[i].handler = handlers[op];
+#else
+        (void)handlers;
+        vm->threaded[i].op = op;
+#endif
+        vm->threaded[i].a = in->a;
+        vm->threaded[i].level = in->level;
+    }
+    return 0;
+}
+
+// Run generated code to its HLT. Returns 0, or -1 after a runtime error
+// (vm->error and vm->errorLine say which) or if memory ran out.
+static int runVM(VM *vm, const Code *code) {
+#if PL0_VM_THREADED
+    static const void *const handlers[VM_HANDLER_COUNT] = {
+        [OP_LIT] = &&do_OP_LIT, [OP_LOD] = &&do_OP_LOD, [OP_STO] = &&do_OP_STO, [OP_LDA] = &&do_OP_LDA,
+        [OP_LDI] = &&do_OP_LDI, [OP_STI] = &&do_OP_STI, [OP_LDX] = &&do_OP_LDX, [OP_STX] = &&do_OP_STX,
+        [OP_CHK] = &&do_OP_CHK, [OP_INT] = &&do_OP_INT, [OP_CAL] = &&do_OP_CAL, [OP_RET] = &&do_OP_RET,
+        [OP_JMP] = &&do_OP_JMP, [OP_JPC] = &&do_OP_JPC, [OP_NEG] = &&do_OP_NEG, [OP_ADD] = &&do_OP_ADD,
+        [OP_SUB] = &&do_OP_SUB, [OP_MUL] = &&do_OP_MUL, [OP_DIV] = &&do_OP_DIV, [OP_MOD] = &&do_OP_MOD,
+        [OP_ODD] = &&do_OP_ODD, [OP_EQL] = &&do_OP_EQL, [OP_NEQ] = &&do_OP_NEQ, [OP_LSS] = &&do_OP_LSS,
+        [OP_LEQ] = &&do_OP_LEQ, [OP_GTR] = &&do_OP_GTR, [OP_GEQ] = &&do_OP_GEQ, [OP_RED] = &&do_OP_RED,
+        [OP_RDL] = &&do_OP_RDL, [OP_WRT] = &&do_OP_WRT, [OP_WRL] = &&do_OP_WRL, [OP_HLT] = &&do_OP_HLT,
+        [OP_INC] = &&do_OP_INC, [OP_FOR] = &&do_OP_FOR, [OP_ADK] = &&do_OP_ADK, [OP_MLK] = &&do_OP_MLK,
+        [OP_DVK] = &&do_OP_DVK, [OP_MDK] = &&do_OP_MDK, [OP_LXK] = &&do_OP_LXK, [OP_LXL] = &&do_OP_LXL,
+        [OP_LAK] = &&do_OP_LAK, [OP_LL] = &&do_OP_LL,
+        [VM_LOD0] = &&do_VM_LOD0, [VM_STO0] = &&do_VM_STO0, [VM_LDX0] = &&do_VM_LDX0, [VM_STX0] = &&do_VM_STX0,
+#define RELATION_HANDLERS(rel) \
+        [VM_JRL_##rel] = &&do_VM_JRL_##rel, [VM_JRK_##rel] = &&do_VM_JRK_##rel, [VM_JR_##rel] = &&do_VM_JR_##rel,
+        RELATION_HANDLERS(EQL) RELATION_HANDLERS(NEQ) RELATION_HANDLERS(LSS)
+        RELATION_HANDLERS(LEQ) RELATION_HANDLERS(GTR) RELATION_HANDLERS(GEQ)
+#undef RELATION_HANDLERS
+    };
+#define CASE(name) do_##name:
+#define DISPATCH() goto *pc->handler
+#else
+    static const void *const *const handlers = NULL;
+#define CASE(name) case name:
+#define DISPATCH() goto dispatch
+#endif
+#define NEXT() do { pc++; DISPATCH(); } while (0)
+#define SKIP(n) do { pc += (n); DISPATCH(); } while (0)
+#define COUNT_RUN() (executed += (uint64_t)runCount[pc - base])
+#define JUMP(target) do { pc = base + (target); executed -= (uint64_t)runCount[pc - base] - 1; DISPATCH(); } while (0)
+#define VM_ERROR(msg) do { vm->error = (msg); goto fail; } while (0)
+
+    vm->error = NULL;
+    vm->executed = 0;
+    if (code->count == 0 || vmTranslate(vm, code, handlers) != 0) {
+        vm->error = "Out of memory";
+        vm->errorLine = 0;
+        return -1;
+    }
+
+    const VMInstruction *const base = vm->threaded;
+    const VMInstruction *pc = base;
+    const int32_t *const runCount = vm->runCount;
+    int32_t *const stack = vm->stack;
+    // Room a frame must leave for the operands above it and the next call's links.
+    const size_t reserve = (size_t)code->maxDepth + FRAME_HEADER + 2;
+    int32_t *sp, *bp = stack;  // Highest cell in memory; base of the current frame
+    int32_t tos = 0;            // Top of the operand stack
+    int32_t v, w;
+    uint64_t executed = 0;
+
+    bp[0] = bp[1] = bp[2] = 0; // The main program's links
+    sp = bp + FRAME_HEADER - 1;
+
+#if PL0_VM_THREADED
+    goto *pc->handler;
+#else
+dispatch:
+#ifdef PL0_VM_PROFILE
+    PL0_VM_PROFILE(vm, (int)(pc - base));
+#endif
+    switch (pc->op) {
+#endif
+
+    CASE(OP_LIT)
+        *++sp = tos;
+        tos = pc->a;
+        NEXT();
+    CASE(VM_LOD0)
+        *++sp = tos;
+        tos = bp[pc->a];
+        NEXT();
+    CASE(OP_LOD) {
+        int32_t *frame = bp;
+        for (int l = pc->level; l > 0; l--) frame = stack + frame[0];
+        *++sp = tos;
+        tos = frame[pc->a];
+        NEXT();
+    }
+    CASE(VM_STO0)
+        bp[pc->a] = tos;
+        tos = *sp--;
+        NEXT();
+    CASE(OP_STO) {
+        int32_t *frame = bp;
+        for (int l = pc->level; l > 0; l--) frame = stack + frame[0];
+        frame[pc->a] = tos;
+        tos = *sp--;
+        NEXT();
+    }
+    CASE(OP_LDA) {
+        int32_t *frame = bp;
+        for (int l = pc->level; l > 0; l--) frame = stack + frame[0];
+        *++sp = tos;
+        tos = (int32_t)(frame + pc->a - stack);
+        NEXT();
+    }
+    CASE(OP_LDI)
+        tos = stack[tos];
+        NEXT();
+    CASE(OP_STI)
+        stack[*sp] = tos;
+        tos = sp[-1];
+        sp -= 2;
+        NEXT();
+    CASE(VM_LDX0)
+        tos = bp[pc->a + tos];
+        NEXT();
+    CASE(OP_LDX) {
+        int32_t *frame = bp;
+        for (int l = pc->level; l > 0; l--) frame = stack + frame[0];
+        tos = frame[pc->a + tos];
+        NEXT();
+    }
+    CASE(VM_STX0)
+        bp[pc->a + *sp] = tos;
+        tos = sp[-1];
+        sp -= 2;
+        NEXT();
+    CASE(OP_STX) {
+        int32_t *frame = bp;
+        for (int l = pc->level; l > 0; l--) frame = stack + frame[0];
+        frame[pc->a + *sp] = tos;
+        tos = sp[-1];
+        sp -= 2;
+        NEXT();
+    }
+    CASE(OP_CHK)
+        if ((uint32_t)tos >= (uint32_t)pc->a) VM_ERROR("Array index out of bounds");
+        NEXT();
+    CASE(OP_INT)
+        if ((size_t)(bp - stack) + (size_t)pc->a + reserve > vm->stackCells) VM_ERROR("Stack overflow");
+        memset(bp + FRAME_HEADER, 0, (size_t)(pc->a - FRAME_HEADER) * sizeof(int32_t));
+        sp = bp + pc->a - 1;
+        NEXT();
+    CASE(OP_CAL) {
+        int32_t *frame = bp;
+        for (int l = pc->level; l > 0; l--) frame = stack + frame[0];
+        *++sp = tos;
+        sp[1] = (int32_t)(frame - stack);
+        sp[2] = (int32_t)(bp - stack);
+        sp[3] = (int32_t)(pc - base) + 1;
+        bp = sp + 1;
+        COUNT_RUN();
+        JUMP(pc->a);
+    }
+    CASE(OP_RET) {
+        int32_t *frame = bp;
+        sp = frame - 1 - pc->a; // Below the arguments
+        tos = *sp--;
+        COUNT_RUN();
+        pc = base + frame[2];
+        bp = stack + frame[1];
+        DISPATCH();
+    }
+    CASE(OP_JMP)
+        COUNT_RUN();
+        JUMP(pc->a);
+    CASE(OP_JPC)
+        v = tos;
+        tos = *sp--;
+        COUNT_RUN();
+        if (v == 0) JUMP(pc->a);
+        NEXT();
+    CASE(OP_NEG)
+        tos = (int32_t)(0u - (uint32_t)tos);
+        NEXT();
+    CASE(OP_ADD)
+        tos = (int32_t)((uint32_t)*sp-- + (uint32_t)tos);
+        NEXT();
+    CASE(OP_SUB)
+        tos = (int32_t)((uint32_t)*sp-- - (uint32_t)tos);
+        NEXT();
+    CASE(OP_MUL)
+        tos = (int32_t)((uint32_t)*sp-- * (uint32_t)tos);
+        NEXT();
+    CASE(OP_DIV)
+        if (tos == 0) VM_ERROR("Division by zero");
+        tos = foldOperator(SLASH, *sp--, tos);
+        NEXT();
+    CASE(OP_MOD)
+        if (tos == 0) VM_ERROR("Modulo by zero");
+        tos = foldOperator(PERCENT, *sp--, tos);
+        NEXT();
+    CASE(OP_ODD)
+        tos &= 1;
+        NEXT();
+    CASE(OP_EQL)
+        tos = *sp-- == tos;
+        NEXT();
+    CASE(OP_NEQ)
+        tos = *sp-- != tos;
+        NEXT();
+    CASE(OP_LSS)
+        tos = *sp-- < tos;
+        NEXT();
+    CASE(OP_LEQ)
+        tos = *sp-- <= tos;
+        NEXT();
+    CASE(OP_GTR)
+        tos = *sp-- > tos;
+        NEXT();
+    CASE(OP_GEQ)
+        tos = *sp-- >= tos;
+        NEXT();
+    CASE(OP_RED)
+        *++sp = tos;
+        if (vmReadInteger(vm->input, &tos) != 0) VM_ERROR("Expected an integer on input");
+        NEXT();
+    CASE(OP_RDL)
+        *++sp = tos;
+        if (vmReadInteger(vm->input, &tos) != 0) VM_ERROR("Expected an integer on input");
+        vmSkipLine(vm->input);
+        NEXT();
+    CASE(OP_WRT)
+        fprintf(vm->output, "%d", tos);
+        tos = *sp--;
+        NEXT();
+    CASE(OP_WRL)
+        fprintf(vm->output, "%d\n", tos);
+        tos = *sp--;
+        NEXT();
+    CASE(OP_HLT)
+        COUNT_RUN();
+        vm->executed = executed;
+        return 0;
+
+    // Superinstructions: pc[1], pc[2]... are the instructions they cover.
+    CASE(OP_INC)
+        bp[pc->a] = (int32_t)((uint32_t)bp[pc->a] + (uint32_t)pc[1].a);
+        SKIP(4);
+    CASE(OP_FOR) {
+        const VMInstruction *test = base + pc[4].a; // LOD 0 v; LOD 0 limit; LEQ; JPC exit
+        v = (int32_t)((uint32_t)bp[pc->a] + (uint32_t)pc[1].a);
+        bp[pc->a] = v;
+        COUNT_RUN();
+        if (v <= bp[test[1].a]) JUMP(pc[4].a + 4);
+        JUMP(test[3].a);
+    }
+#define RELATION_CASES(rel, op) \
+    CASE(VM_JRL_##rel) \
+        COUNT_RUN(); \
+        if (!(bp[pc->a] op bp[pc[1].a])) JUMP(pc[3].a); \
+        SKIP(4); \
+    CASE(VM_JRK_##rel) \
+        COUNT_RUN(); \
+        if (!(bp[pc->a] op pc[1].a)) JUMP(pc[3].a); \
+        SKIP(4); \
+    CASE(VM_JR_##rel) \
+        v = *sp--; \
+        w = tos; \
+        tos = *sp--; \
+        COUNT_RUN(); \
+        if (!(v op w)) JUMP(pc[1].a); \
+        SKIP(2);
+    RELATION_CASES(EQL, ==)
+    RELATION_CASES(NEQ, !=)
+    RELATION_CASES(LSS, <)
+    RELATION_CASES(LEQ, <=)
+    RELATION_CASES(GTR, >)
+    RELATION_CASES(GEQ, >=)
+#undef RELATION_CASES
+    CASE(OP_ADK)
+        tos = (int32_t)((uint32_t)tos + (uint32_t)pc->a);
+        SKIP(2);
+    CASE(OP_MLK)
+        tos = (int32_t)((uint32_t)tos * (uint32_t)pc->a);
+        SKIP(2);
+    CASE(OP_DVK)
+        tos = foldOperator(SLASH, tos, pc->a);
+        SKIP(2);
+    CASE(OP_MDK)
+        tos = foldOperator(PERCENT, tos, pc->a);
+        SKIP(2);
+    CASE(OP_LXK)
+        *++sp = tos;
+        tos = bp[pc[1].a + pc->a];
+        SKIP(2);
+    CASE(OP_LXL)
+        v = bp[pc->a];
+        if ((uint32_t)v >= (uint32_t)pc[1].a) VM_ERROR("Array index out of bounds");
+        *++sp = tos;
+        tos = bp[pc[2].a + v];
+        SKIP(3);
+    CASE(OP_LAK)
+        *++sp = tos;
+        tos = (int32_t)((uint32_t)bp[pc->a] + (uint32_t)pc[1].a);
+        SKIP(3);
+    CASE(OP_LL)
+        sp[1] = tos;
+        sp[2] = bp[pc->a];
+        sp += 2;
+        tos = bp[pc[1].a];
+        SKIP(2);
+
+#if !PL0_VM_THREADED
+        default:
+            VM_ERROR("Invalid instruction");
+    }
+#endif
+
+fail:
+    COUNT_RUN();
+    vm->executed = executed;
+    vm->errorLine = code->lines[pc - base];
+    return -1;
+
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+#undef SKIP
+#undef COUNT_RUN
+#undef JUMP
+#undef VM_ERROR
+}
+
+#endif
@@ -4,1338 +4,504 @@ Tran Pham Minh Duc - 20226077
 Nguyen Khoa Ninh - 20226117
 */
 
+// gcc semantic_analyzer_ver2.c -o semantic_analyzer_ver2 -pthread
+// ./semantic_analyzer_ver2 source.txt
+// ./semantic_analyzer_ver2 -j 8 submissions/     (every *.pl0 in the directory on 8 threads, see pl0_batch.h)
+// ./semantic_analyzer_ver2 @manifest.txt         (one source path per line)
+// ./semantic_analyzer_ver2 -p source.txt         (lex on a second thread, see pl0_pipeline.h)
+// ./semantic_analyzer_ver2 -a source.txt         (also print the syntax tree, see pl0_ast.h)
+// ./semantic_analyzer_ver2 -e 20 source.txt      (stop after 20 errors; by default every error is reported)
+// ./semantic_analyzer_ver2 -c source.txt         (also print the generated p-code, see pl0_codegen.h)
+// ./semantic_analyzer_ver2 -r source.txt         (run the program on the VM instead, see pl0_vm.h)
+// ./semantic_analyzer_ver2 -r -t source.txt      (run it and report instructions executed per second)
+// ./semantic_analyzer_ver2 -r -F source.txt      (run or print p-code without superinstructions, see pl0_peephole.h)
+// ./semantic_analyzer_ver2 -R -t source.txt      (the same on the register VM, see pl0_regvm.h)
+// ./semantic_analyzer_ver2 -J -t source.txt      (compile the register code to x86-64 and run that, see pl0_jit.h)
+// ./semantic_analyzer_ver2 -C source.txt         (also print the register code, see pl0_regcode.h)
+// ./semantic_analyzer_ver2 -S source.txt > a.s   (x86-64 assembly instead, see pl0_asm.h; link with pl0_runtime.c)
+// ./semantic_analyzer_ver2 -E source.txt > a.c   (C instead, see pl0_cgen.h; gcc -O2 a.c -pthread)
+// ./semantic_analyzer_ver2 -O -J -t source.txt   (-R, -J, -S, -E and -C from the optimized SSA form, see pl0_ir.h)
+// ./semantic_analyzer_ver2 -I source.txt         (also print the optimized SSA form and what each pass did)
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <stdbool.h>
-
-#define TAB_WIDTH 4
-#define MAX_IDENT_LEN 11
-#define MAX_NUM_LEN 6
-#define MAX_PARAMS 10
-#define MAX_SYMBOLS 1024
-#define MAX_NESTING_DEPTH 100 
-int scope_stack[MAX_NESTING_DEPTH];
-int scope_stack_ptr = -1; 
-
-bool compilationErrorOccurred = false;
-
-
-typedef enum { KIND_CONST, KIND_VAR, KIND_PROC } ObjectKind;
-typedef enum { TYPE_NONE, TYPE_INTEGER, TYPE_ARRAY, TYPE_ERROR } DataType;
-
-const char* DataTypeStrings[] = {
-    "NONE",
-    "INTEGER",
-    "ARRAY",
-    "TYPE_ERROR"
+#include <time.h>
+#include "pl0_compiler.h"
+#include "pl0_codegen.h"
+#include "pl0_peephole.h"
+#include "pl0_vm.h"
+#include "pl0_regvm.h"
+#include "pl0_jit.h"
+#include "pl0_asm.h"
+#include "pl0_ir.h"
+#include "pl0_passes.h"
+#include "pl0_lower.h"
+#include "pl0_cgen.h"
+#include "pl0_batch.h"
+
+static const char *const astKindNames[] = {
+    "PROGRAM", "BLOCK", "PROCEDURE", "ASSIGN", "CALL", "BEGIN", "IF", "WHILE",
+    "FOR", "ODD", "COMPARE", "BINARY", "NEGATE", "NUMBER", "VARIABLE", "ELEMENT"
 };
-const char* datatype_to_string(DataType type) {
-    if (type >= TYPE_NONE && type <= TYPE_ERROR) { 
-        return DataTypeStrings[type];
-    }
-    return "UNKNOWN_DATATYPE";
-}
-
-typedef struct {
-    DataType type;
-    int value; // For constants
-    bool isConst; // For constants
-} SemanticProperties;
-
-typedef struct {
-    char name[MAX_IDENT_LEN + 1];
-    ObjectKind kind;
-    DataType type;     // Data type of the identifier
-    DataType elementType; // Type of elements in case of array
-    int value;         // For constants
-    int size;          // For arrays
-    int level;         // Scope level
-    int address;       // Address or offset
-    int numParams;
-    DataType formalParamTypes[MAX_PARAMS];
-} Symbol;
-
-Symbol symbolTable[MAX_SYMBOLS];
-int symbolCount = 0;
-int currentLevel = 0;
-
-void Enter(char *Id, ObjectKind kind, DataType type, int value, int size) {
-    if (symbolCount >= MAX_SYMBOLS) {
-        fprintf(stderr, "Symbol table overflow\n");
-        exit(EXIT_FAILURE);
-    }
-    strncpy(symbolTable[symbolCount].name, Id, MAX_IDENT_LEN);
-    symbolTable[symbolCount].name[MAX_IDENT_LEN] = '\0';
-    symbolTable[symbolCount].kind = kind;
-    symbolTable[symbolCount].type = type;
-    symbolTable[symbolCount].level = currentLevel;
-    symbolTable[symbolCount].address = symbolCount; 
-    symbolTable[symbolCount].value = value;
-    symbolTable[symbolCount].size = size;
-
-    if (type == TYPE_ARRAY) {
-        symbolTable[symbolCount].elementType = TYPE_INTEGER;
-    } else {
-        symbolTable[symbolCount].elementType = TYPE_NONE;
-    }
-
-    symbolCount++;
-}
-
-int Location(char *Id) {
-    int i;
-    int sptr_loop; 
-    for (sptr_loop = scope_stack_ptr; sptr_loop >= 0; sptr_loop--) {
-        int levelOfScopeBeingSearched = sptr_loop;
-        int scopeStartIndex = scope_stack[sptr_loop];
-        int scopeEndIndex;
-
-        if (levelOfScopeBeingSearched == 0) {
-            scopeStartIndex = 0;
-        } else {
-            scopeStartIndex = scope_stack[sptr_loop];
-        }
-
-        if (sptr_loop == scope_stack_ptr) {
-            scopeEndIndex = symbolCount - 1;
-        } else {
-            scopeEndIndex = scope_stack[sptr_loop + 1] - 1;
-        }
-
-        for (i = scopeEndIndex; i >= scopeStartIndex; i--) {
-            if (symbolTable[i].level == levelOfScopeBeingSearched && strcmp(symbolTable[i].name, Id) == 0) {
-                return i + 1;
-            }
-        }
-    }
-    return 0; 
-}
-
-int checkIdent(char *Id) {
-    if (scope_stack_ptr < 0) {
-        return 0; 
-    }
-    int currentScopeStartIndex = (scope_stack_ptr >= 0) ? scope_stack[scope_stack_ptr] : 0;
-    for (int i = symbolCount - 1; i >= currentScopeStartIndex; i--) {
-        if (strcmp(symbolTable[i].name, Id) == 0 && symbolTable[i].level == currentLevel) {
-            return 1;
-        }
-    }
-    return 0;
-}
 
-ObjectKind getKind(int idx) {
-    if (idx > 0 && idx <= symbolCount) {
-        return symbolTable[idx - 1].kind;
-    }
-    return -1; // Invalid index
-}
-
-typedef enum { // Token types in PL/0
-    NONE = 0, IDENT, NUMBER,
-    BEGIN, CALL, CONST, DO, ELSE, END, FOR, IF, ODD,
-    PROCEDURE, PROGRAM, THEN, TO, VAR, WHILE,
-    PLUS, MINUS, TIMES, SLASH, EQU, NEQ, LSS, LEQ, GTR, GEQ,
-    LPARENT, RPARENT, LBRACK, RBRACK, PERIOD, COMMA, SEMICOLON, ASSIGN, PERCENT,
-    EOFS
-} TokenType;
-
-const char* TokenTypeStrings[] = {
-    "NONE", "IDENT", "NUMBER",
-    "BEGIN", "CALL", "CONST", "DO", "ELSE", "END", "FOR", "IF", "ODD",
-    "PROCEDURE", "PROGRAM", "THEN", "TO", "VAR", "WHILE",
-    "PLUS", "MINUS", "TIMES", "SLASH", "EQU", "NEQ", "LSS", "LEQ", "GTR", "GEQ",
-    "LPARENT", "RPARENT", "LBRACK", "RBRACK", "PERIOD", "COMMA", "SEMICOLON", "ASSIGN", "PERCENT",
-    "EOFS"
-};
-const char* token_to_string(TokenType type) {
-    if (type >= NONE && type <= EOFS) { 
-        return TokenTypeStrings[type];
-    }
-    return "UNKNOWN_TOKEN"; 
-}
-const TokenType keywordTokens[] = {
-    BEGIN, CALL, CONST, DO, ELSE, END, FOR, IF, ODD,
-    PROCEDURE, PROGRAM, THEN, TO, VAR, WHILE
-};
-
-const char* keywords[] = {
-    "BEGIN", "CALL", "CONST", "DO", "ELSE", "END", "FOR", "IF", "ODD",
-    "PROCEDURE", "PROGRAM", "THEN", "TO", "VAR", "WHILE"
-};
-
-typedef struct {
-    TokenType type;
-    char lexeme[MAX_IDENT_LEN + 1];  // save identifier string
-    int numberValue;                 // Save number value for NUMBER
-    int line;
-    int col;
-} Token;
-
-const char* filename = NULL;
-static int global_currentLine = 1;
-static int global_currentCol = 1;
-Token previousToken;
-
-bool isStartOfStatement(TokenType type) {
-    return type == IDENT || type == CALL || type == BEGIN ||
-           type == IF || type == WHILE || type == FOR;
-}
-
-void showErrorContext(int line, int col, const char* filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) return;
-    char buf[512];
-    int currentLine = 1;
-    while (fgets(buf, sizeof(buf), file)) {
-        if (currentLine == line) {
-            fprintf(stderr, "%s", buf);
-            for (int i = 1; i < col; i++) fprintf(stderr, " ");
-            fprintf(stderr, "^\n");
-            break;
-        }
-        currentLine++;
-    }
-    fclose(file);
-}
-
-TokenType getToken(char *str) {
-    int numKeywords = sizeof(keywords) / sizeof(keywords[0]);  // Get number of keywords
-    for (int i = 0; i < numKeywords; i++) {
-        if (strcmp(str, keywords[i]) == 0) { // Compare input with keyword list
-            return keywordTokens[i]; // Return corresponding token
-        }
-    }
-    return IDENT; // If not a keyword, return IDENT
-}
-
-Token getNextToken(FILE *source) {
-    Token token = {NONE, "", 0, 0, 0};
-    int ch; 
-    // 1. Passing whitespace characters
-    do {
-        ch = fgetc(source);
-        if (ch == EOF) {
-            token.type = EOFS;
-            token.line = global_currentLine;
-            token.col = global_currentCol + 1;
-            return token;
-        }
-        if (ch == '\t'){
-            global_currentCol += TAB_WIDTH ; // Adjust for tab width
-        }
-        else if (ch == '\n') {
-            global_currentLine++;
-            global_currentCol = 1;
-        } else {
-            global_currentCol++;
-        }
-    } while (isspace(ch));
-
-    // 2. Read input character
-    int i = 0; // index for lexeme
-
-    // 2a. If it's a letter -> IDENT or KEYWORD
-    if (isalpha(ch)) {
-        char Id[MAX_IDENT_LEN + 1];
-        Id[i++] = toupper(ch); 
-        token.lexeme[0] = toupper(ch); 
-
-        while (i < MAX_IDENT_LEN) {
-            ch = fgetc(source);
-            if (isalnum(ch)) { // if character is a number or letter
-                Id[i++] = toupper(ch);
-                token.lexeme[i - 1] = toupper(ch); 
-                global_currentCol++;
-            } else {
-                ungetc(ch, source); // if not a number or letter, push back the character
-                break; 
-            }
-        }
-
-        Id[i] = '\0';
-        token.lexeme[i] = '\0';
-        if (i == MAX_IDENT_LEN) {
-            ch = fgetc(source);
-            if (isalnum(ch)) {
-                fprintf(stderr, "Lexical Error at Line %d, Column %d: Identifier '%s' too long\n", global_currentLine, global_currentCol, token.lexeme);
-                showErrorContext(global_currentCol, global_currentLine, filename);
-                do {
-                    ch = fgetc(source);
-                    global_currentCol++;
-                } while (isalnum(ch));
-
-                ungetc(ch, source);
-                token.type = NONE; // Error: identifier too long
-                return token;
-            } else {
-                ungetc(ch, source); 
-            }
-        }
-
-        token.type = getToken(Id); // Check if the identifier is a keyword
-        token.line = global_currentLine;
-        token.col = global_currentCol;
-
-    // 2b. If it's a number -> NUMBER
-    } else if (isdigit(ch)) {
-        char numStr[MAX_NUM_LEN + 1]; 
-        numStr[i++] = ch;
-        token.lexeme[0] = ch;
-        token.numberValue = ch - '0';
-
-        while (i < MAX_NUM_LEN) {
-            ch = fgetc(source);
-            if (isdigit(ch)) {
-                numStr[i++] = ch;
-                token.lexeme[i - 1] = ch;
-                token.numberValue = token.numberValue * 10 + (ch - '0');
-                global_currentCol++;
-            } else {
-                ungetc(ch, source); // Push back the character if it's not a digit
+// Print the subtree at 'node' and every node after it in its list, one node per line.
+void printAst(const Compiler *c, int node, int depth) {
+    for (; node != AST_NONE; node = c->ast.nodes[node].next) {
+        const AstNode *n = &c->ast.nodes[node];
+        printf("%*s%s", depth * 2, "", astKindNames[n->kind]);
+        switch (n->kind) {
+            case AST_PROCEDURE: case AST_ASSIGN: case AST_CALL: case AST_FOR: case AST_VARIABLE: case AST_ELEMENT:
+                printf(" %s", internedName(&c->names, c->symbolTable[n->a].nameId));
+                break;
+            case AST_COMPARE: case AST_BINARY:
+                printf(" %s", token_to_string((TokenType)n->op));
+                break;
+            case AST_NUMBER:
+                printf(" %d", n->a);
+                break;
+            default:
                 break;
-            }
-        }
-
-        numStr[i] = '\0';
-        token.lexeme[i] = '\0';
-
-        if (i == MAX_NUM_LEN) {
-            ch = fgetc(source);
-            if (isdigit(ch)) {
-                fprintf(stderr, "Lexical Error at Line %d, Column %d: Number '%s' too long\n", global_currentLine, global_currentCol, token.lexeme);
-                showErrorContext(global_currentLine, global_currentCol, filename);
-                do {
-                    ch = fgetc(source);
-                    global_currentCol++;
-                } while (isdigit(ch));
-                ungetc(ch, source);
-                token.type = NONE; // Error: number too long
-                return token;
-            } else {
-                ungetc(ch, source); // Push back the character if it's not a digit
-            }
         }
-        token.type = NUMBER;
-        token.line = global_currentLine;
-        token.col = global_currentCol;
-
-    // 2c. If it's a special character -> check for operators and delimiters
-    } else {
-        token.lexeme[i++] = ch; 
-        switch (ch) {
-            case '+': token.type = PLUS; break;
-            case '-': token.type = MINUS; break;
-            case '*': token.type = TIMES; break;
-            case '/': token.type = SLASH; break;
-            case '%': token.type = PERCENT; break;
-            case '=': token.type = EQU; break;
-            case '(': token.type = LPARENT; break;
-            case ')': token.type = RPARENT; break;
-            case '[': token.type = LBRACK; break;
-            case ']': token.type = RBRACK; break;
-            case ',': token.type = COMMA; break;
-            case ';': token.type = SEMICOLON; break;
-            case '.': token.type = PERIOD; break;
-            case '<':
-                ch = fgetc(source); 
-                if (ch == '=') {
-                    global_currentCol++;
-                    token.type = LEQ;
-                    token.lexeme[i++] = ch;
-                } else if (ch == '>') {
-                    global_currentCol++;
-                    token.type = NEQ;
-                    token.lexeme[i++] = ch;
-                } else {
-                    token.type = LSS;
-                    ungetc(ch, source); // Push back if not '=' or '>'
-                }
+        printf("  (line %d)\n", n->line);
+        switch (n->kind) {
+            case AST_PROGRAM: case AST_BEGIN: case AST_ODD: case AST_NEGATE:
+                printAst(c, n->a, depth + 1);
                 break;
-            case '>':
-                ch = fgetc(source); 
-                if (ch == '=') {
-                    token.type = GEQ;
-                    token.lexeme[i++] = ch;
-                    global_currentCol++;
-                } else {
-                    token.type = GTR;
-                    ungetc(ch, source); // Push back if not '='
-                }
+            case AST_BLOCK: case AST_WHILE: case AST_COMPARE: case AST_BINARY:
+                printAst(c, n->a, depth + 1);
+                printAst(c, n->b, depth + 1);
                 break;
-            case ':':
-                ch = fgetc(source); 
-                if (ch == '=') {
-                    token.type = ASSIGN;
-                    token.lexeme[i++] = ch;
-                    global_currentCol++;
-                } else {
-                    ungetc(ch, source); // Push back if not '='
-                    fprintf(stderr, "Lexical Error at Line %d, Column %d: Unexpected character ':'\n", global_currentLine, global_currentCol);
-                    showErrorContext(global_currentLine, global_currentCol, filename);
-                    token.type = NONE; // Error: ':' not followed by '='
-                    return token;
-                }
+            case AST_PROCEDURE: case AST_CALL: case AST_ELEMENT:
+                printAst(c, n->b, depth + 1);
+                break;
+            case AST_ASSIGN: case AST_FOR: // FOR: start and end value, then the body
+                printAst(c, n->b, depth + 1);
+                printAst(c, n->c, depth + 1);
+                break;
+            case AST_IF:
+                printAst(c, n->a, depth + 1);
+                printAst(c, n->b, depth + 1);
+                printAst(c, n->c, depth + 1);
                 break;
             default:
-                fprintf(stderr, "Lexical Error at Line %d, Column %d: Unknown character '%c'\n", global_currentLine, global_currentCol, ch);
-                showErrorContext(global_currentLine, global_currentCol, filename);
-                token.type = NONE; // Error: unknown character
-                return token;
+                break;
         }
-        token.lexeme[i] = '\0'; // Null-terminate the lexeme
-        token.line = global_currentLine;
-        token.col = global_currentCol;
     }
-
-    return token;
 }
 
-Token currentToken;
-FILE *inputFile;
-
-const char* token_to_string(TokenType type);
-const char* datatype_to_string(DataType type);
-
-void addError(Token t, const char *msg) {
-    compilationErrorOccurred = true;
-    fprintf(stderr, "Error at Line %d, Column %d (near token '%s'): %s\n",
-            t.line, t.col, t.lexeme, msg);
-    if (filename) {
-        showErrorContext(t.line, t.col, filename);
+// Print generated code, one instruction per line. The instructions a
+// superinstruction covers are marked with '+'.
+void printCode(const Code *code) {
+    int covered = 0;
+    for (int i = 0; i < code->count; i++) {
+        const Instruction *in = &code->code[i];
+        printf("%6d %c%-4s %3d %10d   (line %d)\n", i, covered > 0 ? '+' : ' ', opcodeNames[in->op], in->level, in->a,
+               code->lines[i]);
+        covered = covered > 0 ? covered - 1 : instructionLength(in->op) - 1;
     }
 }
-// Error handling function
-void Error(Token t, const char *msg) {
-    fprintf(stderr, "Syntax Error at Line %d, Column %d (near token '%s'): %s\n",
-            t.line, t.col, t.lexeme, msg);
-    showErrorContext(t.line, t.col, filename);
-    exit(EXIT_FAILURE);
-}
 
-// Function to consume the current token and get the next one
-void consumeToken() {
-    previousToken = currentToken;
-    currentToken = getNextToken(inputFile);
-}
-
-void program();
-void block();
-void statement();
-SemanticProperties expression();
-SemanticProperties condition();
-SemanticProperties term();
-SemanticProperties factor();
-
-void compileDeclareVariable(void) {
-    Token identToken;
-    if (currentToken.type == IDENT) {
-        identToken = currentToken;
-        
-        if (checkIdent(currentToken.lexeme) != 0) {
-            Error(currentToken, "Variable name already declared in this scope");
-            return;
-        }
-        consumeToken();
-        if (currentToken.type == LBRACK) {
-            // Array declaration handling (example: VAR arr[10];)
-            consumeToken();
-            if (currentToken.type == NUMBER) {
-                int arraySize = currentToken.numberValue;
-                consumeToken();
-                if (currentToken.type == RBRACK) {
-                    consumeToken();
-                    Enter(identToken.lexeme, KIND_VAR, TYPE_ARRAY, 0, arraySize);
-                } else {
-                    Error(currentToken, "Expected ']' after array size");
-                }
-            } else {
-                Error(currentToken, "Expected array size after '['");
-            }
-        } else {
-            Enter(identToken.lexeme, KIND_VAR, TYPE_INTEGER, 0, 0);
-        }
-    } else {
-        Error(currentToken, "Missing variable name in declaration");
+// Generate p-code, fusing superinstructions unless 'plain'.
+int generateRunnableCode(const Compiler *c, Code *code, int plain) {
+    if (generateCode(c, code) != 0) {
+        return -1;
     }
+    return plain || fuseSuperinstructions(code) >= 0 ? 0 : -1;
 }
 
-void compileDeclareConstant(void){
-    Token identToken;
-    int constValue;
-    if (currentToken.type == IDENT) {
-        identToken = currentToken;
-        if (checkIdent(currentToken.lexeme) == 0) {
-            consumeToken();
-            if (currentToken.type == EQU) {
-                consumeToken();
-                if (currentToken.type == NUMBER) {
-                    constValue = currentToken.numberValue;
-                    consumeToken();
-                    Enter(identToken.lexeme, KIND_CONST, TYPE_INTEGER, constValue, 0);
-                } else {
-                    Error(currentToken, "Expected constant value after '='");
-                }
-            }
-        } else {
-            Error(currentToken, "Constant name already declared in this scope");
-        }
-    } else {
-        Error(currentToken, "Missing constant name in declaration");
-    }
-}
-
-void compileDeclareProcedure(void) {
-    Token procIdentToken;
-    Symbol* currentProcedureSymbol = NULL;
-    int previousLevel = currentLevel;
-
-    if (currentToken.type == IDENT) {
-        procIdentToken = currentToken;
-        if (checkIdent(currentToken.lexeme) == 0) {
-            Enter(currentToken.lexeme, KIND_PROC, TYPE_NONE, 0, 0);
-            if (symbolCount > 0) {
-                currentProcedureSymbol = &symbolTable[symbolCount - 1];
-            } else {
-                Error(procIdentToken, "Failed to enter procedure in symbol table");
-                return;
-            }
-            consumeToken();
-            currentLevel++;
-            scope_stack_ptr++;
-            if (scope_stack_ptr >= MAX_NESTING_DEPTH) {
-                fprintf(stderr, "Critical Error: Maximum nesting depth exceeded for procedure %s.\n", procIdentToken.lexeme);
-                currentLevel = previousLevel;
-                scope_stack_ptr--; 
-                exit(EXIT_FAILURE);
-            }
-            scope_stack[scope_stack_ptr] = symbolCount;
-        } else {
-            Error(currentToken, "Procedure name already declared in this scope");
-        }
-    } else {
-        Error(currentToken, "Missing procedure name in declaration");
-    }
-
-    if (currentToken.type == LPARENT) {
-        consumeToken();
-        if (currentToken.type == VAR || currentToken.type == IDENT) { 
-            do {
-                bool isVarParam = false; 
-                if (currentToken.type == VAR) {
-                    isVarParam = true;
-                    consumeToken();
-                }
-
-                if (currentToken.type == IDENT) {
-                    Token paramToken = currentToken;
-                    if (checkIdent(paramToken.lexeme) != 0) {
-                        Error(paramToken, "Parameter name already declared in this procedure's scope");
-                    } else {
-                        Enter(paramToken.lexeme, KIND_VAR, TYPE_INTEGER, 0, 0);
-
-                        if (currentProcedureSymbol != NULL) {
-                            if (currentProcedureSymbol->numParams < MAX_PARAMS) {
-                                currentProcedureSymbol->formalParamTypes[currentProcedureSymbol->numParams] = TYPE_INTEGER;
-                            } else {
-                                Error(paramToken, "Too many parameters for procedure.");
-                            }
-                            currentProcedureSymbol->numParams++;
-                        }
-                    }
-                    consumeToken(); 
-                } else {
-                    Error(currentToken, "Expected parameter name (identifier).");
-                    currentLevel = previousLevel;
-                    scope_stack_ptr--;
-                    return;
-                }
-
-                if (currentToken.type == SEMICOLON) { 
-                    consumeToken();
-                    if (currentToken.type != IDENT && currentToken.type != VAR) {
-                        Error(currentToken, "Expected parameter declaration after ';'.");
-                        currentLevel = previousLevel;
-                        scope_stack_ptr--;
-                        return;
-                    }
-                } else if (currentToken.type != RPARENT) {
-                    Error(currentToken, "Expected ';' or ')' in parameter list.");
-                    currentLevel = previousLevel;
-                    scope_stack_ptr--; 
-                    return;
-                }
-            } while (currentToken.type != RPARENT);
-            if (currentToken.type == RPARENT) {
-            consumeToken(); 
-            }  
-        } else {
-            Error(currentToken, "Expected parameter declaration (IDENT or VAR) after '('. An empty parameter list '()' is not allowed.");
-            currentLevel = previousLevel;
-            scope_stack_ptr--;
-            return;
-        }
-    }
-    if (currentToken.type == SEMICOLON) {
-        consumeToken();
-    } else {
-        addError(previousToken, "Expected ';' after procedure header.");
-        compilationErrorOccurred = true;
+// Print generated register code, one instruction per line.
+void printRegCode(const RegCode *code) {
+    for (int i = 0; i < code->count; i++) {
+        const RegInstruction *in = &code->code[i];
+        printf("%6d  %-5s %10d %10d %10d %10d   (line %d)\n",
+               i, regOpcodeNames[in->op], in->a, in->b, in->c, in->d, code->lines[i]);
     }
-    block();
-    currentLevel = previousLevel;
-    scope_stack_ptr--;  
 }
 
-SemanticProperties factor() {
-    SemanticProperties result;
-    result.type = TYPE_NONE; // Default type
-    result.isConst = false; // Default is not constant
-
-    Token identToken;
-
-    if (currentToken.type == IDENT) {
-        identToken = currentToken;
-        int p = Location(currentToken.lexeme);
-            if (p == 0) {
-                Error(currentToken, "Variable not declared before use");
+// Print the IR of every function, block by block.
+void printIr(const IrProgram *p) {
+    const Compiler *c = p->c;
+    for (int fi = 0; fi < p->count; fi++) {
+        const IrFunction *f = &p->functions[fi];
+        printf("\n%s %s (level %d, %d cells):\n", f->symbol != IR_NONE ? "Procedure" : "Program",
+               f->symbol != IR_NONE ? internedName(&c->names, c->symbolTable[f->symbol].nameId) : "main",
+               f->level, f->variables);
+        for (int b = 0; b < f->blockCount; b++) {
+            const IrBlock *block = &f->blocks[b];
+            if (block->first == IR_NONE) {
+                continue;
+            }
+            printf("  b%d:", b);
+            for (int w = 0; w < 2; w++) {
+                if (block->pred[w] != IR_NONE) printf("%s b%d", w == 0 ? "  from" : ",", block->pred[w]);
             }
-            Symbol* sym = &symbolTable[p - 1];
-            consumeToken(); 
-
-            if (sym->kind == KIND_CONST){
-                result.type = TYPE_INTEGER;
-                result.value = sym->value;
-                result.isConst = true;
-                if (currentToken.type == LBRACK) {
-                    Error(identToken, "Constant is not an array, cannot use subscript.");       
-                }
-            } else if (sym->kind == KIND_VAR) {
-                if (sym->type == TYPE_INTEGER){
-                    result.type = TYPE_INTEGER;
-                    if (currentToken.type == LBRACK) {
-                        Error(identToken, "Variable is not an array (it's an INTEGER), cannot use subscript.");
-                    }
-                } else if (sym->type == TYPE_ARRAY){
-
-                    result.isConst = false;
-
-                    if (currentToken.type == LBRACK){
-                        consumeToken();
-                        SemanticProperties indexProps = expression();
-
-                        if (indexProps.type != TYPE_INTEGER) {
-                            Error(currentToken, "Array index must be an integer expression");
-                            result.type = TYPE_ERROR;
-                    } else {
-                        if (indexProps.isConst) {
-                            int indexValue = indexProps.value;
-                            if (indexValue < 0 || indexValue >= sym->size) {
-                                char msg[150];
-                                sprintf(msg, "Semantic error: Array index [%d] for array '%s' is out of bounds (size: %d, valid indices: 0..%d).",
-                                        indexValue, sym->name, sym->size, sym->size - 1);
-                                Error(identToken, msg); 
-                                result.type = TYPE_ERROR; 
-                            }
+            printf("\n");
+            for (int i = block->first; i != IR_NONE; i = f->code[i].next) {
+                const IrInstruction *in = &f->code[i];
+                if (in->op == IR_NOP) continue;
+                printf("    ");
+                if (irHasValue(in->op)) printf("v%d = ", i);
+                printf("%s", irOpcodeNames[in->op]);
+                if (in->symbol != IR_NONE) printf(" %s", internedName(&c->names, c->symbolTable[in->symbol].nameId));
+                switch ((IrOpcode)in->op) {
+                    case IR_CONST:
+                        printf(" %d", in->k);
+                        break;
+                    case IR_CALL:
+                        for (int a = 0; a < f->arguments[in->k]; a++) {
+                            printf("%s v%d", a > 0 ? "," : "", f->arguments[in->k + 1 + a]);
                         }
-                    }
-                    if (result.type != TYPE_ERROR) {
-                        result.type = sym->elementType;
-                    }
-                    if (currentToken.type == RBRACK) {
-                        consumeToken();
-                    } else {
-                        Error(currentToken, "Expected ']' after array index expression");
-                        result.type = TYPE_ERROR;
-                    }  
-                } else{
-                    Error(identToken, "Cannot use an entire array in this expression context");
-                    result.type = TYPE_ERROR;
+                        break;
+                    case IR_BRANCH:
+                        printf(" v%d %s", in->a, in->k == ODD ? "odd" : token_to_string((TokenType)in->k));
+                        if (in->b != IR_NONE) printf(" v%d", in->b);
+                        printf(" -> b%d, b%d", block->succ[0], block->succ[1]);
+                        break;
+                    case IR_JUMP:
+                        printf(" -> b%d", block->succ[0]);
+                        break;
+                    default:
+                        if (in->a != IR_NONE) printf(" v%d", in->a);
+                        if (in->b != IR_NONE) printf(", v%d", in->b);
+                        if (in->op == IR_READ || in->op == IR_WRITE) printf("%s", in->k ? " ln" : "");
+                        break;
                 }
-            } else{
-                Error(identToken, "Identifier is not a variable or constant");
-                result.type = TYPE_ERROR;
+                printf("   (line %d)\n", in->line);
             }
-        }  
-    } else if (currentToken.type == NUMBER) {
-        result.type = TYPE_INTEGER;
-        result.value = currentToken.numberValue;
-        result.isConst = true;
-        consumeToken(); 
-    } else if (currentToken.type == LPARENT) {
-        consumeToken(); 
-        result = expression();  
-        if (currentToken.type == RPARENT) { 
-            consumeToken(); 
-        } else {
-            Error(previousToken, "Expected ')' after expression in parentheses");
-            result.type = TYPE_ERROR;
-            result.isConst = false;
         }
-    } else {
-        Error(previousToken, "Invalid factor: Expected Identifier, Number, or '('");
-        result.type = TYPE_ERROR;
-        result.isConst = false;
     }
-
-    return result;
 }
 
-SemanticProperties term() {
-    SemanticProperties leftProps = factor();
-    while (currentToken.type == TIMES || currentToken.type == SLASH || currentToken.type == PERCENT) {
-        Token operatorToken = currentToken;
-        consumeToken();
-        SemanticProperties rightProps = factor();
-
-        if (leftProps.type != TYPE_INTEGER || rightProps.type != TYPE_INTEGER) {
-            if (leftProps.type != TYPE_ERROR && rightProps.type != TYPE_ERROR) { 
-                char msg[150];
-                sprintf(msg, "Type mismatch for operator '%s'. Both operands must be INTEGER, but found '%s' and '%s'.",
-                        token_to_string(operatorToken.type),
-                        datatype_to_string(leftProps.type),
-                        datatype_to_string(rightProps.type));
-                Error(operatorToken, msg);
-            }
-            leftProps.type = TYPE_ERROR;
-            leftProps.isConst = false;
-        } else { 
-            leftProps.type = TYPE_INTEGER; 
-
-            bool compileTimeErrorOccurred = false;
-
-            if (operatorToken.type == SLASH) {
-                if (rightProps.isConst && rightProps.value == 0) {
-                    Error(operatorToken, "Semantic error: Division by constant zero.");
-                    leftProps.type = TYPE_ERROR;
-                    leftProps.isConst = false;
-                    compileTimeErrorOccurred = true;
-                }
-            } else if (operatorToken.type == PERCENT) {
-                if (rightProps.isConst && rightProps.value == 0) {
-                    Error(operatorToken, "Semantic error: Modulo by constant zero.");
-                    leftProps.type = TYPE_ERROR;
-                    leftProps.isConst = false;
-                    compileTimeErrorOccurred = true;
-                }
-            }
-
-           
-            if (!compileTimeErrorOccurred) {
-                if (leftProps.isConst && rightProps.isConst) {
-                    leftProps.isConst = true;
-                    switch (operatorToken.type) {
-                        case TIMES:
-                            leftProps.value = leftProps.value * rightProps.value;
-                            break;
-                        case SLASH:
-                            leftProps.value = leftProps.value / rightProps.value;
-                            break;
-                        case PERCENT:
-                            leftProps.value = leftProps.value % rightProps.value;
-                            break;
-                        default:
-                            break;
-                    }
-                } else {
-                    leftProps.isConst = false;
-                }
-            }
-        }
-        if (rightProps.type == TYPE_ERROR && leftProps.type != TYPE_ERROR) {
-             leftProps.type = TYPE_ERROR;
-             leftProps.isConst = false;
-        }
+// Print what each pass did.
+static void printPassRuns(FILE *out, const IrPassRun *runs, int count) {
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "  %-6s %9.6f s  %7ld changed  %8ld -> %ld instructions\n",
+                runs[i].name, runs[i].seconds, runs[i].changed, runs[i].before, runs[i].after);
     }
-    return leftProps;
 }
 
-SemanticProperties expression() {
-    SemanticProperties resultProps;
-    TokenType unaryOperator = NONE;
-    if (currentToken.type == PLUS || currentToken.type == MINUS) {
-        unaryOperator = currentToken.type;
-        consumeToken();
+// Build the program's SSA form and run the optimization passes over it,
+// reporting with 'timed' what each did on stderr. Returns 0, or -1 if memory ran out.
+int optimizeProgram(const Compiler *c, IrProgram *ir, IrPassRun *runs, int timed) {
+    if (buildIr(c, ir) != 0) {
+        return -1;
     }
-    resultProps = term();
-    if (unaryOperator != NONE) {
-        if (resultProps.type != TYPE_INTEGER) {
-            if (resultProps.type != TYPE_ERROR) {
-                char msg[150];
-                sprintf(msg, "Unary operator '%s' can only be applied to an INTEGER, but found '%s'.",
-                        token_to_string(unaryOperator),
-                        datatype_to_string(resultProps.type));
-                Error(previousToken, msg); 
-                resultProps.type = TYPE_ERROR;
-            }
-            resultProps.isConst = false; 
-        } else {
-            if (resultProps.isConst && unaryOperator == MINUS) {
-                resultProps.value = -resultProps.value;
-            }
-        }
+    if (runIrPasses(ir, irPipeline, IR_PIPELINE_LENGTH, runs) != 0) {
+        freeIr(ir);
+        return -1;
     }
-    while (currentToken.type == PLUS || currentToken.type == MINUS) {
-        Token operatorToken = currentToken;
-        consumeToken(); 
-        SemanticProperties rightProps = term();
-        if (resultProps.type != TYPE_INTEGER || rightProps.type != TYPE_INTEGER) {
-            if (resultProps.type != TYPE_ERROR && rightProps.type != TYPE_ERROR) {
-                char msg[150];
-                sprintf(msg, "Type mismatch for binary operator '%s'. Both operands must be INTEGER, but found '%s' and '%s'.",
-                        token_to_string(operatorToken.type),
-                        datatype_to_string(resultProps.type),
-                        datatype_to_string(rightProps.type));
-                Error(operatorToken, msg);
-            }
-            resultProps.type = TYPE_ERROR;
-            resultProps.isConst = false;
-        } else {
-            resultProps.type = TYPE_INTEGER; 
-
-            if (resultProps.isConst && rightProps.isConst) {
-
-                resultProps.isConst = true;
-                if (operatorToken.type == PLUS) {
-                    resultProps.value = resultProps.value + rightProps.value;
-                } else { // MINUS
-                    resultProps.value = resultProps.value - rightProps.value;
-                }
-            } else {
-                resultProps.isConst = false;
-            }
-        }
-
-        if (rightProps.type == TYPE_ERROR) {
-            resultProps.type = TYPE_ERROR;
-            resultProps.isConst = false;
-        }
+    if (timed) {
+        printPassRuns(stderr, runs, IR_PIPELINE_LENGTH);
     }
-
-    return resultProps;
+    return 0;
 }
 
-SemanticProperties condition() {
-    SemanticProperties result;
-    result.type = TYPE_NONE; 
-    result.isConst = false;  
-    result.value = 0; 
-    Token errorReportingToken;
-    if (currentToken.type == ODD) { 
-        errorReportingToken = currentToken;
-        consumeToken(); 
-        SemanticProperties exprProps = expression();
-        if (exprProps.type == TYPE_ERROR) {
-            result.type = TYPE_ERROR; 
-            return result;
-        }
-        if (exprProps.type != TYPE_INTEGER) {
-            result.type = TYPE_ERROR;
-            char msg[150];
-            sprintf(msg, "Operand for ODD must be an INTEGER expression, but found '%s'.", datatype_to_string(exprProps.type));
-            Error(errorReportingToken, msg);
-        }
-    } else { 
-        SemanticProperties leftExprProps = expression();
-        if (currentToken.type == EQU || currentToken.type == NEQ || currentToken.type == LSS ||
-            currentToken.type == LEQ || currentToken.type == GTR || currentToken.type == GEQ) {
-            Token relOpToken = currentToken; 
-            consumeToken(); 
-            SemanticProperties rightExprProps = expression();
-            if (leftExprProps.type == TYPE_ERROR || rightExprProps.type == TYPE_ERROR) {
-                result.type = TYPE_ERROR;
-                return result;
-            }
-
-            if (leftExprProps.type != TYPE_INTEGER || rightExprProps.type != TYPE_INTEGER) {
-                result.type = TYPE_ERROR;
-                char msg[200];
-                sprintf(msg, "Type mismatch for relational operator '%s'. Both operands must be INTEGER, but found '%s' and '%s'.",
-                        token_to_string(relOpToken.type),
-                        datatype_to_string(leftExprProps.type),
-                        datatype_to_string(rightExprProps.type));
-                Error(relOpToken, msg); 
-            }
-        } else {
-            result.type = TYPE_ERROR;
-            Error(previousToken, "Expected a relational operator (=, <>, <, <=, >, >=) in condition");
-        }
+// Generate register code from the tree, or with 'optimize' from the optimized SSA form.
+int generateRegisterCode(const Compiler *c, RegCode *code, int optimize, int timed) {
+    if (!optimize) {
+        return generateRegCode(c, code);
     }
-    return result;
-}
-
-void statement() {
-    Token identToken; 
-    int loc;
-    Symbol* sym;
-    SemanticProperties props, props2, indexProps;
-
-    switch (currentToken.type) {
-        case IDENT: 
-            identToken = currentToken;
-            loc = Location(identToken.lexeme);
-
-            if (loc == 0) {
-                Error(identToken, "Identifier not declared (used in assignment)");
-                return;
-            }
-            sym = &symbolTable[loc - 1];
-
-            if (sym->kind != KIND_VAR) {
-                Error(identToken, "Identifier on the left side of assignment must be a variable.");
-                return;
-            }
-
-            consumeToken(); 
-
-            if (currentToken.type == LBRACK) { 
-                if (sym->type != TYPE_ARRAY) {
-                    Error(identToken, "Identifier is not an array, cannot use subscript.");
-                    return;
-                }
-                consumeToken(); 
-                indexProps = expression(); 
-
-                if (indexProps.type != TYPE_INTEGER) {
-                    Error(currentToken, "Array index must be an integer expression.");
-                }
-
-                if (currentToken.type == RBRACK) {
-                    consumeToken(); 
-                } else {
-                    Error(currentToken, "Expected ']' after array index.");
-                    return;
-                }
-
-                if (currentToken.type == ASSIGN) {
-                    consumeToken(); 
-                    props = expression(); 
-
-                    if (sym->elementType != props.type && props.type != TYPE_ERROR) {
-                        char msg[150];
-                        sprintf(msg, "Type mismatch in assignment to array element.",sym->name);
-                        Error(identToken, msg); 
-                    }
-                } else {
-                    Error(currentToken, "Expected ':=' after array element access in assignment.");
-                }
-
-            } else { 
-                if (sym->type == TYPE_ARRAY) {
-                    Error(identToken, "Cannot assign to an entire array. Must specify an index or use a scalar variable.");
-
-                    return;
-                }
-                if (currentToken.type == ASSIGN) {
-                    consumeToken(); 
-                    props = expression(); 
-
-                    if (sym->type != props.type && props.type != TYPE_ERROR) {
-                        char msg[150];
-                        sprintf(msg, "Type mismatch in assignment.",
-                                sym->name);
-                        Error(identToken, msg);
-                    }
-                } else {
-                    Error(currentToken, "Expected ':=' after variable name in assignment.");
-                }
-            }
-            break;
-
-        case CALL:
-            consumeToken(); 
-            if (currentToken.type == IDENT) {
-                identToken = currentToken;
-                loc = Location(identToken.lexeme);
-                if (loc == 0) {
-                    Error(identToken, "Procedure not declared.");
-                    return;
-                }
-                sym = &symbolTable[loc - 1];
-                if (sym->kind != KIND_PROC) {
-                    Error(identToken, "Identifier is not a procedure.");
-                    return;
-                }
-                consumeToken(); 
-
-                int actualParamCount = 0;
-                SemanticProperties actualParamProps[MAX_PARAMS]; 
-
-                if (currentToken.type == LPARENT) {
-                    consumeToken(); 
-                    if (currentToken.type != RPARENT) { 
-                        do {
-                            if (actualParamCount > 0) { 
-                                if (currentToken.type == COMMA) {
-                                    consumeToken(); 
-                                } else {
-                                    Error(currentToken, "Expected ',' or ')' in procedure call arguments.");
-                                    return;
-                                }
-                            }
-                            if (actualParamCount < MAX_PARAMS) {
-                                actualParamProps[actualParamCount] = expression();
-                            } else {
-                                Error(currentToken, "Too many arguments in procedure call (exceeds internal limit).");
-                                expression();
-                            }
-                            actualParamCount++;
-                        } while (currentToken.type == COMMA);
-                    }
-                    if (currentToken.type == RPARENT) {
-                        consumeToken(); 
-                    } else {
-                        Error(currentToken, "Expected ')' after procedure call arguments.");
-                        return;
-                    }
-                } 
-                if (actualParamCount != sym->numParams) {
-                    char msg[100];
-                    sprintf(msg, "Incorrect number of arguments for procedure '%s'. Expected %d, got %d.",
-                            sym->name, sym->numParams, actualParamCount);
-                    Error(identToken, msg);
-                } else {
-                    for (int i = 0; i < actualParamCount; i++) {
-                        if (actualParamProps[i].type != sym->formalParamTypes[i] && actualParamProps[i].type != TYPE_ERROR) {
-                            char msg[150];
-                            sprintf(msg, "Type mismatch for argument %d of procedure '%s'. Expected '%s', got '%s'.",
-                                    i + 1, sym->name,
-                                    datatype_to_string(sym->formalParamTypes[i]),
-                                    datatype_to_string(actualParamProps[i].type));
-                            Error(identToken, msg);
-                        }
-                    }
-                }
-            } else {
-                Error(currentToken, "Expected procedure name after CALL.");
-            }
-            break;
-
-        case BEGIN:
-            consumeToken();
-            if (isStartOfStatement(currentToken.type)) {
-                statement(); 
-            } else if (currentToken.type != END) {
-                addError(currentToken, "Expected a statement or END after BEGIN.");
-            }
-            while (currentToken.type == SEMICOLON || isStartOfStatement(currentToken.type)) {
-                Token tokenForMissingSemicolonError = currentToken;
-
-                if (currentToken.type == SEMICOLON) {
-                    consumeToken(); 
-                    if (!isStartOfStatement(currentToken.type)) {
-                        if (currentToken.type == END) {
-                            break; 
-                        }
-                        addError(currentToken, "Expected a statement or END after ';'.");
-                        break;
-                    }
-                } else {
-                    addError(tokenForMissingSemicolonError, "Missing ';' before this statement.");
-                }
-                if (isStartOfStatement(currentToken.type)) {
-                    statement(); 
-                } else {
-                    if (currentToken.type != END) {
-                        addError(currentToken, "Expected a statement to follow after handling semicolon (or missing semicolon).");
-                    }
-                    break;
-                }
-            }
-            if (currentToken.type == END) {
-                consumeToken();
-            } else {
-                Token errorToken = (currentToken.type == PERIOD || currentToken.type == EOFS) ? currentToken : previousToken;
-                addError(errorToken, "Expected 'END' keyword to close BEGIN...END statement.");
-            }
-            break;
-
-        case IF:
-            consumeToken();
-            props = condition();
-            if (currentToken.type == THEN) {
-                consumeToken();
-            } else {
-                Error(previousToken, "Expected 'THEN' after condition in IF statement");
-            }
-            statement();
-            if (currentToken.type == ELSE) {
-                consumeToken();
-                statement();
-            }
-            break;
-
-        case WHILE:
-            consumeToken();
-            props = condition();
-            if (currentToken.type == DO) {
-                consumeToken();
-            } else {
-                Error(previousToken, "Expected 'DO' after condition in WHILE statement");
-            }
-            statement();
-            break;
-
-        case FOR:
-            consumeToken();
-            if (currentToken.type == IDENT) {
-                identToken = currentToken;
-                loc = Location(identToken.lexeme);
-                if (loc == 0) {
-                    Error(identToken, "Variable not declared for loop variable");
-                    return;
-                } else {
-                    sym = &symbolTable[loc - 1];
-                    if (sym->kind != KIND_VAR || sym->type != TYPE_INTEGER) {
-                        Error(identToken, "Loop control variable must be an INTEGER variable");
-                        return;
-                    }
-                }
-                consumeToken();
-            } else {
-                Error(previousToken, "Expected identifier for loop variable after FOR");
-            }
-            if (currentToken.type == ASSIGN) {
-                consumeToken();
-            } else {
-                Error(previousToken, "Expected ':=' after loop variable in FOR statement");
-            }
-            
-            props = expression();
-            if (props.type != TYPE_INTEGER && props.type != TYPE_ERROR) {
-                Error(previousToken, "FOR loop start expression must be INTEGER type");
-                return;
-            }
-            if (currentToken.type == TO) {
-                consumeToken();
-            } else {
-                Error(previousToken, "Expected 'TO' after starting value in FOR statement");
-            }
-            props2 = expression();
-            if (props2.type != TYPE_INTEGER && props2.type != TYPE_ERROR) {
-                Error(previousToken, "FOR loop end expression must be INTEGER type.");
-            }
-            if (currentToken.type == DO) {
-                consumeToken();
-            } else {
-                Error(previousToken, "Expected 'DO' after ending value in FOR statement");
-            }
-            statement();
-            break;
-
-        default:
-            break;
+    IrProgram ir;
+    IrPassRun runs[IR_PIPELINE_LENGTH];
+    if (optimizeProgram(c, &ir, runs, timed) != 0) {
+        return -1;
     }
+    int rc = lowerIr(&ir, code);
+    freeIr(&ir);
+    return rc;
 }
 
-void block() {
-    if (currentToken.type == CONST) {
-        consumeToken(); 
-        compileDeclareConstant();
-        while (currentToken.type == COMMA) {
-            consumeToken(); 
-            compileDeclareConstant();
-        }
-
-        if (currentToken.type == SEMICOLON) {
-            consumeToken();
-        } else {
-            addError(previousToken, "Expected ';' after CONST declarations");
-        }
-    } 
-
-    if (currentToken.type == VAR) {
-        consumeToken(); 
-        compileDeclareVariable();
-        while (currentToken.type == COMMA) {
-            consumeToken(); 
-            compileDeclareVariable();
-        }
-        if (currentToken.type == SEMICOLON) {
-            consumeToken(); 
-        } else {
-            addError(previousToken, "Expected ';' after VAR declarations");
-        }
-    } 
-
-    while (currentToken.type == PROCEDURE) {
-        consumeToken(); 
-        compileDeclareProcedure();
-        
-        if (currentToken.type == SEMICOLON) {
-            consumeToken(); 
-        } else {
-            addError(previousToken, "Expected ';' after procedure block");
-        }
-    } 
-
-    if (currentToken.type == BEGIN) { 
-        consumeToken(); 
-        if (isStartOfStatement(currentToken.type)) { 
-            statement(); 
-        } else if (currentToken.type != END) {
-             addError(currentToken, "Expected a statement or END after BEGIN.");
-        }
-        while (currentToken.type == SEMICOLON || isStartOfStatement(currentToken.type)) {
-            Token tokenForMissingSemicolonError = currentToken;
-            if (currentToken.type == SEMICOLON) {
-                consumeToken(); 
-                if (!isStartOfStatement(currentToken.type)) {
-                    if (currentToken.type == END) {
-                    break;
-                }
-                    addError(currentToken, "Expected a statement or END after ';'.");
-                    break;
-                }
-            } else {
-                addError(tokenForMissingSemicolonError, "Missing ';' before this statement.");
-            }
+// Report how a run ended, and with 'timed' how fast it went.
+static int reportRun(int rc, const char *error, int errorLine, uint64_t executed,
+                     const struct timespec *start, const struct timespec *stop, int timed) {
+    fflush(stdout);
+    if (rc != 0) {
+        fprintf(stderr, "Runtime Error at Line %d: %s\n", errorLine, error);
+    }
+    double seconds = (double)(stop->tv_sec - start->tv_sec) + (double)(stop->tv_nsec - start->tv_nsec) / 1e9;
+    if (timed && executed == 0) {
+        fprintf(stderr, "Ran in %.3f s\n", seconds);
+    } else if (timed) {
+        fprintf(stderr, "%llu instructions in %.3f s (%.1f million instructions/s)\n",
+                (unsigned long long)executed, seconds, seconds > 0 ? (double)executed / seconds / 1e6 : 0.0);
+    }
+    return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
 
-            if (isStartOfStatement(currentToken.type)) {
-                statement(); 
-            } else {
-                if (currentToken.type != END) { 
-                    addError(currentToken, "Expected a statement to follow."); 
-                }
-                break; 
-            }
-        }
-        if (currentToken.type == END) {
-            consumeToken(); 
-        } else {
-            Token errorToken = (currentToken.type == PERIOD || currentToken.type == EOFS) ? currentToken : previousToken;
-            addError(errorToken, "Expected 'END' keyword to close the block.");
-        }
+// Run mode: generate code for the analyzed program and execute it, reading the
+// program's input from stdin and writing its output to stdout.
+int runProgram(const Compiler *c, int timed, int plain) {
+    Code code = {NULL, NULL, 0, 0, 0};
+    VM vm;
+    if (generateRunnableCode(c, &code, plain) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
     }
-    else { 
-    Error(previousToken, "Expected 'BEGIN' keyword to start the block body after declarations"); 
+    if (initVM(&vm, VM_STACK_CELLS, stdin, stdout) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        freeCode(&code);
+        return EXIT_FAILURE;
     }
-} 
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int rc = runVM(&vm, &code);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    rc = reportRun(rc, vm.error, vm.errorLine, vm.executed, &start, &stop, timed);
+    freeVM(&vm);
+    freeCode(&code);
+    return rc;
+}
 
-void program() {
-    if (currentToken.type == PROGRAM) { 
-        consumeToken(); 
-    } else {
-        Error(previousToken, "Program must start with 'PROGRAM' keyword");
+// The same on the register VM.
+int runRegisterProgram(const Compiler *c, int timed, int optimize) {
+    RegCode code = {NULL, NULL, 0, 0};
+    RegVM vm;
+    if (generateRegisterCode(c, &code, optimize, timed) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
     }
-
-    if (currentToken.type == IDENT) { 
-        consumeToken(); 
-    } else {
-        Error(previousToken, "Expected program name (identifier) after 'PROGRAM'");
+    if (initRegVM(&vm, VM_STACK_CELLS, stdin, stdout) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        freeRegCode(&code);
+        return EXIT_FAILURE;
     }
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int rc = runRegVM(&vm, &code);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    rc = reportRun(rc, vm.error, vm.errorLine, vm.executed, &start, &stop, timed);
+    freeRegVM(&vm);
+    freeRegCode(&code);
+    return rc;
+}
 
-    if (currentToken.type == SEMICOLON) { 
-        consumeToken(); 
-    } else {
-        addError(previousToken, "Expected ';' after program name. Continuing parse.");
-    }
-    currentLevel = 0;
-    scope_stack_ptr++;
-    if (scope_stack_ptr >= MAX_NESTING_DEPTH) {
-        fprintf(stderr, "Critical Error: Maximum nesting depth exceeded.\n");
-        exit(EXIT_FAILURE);
+// The same as machine code, compiled from the register code when it is run.
+int runJitProgram(const Compiler *c, int timed, int optimize) {
+    RegCode code = {NULL, NULL, 0, 0};
+    Jit jit;
+    if (generateRegisterCode(c, &code, optimize, timed) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
     }
-    scope_stack[scope_stack_ptr] = symbolCount;
-    block();
-
-    if (currentToken.type == PERIOD) { 
-        consumeToken();
-    } else {
-        Error(previousToken, "Program must end with a '.'");
+    if (initJit(&jit, VM_STACK_CELLS, stdin, stdout) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        freeRegCode(&code);
+        return EXIT_FAILURE;
     }
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int rc = runJit(&jit, &code);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    rc = reportRun(rc, jit.error, jit.errorLine, 0, &start, &stop, timed);
+    freeJit(&jit);
+    freeRegCode(&code);
+    return rc;
+}
 
-    if (currentToken.type != EOFS) {
-        Error(previousToken, "Unexpected tokens after the final '.'");
+// Native mode: write the program as x86-64 assembly to stdout.
+int writeAssembly(const Compiler *c, int optimize, int timed) {
+    RegCode code = {NULL, NULL, 0, 0};
+    if (generateRegisterCode(c, &code, optimize, timed) != 0 || emitAssembly(&code, stdout) != 0) {
+        fprintf(stderr, "Out of memory or write error\n");
+        freeRegCode(&code);
+        return EXIT_FAILURE;
     }
+    freeRegCode(&code);
+    return fflush(stdout) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-void EnterInputOutputStatement(){
-    Enter("READLN", KIND_PROC, TYPE_NONE, 0, 0);
-    if (symbolCount > 0) {
-        Symbol* readln_sym = &symbolTable[symbolCount - 1];
-        readln_sym->numParams = 1;
-        readln_sym->formalParamTypes[0] = TYPE_INTEGER;
+// The same as C.
+int writeC(const Compiler *c, int optimize, int timed) {
+    IrProgram ir;
+    IrPassRun runs[IR_PIPELINE_LENGTH];
+    if (optimize && optimizeProgram(c, &ir, runs, timed) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
     }
-    Enter("WRITELN", KIND_PROC, TYPE_NONE, 0, 0);
-    if (symbolCount > 0) {
-        Symbol* writeln_sym = &symbolTable[symbolCount - 1];
-        writeln_sym->numParams = 1;
-        writeln_sym->formalParamTypes[0] = TYPE_INTEGER;
+    int rc = emitC(c, optimize ? &ir : NULL, stdout);
+    if (optimize) {
+        freeIr(&ir);
     }
-    Enter("READ", KIND_PROC, TYPE_NONE, 0, 0);
-    if (symbolCount > 0) {
-        Symbol* read_sym = &symbolTable[symbolCount - 1];
-        read_sym->numParams = 1;
-        read_sym->formalParamTypes[0] = TYPE_INTEGER;
+    if (rc != 0) {
+        fprintf(stderr, "Out of memory or write error\n");
+        return EXIT_FAILURE;
     }
-    Enter("WRITE", KIND_PROC, TYPE_NONE, 0, 0);
-    if (symbolCount > 0) {
-        Symbol* write_sym = &symbolTable[symbolCount - 1];
-        write_sym->numParams = 1;
-        write_sym->formalParamTypes[0] = TYPE_INTEGER;
+    return fflush(stdout) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Batch mode: compile every file of a manifest or directory in one process.
+int compileMany(const char *input, int threads, int maxErrors) {
+    FileList files = {NULL, 0, 0};
+    int rc = input[0] == '@' ? readManifest(&files, input + 1) : readDirectory(&files, input);
+    if (rc != 0) {
+        perror(input[0] == '@' ? "Error reading manifest" : "Error reading directory");
+        freeFileList(&files);
+        return EXIT_FAILURE;
     }
+    long failed = compileBatch(&files, threads, maxErrors, stdout);
+    if (failed < 0) {
+        fprintf(stderr, "Out of memory\n");
+    }
+    freeFileList(&files);
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
+
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <source_file>\n", argv[0]);
+    int threads = 0, pipelined = 0, showAst = 0, showCode = 0, showRegCode = 0, showIr = 0, plain = 0, optimize = 0, run = 0, native = 0, timed = 0, maxErrors = 0, argi = 1;
+    for (; argi < argc - 1; argi++) {
+        if (strcmp(argv[argi], "-p") == 0) {
+            pipelined = 1;
+        } else if (strcmp(argv[argi], "-a") == 0) {
+            showAst = 1;
+        } else if (strcmp(argv[argi], "-c") == 0) {
+            showCode = 1;
+        } else if (strcmp(argv[argi], "-C") == 0) {
+            showRegCode = 1;
+        } else if (strcmp(argv[argi], "-I") == 0) {
+            showIr = 1;
+        } else if (strcmp(argv[argi], "-O") == 0) {
+            optimize = 1;
+        } else if (strcmp(argv[argi], "-r") == 0) {
+            run = 1;
+        } else if (strcmp(argv[argi], "-R") == 0) {
+            run = 2;
+        } else if (strcmp(argv[argi], "-J") == 0) {
+            run = 3;
+        } else if (strcmp(argv[argi], "-S") == 0) {
+            native = 1;
+        } else if (strcmp(argv[argi], "-E") == 0) {
+            native = 2;
+        } else if (strcmp(argv[argi], "-F") == 0) {
+            plain = 1;
+        } else if (strcmp(argv[argi], "-t") == 0) {
+            timed = 1;
+        } else if (strcmp(argv[argi], "-j") == 0 && argi + 1 < argc - 1) {
+            threads = atoi(argv[++argi]);
+        } else if (strcmp(argv[argi], "-e") == 0 && argi + 1 < argc - 1) {
+            maxErrors = atoi(argv[++argi]);
+        } else {
+            break;
+        }
+    }
+    if (argi + 1 != argc) {
+        fprintf(stderr, "Usage: %s [-a] [-c] [-C] [-I] [-F] [-O] [-r | -R | -J [-t] | -S | -E] [-p] [-e max_errors] [-j threads] <source_file | directory | @manifest>\n", argv[0]);
+        fprintf(stderr, "  A directory compiles every *.pl0 file in it, a manifest lists one path per line.\n");
         return EXIT_FAILURE;
     }
+    if (argv[argi][0] == '@' || isDirectory(argv[argi])) {
+        return compileMany(argv[argi], threads, maxErrors);
+    }
 
-    inputFile = fopen(argv[1], "r");
-    if (inputFile == NULL) {
+    SourceBuffer inputSource;
+    if (openSourceBuffer(&inputSource, argv[argi]) != 0) {
         perror("Error opening source file");
         return EXIT_FAILURE;
     }
 
-    EnterInputOutputStatement();
-    consumeToken();
-
-    program();
-
-    if (compilationErrorOccurred) {
-        printf("\nCompilation failed due to errors listed above.\n");
-    } else {
+    Compiler compiler;
+    Compiler *c = &compiler;
+    initCompiler(c, stderr);
+    c->pipelined = pipelined;
+    c->maxErrors = maxErrors;
+    CompileStatus status = compileSource(c, &inputSource);
+
+    if ((run || native) && status == COMPILE_OK) {
+        int rc = native == 2 ? writeC(c, optimize, timed) : native ? writeAssembly(c, optimize, timed)
+               : run == 3 ? runJitProgram(c, timed, optimize) : run == 2 ? runRegisterProgram(c, timed, optimize)
+               : runProgram(c, timed, plain);
+        freeCompiler(c);
+        closeSourceBuffer(&inputSource);
+        return rc;
+    }
+
+    // An aborted compilation has already reported its fatal error. With -S and -E
+    // stdout carries only the assembly or C, so the status joins the diagnostics.
+    if (status == COMPILE_ERRORS) {
+        fprintf(native ? stderr : stdout, "\nCompilation failed due to the %d error%s listed above.\n", c->errorCount,
+                c->errorCount == 1 ? "" : "s");
+    } else if (status == COMPILE_OK) {
         printf("\nSemantic analysis successful! (No syntax/semantic errors detected by this phase)\n");
         printf("\nSymbol Table:\n");
         printf("%-15s %-10s %-10s %-10s %-10s %-10s %-10s %-10s %-10s \n",
                "Name", "Kind", "Type", "ElemType", "Value", "Size", "Level" , "Address", "NumParams");
         printf("------------------------------------------------------------------------------------------\n"); 
-        for (int i = 0; i < symbolCount; i++) {
+        for (int i = 0; i < c->symbolCount; i++) {
             const char *kindStr, *typeStr, *elemTypeStr;
-            switch (symbolTable[i].kind) {
+            const ArrayInfo *array = c->symbolTable[i].type == TYPE_ARRAY ? arrayInfoOf(c, i) : NULL;
+            const ProcInfo *proc = c->symbolTable[i].kind == KIND_PROC ? procInfoOf(c, i) : NULL;
+            int numParams = proc ? proc->numParams : 0;
+            switch (c->symbolTable[i].kind) {
                 case KIND_CONST: kindStr = "CONST"; break;
                 case KIND_VAR: kindStr = "VAR"; break;
                 case KIND_PROC: kindStr = "PROC"; break;
                 default: kindStr = "UNKNOWN";
             }
-            typeStr = datatype_to_string(symbolTable[i].type);
-            elemTypeStr = datatype_to_string(symbolTable[i].elementType);
+            typeStr = datatype_to_string(c->symbolTable[i].type);
+            elemTypeStr = datatype_to_string(array ? array->elementType : TYPE_NONE);
 
             printf("%-15s %-10s %-10s %-10s %-10d %-10d %-10d %-10d %-10d ",
-                   symbolTable[i].name,
+                   internedName(&c->names, c->symbolTable[i].nameId),
                    kindStr,
                    typeStr,
                    elemTypeStr,
-                   symbolTable[i].value,
-                   symbolTable[i].size,
-                   symbolTable[i].level,
-                   symbolTable[i].address,
-                   symbolTable[i].numParams
+                   c->symbolTable[i].value,
+                   array ? array->size : 0,
+                   c->symbolTable[i].level,
+                   c->symbolTable[i].address,
+                   numParams
             );
-            if (symbolTable[i].numParams > 0) {
+            if (numParams > 0) {
                 printf("[");
-                for (int j = 0; j < symbolTable[i].numParams; j++) {
-                    printf("%s", datatype_to_string(symbolTable[i].formalParamTypes[j]));
-                    if (j < symbolTable[i].numParams - 1) printf(", ");
+                for (int j = 0; j < numParams; j++) {
+                    printf("%s", datatype_to_string(proc->formalParamTypes[j]));
+                    if (j < numParams - 1) printf(", ");
                 }
                 printf("]");
             }
             printf("\n");
         }
+        if (showAst) {
+            printf("\nSyntax Tree (%d nodes):\n", c->ast.count);
+            printAst(c, c->ast.root, 0);
+        }
+        if (showCode) {
+            Code code = {NULL, NULL, 0, 0, 0};
+            if (generateRunnableCode(c, &code, plain) != 0) {
+                fprintf(stderr, "Out of memory\n");
+            } else {
+                printf("\nCode (%d instructions):\n", code.count);
+                printCode(&code);
+            }
+            freeCode(&code);
+        }
+        if (showRegCode) {
+            RegCode code = {NULL, NULL, 0, 0};
+            if (generateRegisterCode(c, &code, optimize, 0) != 0) {
+                fprintf(stderr, "Out of memory\n");
+            } else {
+                printf("\nRegister Code (%d instructions):\n", code.count);
+                printRegCode(&code);
+            }
+            freeRegCode(&code);
+        }
+        if (showIr) {
+            IrProgram ir;
+            IrPassRun runs[IR_PIPELINE_LENGTH];
+            if (optimizeProgram(c, &ir, runs, 0) != 0) {
+                fprintf(stderr, "Out of memory\n");
+            } else {
+                printf("\nSSA Form (%ld instructions):\n", irInstructionCount(&ir));
+                printIr(&ir);
+                printf("\nPasses:\n");
+                printPassRuns(stdout, runs, IR_PIPELINE_LENGTH);
+                freeIr(&ir);
+            }
+        }
     }
-    fclose(inputFile);
-    return compilationErrorOccurred ? EXIT_FAILURE : EXIT_SUCCESS;
+    freeCompiler(c);
+    closeSourceBuffer(&inputSource);
+    return status == COMPILE_OK ? EXIT_SUCCESS : EXIT_FAILURE;
 }
\ No newline at end of file
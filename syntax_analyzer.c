@@ -8,218 +8,131 @@ Nguyen Khoa Ninh - 20226117
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-
-#define MAX_IDENT_LEN 11
-#define MAX_NUM_LEN 6
-
-typedef enum { // Token types in PL/0
-    NONE = 0, IDENT, NUMBER,
-    BEGIN, CALL, CONST, DO, ELSE, END, FOR, IF, ODD,
-    PROCEDURE, PROGRAM, THEN, TO, VAR, WHILE,
-    PLUS, MINUS, TIMES, SLASH, EQU, NEQ, LSS, LEQ, GTR, GEQ,
-    LPARENT, RPARENT, LBRACK, RBRACK, PERIOD, COMMA, SEMICOLON, ASSIGN, PERCENT,
-    EOFS
-} TokenType;
-
-const TokenType keywordTokens[] = {
-    BEGIN, CALL, CONST, DO, ELSE, END, FOR, IF, ODD,
-    PROCEDURE, PROGRAM, THEN, TO, VAR, WHILE
-};
-
-const char* keywords[] = {
-    "BEGIN", "CALL", "CONST", "DO", "ELSE", "END", "FOR", "IF", "ODD",
-    "PROCEDURE", "PROGRAM", "THEN", "TO", "VAR", "WHILE"
-};
-
-typedef struct {
-    TokenType type;
-    char lexeme[MAX_IDENT_LEN + 1];  // save identifier string
-    int numberValue;                 // Save number value for NUMBER
-} Token;
-
-TokenType getToken(char *str) {
-    int numKeywords = sizeof(keywords) / sizeof(keywords[0]);  // Get number of keywords
-
-    for (int i = 0; i < numKeywords; i++) {
-        if (strcmp(str, keywords[i]) == 0) { // Compare input with keyword list
-            return keywordTokens[i]; // Return corresponding token
-        }
+#include <setjmp.h>
+#include "pl0_lexer.h"
+#include "pl0_sync.h"
+#include "pl0_tokstream.h"
+
+// A syntax error does not end the analysis: the construct it occurred in is
+// abandoned and parsing resumes at the next token in that construct's
+// synchronizing set (pl0_sync.h), so one run reports every error it can.
+// "-e N" stops after N errors.
+
+jmp_buf *recovery = NULL; // Innermost construct to resume after a syntax error, NULL for none
+long tokenCount = 0;      // Tokens consumed so far
+long quietAt = -1;        // No diagnostics while tokenCount is still this (see skipTo)
+int errorCount = 0;
+int maxErrors = 0;        // Stop after this many errors, 0 for no limit
+
+void countError() {
+    if (++errorCount == maxErrors) {
+        fprintf(stderr, "Too many errors (%d), stopping.\n", errorCount);
+        exit(EXIT_FAILURE);
     }
-    
-    return IDENT; // If not a keyword, return IDENT
 }
 
-Token getNextToken(FILE *source) {
-    Token token; 
-    token.type = NONE;
-    token.lexeme[0] = '\0';
-    token.numberValue = 0;
-
-    int ch; 
-
-    // 1. Passing whitespace characters
-    do {
-        ch = fgetc(source);
-        if (ch == EOF) {
-            token.type = EOFS;
-            return token;
-        }
-    } while (isspace(ch));
-
-    // 2. Read input character
-    int i = 0; // index for lexeme
-
-    // 2a. If it's a letter -> IDENT or KEYWORD
-    if (isalpha(ch)) {
-        char Id[MAX_IDENT_LEN + 1];
-        Id[i++] = toupper(ch); 
-        token.lexeme[0] = toupper(ch); 
-
-        while (i < MAX_IDENT_LEN) {
-            ch = fgetc(source);
-            if (isalnum(ch)) { // if character is a number or letter
-                Id[i++] = toupper(ch);
-                token.lexeme[i - 1] = toupper(ch); 
-            } else {
-                ungetc(ch, source); // if not a number or letter, push back the character
-                break; 
-            }
-        }
-
-        Id[i] = '\0';
-        token.lexeme[i] = '\0';
-
-        if (i == MAX_IDENT_LEN) {
-            ch = fgetc(source);
-            if (isalnum(ch)) {
-                fprintf(stderr, "Lexical Error: Identifier starting with '%s' is too long.\n", token.lexeme);
-               
-                while(isalnum(ch = fgetc(source)));
-                ungetc(ch, source);
-                token.type = NONE; // Error: identifier too long
-                return token;
-            } else {
-                ungetc(ch, source); 
-            }
-        }
-
-        token.type = getToken(Id); // Check if the identifier is a keyword
-
-    // 2b. If it's a number -> NUMBER
-    } else if (isdigit(ch)) {
-        char numStr[MAX_NUM_LEN + 1]; 
-        numStr[i++] = ch;
-        token.lexeme[0] = ch;
-        token.numberValue = ch - '0';
-
-        while (i < MAX_NUM_LEN) {
-            ch = fgetc(source);
-            if (isdigit(ch)) {
-                numStr[i++] = ch;
-                token.lexeme[i - 1] = ch;
-                token.numberValue = token.numberValue * 10 + (ch - '0');
-            } else {
-                ungetc(ch, source); // Push back the character if it's not a digit
-                break;
-            }
-        }
-
-        numStr[i] = '\0';
-        token.lexeme[i] = '\0';
-
-        if (i == MAX_NUM_LEN) {
-            ch = fgetc(source);
-            if (isdigit(ch)) {
-                fprintf(stderr, "Lexical Error: Number starting with '%s' is too long.\n", token.lexeme);
-                while(isdigit(ch = fgetc(source)));
-                ungetc(ch, source);
-                token.type = NONE; // Error: number too long
-                return token;
-            } else {
-                ungetc(ch, source); // Push back the character if it's not a digit
-            }
-        }
-        token.type = NUMBER;
-
-    // 2c. If it's a special character -> check for operators and delimiters
-    } else {
-        token.lexeme[i++] = ch; 
-        switch (ch) {
-            case '+': token.type = PLUS; break;
-            case '-': token.type = MINUS; break;
-            case '*': token.type = TIMES; break;
-            case '/': token.type = SLASH; break;
-            case '%': token.type = PERCENT; break;
-            case '=': token.type = EQU; break;
-            case '(': token.type = LPARENT; break;
-            case ')': token.type = RPARENT; break;
-            case '[': token.type = LBRACK; break;
-            case ']': token.type = RBRACK; break;
-            case ',': token.type = COMMA; break;
-            case ';': token.type = SEMICOLON; break;
-            case '.': token.type = PERIOD; break;
-            case '<':
-                ch = fgetc(source); 
-                if (ch == '=') {
-                    token.type = LEQ;
-                    token.lexeme[i++] = ch;
-                } else if (ch == '>') {
-                    token.type = NEQ;
-                    token.lexeme[i++] = ch;
-                } else {
-                    token.type = LSS;
-                    ungetc(ch, source); // Push back if not '=' or '>'
-                }
-                break;
-            case '>':
-                ch = fgetc(source); 
-                if (ch == '=') {
-                    token.type = GEQ;
-                    token.lexeme[i++] = ch;
-                } else {
-                    token.type = GTR;
-                    ungetc(ch, source); // Push back if not '='
-                }
-                break;
-            case ':':
-                ch = fgetc(source); 
-                if (ch == '=') {
-                    token.type = ASSIGN;
-                    token.lexeme[i++] = ch;
-                } else {
-                    ungetc(ch, source); // Push back if not '='
-                    fprintf(stderr, "Lexical Error: Unexpected character ':'\n");
-                    token.type = NONE; // Error: ':' not followed by '='
-                }
-                break;
-            default:
-                fprintf(stderr, "Lexical Error: Unknown character '%c'\n", ch);
-                token.type = NONE; // Error: unknown character
-                break;
-        }
-        token.lexeme[i] = '\0'; // Null-terminate the lexeme
+void reportLexicalError(Token t) {
+    // The parser is bound to reject the bad token as well; that is not worth a second message.
+    quietAt = tokenCount;
+    switch (t.error) {
+        case LEX_IDENT_TOO_LONG:
+            fprintf(stderr, "Lexical Error: Identifier starting with '%.*s' is too long.\n", t.length, t.lexeme);
+            break;
+        case LEX_NUMBER_TOO_LONG:
+            fprintf(stderr, "Lexical Error: Number starting with '%.*s' is too long.\n", t.length, t.lexeme);
+            break;
+        case LEX_EXPECTED_ASSIGN:
+            fprintf(stderr, "Lexical Error: Unexpected character ':'\n");
+            break;
+        default:
+            fprintf(stderr, "Lexical Error: Unknown character '%c'\n", *t.lexeme);
+            break;
     }
+    countError();
+}
 
+Token currentToken;
+SourceBuffer inputSource;
+Interner names;
+Lexer lexer;
+TokenStream tokenStream;
+int fromTokenStream = 0; // 1 when the input is a token stream from "lexical_analyzer -b"
+
+Token getNextToken(Lexer *lexer) {
+    Token token = fromTokenStream ? tokenStreamNext(&tokenStream) : lexNext(lexer);
+    if (token.type == NONE) {
+        reportLexicalError(token);
+    }
     return token;
 }
 
-Token currentToken;
-FILE *inputFile;
+// Report a syntax error at the current token that parsing can carry on after.
+void reportError(const char *msg) {
+    if (tokenCount == quietAt) {
+        return;
+    }
+    fprintf(stderr, "Syntax Error at Line %d, Column %d: %s\n", currentToken.line, currentToken.col, msg);
+    countError();
+}
 
-// Error handling function
+// Error handling function: reports a syntax error and abandons the construct being
+// parsed, resuming at the innermost recovery point.
 void Error(const char *msg) {
-    fprintf(stderr, "Syntax Error: %s\n", msg);
-    exit(EXIT_FAILURE);
-} 
+    reportError(msg);
+    if (recovery == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    longjmp(*recovery, 1);
+}
 
 // Function to consume the current token and get the next one
 void consumeToken() {
-    currentToken = getNextToken(inputFile);
+    tokenCount++;
+    currentToken = getNextToken(&lexer);
+}
+
+// Skip to the next token in 'sync'. Diagnostics are held back until a token past
+// it has been consumed, so that the construct resumed there does not report the
+// same breakage again.
+void skipTo(TokenSet sync) {
+    while (!inTokenSet(currentToken.type, sync)) {
+        consumeToken();
+    }
+    quietAt = tokenCount;
+}
+
+typedef struct {
+    jmp_buf resume;
+    jmp_buf *outer;  // Enclosing recovery point
+    long start;      // tokenCount when the construct began
+} Recovery;
+
+// Make r the innermost recovery point. Must come before the setjmp on r->resume,
+// so that nothing in r changes between that setjmp and a longjmp to it.
+void enterRecovery(Recovery *r) {
+    r->outer = recovery;
+    r->start = tokenCount;
+    recovery = &r->resume;
+}
+
+void leaveRecovery(Recovery *r) {
+    recovery = r->outer;
+}
+
+// Resume after a syntax error unwound to r: skip to 'sync', moving past at least
+// one token so that the same error cannot recur forever.
+void recoverAt(Recovery *r, TokenSet sync) {
+    recovery = r->outer;
+    if (tokenCount == r->start && currentToken.type != EOFS) {
+        consumeToken();
+    }
+    skipTo(sync);
 }
 
 void program();
 void block();
 void statement();
+void statementList();
 void expression();
 void condition();
 void term();
@@ -288,7 +201,7 @@ void condition() {
     }
 }
 
-void statement() {
+void parseStatement() {
     switch (currentToken.type) {
         case IDENT: 
             consumeToken(); 
@@ -333,15 +246,11 @@ void statement() {
 
         case BEGIN:
             consumeToken(); 
-            statement();    
-            while (currentToken.type == SEMICOLON) {
-                consumeToken();
-                statement();       
-            }
+            statementList();
             if (currentToken.type == END) { 
                 consumeToken(); 
             } else {
-                Error("Expected 'END' to close 'BEGIN' block");
+                reportError("Expected 'END' to close 'BEGIN' block");
             }
             break;
 
@@ -403,141 +312,257 @@ void statement() {
     }
 }
 
-void block() {
-    if (currentToken.type == CONST) {
-        consumeToken(); 
-        do {
-            if (currentToken.type == IDENT) {
-                consumeToken(); 
-            } else {
-                Error("Expected identifier in CONST declaration");
-            }
-            if (currentToken.type == EQU) {
-                consumeToken(); 
-            } else {
-                Error("Expected '=' after constant identifier");
-            }
-            if (currentToken.type == NUMBER) {
-                consumeToken();
-            } else {
-                Error("Expected number after '=' in CONST declaration");
-            }
-        } while (currentToken.type == COMMA ? (consumeToken(), 1) : 0); 
+// A statement that is a recovery point: after a syntax error inside it, parsing
+// resumes at the next token in STATEMENT_SYNC.
+void statement() {
+    Recovery r;
+    enterRecovery(&r);
+    if (setjmp(r.resume) != 0) {
+        recoverAt(&r, STATEMENT_SYNC);
+        return;
+    }
+    parseStatement();
+    leaveRecovery(&r);
+}
 
+// The statements of a BEGIN...END, up to the END (which is left to the caller).
+// A missing ';' is reported and the next statement parsed anyway; a token that
+// can neither follow a statement nor start one is reported and skipped.
+void statementList() {
+    statement();
+    for (;;) {
         if (currentToken.type == SEMICOLON) {
             consumeToken();
+        } else if (isStartOfStatement(currentToken.type)) {
+            reportError("Missing ';' before this statement");
+        } else if (currentToken.type == END || inTokenSet(currentToken.type, INPUT_END)) {
+            return;
         } else {
-            Error("Expected ';' after CONST declarations");
+            reportError("Expected ';' or 'END' after statement");
+            consumeToken();
+            skipTo(STATEMENT_SYNC);
+            continue;
         }
-    } 
+        statement();
+    }
+}
 
-    if (currentToken.type == VAR) {
+void constDeclaration() {
+    if (currentToken.type == IDENT) {
         consumeToken(); 
-        do {
+    } else {
+        Error("Expected identifier in CONST declaration");
+    }
+    if (currentToken.type == EQU) {
+        consumeToken(); 
+    } else {
+        Error("Expected '=' after constant identifier");
+    }
+    if (currentToken.type == NUMBER) {
+        consumeToken();
+    } else {
+        Error("Expected number after '=' in CONST declaration");
+    }
+}
+
+void varDeclaration() {
+    if (currentToken.type == IDENT) {
+        consumeToken(); 
+    } else {
+        Error("Expected identifier in VAR declaration");
+    }
+    if (currentToken.type == LBRACK) {
+        consumeToken(); 
+        if (currentToken.type == NUMBER) {
+            consumeToken();
+        } else {
+            Error("Expected number for array size");
+        }
+        if (currentToken.type == RBRACK) {
+            consumeToken(); 
+        } else {
+            Error("Expected ']' after array size");
+        }
+    }
+}
+
+// One CONST or VAR declaration as a recovery point: after a syntax error in it,
+// parsing resumes at the next ',' or at the end of the section.
+void declaration(void (*declare)(void)) {
+    Recovery r;
+    enterRecovery(&r);
+    if (setjmp(r.resume) != 0) {
+        recoverAt(&r, DECLARATION_SYNC | TOKEN_BIT(COMMA));
+        return;
+    }
+    declare();
+    leaveRecovery(&r);
+}
+
+// A CONST or VAR section, from the keyword to the ';'. Anything after a declaration
+// but the ',' or ';' that should follow it is reported and skipped.
+void declarationSection(void (*declare)(void), const char *missingSemicolon) {
+    do {
+        consumeToken(); // CONST, VAR or ','
+        declaration(declare);
+        if (currentToken.type != COMMA && !inTokenSet(currentToken.type, DECLARATION_SYNC)) {
+            reportError(missingSemicolon);
+            skipTo(DECLARATION_SYNC | TOKEN_BIT(COMMA));
+        }
+    } while (currentToken.type == COMMA);
+
+    if (currentToken.type == SEMICOLON) {
+        consumeToken();
+    } else {
+        reportError(missingSemicolon);
+    }
+}
+
+void procedureParameters() {
+    if (currentToken.type == LPARENT) {
+        consumeToken(); 
+        if (currentToken.type == IDENT || currentToken.type == VAR) {
+            if (currentToken.type == VAR) {
+                consumeToken(); 
+            }
             if (currentToken.type == IDENT) {
                 consumeToken(); 
             } else {
-                Error("Expected identifier in VAR declaration");
+                Error("Expected parameter identifier");
             }
-            if (currentToken.type == LBRACK) {
+            while (currentToken.type == SEMICOLON) {
                 consumeToken(); 
-                if (currentToken.type == NUMBER) {
-                    consumeToken();
-                } else {
-                    Error("Expected number for array size");
+                if (currentToken.type == VAR) {
+                    consumeToken(); 
                 }
-                if (currentToken.type == RBRACK) {
+                if (currentToken.type == IDENT) {
                     consumeToken(); 
                 } else {
-                    Error("Expected ']' after array size");
+                    Error("Expected parameter identifier after ';'");
                 }
             }
-        } while (currentToken.type == COMMA ? (consumeToken(), 1) : 0);
-
-        if (currentToken.type == SEMICOLON) {
+        }
+        if (currentToken.type == RPARENT) {
             consumeToken(); 
         } else {
-            Error("Expected ';' after VAR declarations");
+            Error("Expected ')' to end parameter list");
         }
-    } 
+    }
+}
 
-    while (currentToken.type == PROCEDURE) {
+// The name and parameters of a procedure as a recovery point: a broken heading
+// resumes at its ')' or at the procedure's declarations or body.
+void procedureHeading() {
+    Recovery r;
+    enterRecovery(&r);
+    if (setjmp(r.resume) != 0) {
+        recoverAt(&r, HEADING_SYNC);
+        if (currentToken.type == RPARENT) {
+            consumeToken();
+        }
+        return;
+    }
+    if (currentToken.type == IDENT) {
         consumeToken(); 
+    } else {
+        Error("Expected procedure name after PROCEDURE");
+    }
+    procedureParameters();
+    leaveRecovery(&r);
+}
 
-        if (currentToken.type == IDENT) {
-            consumeToken(); 
-        } else {
-            Error("Expected procedure name after PROCEDURE");
-        }
+// A procedure declaration after PROCEDURE, as a recovery point: after a syntax
+// error that its heading and statements could not recover from, parsing resumes
+// at the next declaration or at the body of the enclosing block.
+void procedureDeclaration() {
+    Recovery r;
+    enterRecovery(&r);
+    if (setjmp(r.resume) != 0) {
+        recoverAt(&r, DECLARATION_SYNC);
+        return;
+    }
+    procedureHeading();
+
+    if (currentToken.type == SEMICOLON) {
+        consumeToken(); 
+    } else {
+        reportError("Expected ';' after procedure header");
+    }
 
-        if (currentToken.type == LPARENT) {
+    block();
+    leaveRecovery(&r);
+}
+
+void block() {
+    for (;;) {
+        if (currentToken.type == CONST) {
+            declarationSection(constDeclaration, "Expected ';' after CONST declarations");
+        } 
+
+        if (currentToken.type == VAR) {
+            declarationSection(varDeclaration, "Expected ';' after VAR declarations");
+        } 
+
+        while (currentToken.type == PROCEDURE) {
             consumeToken(); 
-            if (currentToken.type == IDENT || currentToken.type == VAR) {
-                if (currentToken.type == VAR) {
-                    consumeToken(); 
-                }
-                if (currentToken.type == IDENT) {
-                    consumeToken(); 
-                } else {
-                    Error("Expected parameter identifier");
-                }
-                while (currentToken.type == SEMICOLON) {
-                    consumeToken(); 
-                    if (currentToken.type == VAR) {
-                        consumeToken(); 
-                    }
-                    if (currentToken.type == IDENT) {
-                        consumeToken(); 
-                    } else {
-                        Error("Expected parameter identifier after ';'");
-                    }
-                }
-            }
-            if (currentToken.type == RPARENT) {
+            procedureDeclaration();
+
+            if (currentToken.type == SEMICOLON) {
                 consumeToken(); 
             } else {
-                Error("Expected ')' to end parameter list");
+                reportError("Expected ';' after procedure block");
             }
-        }
+        } 
 
-        if (currentToken.type == SEMICOLON) {
-            consumeToken(); 
-        } else {
-            Error("Expected ';' after procedure header");
+        if (currentToken.type == BEGIN || currentToken.type == END ||
+            isStartOfStatement(currentToken.type) || inTokenSet(currentToken.type, INPUT_END)) {
+            break;
         }
-
-        block();
-
+        // Neither the body nor a declaration in order: report it, skip to the next
+        // declaration section (past a ';' ending the stray tokens) and go on from there.
+        reportError("Expected 'BEGIN' keyword to start the block body after declarations");
+        skipTo(DECLARATION_START | STATEMENT_SYNC);
         if (currentToken.type == SEMICOLON) {
-            consumeToken(); 
-        } else {
-            Error("Expected ';' after procedure block");
+            consumeToken();
+            quietAt = tokenCount;
+        } else if (!inTokenSet(currentToken.type, DECLARATION_START)) {
+            break;
         }
-    } 
+    }
 
     if (currentToken.type == BEGIN) { 
         consumeToken(); 
     } else {
-        Error("Expected 'BEGIN' keyword to start the block body after declarations");
+        // Most often the BEGIN is just missing, so the body is parsed as if it were there.
+        reportError("Expected 'BEGIN' keyword to start the block body after declarations");
+        skipTo(STATEMENT_SYNC | STATEMENT_START);
+        if (currentToken.type == BEGIN) {
+            consumeToken();
+        }
     }
 
-    statement();
-
-    while (currentToken.type == SEMICOLON) {
-        consumeToken(); 
-        statement();    
-    }
+    statementList();
 
     if (currentToken.type == END) { 
         consumeToken();
     } else {
-        Error("Expected 'END' keyword to close the block body");
+        reportError("Expected 'END' keyword to close the block body");
     }
 
 } 
 
-
-void program() {
+// PROGRAM, the program name and its ';' as a recovery point: a broken heading
+// resumes at the first declaration or at the body.
+void programHeading() {
+    Recovery r;
+    enterRecovery(&r);
+    if (setjmp(r.resume) != 0) {
+        recoverAt(&r, DECLARATION_SYNC);
+        if (currentToken.type == SEMICOLON) {
+            consumeToken();
+        }
+        return;
+    }
     if (currentToken.type == PROGRAM) { 
         consumeToken(); 
     } else {
@@ -553,40 +578,63 @@ void program() {
     if (currentToken.type == SEMICOLON) { 
         consumeToken(); 
     } else {
-        Error("Expected ';' after program name");
+        reportError("Expected ';' after program name");
     }
+    leaveRecovery(&r);
+}
+
+void program() {
+    programHeading();
 
     block();
 
     if (currentToken.type == PERIOD) { 
         consumeToken();
+        if (currentToken.type != EOFS) {
+            reportError("Unexpected tokens after the final '.'");
+        }
     } else {
-        Error("Program must end with a '.'");
+        reportError("Program must end with a '.'");
     }
 
-    if (currentToken.type != EOFS) {
-        Error("Unexpected tokens after the final '.'");
+    if (errorCount == 0) {
+        printf("Syntax analysis successful!\n");
+    } else {
+        fprintf(stderr, "\nSyntax analysis failed with %d error%s.\n", errorCount, errorCount == 1 ? "" : "s");
     }
-
-    printf("Syntax analysis successful!\n");
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <source_file>\n", argv[0]);
+    int argi = 1;
+    if (argc == 4 && strcmp(argv[1], "-e") == 0) {
+        maxErrors = atoi(argv[2]);
+        argi = 3;
+    }
+    if (argi + 1 != argc) {
+        fprintf(stderr, "Usage: %s [-e max_errors] <source_file | token_stream>\n", argv[0]);
         return EXIT_FAILURE;
     }
 
-    inputFile = fopen(argv[1], "r");
-    if (inputFile == NULL) {
+    if (openSourceBuffer(&inputSource, argv[argi]) != 0) {
         perror("Error opening source file");
         return EXIT_FAILURE;
     }
 
+    initInterner(&names);
+    initLexer(&lexer, &inputSource, &names);
+    if (isTokenStream(&inputSource)) {
+        if (openTokenStream(&tokenStream, &inputSource) != 0) {
+            fprintf(stderr, "Error: %s is not a valid token stream\n", argv[argi]);
+            return EXIT_FAILURE;
+        }
+        fromTokenStream = 1;
+    }
     consumeToken();
 
     program();
 
-    fclose(inputFile);
-    return 0;
+    freeLexer(&lexer);
+    freeInterner(&names);
+    closeSourceBuffer(&inputSource);
+    return errorCount == 0 ? 0 : EXIT_FAILURE;
 }
\ No newline at end of file
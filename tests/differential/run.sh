@@ -0,0 +1,24 @@
+#!/bin/sh
+# sh tests/differential/run.sh ./semantic_analyzer_ver2
+#
+# Runs every program in this directory on the register VM straight from the
+# syntax tree (-R) and again through the optimized SSA form (-O -R, -O -J),
+# and lists those whose output or exit status differ. A program reads the
+# file next to it with the extension .in, or nothing.
+
+analyzer=${1:-./semantic_analyzer_ver2}
+dir=$(dirname "$0")
+failed=0
+for source in "$dir"/*.pl0; do
+    input=${source%.pl0}.in
+    [ -f "$input" ] || input=/dev/null
+    expected=$("$analyzer" -R "$source" < "$input" 2>&1; echo "exit $?")
+    for mode in "-O -R" "-O -J"; do
+        actual=$("$analyzer" $mode "$source" < "$input" 2>&1; echo "exit $?")
+        if [ "$actual" != "$expected" ]; then
+            echo "$source ($mode) differs from -R"
+            failed=1
+        fi
+    done
+done
+exit $failed